@@ -0,0 +1,478 @@
+#include "SyntheticEvent.h"
+#include "EQKAnalyzer.h"
+#include "ModelSpace.h"
+#include "Searcher.h"
+#include "SDContainer.h"
+#include "RadPattern.h"
+#include "SynGenerator.h"
+#include "StaList.h"
+#include "MyOMP.h"
+#include "DisAzi.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+/* offline benchmarks on a synthetic event (src_Driver/SyntheticEvent.h), without any real data:
+	gen writes the event into a directory; run times the kernels (Energy in both methods,
+	Map::PathAverage_Reci, group+phase path averages separate and fused, RadPattern::Predict, SDContainer::BinAverage, SacRec transforms,
+	SynGenerator tracing/ComputeSyn), the station re-ordering of epicenter moves, the loading of
+	large measurement files, EQKAnalyzer::LoadData against the # of threads (generate the event with
+	more periods, e.g. 30, to see it scale), the SA loop overhead on 1 - 64 threads, the ModelSpace
+	read/write throughput, and an end-to-end SA + Monte-Carlo search per method, and writes the timings as JSON. With numa=1 the analyzers of the Energy and end-to-end runs are placed per
+	NUMA node (EQKAnalyzer::PlaceOnNuma); runs with numa=0 and 1 give the speedup */
+
+namespace {
+	typedef std::chrono::steady_clock Clock;
+	double Sec( const Clock::time_point& tb ) { return std::chrono::duration<double>(Clock::now()-tb).count(); }
+
+	// ms per iteration over nrep repetitions of niter iterations
+	struct Result {
+		std::string name;
+		int niter = 0;
+		double mean = 0., min = 0., max = 0.;
+	};
+	std::vector<Result> results;
+	bool useNuma = false;
+
+	// load the data of an analyzer (and place it on the NUMA nodes when asked to)
+	void Load( EQKAnalyzer& eka ) {
+		eka.LoadData();
+		if( ! useNuma ) return;
+		eka.Set( "numa" );
+		eka.PlaceOnNuma();
+	}
+
+	// times func(iter), after one warm-up call
+	template <class Func>
+	void Time( const std::string& name, const int nrep, const int niter, const Func& func ) {
+		func( 0 );
+		Result res; res.name = name; res.niter = niter; res.min = 1.e30;
+		for( int irep=0; irep<nrep; irep++ ) {
+			const auto tb = Clock::now();
+			for( int iter=0; iter<niter; iter++ ) func( iter );
+			const double t = Sec(tb) * 1.e3 / niter;
+			res.mean += t / nrep; res.min = std::min(res.min, t); res.max = std::max(res.max, t);
+		}
+		std::cout<<"### "<<name<<": "<<res.mean<<" ms ("<<res.min<<" - "<<res.max<<") per iteration. ###"<<std::endl;
+		results.push_back( res );
+	}
+
+	// a data handler whose energy costs next to nothing, so that an SA step times only the
+	// search loop itself: the perturbations, the spawn barrier, the reductions and the selection
+	struct NullData : public Searcher::IDataHandler<ModelInfo> {
+		ModelInfo mtrue;
+		NullData( const ModelInfo& mtrue ) : mtrue(mtrue) {}
+		void Energy( const ModelInfo& mi, float& E, int& Ndata ) const {
+			E = std::fabs(mi.lon-mtrue.lon) + std::fabs(mi.lat-mtrue.lat) + std::fabs(mi.stk-mtrue.stk)*0.01 + std::fabs(mi.dep-mtrue.dep)*0.1;
+			Ndata = 1;
+		}
+	};
+
+	// us per SA step (one spawn per thread) and per evaluation, on nthread threads
+	struct Scale {
+		int nthread = 0, nstep = 0;
+		double usStep = 0., usEval = 0.;
+	};
+
+	Scale LoopOverhead( const std::string& fparam, const ModelInfo& mtrue, const int nthread, const int nstep ) {
+		omp_set_num_threads( nthread );
+		ModelSpace ms( fparam );
+		ms.SetFreeFocal();
+		NullData nd( mtrue );
+		std::ofstream fnull( "/dev/null" );
+		Scale sc; sc.nthread = nthread; sc.nstep = nstep;
+		const auto tb = Clock::now();
+		Searcher::SimulatedAnnealing<ModelInfo>( ms, nd, nstep*nthread, 1., 1.e-3, 0, fnull, -1, false );
+		const double t = Sec(tb) * 1.e6;
+		sc.usStep = t / nstep; sc.usEval = t / (nstep*nthread);
+		std::cout<<"### SA loop on "<<nthread<<" threads: "<<sc.usStep<<" us per step, "<<sc.usEval<<" us per evaluation. ###"<<std::endl;
+		return sc;
+	}
+
+	// ModelSpace throughput on nthread threads over sec seconds: perturbations (reads of the
+	// space) per sec with all threads reading, then with thread 0 re-shaping the space
+	// (SetPerturb/Centralize, the writes) as fast as it can while the others read
+	struct RW {
+		int nthread = 0;
+		double readsAlone = 0., reads = 0., writes = 0.;
+	};
+
+	RW ModelSpaceRW( const std::string& fparam, const int nthread, const double sec ) {
+		const int nthdmax = omp_get_max_threads();
+		omp_set_num_threads( nthread );	// ModelSpace keeps one RNG per thread
+		ModelSpace ms( fparam );
+		RW rw; rw.nthread = nthread;
+		for( const bool withWriter : { false, true } ) {
+			long nread = 0, nwrite = 0;
+			const auto tb = Clock::now();
+			#pragma omp parallel num_threads(nthread) reduction(+:nread,nwrite)
+			{
+			const bool writer = withWriter && omp_get_thread_num()==0;
+			ModelInfo minew;
+			for( long n=0; ; n++ ) {
+				if( (n&63)==0 && Sec(tb)>sec ) break;
+				if( ! writer ) { ms.Perturb( minew ); nread++; }
+				else if( n%2 ) { ms.Centralize(); nwrite++; }
+				else { ms.SetPerturb( true, true, true, false, true, true, true, true ); nwrite++; }
+			}
+			}
+			const double t = Sec(tb);
+			if( withWriter ) { rw.reads = nread/t; rw.writes = nwrite/t; }
+			else rw.readsAlone = nread/t;
+		}
+		omp_set_num_threads( nthdmax );
+		std::cout<<"### ModelSpace on "<<nthread<<" threads: "<<rw.readsAlone<<" reads/sec alone, "<<rw.reads
+					<<" reads/sec and "<<rw.writes<<" writes/sec with a writer. ###"<<std::endl;
+		return rw;
+	}
+
+	/* SDContainer::UpdateAziDis for nsta stations scattered within 10 deg of the event, with
+		the epicenter random-walking by step deg per call (as in MonteCarlo), against the same
+		update with the StaData records std::sort-ed on each call (the former ordering) */
+	void AziSort( const ModelInfo& mi, const int nsta, const float step, const int nrep ) {
+		std::mt19937 gen( 17 ); std::uniform_real_distribution<float> U(-10., 10.);
+		std::normal_distribution<float> N(0., step);
+		SDContainer sdc( 10., R, true );
+		std::vector<StaData> sdV;
+		for( int i=0; i<nsta; i++ ) {
+			StaData sd( AziData::NaN, mi.lon+U(gen), mi.lat+U(gen), 0., 0., 0. );
+			sdc.push_back( sd ); sdV.push_back( sd );
+		}
+		float lon = mi.lon, lat = mi.lat;
+		sdc.UpdateAziDis( lon, lat );
+		const std::string sstep = std::to_string(step).substr(0, 4);
+		Time( "SDContainer::UpdateAziDis (" + std::to_string(nsta) + " stations, step " + sstep + " deg)", nrep, 200, [&]( int ) {
+			lon = mi.lon + (lon-mi.lon)*0.9 + N(gen); lat = mi.lat + (lat-mi.lat)*0.9 + N(gen);
+			sdc.UpdateAziDis( lon, lat );
+		} );
+		lon = mi.lon; lat = mi.lat;
+		Time( "record sort (" + std::to_string(nsta) + " stations, step " + sstep + " deg)", nrep, 200, [&]( int ) {
+			lon = mi.lon + (lon-mi.lon)*0.9 + N(gen); lat = mi.lat + (lat-mi.lat)*0.9 + N(gen);
+			for( auto& sd : sdV ) {
+				Path<double> path( lon, lat, sd.lon, sd.lat );
+				sd.dis = path.Dist(); sd.azi = path.Azi1();
+			}
+			std::sort( sdV.begin(), sdV.end() );
+		} );
+	}
+
+	/* SDContainer::LoadMeasurements of nper periods of nsta stations (1% of the lines repeat a
+		station, all stations are in the station list), against the same duplicate/station
+		lookups done by the former linear scans */
+	void LoadLarge( const ModelInfo& mi, const int nsta, const int nper, const int nrep ) {
+		const std::string fmeas = "bench_load.meas", fsta = "bench_load.lst";
+		std::mt19937 gen( 19 ); std::uniform_real_distribution<float> U(-15., 15.);
+		std::vector<StaInfo> staV;
+		for( int i=0; i<nsta; i++ ) staV.push_back( StaInfo( "S"+std::to_string(i), mi.lon+U(gen), mi.lat+U(gen) ) );
+		{
+			std::ofstream fout( fsta );
+			for( const auto& sta : staV ) fout<<sta.lon<<" "<<sta.lat<<" "<<sta.name<<"\n";
+			std::ofstream fmout( fmeas );
+			for( int i=0; i<nsta; i++ ) {
+				const auto& sta = staV[ i%100==99 ? i-1 : i ];
+				fmout<<sta.lon<<" "<<sta.lat<<" "<<300.+i%50<<" "<<290.+i%50<<" "<<1.+i%7<<"\n";
+			}
+		}
+		const std::string sname = std::to_string(nsta) + " stations x " + std::to_string(nper) + " periods";
+		Time( "SDContainer::LoadMeasurements (" + sname + ")", nrep, 1, [&]( int ) {
+			std::stringstream sout;	// silence the per-file reports and warnings
+			auto coutbuf = std::cout.rdbuf( sout.rdbuf() ), cerrbuf = std::cerr.rdbuf( sout.rdbuf() );
+			for( int iper=0; iper<nper; iper++ )
+				SDContainer( 10.+iper, R, true, fmeas, 3.0, 3.5, fsta, mi.lon, mi.lat );
+			std::cout.rdbuf( coutbuf ); std::cerr.rdbuf( cerrbuf );
+		} );
+		std::vector<StaData> sdV;
+		for( int i=0; i<nsta; i++ ) sdV.push_back( StaData( AziData::NaN, staV[i].lon, staV[i].lat, 0., 0., 0. ) );
+		Time( "linear station scans (" + sname + ")", nrep, 1, [&]( int ) {
+			int nfound = 0;
+			for( int iper=0; iper<nper; iper++ ) {
+				std::vector<StaData> accV;
+				for( const auto& sd : sdV ) {
+					if( std::find_if( accV.begin(), accV.end(), [&]( const StaData& sd2 ) { return sd.IsSameLocation(sd2); } ) != accV.end() ) continue;
+					nfound += std::find_if( staV.begin(), staV.end(), [&]( const StaInfo& sta ) { return sd.IsSameLocation(sta); } ) != staV.end();
+					accV.push_back( sd );
+				}
+			}
+			if( nfound < 0 ) std::cout<<nfound;
+		} );
+		remove( fmeas.c_str() ); remove( fsta.c_str() );
+	}
+
+	// sec to load the measurements and maps of all periods (EQKAnalyzer::LoadData) on nthread threads
+	struct Startup {
+		int nthread = 0, nperiod = 0;
+		double sec = 0.;
+	};
+
+	Startup LoadData( const std::string& fparam, const int nthread ) {
+		const int nthdmax = omp_get_max_threads();
+		omp_set_num_threads( nthread );
+		EQKAnalyzer eka( fparam, false );
+		const auto tb = Clock::now();
+		eka.LoadData();
+		Startup st; st.nthread = nthread; st.sec = Sec(tb);
+		omp_set_num_threads( nthdmax );
+		std::cout<<"### LoadData on "<<nthread<<" threads: "<<st.sec<<" sec. ###"<<std::endl;
+		return st;
+	}
+
+	// an SA + Monte-Carlo search (as EQKSolver -rsa, with nsearch searches), timed per stage
+	struct E2E {
+		std::string mode;
+		int nsearch = 0;
+		double secStat = 0., secSA = 0., secMC = 0.;
+		float Einit = 0., Efinal = 0.;
+		int Ndata = 0;
+		ModelInfo minit, mfinal;
+	};
+
+	E2E Search( const std::string& mode, const std::string& fparam, const int nsearch ) {
+		E2E e2e; e2e.mode = mode; e2e.nsearch = nsearch;
+		ModelSpace ms( fparam );
+		EQKAnalyzer eka( fparam, false );
+		Load( eka );
+		e2e.minit = ms; eka.Energy( ms, e2e.Einit, e2e.Ndata );
+		std::ofstream fnull( "/dev/null" );
+
+		auto tb = Clock::now();
+		eka.SetCorrectM0(true);
+		ms.SetFreeFocal();
+		float Emean, Estd;
+		Searcher::EStatistic<ModelInfo>( ms, eka, 50, Emean, Estd );
+		e2e.secStat = Sec(tb);
+
+		tb = Clock::now();
+		const double Tinit = 3. * (Emean+3*Estd), Tfinal = 1.e-4 * Emean;
+		ms.SetPerturb( true, true, true, false, true, true, true, true );	// do not perturb M0
+		Searcher::SimulatedAnnealing<ModelInfo>( ms, eka, nsearch*4/5, Tinit, Tfinal, 0, fnull, 0, false );
+		ms.Bound( 2.5, 0.03 );
+		Searcher::SimulatedAnnealing<ModelInfo>( ms, eka, nsearch/5, Tinit*0.01, Tfinal*0.01, 0, fnull, 0, false );
+		e2e.secSA = Sec(tb);
+
+		tb = Clock::now();
+		eka.SetCorrectM0(false);
+		ms.SetFreeFocal();
+		Searcher::MonteCarlo<ModelInfo>( ms, eka, nsearch, eka.outname_pos );
+		e2e.secMC = Sec(tb);
+
+		e2e.mfinal = ms; eka.Energy( ms, e2e.Efinal, e2e.Ndata );
+		return e2e;
+	}
+
+	std::string JModel( const ModelInfo& mi ) {
+		std::stringstream ss;
+		ss<<"{\"lon\":"<<mi.lon<<",\"lat\":"<<mi.lat<<",\"t0\":"<<mi.t0<<",\"stk\":"<<mi.stk<<",\"dip\":"<<mi.dip
+		  <<",\"rak\":"<<mi.rak<<",\"dep\":"<<mi.dep<<",\"M0\":"<<mi.M0<<"}";
+		return ss.str();
+	}
+}
+
+int main( int argc, char* argv[] ) {
+	const std::string mode = argc>1 ? argv[1] : "";
+	if( (mode!="gen" && mode!="run") || argc<3 ) {
+		std::cerr<<"Usage: "<<argv[0]<<" gen [dir] [nsta (optional, default=30)] [nper (optional, default=4)] "
+					<<"[map grid in deg (optional, default=0.5)] [seed (optional, default=11)]\n"
+					<<"       "<<argv[0]<<" run [dir] [output json (optional, default=stdout)] [nrep (optional, default=5)] "
+					<<"[nsearch of the SA/MC run (optional, default=200; 0=skip)] [numa (optional, default=0)]"<<std::endl;
+		return -1;
+	}
+	const std::string dir = argv[2];
+
+	try {
+		if( mode == "gen" ) {
+			SyntheticEvent se( argc>3 ? atoi(argv[3]) : 30, argc>4 ? atoi(argv[4]) : 4,
+									 argc>5 ? atof(argv[5]) : 0.5, argc>6 ? atoi(argv[6]) : 11 );
+			const auto tb = Clock::now();
+			se.Write( dir );
+			std::cout<<"### synthetic event written to "<<dir<<" in "<<Sec(tb)<<" sec. ###"<<std::endl;
+			return 0;
+		}
+
+		// run: paths in the params are relative to dir
+		std::string fjson = argc>3 ? argv[3] : "";
+		if( ! fjson.empty() && fjson[0] != '/' ) {
+			char cwd[4096];
+			if( getcwd(cwd, sizeof(cwd)) ) fjson = std::string(cwd) + "/" + fjson;
+		}
+		const int nrep = argc>4 ? atoi(argv[4]) : 5, nsearch = argc>5 ? atoi(argv[5]) : 200;
+		useNuma = argc>6 && atoi(argv[6])!=0;
+		if( nrep <= 0 || nsearch < 0 ) throw std::runtime_error( "invalid nrep/nsearch" );
+		const SyntheticEvent se = SyntheticEvent::Read( dir );
+		if( chdir(dir.c_str()) != 0 ) throw std::runtime_error( "cannot access " + dir );
+		const auto& mi = se.minfo;
+		const float per0 = se.MeasurementPeriods().front();
+		const std::string fbase = "data/R_" + std::to_string((int)per0);
+
+		// Energy, one perturbed model per iteration
+		for( const std::string m : { "measurement", "waveform" } ) {
+			const std::string fparam = m=="waveform" ? "param_wave.txt" : "param_disp.txt";
+			ModelSpace ms( fparam );
+			EQKAnalyzer eka( fparam, false );
+			Load( eka );
+			Time( "EQKAnalyzer::Energy (" + m + ")", nrep, m=="waveform" ? 10 : 50, [&]( int ) {
+				ModelInfo minew; ms.Perturb( minew );
+				float E; int Ndata; eka.Energy( minew, E, Ndata );
+			} );
+		}
+
+		std::vector<StaInfo> staV;
+		{
+			std::ifstream fin( "stations.lst" );
+			for( std::string line; std::getline(fin, line); ) staV.push_back( StaInfo(line) );
+		}
+
+		// group-time path averages from the event, over all stations (lambda = per * SDContainer::Lfactor)
+		Map mapG( fbase + ".G.map" ); mapG.SetSource( mi.lon, mi.lat );
+		Time( "Map::PathAverage_Reci", nrep, staV.size(), [&]( int ista ) {
+			float perc; mapG.PathAverage_Reci( staV[ista], perc, per0*2.5 );
+		} );
+
+		// group+phase path averages: two PathAverage_Reci calls against one fused pass
+		Map mapP( fbase + ".P.map" ); mapP.SetSource( mi.lon, mi.lat );
+		if( mapG.SameGrid(mapP) ) {
+			Time( "Map::PathAverage_Reci (group+phase)", nrep, staV.size(), [&]( int ista ) {
+				float perc; mapG.PathAverage_Reci( staV[ista], perc, per0*2.5 ); mapP.PathAverage_Reci( staV[ista], perc, per0*2.5 );
+			} );
+			Map* const maps[2] = { &mapG, &mapP };
+			const Map::AvgType types[2] = { Map::Reci, Map::Reci };
+			Time( "Map::PathAverage_Fused (group+phase)", nrep, staV.size(), [&]( int ista ) {
+				float vels[2], percs[2]; Map::PathAverage_Fused( maps, types, 2, staV[ista], vels, percs, per0*2.5 );
+			} );
+		}
+
+		// radiation patterns at all measurement periods (the strike changes each call)
+		RadPattern rp( 'R', "R.eig" );
+		Time( "RadPattern::Predict", nrep, 20, [&]( int iter ) {
+			rp.Predict( mi.stk + (iter%2 ? 0.1 : -0.1), mi.dip, mi.rak, mi.dep, mi.M0, se.MeasurementPeriods() );
+		} );
+
+		// azimuthal bin averages of the misfits at the true model
+		SDContainer sdc( per0, R, true, fbase+".meas", fbase+".G.map", fbase+".P.map", "stations.lst", mi.lon, mi.lat );
+		sdc.UpdatePathPred( mi.lon, mi.lat, mi.t0 );
+		rp.Predict( mi.stk, mi.dip, mi.rak, mi.dep, mi.M0, se.MeasurementPeriods() );
+		sdc.UpdateSourcePred( rp );
+		Time( "SDContainer::BinAverage", nrep, 50, [&]( int ) {
+			std::vector<AziData> adVmean, adVvar;
+			sdc.BinAverage( adVmean, adVvar, true, true, true );
+		} );
+
+		// station re-ordering for epicenter moves of the size of the MonteCarlo steps
+		for( const float step : { 0.01, 0.05, 0.2 } ) AziSort( mi, 1000, step, nrep );
+
+		// measurement files of a large array
+		LoadLarge( mi, 5000, 30, std::min(nrep, 3) );
+
+		// startup (all periods of both wave types) from 1 thread to all
+		std::vector<Startup> startV;
+		for( int nthd=1; ; nthd=std::min(nthd*2, omp_get_max_threads()) ) {
+			startV.push_back( LoadData( "param_disp.txt", nthd ) );
+			startV.back().nperiod = se.nper * 2;
+			if( nthd == omp_get_max_threads() ) break;
+		}
+
+		// SAC transforms on the first record
+		std::string fsac;
+		{ std::ifstream flst( "data/saclistR.txt" ); flst >> fsac; }
+		SacRec sac( fsac ); sac.Load();
+		Time( "SacRec::ToAmPh+FromAmPh", nrep, 50, [&]( int ) {
+			SacRec sacam, sacph, sacout( sac );
+			sac.ToAmPh( sacam, sacph );
+			sacout.FromAmPh( sacam, sacph );
+		} );
+		Time( "SacRec::BandpassCOSFilt", nrep, 50, [&]( int ) {
+			SacRec sacout( sac ); sacout.BandpassCOSFilt( 0.04, 0.05, 0.15, 0.17 );
+		} );
+		Time( "SacRec::Preprocess", nrep, 50, [&]( int ) {
+			SacRec sacout( sac ); sacout.Preprocess( 0.04, 0.05, 0.15, 0.17 );
+		} );
+
+		// tracing (event to all stations, all periods) and per-station synthetics
+		SynGenerator synG( "model.R.bin", "R.phv", "R.eig", 'R', 0 );
+		for( const auto& sta : staV ) {
+			SacRec s;
+			snprintf( s.shd.kstnm, sizeof(s.shd.kstnm), "%s", sta.name.c_str() ); snprintf( s.shd.knetwk, sizeof(s.shd.knetwk), "%s", sta.net.c_str() );
+			s.shd.stlo = sta.lon; s.shd.stla = sta.lat;
+			synG.PushbackSta( s );
+		}
+		Time( "SynGenerator::TraceAll", nrep, 2, [&]( int ) {
+			synG.SetEvent( mi ); synG.Trace();
+		} );
+		Time( "SynGenerator::ComputeSyn", nrep, staV.size(), [&]( int ista ) {
+			SacRec z, r, t;
+			synG.ComputeSyn( staV[ista].name, staV[ista].lon, staV[ista].lat, 3000, 1., z, r, t, false );
+		} );
+
+		// SA loop overhead (no data) from 1 to 64 threads; the time per step should stay flat
+		std::vector<Scale> scaleV;
+		const int nthdmax = omp_get_max_threads();
+		for( int nthd=1; nthd<=64; nthd*=2 ) scaleV.push_back( LoopOverhead( "param_disp.txt", mi, nthd, 200 ) );
+		omp_set_num_threads( nthdmax );
+
+		// ModelSpace reads against a writer
+		const RW rw = ModelSpaceRW( "param_disp.txt", std::max(nthdmax, 2), 1. );
+
+		// end to end
+		std::vector<E2E> e2eV;
+		if( nsearch > 0 )
+			for( const std::string m : { "measurement", "waveform" } )
+				e2eV.push_back( Search( m, m=="waveform" ? "param_wave.txt" : "param_disp.txt", nsearch ) );
+
+		// JSON
+		std::stringstream ss;
+		ss<<"{\"build\":{\"compiler\":\""<<__VERSION__<<"\",\"profile\":";
+#ifdef EQK_PROFILE
+		ss<<"true";
+#else
+		ss<<"false";
+#endif
+		ss<<",\"threads\":"<<omp_get_max_threads()<<",\"numa\":"<<(useNuma?"true":"false")<<",\"numa_nodes\":"<<Numa::NNode()<<"},\n \"dataset\":{\"dir\":\""<<dir<<"\",\"nsta\":"<<se.nsta<<",\"nper\":"<<se.nper
+		  <<",\"grid\":"<<se.dgrid<<",\"noise\":"<<se.noise<<",\"seed\":"<<se.seed<<",\"truth\":"<<JModel(mi)<<"},\n \"nrep\":"<<nrep
+		  <<",\n \"kernels\":[";
+		for( int i=0; i<results.size(); i++ ) {
+			const auto& res = results[i];
+			ss<<(i==0?"\n  ":",\n  ")<<"{\"name\":\""<<res.name<<"\",\"niter\":"<<res.niter<<",\"ms_mean\":"<<res.mean
+			  <<",\"ms_min\":"<<res.min<<",\"ms_max\":"<<res.max<<"}";
+		}
+		ss<<"],\n \"sa_loop\":[";
+		for( int i=0; i<scaleV.size(); i++ ) {
+			const auto& sc = scaleV[i];
+			ss<<(i==0?"\n  ":",\n  ")<<"{\"threads\":"<<sc.nthread<<",\"nstep\":"<<sc.nstep<<",\"us_step\":"<<sc.usStep
+			  <<",\"us_eval\":"<<sc.usEval<<"}";
+		}
+		ss<<"],\n \"startup\":[";
+		for( int i=0; i<startV.size(); i++ ) {
+			const auto& st = startV[i];
+			ss<<(i==0?"\n  ":",\n  ")<<"{\"threads\":"<<st.nthread<<",\"periods\":"<<st.nperiod<<",\"sec\":"<<st.sec<<"}";
+		}
+		ss<<"],\n \"modelspace\":{\"threads\":"<<rw.nthread<<",\"reads_per_sec_alone\":"<<rw.readsAlone
+		  <<",\"reads_per_sec\":"<<rw.reads<<",\"writes_per_sec\":"<<rw.writes<<"}";
+		ss<<",\n \"e2e\":[";
+		for( int i=0; i<e2eV.size(); i++ ) {
+			const auto& e2e = e2eV[i];
+			ss<<(i==0?"\n  ":",\n  ")<<"{\"mode\":\""<<e2e.mode<<"\",\"nsearch\":"<<e2e.nsearch
+			  <<",\"sec\":{\"estatistic\":"<<e2e.secStat<<",\"sa\":"<<e2e.secSA<<",\"mc\":"<<e2e.secMC
+			  <<",\"total\":"<<e2e.secStat+e2e.secSA+e2e.secMC<<"},\"Ndata\":"<<e2e.Ndata<<",\"Einit\":"<<e2e.Einit
+			  <<",\"Efinal\":"<<e2e.Efinal<<",\"init\":"<<JModel(e2e.minit)<<",\"final\":"<<JModel(e2e.mfinal)<<"}";
+		}
+		ss<<"]}\n";
+		if( fjson.empty() ) {
+			std::cout<<ss.str();
+		} else {
+			std::ofstream fout( fjson );
+			if( ! (fout << ss.str()) ) throw std::runtime_error( "cannot write to " + fjson );
+			std::cout<<"### results written to "<<fjson<<" ###"<<std::endl;
+		}
+	} catch( std::exception& e ) {
+		std::cerr<<e.what()<<std::endl;
+		return -2;
+	}
+
+	return 0;
+}
@@ -65,6 +65,12 @@ int main( int argc, char* argv[] ) {
 		// initialize eqk analyzer (do not move/save old outputs just yet)
 		EQKAnalyzer eka( fparam, false );
 		eka.LoadData();
+		// path corrections over the epicenter box (if param pathTable is set)
+		float lonmin, lonmax, latmin, latmax;
+		ms.EpicBox( lonmin, lonmax, latmin, latmax );
+		eka.LoadPathTables( lonmin, lonmax, latmin, latmax );
+		// threads and data per NUMA node (if param numa is set)
+		eka.PlaceOnNuma();
 
 		// option -pic: print out initial chiSquare
 		//if( std::find(options.begin(), options.end(), 'c') != options.end() ) {
@@ -0,0 +1,45 @@
+#include "Map.h"
+#include <iostream>
+#include <chrono>
+
+/* convert a text map (lon lat data) into the binary map format and
+ * report the startup (load + hash) time of both formats */
+int main(int argc, char* argv[]) {
+	/* check #params */
+	if( argc!=3 && argc!=5 ) {
+		std::cerr<<"Usage: "<<argv[0]<<" [input text map] [output binary map] [grdlon grdlat (optional, default=1 1)]"<<std::endl;
+		exit(-1);
+	}
+	float grdlon = argc==5 ? atof(argv[3]) : 1.;
+	float grdlat = argc==5 ? atof(argv[4]) : 1.;
+	if( grdlon<=0. || grdlat<=0. ) {
+		std::cerr<<"Invalid grid size: "<<grdlon<<" "<<grdlat<<std::endl;
+		exit(-2);
+	}
+
+	using Clock = std::chrono::steady_clock;
+	auto msSince = []( const Clock::time_point& t0 ) {
+		return std::chrono::duration<float, std::milli>(Clock::now()-t0).count();
+	};
+
+	// load the text map
+	auto t0 = Clock::now();
+	Map mapT( argv[1], grdlon, grdlat );
+	float tT = msSince(t0);
+
+	// write and re-load in binary
+	mapT.SaveBinary( argv[2] );
+	t0 = Clock::now();
+	Map mapB( argv[2], grdlon, grdlat );
+	float tB = msSince(t0);
+
+	// check
+	if( mapB.size()!=mapT.size() || mapB.isReg()!=mapT.isReg() ) {
+		std::cerr<<"Inconsistent maps after conversion: "<<mapT.size()<<" vs "<<mapB.size()<<" points"<<std::endl;
+		exit(-3);
+	}
+	std::cout<<"### "<<mapT.size()<<" points ("<<(mapT.isReg()?"regular":"irregular")<<" grid) in region "<<mapT<<" ###\n"
+				<<"### startup time: text = "<<tT<<" ms, binary = "<<tB<<" ms ###"<<std::endl;
+
+	return 0;
+}
@@ -0,0 +1,76 @@
+#include "Map.h"
+#include "DisAzi.h"
+#include <iostream>
+#include <chrono>
+#include <random>
+
+/* regression check of the fused path averages (Map::PathAverage_Fused) against separate
+ * Map::PathAverage_Reci calls, on a group and a phase map of one grid: random sources in the
+ * maps, receivers around each, lambda as in SDContainer::UpdatePathPred. Reports the speedup of
+ * the fused pass. Exits with -3 when any average or perc differs */
+int main(int argc, char* argv[]) {
+	/* check #params */
+	if( argc!=4 && argc!=5 && argc!=6 ) {
+		std::cerr<<"Usage: "<<argv[0]<<" [group map] [phase map] [period] [# of sources (optional, default=5)] [# of receivers per source (optional, default=100)]"<<std::endl;
+		exit(-1);
+	}
+	const float per = atof(argv[3]);
+	const int nsrc = argc>4 ? atoi(argv[4]) : 5, nrec = argc>5 ? atoi(argv[5]) : 100;
+	if( per<=0. || nsrc<=0 || nrec<=0 ) {
+		std::cerr<<"Invalid period/# of sources/receivers: "<<per<<" "<<nsrc<<" "<<nrec<<std::endl;
+		exit(-2);
+	}
+
+	/* maps */
+	Map mapG( argv[1] ), mapP( argv[2] );
+	if( ! mapG.SameGrid(mapP) ) {
+		std::cerr<<"The group and phase maps are not on the same grid."<<std::endl;
+		exit(-2);
+	}
+	Map* const maps[2] = { &mapG, &mapP };
+	const Map::AvgType types[2] = { Map::Reci, Map::Reci };
+
+	/* sources and receivers within the map region */
+	std::mt19937 gen(17);
+	std::uniform_real_distribution<float> Ulon( mapG.LonMin(), mapG.LonMax() ), Ulat( mapG.LatMin(), mapG.LatMax() );
+	std::vector<Point<float>> srcV, recV;
+	for( int isrc=0; isrc<nsrc; isrc++ ) srcV.push_back( Point<float>(Ulon(gen), Ulat(gen)) );
+	for( int irec=0; irec<nrec; irec++ ) recV.push_back( Point<float>(Ulon(gen), Ulat(gen)) );
+
+	/* averages: separate calls then fused */
+	const float lambda = per * 2.5;
+	auto Lambda = [&]( const float dis ) { return dis<300. ? (lambda * (2.5-dis*0.005)) : lambda; };
+	std::vector<float> sepV, fusV;
+	float tsep = 0., tfus = 0.;
+	for( const auto& src : srcV ) {
+		mapG.SetSource( src ); mapP.SetSource( src );
+		auto t0 = std::chrono::steady_clock::now();
+		for( const auto& rec : recV ) {
+			const float lam = Lambda( Path<float>(src, rec).Dist() );
+			float percG, percP;
+			sepV.push_back( mapG.PathAverage_Reci( rec, percG, lam ).Data() ); sepV.push_back( percG );
+			sepV.push_back( mapP.PathAverage_Reci( rec, percP, lam ).Data() ); sepV.push_back( percP );
+		}
+		auto t1 = std::chrono::steady_clock::now();
+		for( const auto& rec : recV ) {
+			const float lam = Lambda( Path<float>(src, rec).Dist() );
+			float vels[2], percs[2];
+			Map::PathAverage_Fused( maps, types, 2, rec, vels, percs, lam );
+			fusV.push_back( vels[0] ); fusV.push_back( percs[0] );
+			fusV.push_back( vels[1] ); fusV.push_back( percs[1] );
+		}
+		auto t2 = std::chrono::steady_clock::now();
+		tsep += std::chrono::duration<float, std::milli>(t1-t0).count();
+		tfus += std::chrono::duration<float, std::milli>(t2-t1).count();
+	}
+
+	/* compare (bitwise: the fused pass does the same float operations in the same order) */
+	int nbad = 0;
+	for( int i=0; i<sepV.size(); i++ ) if( sepV[i] != fusV[i] ) nbad++;
+	std::cout<<"### "<<nsrc*nrec<<" paths compared: "<<nbad<<" of "<<sepV.size()<<" values differ. ###"<<std::endl;
+	std::cout<<"### separate: "<<tsep/(nsrc*nrec)<<" ms per path, fused: "<<tfus/(nsrc*nrec)<<" ms per path, speedup = "
+				<<tsep/tfus<<". ###"<<std::endl;
+
+	if( nbad > 0 ) exit(-3);
+	return 0;
+}
@@ -13,8 +13,8 @@ int main( int argc, char* argv[] ) {
 	try {
 		// load
 		SacRec sac1, sac2;// saccor;
-		sac1.Load(argv[1]);
-		sac2.Load(argv[2]);
+		sac1.Load(SacView(argv[1]));
+		sac2.Load(SacView(argv[2]));
 		//sac1.CrossCorrelate(sac2, saccor);
 
 		// FFT
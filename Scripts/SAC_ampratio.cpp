@@ -10,13 +10,14 @@ int main( int argc, char* argv[] ) {
 	}
 
 	try {
-		// load sac
-		SacRec sac1( argv[1] ), sac2( argv[2] );
-		sac1.Load(); sac2.Load();
-
+		// map sac, and copy out the window only
+		SacView view1( argv[1] ), view2( argv[2] );
+		SacRec sac1, sac2;
 		if( argc == 6 ) {
 			float tmin = atof(argv[4]), tmax = atof(argv[5]);
-			sac1.cut(tmin, tmax); sac2.cut(tmin, tmax);
+			view1.cut(tmin, tmax, sac1); view2.cut(tmin, tmax, sac2);
+		} else {
+			sac1.Load(view1); sac2.Load(view2);
 		}
 
 		// FFT
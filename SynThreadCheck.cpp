@@ -0,0 +1,92 @@
+#include "SyntheticEvent.h"
+#include "SynGenerator.h"
+#include "StaList.h"
+#include "MyOMP.h"
+#include <array>
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <unistd.h>
+
+/* regression check of concurrent synthesis: the synthetics of all stations (and of their unit
+ * moment tensor components) computed on several threads at once from one SynGenerator, against the
+ * same synthetics computed serially, for random events around the synthetic event written by
+ * EQKBench gen. Exits with -3 when any sample differs */
+int main(int argc, char* argv[]) {
+	/* check #params */
+	if( argc<2 || argc>4 ) {
+		std::cerr<<"Usage: "<<argv[0]<<" [event dir (from EQKBench gen)] [# of threads (optional, default=all cores)] [# of events (optional, default=5)]"<<std::endl;
+		exit(-1);
+	}
+	const int nthd = argc>2 ? atoi(argv[2]) : omp_get_num_procs(), nevent = argc>3 ? atoi(argv[3]) : 5;
+	if( nthd<2 || nevent<=0 ) {
+		std::cerr<<"Invalid # of threads/events: "<<nthd<<" "<<nevent<<" (the check needs at least 2 threads)"<<std::endl;
+		exit(-2);
+	}
+	if( omp_get_num_procs() < 2 )
+		std::cerr<<"Warning: a single core. Threads will rarely overlap within cal_synsac."<<std::endl;
+
+	try {
+		const std::string dir( argv[1] );
+		const SyntheticEvent se = SyntheticEvent::Read( dir );
+		if( chdir(dir.c_str()) != 0 ) throw std::runtime_error( "cannot access " + dir );
+		std::vector<StaInfo> staV;
+		{
+			std::ifstream fin( "stations.lst" );
+			for( std::string line; std::getline(fin, line); ) staV.push_back( StaInfo(line) );
+		}
+		const int nsta = staV.size(), nsyn = nsta * 7, npts = 3000;
+
+		std::mt19937 gen(23);
+		std::uniform_real_distribution<float> U(-1., 1.);
+		bool pass = true;
+		for( const char type : { 'R', 'L' } ) {
+			const std::string stype( 1, type );
+			SynGenerator synG( "model."+stype+".bin", stype+".phv", stype+".eig", type, 0 );
+			for( const auto& sta : staV ) {
+				SacRec s;
+				snprintf( s.shd.kstnm, sizeof(s.shd.kstnm), "%s", sta.name.c_str() ); snprintf( s.shd.knetwk, sizeof(s.shd.knetwk), "%s", sta.net.c_str() );
+				s.shd.stlo = sta.lon; s.shd.stla = sta.lat;
+				synG.PushbackSta( s );
+			}
+
+			// the full synthetic (m<0) or a unit-tensor component of each station, as Z, R, T
+			auto synthesize = [&]( const int i, std::vector<std::array<SacRec,3>>& synV ) {
+				const int ista = i / 7, m = i%7 - 1;
+				auto& sac3 = synV[i];
+				const bool succeed = m < 0 ?
+					synG.ComputeSyn( ista, npts, 1., sac3[0], sac3[1], sac3[2], false ) :
+					synG.ComputeSynUnit( m, ista, npts, 1., sac3[0], sac3[1], sac3[2], false );
+				if( ! succeed ) throw std::runtime_error( "failed to synthesize for station "+staV[ista].name );
+			};
+
+			for( int ievent=0; ievent<nevent; ievent++ ) {
+				ModelInfo mi = se.minfo;
+				mi.lon += 0.2*U(gen); mi.lat += 0.2*U(gen); mi.dep = std::max(1., mi.dep+3.*U(gen));
+				mi.stk += 40.*U(gen); mi.dip = std::min(89., std::max(1., mi.dip+20.*U(gen))); mi.rak += 40.*U(gen);
+				synG.SetEvent( mi ); synG.Trace();
+
+				std::vector<std::array<SacRec,3>> synV0( nsyn ), synV1( nsyn );
+				for( int i=0; i<nsyn; i++ ) synthesize( i, synV0 );
+				ParallelTasks( nsyn, nthd, [&]( const int i ) { synthesize( i, synV1 ); } );
+
+				// the channel of the wave type (as EQKAnalyzer uses): cal_synsac leaves the others unset
+				const int ic = type=='R' ? 0 : 2;
+				int nbad = 0;
+				for( int i=0; i<nsyn; i++ ) {
+					const auto &sac0 = synV0[i][ic], &sac1 = synV1[i][ic];
+					if( sac0.shd.npts != sac1.shd.npts ||
+						 ! std::equal( sac0.sig.get(), sac0.sig.get()+sac0.shd.npts, sac1.sig.get() ) ) nbad++;
+				}
+				std::cout<<"### "<<type<<" event "<<ievent<<": "<<nsyn<<" traces on "<<nthd<<" threads, "<<nbad<<" differ from the serial ones. ###"<<std::endl;
+				if( nbad > 0 ) pass = false;
+			}
+		}
+		if( ! pass ) exit(-3);
+	} catch( std::exception& e ) {
+		std::cerr<<e.what()<<std::endl;
+		return -2;
+	}
+
+	return 0;
+}
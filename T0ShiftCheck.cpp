@@ -0,0 +1,136 @@
+#include "EQKAnalyzer.h"
+#include "ModelSpace.h"
+#include "Searcher.h"
+#include "Metrics.h"
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <random>
+
+/* regression check of the t0-only perturbations (t0ShiftCache: synthetics cut to the new origin time)
+ * against full synthesis, on the data of a waveform-fitting param file, for both the per-station SacRec
+ * pipeline and the spectral engine. Each random model is followed by t0-only steps (fractional samples
+ * included). Then times Monte Carlo searches over all 8 parameters (t0 moves at 1/8 of the proposals)
+ * with the cache on and off. Exits with -3 when any station misfit is beyond tolerance */
+int main(int argc, char* argv[]) {
+	/* check #params */
+	if( argc<2 || argc>5 ) {
+		std::cerr<<"Usage: "<<argv[0]<<" [param file] [# of models (optional, default=5)] [# of t0 steps per model (optional, default=8)]"
+					<<" [# of Monte Carlo proposals (optional, default=2000; 0 to skip)]"<<std::endl;
+		exit(-1);
+	}
+	const int nmodel = argc>2 ? atoi(argv[2]) : 5, nt0 = argc>3 ? atoi(argv[3]) : 8, nsearch = argc>4 ? atoi(argv[4]) : 2000;
+	if( nmodel<=0 || nt0<=0 || nsearch<0 ) {
+		std::cerr<<"Invalid # of models/steps/proposals: "<<nmodel<<" "<<nt0<<" "<<nsearch<<std::endl;
+		exit(-2);
+	}
+
+	/* analyzers: with and without t0 shifts, for the SacRec pipeline and the spectral engine */
+	const std::string fparam( argv[1] );
+	const std::vector<std::string> setV{ "specEngine -1", "specEngine 4" }, cacheV{ "t0ShiftCache 0", "t0ShiftCache 16" };
+	auto loadEKA = [&]( const std::string& sset, const std::string& scache ) {
+		EQKAnalyzer eka( fparam, false );
+		eka.Set( sset.c_str() ); eka.Set( scache.c_str() );
+		eka.LoadData();
+		return eka;
+	};
+
+	/* models: random locations/depths/focals around the param model, each followed by t0-only steps */
+	ModelSpace ms( fparam );
+	std::mt19937 gen(17);
+	std::uniform_real_distribution<float> U(-1., 1.);
+	std::vector<ModelInfo> miV;
+	for( int imodel=0; imodel<nmodel; imodel++ ) {
+		ModelInfo mi = ms;
+		mi.lon += 0.1*U(gen); mi.lat += 0.1*U(gen); mi.dep = std::max(1., mi.dep+2.*U(gen));
+		mi.stk += 30.*U(gen); mi.dip = std::min(89., std::max(1., mi.dip+20.*U(gen)));
+		mi.rak += 30.*U(gen); mi.M0 *= 1.+0.3*U(gen);
+		for( int it0=0; it0<=nt0; it0++ ) {
+			miV.push_back( mi );
+			mi.t0 += 2.*U(gen);
+		}
+	}
+
+	const float tolG = 0.01, tolP = 1.e-3, tolA = 1.e-3;
+	bool pass = true;
+	std::array<double, Metrics::NCounter> cnt0, cnt1;
+	for( const auto& sset : setV ) {
+		/* predictions and timing */
+		std::vector<std::vector<std::vector<SDContainer>>> predV( cacheV.size() );
+		std::vector<float> timeV( cacheV.size() );
+		for( int ic=0; ic<cacheV.size(); ic++ ) {
+			auto eka = loadEKA( sset, cacheV[ic] );
+			Metrics::Snapshot( cnt0 );
+			auto t0 = std::chrono::steady_clock::now();
+			for( const auto& mi : miV ) {
+				std::vector<SDContainer> dataR{SDContainer(0., R)}, dataL{SDContainer(0., L)};
+				eka.UpdatePredsW( mi, dataR, dataL );
+				predV[ic].push_back( std::vector<SDContainer>{dataR[0], dataL[0]} );
+			}
+			timeV[ic] = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now()-t0).count() / miV.size();
+			Metrics::Snapshot( cnt1 );
+			if( ic == 0 ) continue;
+			// the shifts have to be exercised for the comparison to mean anything
+			const double nshift = cnt1[Metrics::T0ShiftStas] - cnt0[Metrics::T0ShiftStas];
+			const double nsyn = cnt1[Metrics::SynStas] - cnt0[Metrics::SynStas];
+			std::cout<<"### "<<sset<<", "<<cacheV[ic]<<": "<<nshift<<" stations shifted, "<<nsyn<<" synthesized. ###"<<std::endl;
+			if( nshift <= 0. ) {
+				std::cerr<<"No station was shifted with "<<cacheV[ic]<<std::endl;
+				pass = false;
+			}
+		}
+
+		/* compare against full synthesis */
+		float dGmax = 0., dPmax = 0., dAmax = 0.; int ncmp = 0, nbad = 0;
+		for( int imi=0; imi<miV.size(); imi++ )
+			for( int it=0; it<2; it++ ) {
+				const auto &sdc0 = predV[0][imi][it], &sdc1 = predV[1][imi][it];
+				if( sdc0.size() != sdc1.size() ) {
+					std::cerr<<"Inconsistent # of stations: "<<sdc0.size()<<" vs "<<sdc1.size()<<std::endl;
+					exit(-3);
+				}
+				auto I1 = sdc1.begin();
+				for( auto I0 = sdc0.begin(); I0 != sdc0.end(); I0++, I1++ ) {
+					float dG = std::fabs(I0->Gdata-I1->Gdata), dP = std::fabs(I0->Pdata-I1->Pdata);
+					float dA = std::fabs(I0->Adata-I1->Adata) / std::fabs(I0->Asource);
+					if( dG>tolG || dP>tolP || dA>tolA ) nbad++;
+					dGmax = std::max(dGmax, dG); dPmax = std::max(dPmax, dP); dAmax = std::max(dAmax, dA);
+					ncmp++;
+				}
+			}
+		std::cout<<"### "<<sset<<": "<<ncmp<<" station misfits compared: max |dG| = "<<dGmax<<" sec, max |dP| = "<<dPmax
+					<<" rad, max |dA|/Asource = "<<dAmax<<". "<<nbad<<" beyond tolerance. ###"<<std::endl;
+		for( int ic=0; ic<cacheV.size(); ic++ )
+			std::cout<<"### "<<sset<<", "<<cacheV[ic]<<": "<<timeV[ic]<<" ms per model. ###"<<std::endl;
+		if( nbad > 0 ) pass = false;
+	}
+
+	/* Monte Carlo searches over all parameters, with and without t0 shifts */
+	for( const auto& sset : setV ) {
+		if( nsearch == 0 ) break;
+		std::vector<float> secV( cacheV.size() );
+		for( int ic=0; ic<cacheV.size(); ic++ ) {
+			auto eka = loadEKA( sset, cacheV[ic] );
+			eka.SetCorrectM0(false);
+			ModelSpace msc( fparam );
+			msc.SetFreeFocal();
+			msc.SetPerturb( true, true, true, true, true, true, true, true );
+			std::ofstream fnull( "/dev/null" );
+			Metrics::Snapshot( cnt0 );
+			auto tb = std::chrono::steady_clock::now();
+			Searcher::MonteCarlo<ModelInfo>( msc, eka, nsearch, fnull );
+			secV[ic] = std::chrono::duration<float>(std::chrono::steady_clock::now()-tb).count();
+			Metrics::Snapshot( cnt1 );
+			double nprop = 0.;
+			for( int ip=0; ip<Metrics::NParam; ip++ ) nprop += cnt1[Metrics::Proposals+ip] - cnt0[Metrics::Proposals+ip];
+			const double nt0prop = cnt1[Metrics::Proposals+8] - cnt0[Metrics::Proposals+8];
+			const double nhit = cnt1[Metrics::T0RefHits] - cnt0[Metrics::T0RefHits];
+			std::cout<<"### Monte Carlo, "<<sset<<", "<<cacheV[ic]<<": "<<secV[ic]<<" sec for "<<nsearch<<" proposals ("
+						<<(nprop>0. ? nt0prop/nprop : 0.)<<" of them t0 moves, "<<nhit<<" t0 reference hits). ###"<<std::endl;
+		}
+		std::cout<<"### Monte Carlo, "<<sset<<": speedup from t0 shifts = "<<secV[0]/secV[1]<<" ###"<<std::endl;
+	}
+
+	if( ! pass ) exit(-3);
+	return 0;
+}
@@ -0,0 +1,93 @@
+#include "EQKAnalyzer.h"
+#include "ModelSpace.h"
+#include <iostream>
+#include <chrono>
+#include <random>
+
+/* regression check of the spectral-domain waveform misfits (WaveformEngine) against the
+ * per-station SacRec pipeline (EQKAnalyzer::WaveformMisfit), on the data of a waveform-fitting
+ * param file. Each location is followed by focal-only steps so that the unit-tensor spectra are used.
+ * Exits with -3 when any station misfit is beyond tolerance */
+int main(int argc, char* argv[]) {
+	/* check #params */
+	if( argc!=2 && argc!=3 && argc!=4 ) {
+		std::cerr<<"Usage: "<<argv[0]<<" [param file] [# of locations (optional, default=5)] [# of focal steps per location (optional, default=8)]"<<std::endl;
+		exit(-1);
+	}
+	const int nloc = argc>2 ? atoi(argv[2]) : 5, nfoc = argc>3 ? atoi(argv[3]) : 8;
+	if( nloc<=0 || nfoc<=0 ) {
+		std::cerr<<"Invalid # of locations/steps: "<<nloc<<" "<<nfoc<<std::endl;
+		exit(-2);
+	}
+
+	/* analyzers: the SacRec pipeline, batched transforms only, and batched transforms + unit-tensor spectra */
+	const std::string fparam( argv[1] );
+	ModelSpace ms( fparam );
+	std::vector<std::string> setV{ "specEngine -1", "specEngine 0", "specEngine 4" };
+	std::vector<EQKAnalyzer> ekaV;
+	for( const auto& sset : setV ) {
+		ekaV.emplace_back( fparam, false );
+		auto& eka = ekaV.back();
+		eka.Set( sset.c_str() ); eka.Set( "t0ShiftCache 0" );
+		eka.LoadData();
+	}
+
+	/* models: random locations/depths/t0s around the param model, each followed by focal-only steps */
+	std::mt19937 gen(17);
+	std::uniform_real_distribution<float> U(-1., 1.);
+	std::vector<ModelInfo> miV;
+	for( int iloc=0; iloc<nloc; iloc++ ) {
+		ModelInfo mi = ms;
+		mi.lon += 0.1*U(gen); mi.lat += 0.1*U(gen); mi.t0 += 2.*U(gen); mi.dep = std::max(1., mi.dep+2.*U(gen));
+		for( int ifoc=0; ifoc<nfoc; ifoc++ ) {
+			ModelInfo mif = mi;
+			mif.stk += 30.*U(gen); mif.dip = std::min(89., std::max(1., mif.dip+20.*U(gen)));
+			mif.rak += 30.*U(gen); mif.M0 *= 1.+0.3*U(gen);
+			miV.push_back( mif );
+		}
+	}
+
+	/* predictions and timing */
+	std::vector<std::vector<std::vector<SDContainer>>> predV( ekaV.size() );
+	std::vector<float> timeV( ekaV.size() );
+	for( int ieka=0; ieka<ekaV.size(); ieka++ ) {
+		auto t0 = std::chrono::steady_clock::now();
+		for( const auto& mi : miV ) {
+			std::vector<SDContainer> dataR{SDContainer(0., R)}, dataL{SDContainer(0., L)};
+			ekaV[ieka].UpdatePredsW( mi, dataR, dataL );
+			predV[ieka].push_back( std::vector<SDContainer>{dataR[0], dataL[0]} );
+		}
+		timeV[ieka] = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now()-t0).count() / miV.size();
+	}
+
+	/* compare against the SacRec pipeline */
+	const float tolG = 0.01, tolP = 1.e-3, tolA = 1.e-3;
+	bool pass = true;
+	for( int ieka=1; ieka<ekaV.size(); ieka++ ) {
+		float dGmax = 0., dPmax = 0., dAmax = 0.; int ncmp = 0, nbad = 0;
+		for( int imi=0; imi<miV.size(); imi++ )
+			for( int it=0; it<2; it++ ) {
+				const auto &sdc0 = predV[0][imi][it], &sdc1 = predV[ieka][imi][it];
+				if( sdc0.size() != sdc1.size() ) {
+					std::cerr<<"Inconsistent # of stations: "<<sdc0.size()<<" vs "<<sdc1.size()<<std::endl;
+					exit(-3);
+				}
+				auto I1 = sdc1.begin();
+				for( auto I0 = sdc0.begin(); I0 != sdc0.end(); I0++, I1++ ) {
+					float dG = std::fabs(I0->Gdata-I1->Gdata), dP = std::fabs(I0->Pdata-I1->Pdata);
+					float dA = std::fabs(I0->Adata-I1->Adata) / std::fabs(I0->Asource);
+					if( dG>tolG || dP>tolP || dA>tolA ) nbad++;
+					dGmax = std::max(dGmax, dG); dPmax = std::max(dPmax, dP); dAmax = std::max(dAmax, dA);
+					ncmp++;
+				}
+			}
+		std::cout<<"### "<<setV[ieka]<<": "<<ncmp<<" station misfits compared: max |dG| = "<<dGmax<<" sec, max |dP| = "<<dPmax
+					<<" rad, max |dA|/Asource = "<<dAmax<<". "<<nbad<<" beyond tolerance. ###"<<std::endl;
+		if( nbad > 0 ) pass = false;
+	}
+	for( int ieka=0; ieka<ekaV.size(); ieka++ )
+		std::cout<<"### "<<setV[ieka]<<": "<<timeV[ieka]<<" ms per model. ###"<<std::endl;
+
+	if( ! pass ) exit(-3);
+	return 0;
+}
@@ -1,9 +1,12 @@
 #include "EQKAnalyzer.h"
 #include "SynGenerator.h"
 #include "Parabola.h"
+#include "SacPrepCache.h"
 //#include "VectorOperations.h"
 //#include "DataTypes.h"
 #include <sstream>
+#include <exception>
+#include <chrono>
 #include <sys/stat.h>
 #include <cstdlib>
 
@@ -66,6 +69,7 @@ void EQKAnalyzer::LoadParams( const FileName& fname, const bool MoveF ) {
       else nparam++;
    }
    fin.close();
+   Resync();
 
    std::cout<<"### EQKAnalyzer::LoadParams: "<<nparam<<" succed loads from param file "<<fname<<". ###\n"
 				<<"    disRange = "<<DISMIN<<" - "<<DISMAX<<" perRange = "<<1./f3<<" - "<<1./f2<<"\n"
@@ -98,6 +102,34 @@ int EQKAnalyzer::Set( const char *input, const bool MoveF ) {
 	else if( stmp == "fRsp" ) succeed = (bool)(buff >> fRphvname);
 	else if( stmp == "fLse" ) succeed = (bool)(buff >> fLeigname);
 	else if( stmp == "fLsp" ) succeed = (bool)(buff >> fLphvname);
+	else if( stmp == "eigDepGrid" ) {
+		float ddep, depmax = 100.;
+		succeed = (bool)(buff >> ddep);
+		if( succeed ) {
+			buff >> depmax;
+			EigenRec::SetDepthGrid( ddep, depmax );
+		}
+	}
+	else if( stmp == "eigSidecar" ) { succeed = true; EigenRec::UseSidecar(true); }
+	else if( stmp == "sacSidecar" ) { succeed = true; _sacSidecar = true; }
+	else if( stmp == "numa" ) { succeed = true; _numa = true; }
+	else if( stmp == "sigPool" ) {
+		int capMB;
+		succeed = (bool)(buff >> capMB);
+		if( succeed ) SigMem::UsePool( capMB>0, std::max(capMB, 0) );
+	}
+	else if( stmp == "synBasisCache" ) succeed = (bool)(buff >> _synBasisNloc);
+	else if( stmp == "t0ShiftCache" ) succeed = (bool)(buff >> _t0ShiftNmodel);
+	else if( stmp == "specEngine" ) succeed = (bool)(buff >> _specEngineNloc);
+	else if( stmp == "stationThreads" ) succeed = (bool)(buff >> _stationThreads);
+	else if( stmp == "pathTable" ) {
+		succeed = (bool)(buff >> _pathTableName >> _pathTableGrid);
+		if( succeed && !(buff >> _pathTablePad) ) _pathTablePad = 0.;
+	}
+	else if( stmp == "metrics" ) {
+		succeed = (bool)(buff >> _metricsName);
+		if( succeed && buff >> _metricsInterval ) buff >> _metricsProm;
+	}
 	else if( stmp == "weightR_Loc" ) succeed = (bool)(buff >> weightR_Loc);
 	else if( stmp == "weightL_Loc" ) succeed = (bool)(buff >> weightL_Loc);
 	else if( stmp == "weightR_Foc" ) succeed = (bool)(buff >> weightR_Foc);
@@ -381,17 +413,22 @@ void EQKAnalyzer::LoadData() {
 	// check input params
 	// do waveform fitting if model and saclist are input
 	_usewaveform = ( !fsaclistR.empty() && !fmodelR.empty() ) || ( !fsaclistL.empty() && !fmodelL.empty() );
+	_replicas.clear();	// PlaceOnNuma again after loading
+
+	// runtime metrics, reported over the lifetime of the analyzer
+	if( ! _metricsName.empty() ) _preporter = std::make_shared<Metrics::Reporter>( _metricsName, _metricsInterval, _metricsProm );
+	else _preporter.reset();
 
 	if( _usewaveform ) {	// read in sacs
 		// period band
 		if( f2<0. || f3<0. || f2>=f3 )
 			throw ErrorEA::BadParam(FuncName, "invalid freq range: "+std::to_string(f2)+" - "+std::to_string(f3));
 
-		// lambda function that loads a single sac file into both sac3V and synG
-		auto LoadSac = [&]( const std::string& sacname, SynGenerator& synG, std::vector<SacRec3>& sac3V ) {
+		// lambda function that preprocesses a single sac file into sac3 (returns false if rejected)
+		auto LoadSac = [&]( const std::string& sacname, SacRec3& sac3 ) {
 			SacRec sac(sacname); sac.Load();
 			auto& shd = sac.shd;
-			if( shd.depmax!=shd.depmax ) return;
+			if( shd.depmax!=shd.depmax ) return false;
 			// check/define event location in sac header
 			if( shd.evlo<-180 || shd.evla<-90 ) {
 				shd.evlo = initlon;
@@ -399,15 +436,12 @@ void EQKAnalyzer::LoadData() {
 			}
 			// check distance
 			float dis = sac.Dis();
-			if( dis<DISMIN || dis>DISMAX ) return;
+			if( dis<DISMIN || dis>DISMAX ) return false;
 			// SNR
 			shd.user1 = sac.SNR(dis*0.2, dis*0.5, dis*0.5+500., dis*0.5+1000.);
-			if( shd.user1 < SNRMIN ) return;
-			// filter
-			sac.Resample();	// sample grid alignment
-			if( sacRtype == 1 ) sac.Integrate();
-			//sac.Filter(f1,f2,f3,f4);
-			sac.BandpassCOSFilt(f1,f2,f3,f4);
+			if( shd.user1 < SNRMIN ) return false;
+			// sample grid alignment, integration (of velocity records), and filter in a single FFT pair
+			sac.Preprocess(f1, f2, f3, f4, sacRtype==1);
 			// zoom in to the surface wave window
 			float tb, te;
 			if( dis < 300. ) {
@@ -425,22 +459,69 @@ void EQKAnalyzer::LoadData() {
 			SacRec sacEnv; sacEnv.shd = shd;
 			sacEnv.FromAmPh(sac_am, sac_ph, 2); 
 			shd.user4 = sacEnv.Tpeak();
-			// save sac files and put a station record into synGR
-			synG.PushbackSta( sac );
-			sac3V.push_back( SacRec3{ std::move(sac), std::move(sac_am), std::move(sac_ph) } );
+			sac3 = SacRec3{ std::move(sac), std::move(sac_am), std::move(sac_ph) };
+			return true;
+		};
+
+		// sidecars of the preprocessed records, keyed by the sac file and every setting LoadSac depends on
+		std::unique_ptr<SacPrepCache> pprep;
+		if( _sacSidecar ) pprep.reset( new SacPrepCache( std::vector<float>{ f1, f2, f3, f4, (float)sacRtype,
+																	DISMIN, DISMAX, SNRMIN, initlon, initlat } ) );
+		int nsidecar = 0;
+
+		// lambda function that loads all sac files in a list (in parallel) into both sac3V and synG
+		auto LoadList = [&]( const std::string& fsaclist, SynGenerator& synG, std::vector<SacRec3>& sac3V ) {
+			std::ifstream fin( fsaclist );
+			if( ! fin )
+				throw ErrorEA::BadFile(FuncName, fsaclist);
+			std::vector<std::string> sacnameV;
+			for( std::string line; std::getline(fin, line); ) {
+				std::stringstream ss(line); ss >> line;
+				sacnameV.push_back( line );
+			}
+			fin.close();
+			// preprocess (or load from sidecars) into slots that keep the list order
+			const int nsac = sacnameV.size();
+			std::vector<SacRec3> sac3Vall( nsac );
+			std::vector<char> acceptV( nsac, false );
+			std::exception_ptr perr;
+			#pragma omp parallel for schedule(dynamic, 1)
+			for( int i=0; i<nsac; i++ ) {
+				try {
+					const auto& sacname = sacnameV[i];
+					bool accepted = false;
+					const uint64_t key = pprep ? pprep->Key(sacname) : 0;
+					if( pprep && pprep->Load(sacname, key, accepted, sac3Vall[i]) ) {
+						#pragma omp atomic
+						nsidecar++;
+					} else {
+						accepted = LoadSac( sacname, sac3Vall[i] );
+						if( pprep && key!=0 ) pprep->Save( sacname, key, accepted, sac3Vall[i] );
+					}
+					acceptV[i] = accepted;
+				} catch( ... ) {
+					#pragma omp critical(LoadList)
+					if( ! perr ) perr = std::current_exception();
+				}
+			}
+			if( perr ) std::rethrow_exception( perr );
+			// save sac files and put station records into synG (in list order)
+			sac3V.clear(); synG.ClearSta();
+			for( int i=0; i<nsac; i++ ) {
+				if( ! acceptV[i] ) continue;
+				synG.PushbackSta( sac3Vall[i][0] );
+				sac3V.push_back( std::move(sac3Vall[i]) );
+			}
 		};
 
+		// the spectral engine keeps unit-tensor spectra of its own (built from ComputeSynUnit, six
+		// tasks per station): a synthetic basis below it would be built concurrently by all six
+		const int synBasisNloc = _specEngineNloc > 0 ? 0 : _synBasisNloc;
 		// Rayleigh
 		_synGR.Initialize(fmodelR, fRphvname, fReigname, 'R', 0);
-		std::ifstream fin( fsaclistR );
-		if( ! fin )
-	      throw ErrorEA::BadFile(FuncName, fsaclistR);
-		_sac3VR.clear(); _synGR.ClearSta();
-		for( std::string line; std::getline(fin, line); ) {
-			std::stringstream ss(line); ss >> line;
-			LoadSac( line, _synGR, _sac3VR );
-		}
-		fin.close(); fin.clear();
+		_synGR.LoadModel();
+		_synGR.SetBasisCache( synBasisNloc );
+		LoadList( fsaclistR, _synGR, _sac3VR );
 		float pseudo_per = nint(1./f3) + 0.001*nint(1./f2);
 		_dataR.push_back( SDContainer{pseudo_per, R, false} );	// waveform data container
 		// Uncertainties
@@ -452,14 +533,9 @@ void EQKAnalyzer::LoadData() {
 
 		// Love
 		_synGL.Initialize(fmodelL, fLphvname, fLeigname, 'L', 0);
-		fin.open( fsaclistL );
-		if( ! fin )
-			throw ErrorEA::BadFile(FuncName, fsaclistL);
-		_sac3VL.clear(); _synGL.ClearSta();
-		for( std::string line; std::getline(fin, line); ) {
-			std::stringstream ss(line); ss >> line;
-			LoadSac( line, _synGL, _sac3VL );
-		}
+		_synGL.LoadModel();
+		_synGL.SetBasisCache( synBasisNloc );
+		LoadList( fsaclistL, _synGL, _sac3VL );
 		_dataL.push_back( SDContainer{pseudo_per, L, false} );	// waveform data container
 		// Uncertainties
 		Ispi = spiLM.find(-1.);
@@ -468,12 +544,31 @@ void EQKAnalyzer::LoadData() {
 			sigmaS = AziData{0., spi.sigmaG, spi.sigmaP, spi.sigmaA}; sigmaS = sigmaS * sigmaS;
 		}
 
-		std::cout<<"### "<<_sac3VR.size()<<"(Rayl) + "<<_sac3VL.size()<<"(Love) sac file(s) loaded. ###"<<std::endl;
+		// references for t0-only perturbations
+		if( _t0ShiftNmodel > 0 ) _pwref = std::make_shared<WaveformRefCache>(_t0ShiftNmodel);
+		else _pwref.reset();
+		// spectral-domain misfits
+		if( _specEngineNloc >= 0 ) _pweng = std::make_shared<WaveformEngine>(_specEngineNloc, f1, f2, f3, f4, rotateSyn);
+		else _pweng.reset();
+		// threads over stations within an evaluation (nested in the searcher's threads)
+		_pinner = std::make_shared<InnerThreads>( _stationThreads );
+		if( _stationThreads != 1 ) omp_set_nested(true);
+
+		std::cout<<"### "<<_sac3VR.size()<<"(Rayl) + "<<_sac3VL.size()<<"(Love) sac file(s) loaded";
+		if( pprep ) std::cout<<" ("<<nsidecar<<" record(s) from sidecars)";
+		std::cout<<". ###"<<std::endl;
 	} else {	// read DISP measurements
-		auto LoadSDData = [&]( const std::map<float, SinglePeriodInfo>& spiM, std::vector<SDContainer>& dataV, const Dtype t ) {
-			dataV.clear(); dataV.reserve( spiM.size() );
+		/* a task per (wave type, period), run on all threads. Map files shared by several periods are
+			read once (each container clips a copy). The reports of the tasks are printed in task order
+			and the error of the first failed task is thrown, whatever order the threads ran in */
+		struct Task {
+			Dtype type; float per;
+			const SinglePeriodInfo* pspi;
+			bool is1D; float velG, velP;
+		};
+		std::vector<Task> taskV;
+		auto AddTasks = [&]( const std::map<float, SinglePeriodInfo>& spiM, const Dtype t ) {
 			for( const auto& psPair : spiM ) {
-				const float per = psPair.first;
 				const auto& spi = psPair.second;
 				if( spi.fmeasure.empty() || spi.fmapG.empty() || spi.fmapP.empty() ) {
 					if( ! (spi.fmeasure.empty() && spi.fmapG.empty() && spi.fmapP.empty()) )
@@ -483,29 +578,120 @@ void EQKAnalyzer::LoadData() {
 				// farray[0]: measurement file
 				// farray[1] & [2]: either G&P vel_map files or G&P velocities (float for 1D model)
 				// farray[3]: list of stations to be used
-				float velG, velP;
-				SDContainer sd;
-				if( FilenameToVel(spi.fmapG, velG) && FilenameToVel(spi.fmapP, velP) ) {
-					sd = SDContainer(per, t, true, spi.fmeasure, velG, velP, spi.fstalst, initlon, initlat, DISMIN, DISMAX);	// FTAN measurement container
+				Task task{ t, psPair.first, &spi, false, 0., 0. };
+				task.is1D = FilenameToVel(spi.fmapG, task.velG) && FilenameToVel(spi.fmapP, task.velP);
+				taskV.push_back( task );
+			}
+		};
+		// Rayleigh
+		AddTasks( spiRM, R );
+		// Love
+		AddTasks( spiLM, L );
+		const int ntask = taskV.size();
+
+		// distinct map files
+		std::vector<std::string> fmapV;
+		std::map<std::string, int> imapM;
+		for( const auto& task : taskV ) {
+			if( task.is1D ) continue;
+			for( const auto& fmap : { task.pspi->fmapG, task.pspi->fmapP } )
+				if( imapM.emplace(fmap, fmapV.size()).second ) fmapV.push_back( fmap );
+		}
+		std::vector<Map> mapV( fmapV.size() );
+		std::vector<std::exception_ptr> errV( fmapV.size() );
+		#pragma omp parallel for schedule(dynamic, 1)
+		for( int i=0; i<fmapV.size(); i++ ) {
+			try {
+				mapV[i].Load( fmapV[i] );
+				if( mapV[i].size() == 0 ) throw ErrorSC::EmptyMap(FuncName, fmapV[i]);
+			} catch( ... ) {
+				errV[i] = std::current_exception();
+			}
+		}
+		for( const auto& perr : errV ) if( perr ) std::rethrow_exception( perr );
+
+		// containers
+		std::vector<SDContainer> sdcV( ntask );
+		std::vector<std::stringstream> soutV( ntask ), serrV( ntask );
+		errV.assign( ntask, nullptr );
+		#pragma omp parallel for schedule(dynamic, 1)
+		for( int i=0; i<ntask; i++ ) {
+			try {
+				const auto& task = taskV[i];
+				const auto& spi = *(task.pspi);
+				auto& sd = sdcV[i];
+				if( task.is1D ) {
+					sd = SDContainer(task.per, task.type, true, spi.fmeasure, task.velG, task.velP, spi.fstalst,
+										  initlon, initlat, DISMIN, DISMAX, soutV[i], serrV[i]);	// FTAN measurement container
 				} else {
-					sd = SDContainer(per, t, true, spi.fmeasure, spi.fmapG, spi.fmapP, spi.fstalst, initlon, initlat, DISMIN, DISMAX);
+					sd = SDContainer(task.per, task.type, true, spi.fmeasure, mapV[imapM.at(spi.fmapG)], mapV[imapM.at(spi.fmapP)],
+										  spi.fstalst, initlon, initlat, DISMIN, DISMAX, soutV[i], serrV[i]);
 				}
 				if( spi.sigmaG>0 && spi.sigmaP>0 && spi.sigmaA>0 ) {
-					sd.sigmaS = AziData{per, spi.sigmaG, spi.sigmaP, spi.sigmaA}; sd.sigmaS = sd.sigmaS * sd.sigmaS;
+					sd.sigmaS = AziData{task.per, spi.sigmaG, spi.sigmaP, spi.sigmaA}; sd.sigmaS = sd.sigmaS * sd.sigmaS;
 				}
-				dataV.push_back( std::move(sd) );
+			} catch( ... ) {
+				errV[i] = std::current_exception();
 			}
-		};
-		// Rayleigh
-		LoadSDData( spiRM, _dataR, R );
-		// Love
-		LoadSDData( spiLM, _dataL, L );
+		}
+		_dataR.clear(); _dataL.clear();
+		for( int i=0; i<ntask; i++ ) {
+			std::cerr<<serrV[i].str(); std::cout<<soutV[i].str();
+			if( errV[i] ) std::rethrow_exception( errV[i] );
+			(taskV[i].type==R ? _dataR : _dataL).push_back( std::move(sdcV[i]) );
+		}
 
 		std::cout<<"### "<<_dataR.size()<<"(Rayl) + "<<_dataL.size()<<"(Love) data periods (measurements+maps) loaded. ###"<<std::endl;
 	}
 
 }
 
+void EQKAnalyzer::LoadPathTables( const float lonmin, const float lonmax, const float latmin, const float latmax ) {
+	if( ! _usewaveform || _pathTableGrid<=0. ) return;
+	const float pad = _pathTablePad;
+	if( ! _sac3VR.empty() )
+		_synGR.LoadPathTable( _pathTableName+".R", lonmin-pad, lonmax+pad, latmin-pad, latmax+pad, _pathTableGrid );
+	if( ! _sac3VL.empty() )
+		_synGL.LoadPathTable( _pathTableName+".L", lonmin-pad, lonmax+pad, latmin-pad, latmax+pad, _pathTableGrid );
+	Resync();
+}
+
+void EQKAnalyzer::PlaceOnNuma() {
+	if( ! _numa ) return;
+	const int nnode = Numa::NNode();
+	if( nnode < 2 ) {
+		std::cout<<"### PlaceOnNuma: a single NUMA node, nothing to place. ###"<<std::endl;
+		return;
+	}
+	const int nbound = Numa::PinThreads();
+	Replicate();
+	std::cout<<"### PlaceOnNuma: "<<nbound<<" thread(s) bound, data replicated on "<<nnode<<" NUMA nodes. ###"<<std::endl;
+}
+
+void EQKAnalyzer::Replicate() {
+	const int nnode = Numa::NNode();
+	std::vector<std::shared_ptr<EQKAnalyzer>> repV( nnode );
+	for( int node=0; node<nnode; node++ )
+		Numa::OnNode( node, [&]() {
+			auto prep = std::make_shared<EQKAnalyzer>( *this );
+			prep->_replicas.clear();
+			prep->Detach();
+			repV[node] = std::move(prep);
+		} );
+	_replicas = std::move(repV);
+}
+
+void EQKAnalyzer::Detach() {
+	for( auto& sdc : _dataR ) sdc.Detach();
+	for( auto& sdc : _dataL ) sdc.Detach();
+	for( auto& rp : _rpR ) rp.Detach();
+	for( auto& rp : _rpL ) rp.Detach();
+	_synGR.Detach(); _synGL.Detach();
+	if( _pwref ) _pwref = std::make_shared<WaveformRefCache>(_t0ShiftNmodel);
+	if( _pweng ) _pweng = std::make_shared<WaveformEngine>(_specEngineNloc, f1, f2, f3, f4, rotateSyn);
+	if( _pinner ) _pinner = std::make_shared<InnerThreads>( _stationThreads );
+}
+
 
 inline std::vector<float> EQKAnalyzer::perRlst() const { return perlst(R); }
 inline std::vector<float> EQKAnalyzer::perLlst() const { return perlst(L); }
@@ -537,6 +723,8 @@ inline float EQKAnalyzer::BoundInto( float val, float lb, float ub ) const {
 /* -------------------- fill the rpR and rpL objects with the current model state -------------------- */
 void EQKAnalyzer::UpdatePredsM( const ModelInfo& minfo, std::vector<SDContainer>& dataR, std::vector<SDContainer>& dataL ) const {
 										  //bool& source_updated, bool updateSource ) const {
+	Metrics::Timer timer( Metrics::PredsMSec );
+	PROFILE_SCOPE("EQKAnalyzer::UpdatePredsM");
 	int ithd = omp_get_thread_num(); auto &rpR = _rpR[ithd], &rpL = _rpL[ithd];
 	// radpattern
 	bool model_updated = false;
@@ -548,6 +736,7 @@ void EQKAnalyzer::UpdatePredsM( const ModelInfo& minfo, std::vector<SDContainer>
 	//model_updated |= rpL.Predict( 'L', fLeigname, fLphvname, stk, dip, rak, dep, M0, perLlst() );
 	model_updated = rpR.Predict( stk, dip, rak, dep, M0, perRlst() ) || model_updated;	// M0 will be computed in sdc.UpdateSourcePred
 	model_updated = rpL.Predict( stk, dip, rak, dep, M0, perLlst() ) || model_updated;
+	timer.Lap( Metrics::RadPatternSec );
 
 	if( _usewaveform ) return;
 
@@ -556,6 +745,7 @@ void EQKAnalyzer::UpdatePredsM( const ModelInfo& minfo, std::vector<SDContainer>
 		model_updated = sdc.UpdatePathPred( minfo.lon, minfo.lat, minfo.t0 ) || model_updated;
 	for( auto& sdc : dataL )
 		model_updated = sdc.UpdatePathPred( minfo.lon, minfo.lat, minfo.t0 ) || model_updated;
+	timer.Lap( Metrics::PathPredSec );
 
 	/*
 	if( model_updated ) source_updated = false;	// source terms need to be updated
@@ -574,6 +764,7 @@ void EQKAnalyzer::UpdatePredsM( const ModelInfo& minfo, std::vector<SDContainer>
 		float Af = exp( RescaleSourceAmps( dataR, dataL ) );
 		minfo.M0 *= Af; rpR *= Af; rpL *= Af;
 	}
+	timer.Lap( Metrics::SourcePredSec );
 
 /*
 std::cerr<<"UpdatePredsM0: minfo = "<<minfo<<std::endl;
@@ -673,12 +864,18 @@ void EQKAnalyzer::chiSquareM( const ModelInfo &minfo, float& chiS, int& N ) cons
 
 
 // given an observed waveform (sac, sac_am, sac_ph), generate synthetic and compute misfit
-SacRec EQKAnalyzer::ComputeSyn(const SacRec &sac, SynGenerator &synG) const {
+SacRec EQKAnalyzer::ComputeSyn(const SacRec &sac, SynGenerator &synG, const int ista, SacRec* psacF) const {
 	const auto &shd = sac.shd;
 	SacRec sacSZ, sacSR, sacST;
 	int nptsS = ceil( (shd.user3-synG.minfo.t0)/shd.delta ) + 1;
-	bool synsuc = synG.ComputeSyn( sac.stname(), shd.stlo, shd.stla, nptsS, shd.delta, 
+	// synthesize the full FFT size when asked for (and nptsS alone if that fails)
+	const int nptsF = psacF ? SynGenerator::FullSize(nptsS) : nptsS;
+	bool synsuc = synG.ComputeSyn( ista, nptsF, shd.delta, 
 											 sacSZ, sacSR, sacST, rotateSyn, f1, f2, f3, f4 );
+	if( !synsuc && nptsF!=nptsS ) {
+		psacF = nullptr;
+		synsuc = synG.ComputeSyn( ista, nptsS, shd.delta, sacSZ, sacSR, sacST, rotateSyn, f1, f2, f3, f4 );
+	}
 	Dtype type = synG.type=='R' ? R : L;
 	if( ! synsuc ) {
 		(type==R ? sacSZ : sacST).Write("debug_Syn_"+sac.stname()+".SAC");
@@ -699,16 +896,29 @@ SacRec EQKAnalyzer::ComputeSyn(const SacRec &sac, SynGenerator &synG) const {
 	// check for bad sac (done already in ComputeSyn!)
 	//if( sacS.shd.depmax!=sacS.shd.depmax ) return;
 
-	return type==R ? sacSZ : sacST;
+	SacRec& sacS = type==R ? sacSZ : sacST;
+	if( psacF && nptsF!=nptsS ) {
+		*psacF = std::move(sacS);
+		SacRec sacC;
+		if( ! SynGenerator::CutSyn( *psacF, synG.minfo.t0, nptsS, sacC ) )
+			throw ErrorEA::InternalException(FuncName, "failed to cut the full-size synthetic for station "+sac.stname());
+		return sacC;
+	}
+	if( psacF ) *psacF = sacS;
+	return std::move(sacS);
 }
 
-StaData EQKAnalyzer::WaveformMisfit( const SacRec3 &sac3, SynGenerator &synG ) const {
+StaData EQKAnalyzer::WaveformMisfit( const SacRec3 &sac3, SynGenerator &synG, const int ista, SacRec* psacF ) const {
+	// produce synthetic
+	SacRec sacS = ComputeSyn(sac3[0], synG, ista, psacF);
+	return WaveformMisfit( sac3, sacS );
+}
+
+StaData EQKAnalyzer::WaveformMisfit( const SacRec3 &sac3, SacRec &sacS ) const {
+	PROFILE_SCOPE("EQKAnalyzer::WaveformMisfit");
 	// references to data sacs
 	const SacRec &sacM = sac3[0], &sac_am1 = sac3[1], &sac_ph1 = sac3[2];
 
-	// produce synthetic
-	SacRec sacS = ComputeSyn(sacM, synG);
-
 	sacS.Resample();	// important! shift to regular sampling grids
 
 	// zoom in to the surface wave window
@@ -751,14 +961,78 @@ StaData EQKAnalyzer::WaveformMisfit( const SacRec3 &sac3, SynGenerator &synG ) c
 }
 
 void EQKAnalyzer::UpdatePredsW( const ModelInfo& minfo, std::vector<SDContainer> &dataR, std::vector<SDContainer> &dataL ) const {
+	Metrics::Timer timer( Metrics::PredsWSec );
+	PROFILE_SCOPE("EQKAnalyzer::UpdatePredsW");
 	// lambda: update misfits for a single wavetype
 	auto updatePreds = [&]( SynGenerator synG, const std::vector<SacRec3> &sac3V, SDContainer &data ) {
+		// t0-only perturbation of a model with references: cut the synthetics of all stations
+		// to the new origin time, with no tracing or synthesis
+		auto prefV = _pwref ? _pwref->Find( minfo, synG.type ) : nullptr;
+		if( _pwref ) Metrics::Add( prefV ? Metrics::T0RefHits : Metrics::T0RefMisses );
+		if( prefV && prefV->size()==sac3V.size() ) {
+			Metrics::Timer timerT0( Metrics::T0ShiftSec );
+			const int nsta = sac3V.size();
+			std::vector<SacRec> sacSV( nsta );
+			bool cutsuc = true;
+			for( int i=0; i<nsta && cutsuc; i++ ) {
+				const auto& shdM = sac3V[i][0].shd;
+				const int nptsS = ceil( (shdM.user3-minfo.t0)/shdM.delta ) + 1;
+				cutsuc = SynGenerator::CutSyn( (*prefV)[i], minfo.t0, nptsS, sacSV[i] );
+			}
+			if( cutsuc ) {
+				Metrics::Add( Metrics::T0ShiftStas, nsta );
+				if( _pweng ) {
+					std::vector<WaveformEngine::Spec> specV;
+					_pweng->Spectra( sac3V, sacSV, specV );
+					for( int i=0; i<nsta; i++ ) {
+						const auto& shdM = sac3V[i][0].shd;
+						const auto mis = _pweng->StaMisfit( sac3V[i], specV[i] );
+						StaData sd(mis.azi, shdM.stlo, shdM.stla, mis.grT, mis.rms_ph, mis.rms_am+mis.AmpTheory, 0.); sd.Asource = mis.AmpTheory;
+						data.push_back( sd );
+					}
+				} else {
+					for( int i=0; i<nsta; i++ ) data.push_back( WaveformMisfit( sac3V[i], sacSV[i] ) );
+				}
+				data.Sort(); data.UpdateAziDis( minfo.lon, minfo.lat );
+				return;
+			}
+		}
+		Metrics::Add( Metrics::SynStas, sac3V.size() );
 		// prepare SynGenerator
 		//auto synGR = _synGR;
 		synG.SetEvent( minfo );
 		//float pseudo_per = nint(1./f3) + 0.001*nint(1./f2);
 		//SDContainer data( pseudo_per, synG.type=='R' ? R : L, false );	// waveform data container
-		for( const auto& sac3 : sac3V ) data.push_back( WaveformMisfit(sac3, synG) );
+		if( _pweng ) {
+			// spectral-domain misfits of all stations
+			Metrics::Timer timerSE( Metrics::SpecEngineSec );
+			std::vector<WaveformEngine::Spec> specV;
+			std::vector<SacRec> synV;
+			_pweng->Spectra( synG, sac3V, specV, _pinner.get(), _pwref ? &synV : nullptr );
+			for( int i=0; i<sac3V.size(); i++ ) {
+				const auto& shdM = sac3V[i][0].shd;
+				const auto mis = _pweng->StaMisfit( sac3V[i], specV[i] );
+				StaData sd(mis.azi, shdM.stlo, shdM.stla, mis.grT, mis.rms_ph, mis.rms_am+mis.AmpTheory, 0.); sd.Asource = mis.AmpTheory;
+				data.push_back( sd );
+			}
+			// no synthetics when summed from the unit-tensor spectra
+			auto prefVnew = synV.empty() ? nullptr : std::make_shared<const WaveformRefCache::RefV>( std::move(synV) );
+			if( prefVnew ) _pwref->Insert( minfo, synG.type, std::move(prefVnew) );
+		} else {
+			// per-station pipeline, on the # of threads _pinner decides
+			Metrics::Timer timerSP( Metrics::StaPipelineSec );
+			const int nsta = sac3V.size(), nthd = _pinner ? _pinner->Get(nsta) : 1;
+			auto prefVnew = _pwref ? std::make_shared<WaveformRefCache::RefV>( nsta ) : nullptr;
+			std::vector<StaData> sdV( nsta );
+			if( nthd > 1 ) synG.Trace();
+			const auto tb = std::chrono::steady_clock::now();
+			ParallelTasks( nsta, nthd, [&]( const int i ) {
+				sdV[i] = WaveformMisfit( sac3V[i], synG, i, prefVnew ? &((*prefVnew)[i]) : nullptr );
+			} );
+			if( _pinner ) _pinner->Record( std::chrono::duration<float>(std::chrono::steady_clock::now()-tb).count(), nsta, nthd );
+			for( auto& sd : sdV ) data.push_back( sd );
+			if( prefVnew ) _pwref->Insert( minfo, synG.type, std::move(prefVnew) );
+		}
 		//std::cout<<"average misfits = "<<sqrt(amp_sum/(N-1))<<" "<<sqrt(pha_sum/(N-1))<<std::endl;
 		data.Sort(); data.UpdateAziDis( minfo.lon, minfo.lat );
 	};
@@ -836,6 +1110,28 @@ void EQKAnalyzer::chiSquareW( const ModelInfo &minfo, float& chiS, int& N ) cons
 	if( Rsize==1 && RFlag ) chiSW( _synGR, dataR[0] );
 	if( Lsize==1 && LFlag ) chiSW( _synGL, dataL[0] );
 
+	// give back pooled signal buffers above the per-thread cap
+	SigMem::Trim();
+}
+
+
+/* ---------- WaveformRefCache ---------- */
+std::shared_ptr<const EQKAnalyzer::WaveformRefCache::RefV> EQKAnalyzer::WaveformRefCache::Find( const ModelInfo& mi, const char type ) {
+	std::lock_guard<std::mutex> lock(mtx);
+	for( auto I=entryL.begin(); I!=entryL.end(); I++ ) {
+		if( ! Matches(*I, mi, type) ) continue;
+		entryL.splice( entryL.begin(), entryL, I );
+		return entryL.front().prefV;
+	}
+	return nullptr;
+}
+
+void EQKAnalyzer::WaveformRefCache::Insert( const ModelInfo& mi, const char type, std::shared_ptr<const RefV> prefV ) {
+	std::lock_guard<std::mutex> lock(mtx);
+	for( auto I=entryL.begin(); I!=entryL.end(); I++ )
+		if( Matches(*I, mi, type) ) { entryL.erase(I); break; }
+	if( entryL.size() >= nmodel ) entryL.pop_back();
+	entryL.push_front( Entry{mi, type, std::move(prefV)} );
 }
 
 
@@ -858,16 +1154,30 @@ void EQKAnalyzer::OutputWaveforms( const ModelInfo& minfo, const std::string& ou
 		Dtype type = synG.type=='R' ? R : L;
 		synG.SetEvent( minfo );
 
-		for( auto& sac3 : sac3V ) {
-			auto &sacM = sac3[0]; auto &shdM = sacM.shd;
+		// synthetics are produced in order (synG is shared) ...
+		std::vector<SacRec> sacSV; sacSV.reserve( sac3V.size() );
+		for( int i=0; i<sac3V.size(); i++ ) {
+			auto &sacM = sac3V[i][0]; auto &shdM = sacM.shd;
 			// produce synthetic
-			SacRec sacS = ComputeSyn(sacM, synG);
+			sacSV.push_back( ComputeSyn(sacM, synG, i) );
+			auto& sacS = sacSV.back();
 			sacS.Resample();	// shift to regular sampling grids
 			sacS.cut( shdM.user2, shdM.user3 );
-
-			std::string sacname = outdir + "/" + sacS.stname() + "." + sacS.chname();
-			sacM.Write( sacname + "_real.SAC" ); sacS.Write( sacname + "_syn.SAC" );
 		}
+		// ... and written out concurrently (SacRec::Write takes no lock)
+		std::exception_ptr perr;
+		#pragma omp parallel for schedule(dynamic, 1)
+		for( int i=0; i<sac3V.size(); i++ ) {
+			try {
+				auto &sacM = sac3V[i][0], &sacS = sacSV[i];
+				std::string sacname = outdir + "/" + sacS.stname() + "." + sacS.chname();
+				sacM.Write( sacname + "_real.SAC" ); sacS.Write( sacname + "_syn.SAC" );
+			} catch( ... ) {
+				#pragma omp critical(OutputW)
+				if( ! perr ) perr = std::current_exception();
+			}
+		}
+		if( perr ) std::rethrow_exception( perr );
 	};
 
 	// call lambda for Rayleigh and Love
@@ -889,6 +1199,7 @@ void EQKAnalyzer::EstimateSigmas( const ModelInfo& minfo ) {
 	for( auto& sdc : _dataR ) sdc.ComputeVar();
 
 	for( auto& sdc : _dataL ) sdc.ComputeVar();
+	Resync();
 }
 void EQKAnalyzer::OutputSigmas() const {
 	// open output file
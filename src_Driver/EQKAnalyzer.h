@@ -3,14 +3,21 @@
 
 #include "ModelInfo.h"
 #include "SynGenerator.h"
+#include "WaveformEngine.h"
 #include "RadPattern.h"
 #include "SDContainer.h"
 #include "Searcher.h"
+#include "Metrics.h"
+#include "Profiler.h"
 #include "FileName.h"
+#include "Numa.h"
 #include "SacRec.h"
 #include <vector>
 #include <array>
 #include <map>
+#include <list>
+#include <memory>
+#include <mutex>
 
 //class ModelInfo;class SDContainer;
 
@@ -140,6 +147,13 @@ public:
    int Set( const char*, const bool MoveExistF = true );
    void CheckParams();
    void LoadData();
+	/* precompute the path corrections of the loaded stations over the epicenter box (plus a
+		margin), or resume them from file (param pathTable; waveform fitting only) */
+	void LoadPathTables( const float lonmin, const float lonmax, const float latmin, const float latmax );
+	/* with param numa on a multi-node machine: bind the search threads to the NUMA nodes and give
+		each node a replica of the data Energy reads. Call after loading; the non-const methods
+		below keep the replicas in step */
+	void PlaceOnNuma();
 	void SaveOldOutputs() const;
 
 	inline std::vector<float> perRlst() const;
@@ -148,13 +162,14 @@ public:
 
 	// initialize the Analyzer by pre- predicting radpatterns and updating pathpred for all SDContainer
 	// version (1): non-const, modifies internal data
-	void UpdatePredsM( const ModelInfo& mi ) { UpdatePredsM( mi, _dataR, _dataL ); }
+	void UpdatePredsM( const ModelInfo& mi ) { UpdatePredsM( mi, _dataR, _dataL ); Resync(); }
 	// version (2): const, modify external data 
 	void UpdatePredsM( const ModelInfo& mi, std::vector<SDContainer> &dataR, std::vector<SDContainer> &dataL ) const;
 
 	void UpdatePredsW( const ModelInfo& minfo, std::vector<SDContainer> &dataR, std::vector<SDContainer> &dataL ) const;
 	void UpdatePredsW( const ModelInfo& minfo ) {
 		UpdatePredsW( minfo, _dataR, _dataL );
+		Resync();
 	}
 
 	void UpdatePreds( const ModelInfo& minfo ) {
@@ -177,10 +192,16 @@ public:
 */
 
 	// use Love group data only when isInit=true
-	void SetInitSearch( bool isInit ) { _isInit = isInit; }
+	void SetInitSearch( bool isInit ) {
+		_isInit = isInit;
+		for( auto& prep : _replicas ) prep->_isInit = isInit;
+	}
 
 	// compute M0 for least chiS when true
-	void SetCorrectM0( bool correct ) { _correctM0 = correct; }
+	void SetCorrectM0( bool correct ) {
+		_correctM0 = correct;
+		for( auto& prep : _replicas ) prep->_correctM0 = correct;
+	}
 
 	// chi-square misfits from measurements-predictions
 	void chiSquareM( const ModelInfo &minfo, float& chiS, int& N ) const;
@@ -205,8 +226,10 @@ public:
 	}
 
 	void Energy( const ModelInfo& minfo, float& E, int& Ndata ) const {
+		Metrics::Timer timer( Metrics::EnergySec ); Metrics::Add( Metrics::EnergyCalls );
+		PROFILE_SCOPE("EQKAnalyzer::Energy");
 		float chiS; 
-		chiSquare( minfo, chiS, Ndata );
+		Local().chiSquare( minfo, chiS, Ndata );
 		E = chiS * _indep_factor; //chiS/(Ndata-8.);
 		if( Ndata < NdataMin )
 			throw ErrorEA::InsufData( FuncName, std::to_string(Ndata) + " < " + std::to_string(NdataMin) );
@@ -258,6 +281,27 @@ private:	// class
 		FileName fmeasure, fmapG, fmapP, fstalst;
 	};
 
+	/* synthetics kept for t0-only perturbations: the full-size synthetics (SynGenerator::FullSize) of all
+		stations, of which the synthetic at any other origin time is a prefix (SynGenerator::CutSyn).
+		References of the last few models (keyed by everything but t0) for each wave type, most recently used first */
+	class WaveformRefCache {
+	public:
+		typedef std::vector<SacRec> RefV;
+		WaveformRefCache( const int nmodel ) : nmodel(nmodel) {}
+		std::shared_ptr<const RefV> Find( const ModelInfo& mi, const char type );
+		void Insert( const ModelInfo& mi, const char type, std::shared_ptr<const RefV> prefV );
+		void clear() { std::lock_guard<std::mutex> lock(mtx); entryL.clear(); }
+	private:
+		struct Entry { ModelInfo mi; char type; std::shared_ptr<const RefV> prefV; };
+		int nmodel;
+		std::list<Entry> entryL;
+		std::mutex mtx;
+		static bool Matches( const Entry& e, const ModelInfo& mi, const char type ) {
+			ModelInfo mit0 = mi; mit0.t0 = e.mi.t0;
+			return e.type==type && e.mi==mit0 && e.mi.M0==mi.M0;
+		}
+	};
+
 private: // variables
 	const size_t nthd = omp_get_max_threads();
 	// option 1. measurements
@@ -270,6 +314,7 @@ private: // variables
 
 	// option 2. waveform fitting data
 	typedef std::array<SacRec, 3> SacRec3;
+	// the i-th record is station i of the SynGenerator (synthesized by index)
 	std::vector<SacRec3> _sac3VR, _sac3VL;
 	SynGenerator _synGR, _synGL;
 
@@ -288,6 +333,21 @@ private: // variables
 	Dtype datatype;
 	bool _useG = true, _useP = true, _useA = true;
 	bool _usewaveform = false;
+	bool _sacSidecar = false;	// read/write the preprocessed waveform records as binary sidecars (sacname.prepbin)
+	int _synBasisNloc = 4;		// # of event locations to keep synthetic basis for (waveform fitting only; unused when _specEngineNloc>0)
+	int _t0ShiftNmodel = 16;	// # of models to keep full-size synthetics of, cut to the new t0 on t0-only perturbations (waveform fitting only)
+	std::shared_ptr<WaveformRefCache> _pwref;
+	int _specEngineNloc = 4;	// # of (location, depth, t0)s to keep unit-tensor spectra for (0: batched FFTs only; <0: per-station SacRec pipeline)
+	std::shared_ptr<WaveformEngine> _pweng;
+	int _stationThreads = 0;	// max # of threads over stations within a waveform evaluation (0: adaptive; 1: serial)
+	std::shared_ptr<InnerThreads> _pinner;
+	std::string _pathTableName;	// path-correction tables (_pathTableName.R/.L) on a grid of _pathTableGrid deg
+	float _pathTableGrid = 0., _pathTablePad = 0.;	// (<=0: trace every event), over the epicenter box + _pathTablePad deg
+	std::string _metricsName, _metricsProm;	// runtime metrics: JSON lines appended to _metricsName every _metricsInterval sec,
+	float _metricsInterval = 10.;				// and the node-exporter textfile _metricsProm (if given)
+	std::shared_ptr<Metrics::Reporter> _preporter;
+	bool _numa = false;	// replicate the data per NUMA node (PlaceOnNuma)
+	std::vector<std::shared_ptr<EQKAnalyzer>> _replicas;	// by node (empty: no replicas)
 	bool _isInit = false;
 	// data weightings (!!!not implemented, adjust varmins in SDContainer instead!!!)
    float weightR_Loc = 1., weightL_Loc = 1.;  // weighting between Rayleigh and Love data for Location search
@@ -322,9 +382,22 @@ private: // functions
 	void MKDirFor( const std::string& path, const bool isdir = false ) const;
 
 	//float Tpeak( const SacRec& sac ) const;
-	SacRec ComputeSyn(const SacRec &sac, SynGenerator &synG) const;
-	StaData WaveformMisfit( const SacRec3 &sac3, SynGenerator &synG ) const;
+	// synthetic for the record sac of station ista of synG. The full-size synthetic (for later t0 shifts) goes to psacF if given
+	SacRec ComputeSyn(const SacRec &sac, SynGenerator &synG, const int ista, SacRec* psacF = nullptr) const;
+	StaData WaveformMisfit( const SacRec3 &sac3, SynGenerator &synG, const int ista, SacRec* psacF = nullptr ) const;
+	// misfit of the synthetic sacS (from ComputeSyn, resampled and cut in place)
+	StaData WaveformMisfit( const SacRec3 &sac3, SacRec &sacS ) const;
 	float RescaleSourceAmps( std::vector<SDContainer>& dataR, std::vector<SDContainer>& dataL ) const;
+
+	// the replica of the calling thread's node (*this when there are none)
+	const EQKAnalyzer& Local() const {
+		return _replicas.empty() ? *this : *_replicas[Numa::ThisNode()];
+	}
+	// (re)build a replica on each node; rebuild the existing ones
+	void Replicate();
+	void Resync() { if( ! _replicas.empty() ) Replicate(); }
+	// deep copies of what Energy reads, allocated by the calling thread, and caches of its own
+	void Detach();
 };
 
 #endif
@@ -0,0 +1,172 @@
+#include "Metrics.h"
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+
+namespace Metrics {
+	// progress is <0 out of searches; the others are NaN until set
+	std::array<std::atomic<double>, NGauge> gauges{ { {-1.}, {std::numeric_limits<double>::quiet_NaN()},
+		{std::numeric_limits<double>::quiet_NaN()}, {std::numeric_limits<double>::quiet_NaN()} } };
+}
+
+namespace {
+	typedef std::array<std::atomic<double>, Metrics::NCounter> SlotA;
+
+	// the slots of all live threads, and the sums of the exited ones
+	struct Registry {
+		std::mutex mtx;
+		std::vector<SlotA*> live;
+		std::array<double, Metrics::NCounter> retired{};
+	};
+	Registry& Reg() { static Registry reg; return reg; }
+
+	struct Slots {
+		SlotA v;
+		Slots() {
+			for( auto& s : v ) s.store( 0., std::memory_order_relaxed );
+			auto& reg = Reg();
+			std::lock_guard<std::mutex> lck( reg.mtx );
+			reg.live.push_back( &v );
+		}
+		~Slots() {
+			auto& reg = Reg();
+			std::lock_guard<std::mutex> lck( reg.mtx );
+			for( int i=0; i<Metrics::NCounter; i++ ) reg.retired[i] += v[i].load( std::memory_order_relaxed );
+			reg.live.erase( std::find(reg.live.begin(), reg.live.end(), &v) );
+		}
+	};
+	thread_local Slots slots;
+	thread_local int iparamLast = -1;
+
+	// JSON/textfile number (null/NaN for gauges not yet set)
+	std::string Num( const double v, const bool json = true ) {
+		if( std::isnan(v) ) return json ? "null" : "NaN";
+		std::ostringstream ss; ss<<std::setprecision(8)<<v;
+		return ss.str();
+	}
+	double Ratio( const double a, const double b ) {
+		return b>0. ? a/b : std::numeric_limits<double>::quiet_NaN();
+	}
+	// stage timers: name and counter
+	const std::pair<const char*, Metrics::Counter> StageA[] = {
+		{"energy", Metrics::EnergySec}, {"predsM", Metrics::PredsMSec}, {"radpattern", Metrics::RadPatternSec},
+		{"pathpred", Metrics::PathPredSec}, {"sourcepred", Metrics::SourcePredSec}, {"predsW", Metrics::PredsWSec},
+		{"t0shift", Metrics::T0ShiftSec}, {"specengine", Metrics::SpecEngineSec}, {"stapipeline", Metrics::StaPipelineSec}
+	};
+}
+
+namespace Metrics {
+	std::array<std::atomic<double>, NCounter>& Local() { return slots.v; }
+
+	void Propose( const int iparam ) {
+		if( iparam<0 || iparam>=NParam ) return;
+		iparamLast = iparam;
+		Add( (Counter)(Proposals+iparam) );
+	}
+	void Decide( const bool accepted ) {
+		if( iparamLast < 0 ) return;
+		if( accepted ) Add( (Counter)(Accepts+iparamLast) );
+		iparamLast = -1;
+	}
+	void Skip() {
+		if( iparamLast < 0 ) return;
+		Add( (Counter)(Skips+iparamLast) );
+		iparamLast = -1;
+	}
+
+	void Snapshot( std::array<double, NCounter>& counters ) {
+		auto& reg = Reg();
+		std::lock_guard<std::mutex> lck( reg.mtx );
+		counters = reg.retired;
+		for( const auto pslot : reg.live )
+			for( int i=0; i<NCounter; i++ ) counters[i] += (*pslot)[i].load( std::memory_order_relaxed );
+	}
+
+
+	/* -------------------- Reporter -------------------- */
+	Reporter::Reporter( const std::string& fjson, const float interval, const std::string& fprom )
+		: fjson(fjson), fprom(fprom), interval(interval>0. ? interval : 10.)
+		, tstart(std::chrono::steady_clock::now()), tlast(tstart) {
+		thd = std::thread( [this]() {
+			std::unique_lock<std::mutex> lck( mtx );
+			while( ! cv.wait_for( lck, std::chrono::duration<float>(this->interval), [this]{ return stop; } ) ) {
+				lck.unlock(); Report(); lck.lock();
+			}
+		} );
+	}
+
+	Reporter::~Reporter() {
+		{ std::lock_guard<std::mutex> lck( mtx ); stop = true; }
+		cv.notify_all();
+		thd.join();
+		Report();
+	}
+
+	void Reporter::Report() {
+		std::array<double, NCounter> c; Snapshot( c );
+		const auto tnow = std::chrono::steady_clock::now();
+		const double elapsed = std::chrono::duration<double>(tnow-tstart).count();
+		const double dt = std::chrono::duration<double>(tnow-tlast).count();
+		const double hits = c[T0RefHits], misses = c[T0RefMisses];
+
+		// one JSON object per line
+		std::ostringstream ss;
+		ss<<"{\"time\":"<<(long)std::time(nullptr)<<",\"elapsed\":"<<Num(elapsed)
+		  <<",\"energy\":{\"calls\":"<<Num(c[EnergyCalls])<<",\"per_sec\":"<<Num(Ratio(c[EnergyCalls]-clast[EnergyCalls], dt))
+		  <<",\"sec_per_call\":"<<Num(Ratio(c[EnergySec], c[EnergyCalls]))<<"}"
+		  <<",\"stage_sec\":{";
+		for( int i=0; i<sizeof(StageA)/sizeof(StageA[0]); i++ )
+			ss<<(i==0?"":",")<<"\""<<StageA[i].first<<"\":"<<Num(c[StageA[i].second]);
+		ss<<"},\"t0ref\":{\"hits\":"<<Num(hits)<<",\"misses\":"<<Num(misses)<<",\"hit_rate\":"<<Num(Ratio(hits, hits+misses))<<"}"
+		  <<",\"stations\":{\"synthesized\":"<<Num(c[SynStas])<<",\"t0shifted\":"<<Num(c[T0ShiftStas])<<"}"
+		  <<",\"accept\":{";
+		for( int i=0; i<NParam; i++ )
+			ss<<(i==0?"":",")<<"\""<<ParamName[i]<<"\":{\"proposed\":"<<Num(c[Proposals+i])<<",\"accepted\":"<<Num(c[Accepts+i])
+			  <<",\"skipped\":"<<Num(c[Skips+i])<<",\"rate\":"<<Num(Ratio(c[Accepts+i], c[Proposals+i]-c[Skips+i]))<<"}";
+		ss<<"},\"search\":{\"progress\":"<<Num(Get(Progress))<<",\"T\":"<<Num(Get(Temperature))
+		  <<",\"Ebest\":"<<Num(Get(Ebest))<<",\"E\":"<<Num(Get(Ecurrent))<<"}}\n";
+		std::ofstream fout( fjson, std::ofstream::app );
+		if( ! (fout << ss.str()) ) std::cerr<<"Warning(Metrics::Reporter::Report): cannot write to "<<fjson<<std::endl;
+		tlast = tnow; clast = c;
+
+		if( fprom.empty() ) return;
+		// node-exporter textfile: written to a temporary file and renamed, so the collector never reads a partial one
+		std::ostringstream sp;
+		sp<<"# HELP eqk_energy_calls_total Energy (misfit) evaluations.\n# TYPE eqk_energy_calls_total counter\n"
+		  <<"eqk_energy_calls_total "<<Num(c[EnergyCalls], false)<<"\n"
+		  <<"# HELP eqk_stage_seconds_total Wall time summed over threads, by stage.\n# TYPE eqk_stage_seconds_total counter\n";
+		for( const auto& stage : StageA )
+			sp<<"eqk_stage_seconds_total{stage=\""<<stage.first<<"\"} "<<Num(c[stage.second], false)<<"\n";
+		sp<<"# HELP eqk_t0ref_total Lookups of waveform misfit references for t0-only perturbations.\n# TYPE eqk_t0ref_total counter\n"
+		  <<"eqk_t0ref_total{result=\"hit\"} "<<Num(hits, false)<<"\n"
+		  <<"eqk_t0ref_total{result=\"miss\"} "<<Num(misses, false)<<"\n"
+		  <<"# HELP eqk_stations_total Station misfits, by how they were computed.\n# TYPE eqk_stations_total counter\n"
+		  <<"eqk_stations_total{path=\"synthesized\"} "<<Num(c[SynStas], false)<<"\n"
+		  <<"eqk_stations_total{path=\"t0shifted\"} "<<Num(c[T0ShiftStas], false)<<"\n"
+		  <<"# HELP eqk_proposals_total Search proposals, by perturbed parameter.\n# TYPE eqk_proposals_total counter\n";
+		for( int i=0; i<NParam; i++ ) sp<<"eqk_proposals_total{param=\""<<ParamName[i]<<"\"} "<<Num(c[Proposals+i], false)<<"\n";
+		sp<<"# HELP eqk_accepts_total Accepted search proposals, by perturbed parameter.\n# TYPE eqk_accepts_total counter\n";
+		for( int i=0; i<NParam; i++ ) sp<<"eqk_accepts_total{param=\""<<ParamName[i]<<"\"} "<<Num(c[Accepts+i], false)<<"\n";
+		sp<<"# HELP eqk_skips_total Search proposals whose energy could not be computed, by perturbed parameter.\n# TYPE eqk_skips_total counter\n";
+		for( int i=0; i<NParam; i++ ) sp<<"eqk_skips_total{param=\""<<ParamName[i]<<"\"} "<<Num(c[Skips+i], false)<<"\n";
+		sp<<"# TYPE eqk_search_progress gauge\neqk_search_progress "<<Num(Get(Progress), false)<<"\n"
+		  <<"# TYPE eqk_search_temperature gauge\neqk_search_temperature "<<Num(Get(Temperature), false)<<"\n"
+		  <<"# TYPE eqk_search_energy_best gauge\neqk_search_energy_best "<<Num(Get(Ebest), false)<<"\n"
+		  <<"# TYPE eqk_search_energy gauge\neqk_search_energy "<<Num(Get(Ecurrent), false)<<"\n";
+		const std::string ftmp = fprom + ".tmp" + std::to_string(getpid());
+		std::ofstream fp( ftmp );
+		fp << sp.str(); fp.close();
+		if( ! fp || rename(ftmp.c_str(), fprom.c_str()) != 0 ) {
+			std::cerr<<"Warning(Metrics::Reporter::Report): failed to write "<<fprom<<std::endl;
+			unlink( ftmp.c_str() );
+		}
+	}
+}
@@ -0,0 +1,92 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/* runtime metrics of the searches: counters (and timers, as counters of seconds) kept per
+	thread with a single writer each and summed on read, plus gauges of the current search
+	state. A Reporter merges them periodically into a line-delimited JSON file and, optionally,
+	a node-exporter textfile */
+namespace Metrics {
+	// perturbed parameters, indexed as the dice of ModelSpace::Perturb (0: all at once)
+	const int NParam = 9;
+	const char* const ParamName[NParam] = { "all", "stk", "dip", "rak", "dep", "M0", "lon", "lat", "t0" };
+
+	enum Counter {
+		EnergyCalls, EnergySec,
+		PredsMSec, RadPatternSec, PathPredSec, SourcePredSec,		// UpdatePredsM stages
+		PredsWSec, T0ShiftSec, SpecEngineSec, StaPipelineSec,		// UpdatePredsW stages
+		T0RefHits, T0RefMisses, T0ShiftStas, SynStas,
+		Proposals, Accepts = Proposals + NParam,						// per parameter
+		Skips = Accepts + NParam,											// ... proposals whose energy failed
+		NCounter = Skips + NParam
+	};
+	enum Gauge { Progress, Temperature, Ebest, Ecurrent, NGauge };
+
+	// the slots of the calling thread (folded into the totals when the thread exits)
+	std::array<std::atomic<double>, NCounter>& Local();
+	extern std::array<std::atomic<double>, NGauge> gauges;
+
+	inline void Add( const Counter c, const double v = 1. ) {
+		auto& slot = Local()[c];	// single writer: no read-modify-write needed
+		slot.store( slot.load(std::memory_order_relaxed) + v, std::memory_order_relaxed );
+	}
+	inline void Set( const Gauge g, const double v ) { gauges[g].store( v, std::memory_order_relaxed ); }
+	inline double Get( const Gauge g ) { return gauges[g].load( std::memory_order_relaxed ); }
+
+	// the parameter last perturbed by the calling thread, and the search decision on it
+	void Propose( const int iparam );
+	void Decide( const bool accepted );
+	// ... or no decision: the proposal could not be evaluated
+	void Skip();
+
+	// sums over all threads (alive or exited)
+	void Snapshot( std::array<double, NCounter>& counters );
+
+	/* adds the elapsed seconds to a counter on destruction; Lap(c) adds the time since
+		construction (or the last lap) to c */
+	class Timer {
+	public:
+		Timer( const Counter c ) : c(c), tb(Clock::now()), tlap(tb) {}
+		~Timer() { Add( c, Sec(tb, Clock::now()) ); }
+		void Lap( const Counter clap ) {
+			const auto t = Clock::now();
+			Add( clap, Sec(tlap, t) ); tlap = t;
+		}
+	private:
+		typedef std::chrono::steady_clock Clock;
+		const Counter c;
+		const Clock::time_point tb;
+		Clock::time_point tlap;
+		static double Sec( const Clock::time_point& t1, const Clock::time_point& t2 ) {
+			return std::chrono::duration<double>(t2-t1).count();
+		}
+	};
+
+	/* appends a snapshot to fjson every interval sec (and once more on destruction), and
+		rewrites fprom (if not empty) for the node-exporter textfile collector */
+	class Reporter {
+	public:
+		Reporter( const std::string& fjson, const float interval = 10., const std::string& fprom = "" );
+		~Reporter();
+		void Report();
+	private:
+		const std::string fjson, fprom;
+		const float interval;
+		const std::chrono::steady_clock::time_point tstart;
+		std::chrono::steady_clock::time_point tlast;
+		std::array<double, NCounter> clast{};
+		std::mutex mtx;
+		std::condition_variable cv;
+		bool stop = false;
+		std::thread thd;
+	};
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include "Searcher.h"
 #include "EQKAnalyzer.h"
 #include "Rand.h"
+#include "Metrics.h"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
@@ -37,6 +38,7 @@ class ModelSpace : public ModelInfo, public Searcher::IModelSpace<ModelInfo> {
 			if( ! fin )
 				throw std::runtime_error("bad file");
 			int nparam = 0; M0 = 1.;
+			Space sp = space.Read();
 			for( std::string line; std::getline(fin, line); ) {
 				std::istringstream ss(line);
 				if( ! (ss>>line) ) continue;
@@ -48,18 +50,19 @@ class ModelSpace : public ModelInfo, public Searcher::IModelSpace<ModelInfo> {
 				else if( line == "rak" ) ss >> rak;
 				else if( line == "dep" ) ss >> dep;
 				else if( line == "M0" )  ss >> M0;
-				else if( line == "Rlon") ss >> Rlon;
-				else if( line == "Rlat") ss >> Rlat;
-				else if( line == "Rstk") ss >> Rstk;
-				else if( line == "Rdip") ss >> Rdip;
-				else if( line == "Rrak") ss >> Rrak;
-				else if( line == "Rdep") ss >> Rdep;
-				else if( line == "RM0")  ss >> RM0;
-				else if( line == "pertfactor") ss >> pertfactor;
+				else if( line == "Rlon") ss >> sp.Rlon;
+				else if( line == "Rlat") ss >> sp.Rlat;
+				else if( line == "Rstk") ss >> sp.Rstk;
+				else if( line == "Rdip") ss >> sp.Rdip;
+				else if( line == "Rrak") ss >> sp.Rrak;
+				else if( line == "Rdep") ss >> sp.Rdep;
+				else if( line == "RM0")  ss >> sp.RM0;
+				else if( line == "pertfactor") ss >> sp.pertfactor;
 				else continue;
 				nparam += (bool)ss;
 			}
 			fin.close();
+			space.Write( sp );
 
 			std::cout<<"### ModelSpace::LoadParams: "<<nparam<<" succed loads from param file "<<fname<<". ###\n"
 						<<"    current model = "<<MInfo()<<std::endl;
@@ -72,6 +75,12 @@ class ModelSpace : public ModelInfo, public Searcher::IModelSpace<ModelInfo> {
 		}
 
 		const ModelInfo& MInfo() const { return dynamic_cast<const ModelInfo&>(*this); }
+		// lon-lat box the epicenter is searched in
+		void EpicBox( float& lonmin, float& lonmax, float& latmin, float& latmax ) const {
+			const Space sp = space.Read();
+			lonmin = sp.Clon - sp.Rlon; lonmax = sp.Clon + sp.Rlon;
+			latmin = sp.Clat - sp.Rlat; latmax = sp.Clat + sp.Rlat;
+		}
 		inline void SetMState( const ModelInfo& mi ) {
 			dynamic_cast<ModelInfo&>(*this) = mi;
 		}
@@ -80,28 +89,32 @@ class ModelSpace : public ModelInfo, public Searcher::IModelSpace<ModelInfo> {
 				const float Cstkin, const float Cdipin, const float Crakin, const float Cdepin,
 				const float Rlonin, const float Rlatin, const float Rtimin, const float RM0in,
 				const float Rstkin, const float Rdipin, const float Rrakin, const float Rdepin ) {
-			Clon = Clonin; Clat = Clatin; Ctim = Ctimin; CM0 = CM0in;
-			Cstk = Cstkin; Cdip = Cdipin; Crak = Crakin; Cdep = Cdepin;
-			if( Clon<0. ) Clon+=360.;
-			if( Clon<0||Clon>=360. || Clat<-90.||Clat>90. || CM0<1.0e19||CM0>1.0e31 ||
-					Cstk<0||Cstk>=360. || Cdip<0.||Cdip>90. || Crak<-180.||Crak>=180. || Cdep<0. || Cdep>=DEPMAX )
-				throw std::runtime_error("SetC");
-			Rlon = Rlonin; Rlat = Rlatin; Rtim = Rtimin; RM0 = RM0in;
-			Rstk = Rstkin; Rdip = Rdipin; Rrak = Rrakin; Rdep = Rdepin;
-			if( Rlon<=0. || Rlat<=0. || Rtim<=0. || RM0<=0. || Rstk<=0. || Rdip<=0. || Rrak<=0. || Rdep<=0. )
-				throw std::runtime_error("SetR");
+			space.Update( [&]( Space& sp ) {
+				sp.Clon = Clonin; sp.Clat = Clatin; sp.Ctim = Ctimin; sp.CM0 = CM0in;
+				sp.Cstk = Cstkin; sp.Cdip = Cdipin; sp.Crak = Crakin; sp.Cdep = Cdepin;
+				if( sp.Clon<0. ) sp.Clon+=360.;
+				if( sp.Clon<0||sp.Clon>=360. || sp.Clat<-90.||sp.Clat>90. || sp.CM0<1.0e19||sp.CM0>1.0e31 ||
+						sp.Cstk<0||sp.Cstk>=360. || sp.Cdip<0.||sp.Cdip>90. || sp.Crak<-180.||sp.Crak>=180. || sp.Cdep<0. || sp.Cdep>=DEPMAX )
+					throw std::runtime_error("SetC");
+				sp.Rlon = Rlonin; sp.Rlat = Rlatin; sp.Rtim = Rtimin; sp.RM0 = RM0in;
+				sp.Rstk = Rstkin; sp.Rdip = Rdipin; sp.Rrak = Rrakin; sp.Rdep = Rdepin;
+				if( sp.Rlon<=0. || sp.Rlat<=0. || sp.Rtim<=0. || sp.RM0<=0. || sp.Rstk<=0. || sp.Rdip<=0. || sp.Rrak<=0. || sp.Rdep<=0. )
+					throw std::runtime_error("SetR");
+			} );
 			//validS = true;
 		}
 
 		// model space re-shape operations
 		void SetPerturb( const float Plonin, const float Platin, const float Ptimin, const float PM0in, 
 							  const float Pstkin, const float Pdipin, const float Prakin, const float Pdepin ) {
-			Plon = Plonin; Plat = Platin; Ptim = Ptimin; PM0 = PM0in;
-			Pstk = Pstkin; Pdip = Pdipin; Prak = Prakin; Pdep = Pdepin;
-			if( Plon<0. || Plat<0. || Ptim<0. || Pstk<0. || Pdip<0. || Prak<0. || Pdep<0. || PM0<0. )
+			if( Plonin<0. || Platin<0. || Ptimin<0. || Pstkin<0. || Pdipin<0. || Prakin<0. || Pdepin<0. || PM0in<0. )
 				throw std::runtime_error("Error(SetPerturb): negative purtabation!");
-			if( Plon + Plat + Ptim + Pstk + Pdip + Prak + Pdep + PM0 == 0 )
+			if( Plonin + Platin + Ptimin + Pstkin + Pdipin + Prakin + Pdepin + PM0in == 0 )
 				throw std::runtime_error("Error(SetPerturb): model non purtable!");
+			space.Update( [&]( Space& sp ) {
+				sp.Plon = Plonin; sp.Plat = Platin; sp.Ptim = Ptimin; sp.PM0 = PM0in;
+				sp.Pstk = Pstkin; sp.Pdip = Pdipin; sp.Prak = Prakin; sp.Pdep = Pdepin;
+			} );
 			//validP = true;
 		}
 
@@ -109,14 +122,17 @@ class ModelSpace : public ModelInfo, public Searcher::IModelSpace<ModelInfo> {
 							  const bool pstk, const bool pdip, const bool prak, const bool pdep ) {
 			if( plon + plat + ptim + pstk + pdip + prak + pdep + pM0 == 0 )
 				throw std::runtime_error("Error(SetPerturb): model non purtable!");
-			if( plon ) Plon = pertfactor * Rlon; else Plon = 0.;
-			if( plat ) Plat = pertfactor * Rlat; else Plat = 0.;
-			if( ptim ) Ptim = pertfactor * Rtim; else Ptim = 0.;
-			if( pstk ) Pstk = pertfactor * Rstk; else Pstk = 0.;
-			if( pdip ) Pdip = pertfactor * Rdip; else Pdip = 0.;
-			if( prak ) Prak = pertfactor * Rrak; else Prak = 0.;
-			if( pdep ) Pdep = pertfactor * Rdep; else Pdep = 0.;
-			if( pM0 ) PM0 = pow(RM0, pertfactor); else PM0 = 1.;
+			space.Update( [&]( Space& sp ) {
+				const float pf = sp.pertfactor;
+				sp.Plon = plon ? pf * sp.Rlon : 0.;
+				sp.Plat = plat ? pf * sp.Rlat : 0.;
+				sp.Ptim = ptim ? pf * sp.Rtim : 0.;
+				sp.Pstk = pstk ? pf * sp.Rstk : 0.;
+				sp.Pdip = pdip ? pf * sp.Rdip : 0.;
+				sp.Prak = prak ? pf * sp.Rrak : 0.;
+				sp.Pdep = pdep ? pf * sp.Rdep : 0.;
+				sp.PM0 = pM0 ? pow(sp.RM0, pf) : 1.;
+			} );
 		}
 
 		//void FixEpic() { SetPerturb( false, false, false, true, true, true, true, true ); }
@@ -125,15 +141,17 @@ class ModelSpace : public ModelInfo, public Searcher::IModelSpace<ModelInfo> {
 
 		void SetFreeFocal( bool rand_init = false ) {
 			// searching centers and ranges
-			Cstk = Rstk = 180.; //Pstk = 72.;
-			Cdip = Rdip = 45.; //Pdip = 18.;
-			Crak = 0.; Rrak = 180.; //Prak = 72.;
-			Cdep = Rdep = DEPMAX*0.5; //Pdep = 12.;
-			CM0 = M0==NaN ? 5.0e23 : M0; RM0 = 100.;
+			space.Update( [&]( Space& sp ) {
+				sp.Cstk = sp.Rstk = 180.; //Pstk = 72.;
+				sp.Cdip = sp.Rdip = 45.; //Pdip = 18.;
+				sp.Crak = 0.; sp.Rrak = 180.; //Prak = 72.;
+				sp.Cdep = sp.Rdep = DEPMAX*0.5; //Pdep = 12.;
+				sp.CM0 = M0==NaN ? 5.0e23 : M0; sp.RM0 = 100.;
 			// Mw = (2/3)*log_10(M0)-10.7
 			// 1.0e20 = 2.6; 1.0e21 = 3.3; 1.0e22 = 3.9; 1.0e23 = 4.6; 1.0e24 = 5.3; 1.0e25 = 5.9; 
 			// 1.0e26 = 6.6; 1.0e27 = 7.3; 1.0e28 = 7.9; 1.0e29 = 8.6; 1.0e30 = 9.3; 1.0e31 = 9.9;
-			resetPerturb();
+				resetPerturb( sp );
+			} );
 			// starting position
 			if( rand_init ) {
 				auto& rand_t = randO[omp_get_thread_num()];
@@ -150,15 +168,16 @@ class ModelSpace : public ModelInfo, public Searcher::IModelSpace<ModelInfo> {
 		//}	// bad idea: the randO objects are not evolved by the call
 		void RandomState( ModelInfo &mi ) const {
 			if( &mi != this )	mi = *this;	
+			const Space sp = space.Read();
 			auto& rand_t = randO[omp_get_thread_num()];
-			if(Plon>0.) mi.lon = (rand_t.Uniform()*2.-1) * Rlon + Clon;
-			if(Plat>0.) mi.lat = (rand_t.Uniform()*2.-1) * Rlat + Clat;
-			if(Ptim>0.) mi.t0  = (rand_t.Uniform()*2.-1) * Rtim + Ctim;
-			if(Pstk>0.) mi.stk = (rand_t.Uniform()*2.-1) * Rstk + Cstk;
-			if(Pdip>0.) mi.dip = (rand_t.Uniform()*2.-1) * Rdip + Cdip;
-			if(Prak>0.) mi.rak = (rand_t.Uniform()*2.-1) * Rrak + Crak;
-			if(Pdep>0.) mi.dep = (rand_t.Uniform()*2.-1) * Rdep + Cdep;
-			if(PM0 >1.) mi.M0  = exp( (rand_t.Uniform()*2.-1)*log(RM0) ) * CM0;
+			if(sp.Plon>0.) mi.lon = (rand_t.Uniform()*2.-1) * sp.Rlon + sp.Clon;
+			if(sp.Plat>0.) mi.lat = (rand_t.Uniform()*2.-1) * sp.Rlat + sp.Clat;
+			if(sp.Ptim>0.) mi.t0  = (rand_t.Uniform()*2.-1) * sp.Rtim + sp.Ctim;
+			if(sp.Pstk>0.) mi.stk = (rand_t.Uniform()*2.-1) * sp.Rstk + sp.Cstk;
+			if(sp.Pdip>0.) mi.dip = (rand_t.Uniform()*2.-1) * sp.Rdip + sp.Cdip;
+			if(sp.Prak>0.) mi.rak = (rand_t.Uniform()*2.-1) * sp.Rrak + sp.Crak;
+			if(sp.Pdep>0.) mi.dep = (rand_t.Uniform()*2.-1) * sp.Rdep + sp.Cdep;
+			if(sp.PM0 >1.) mi.M0  = exp( (rand_t.Uniform()*2.-1)*log(sp.RM0) ) * sp.CM0;
 			//std::cerr<<mi.stk<<" "<<mi.dip<<" "<<mi.rak<<" "<<mi.dep<<"   "<<mi.lon<<" "<<mi.lat<<" "<<mi.t0<<" "<<mi.M0<<std::endl;
 		}
 		void RandomState() {	RandomState(*this); }
@@ -166,25 +185,26 @@ class ModelSpace : public ModelInfo, public Searcher::IModelSpace<ModelInfo> {
 		// centralize the model space around the current MState
 		void Centralize() {
 			// set model center to the current MState
-			Clon = lon; Clat = lat; Ctim = t0; CM0 = M0;
-			Cstk = stk; Cdip = dip; Crak = rak; Cdep = dep;
+			space.Update( [this]( Space& sp ) { Centralize( sp ); } );
 		}
 
 		void Bound( const float Rfactor = 1., const float pertf = NaN ) {
-			// create default model space
-			ModelSpace ms;
-			// reset perturb half lengths
-			Rlon = ms.Rlon*Rfactor; Rlat = ms.Rlat*Rfactor;
-			Rtim = ms.Rtim*Rfactor; RM0 = ms.RM0*Rfactor;
-			Rstk = ms.Rstk*Rfactor; Rdip = ms.Rdip*Rfactor;
-			Rrak = ms.Rrak*Rfactor; Rdep = ms.Rdep*Rfactor;
-			// reset perturb factor
-			auto psave = pertfactor;
-			pertfactor = pertf>0. ? pertf : ms.pertfactor;
-			// reset model center, perturbation ranges, and random number generators
-			Centralize();
-			resetPerturb();
-			pertfactor = psave;
+			// default model space
+			const Space sp0;
+			space.Update( [&]( Space& sp ) {
+				// reset perturb half lengths
+				sp.Rlon = sp0.Rlon*Rfactor; sp.Rlat = sp0.Rlat*Rfactor;
+				sp.Rtim = sp0.Rtim*Rfactor; sp.RM0 = sp0.RM0*Rfactor;
+				sp.Rstk = sp0.Rstk*Rfactor; sp.Rdip = sp0.Rdip*Rfactor;
+				sp.Rrak = sp0.Rrak*Rfactor; sp.Rdep = sp0.Rdep*Rfactor;
+				// reset perturb factor
+				auto psave = sp.pertfactor;
+				sp.pertfactor = pertf>0. ? pertf : sp0.pertfactor;
+				// reset model center and perturbation ranges
+				Centralize( sp );
+				resetPerturb( sp );
+				sp.pertfactor = psave;
+			} );
 		}
 
 		// decide perturb step length for each parameter based on the model sensitivity to them
@@ -197,66 +217,75 @@ class ModelSpace : public ModelInfo, public Searcher::IModelSpace<ModelInfo> {
 			int Ndata;
 			float Emin; eka.Energy(*this, Emin, Ndata);
 			ModelInfo minfo = *this;
+			const Space sp = space.Read();
 			#pragma omp parallel firstprivate(minfo)
 			{ // parallel begins
 				#pragma omp sections
 				{ // omp sections begins
 					#pragma omp section
 					{
-					float lb_old = stk - Rstk, ub_old = stk + Rstk;
+					float lb_old = stk - sp.Rstk, ub_old = stk + sp.Rstk;
 					float lb_stk = SearchBound( eka, minfo, minfo.stk, lb_old, Pthreshold, Emin, 10 );
 					float ub_stk = SearchBound( eka, minfo, minfo.stk, ub_old, Pthreshold, Emin, 10 );
-					Pstk = (ub_stk-lb_stk) * sfactor;
+					const float P = (ub_stk-lb_stk) * sfactor;
+					space.Update( [P]( Space& s ) { s.Pstk = P; } );
 					} // section 1
 					#pragma omp section
 					{
-					float lb_old = std::max(0.f, dip-Rdip), ub_old = std::min(90.f, dip+Rdip);
+					float lb_old = std::max(0.f, dip-sp.Rdip), ub_old = std::min(90.f, dip+sp.Rdip);
 					float lb_dip = SearchBound( eka, minfo, minfo.dip, lb_old, Pthreshold, Emin, 10 );
 					float ub_dip = SearchBound( eka, minfo, minfo.dip, ub_old, Pthreshold, Emin, 10 );
-					Pdip = (ub_dip-lb_dip) * sfactor;
+					const float P = (ub_dip-lb_dip) * sfactor;
+					space.Update( [P]( Space& s ) { s.Pdip = P; } );
 					} // section 2
 					#pragma omp section
 					{
-					float lb_old = rak - Rrak, ub_old = rak + Rrak;
+					float lb_old = rak - sp.Rrak, ub_old = rak + sp.Rrak;
 					float lb_rak = SearchBound( eka, minfo, minfo.rak, lb_old, Pthreshold, Emin, 10 );
 					float ub_rak = SearchBound( eka, minfo, minfo.rak, ub_old, Pthreshold, Emin, 10 );
-					Prak = (ub_rak-lb_rak) * sfactor;
+					const float P = (ub_rak-lb_rak) * sfactor;
+					space.Update( [P]( Space& s ) { s.Prak = P; } );
 					} // section 3
 					#pragma omp section
 					{
-					float lb_old = std::max(0.f, dep-Rdep), ub_old = dep + Rdep;
+					float lb_old = std::max(0.f, dep-sp.Rdep), ub_old = dep + sp.Rdep;
 					//if( Rdep < 0 ) { lb_old = 0.; ub_old = 200.; }
 					float lb_dep = SearchBound( eka, minfo, minfo.dep, lb_old, Pthreshold, Emin, 10 );
 					float ub_dep = SearchBound( eka, minfo, minfo.dep, ub_old, Pthreshold, Emin, 10 );
-					Pdep = (ub_dep-lb_dep) * sfactor;
+					const float P = (ub_dep-lb_dep) * sfactor;
+					space.Update( [P]( Space& s ) { s.Pdep = P; } );
 					} // section 4
 					#pragma omp section
 					{
-					float lb_old = M0 / RM0, ub_old = M0 * RM0;
+					float lb_old = M0 / sp.RM0, ub_old = M0 * sp.RM0;
 					float lb_M0 = SearchBound( eka, minfo, minfo.M0, lb_old, Pthreshold, Emin, 10 );
 					float ub_M0 = SearchBound( eka, minfo, minfo.M0, ub_old, Pthreshold, Emin, 10 );
-					PM0 = exp( (log(ub_M0)-log(lb_M0)) * sfactor );
+					const float P = exp( (log(ub_M0)-log(lb_M0)) * sfactor );
+					space.Update( [P]( Space& s ) { s.PM0 = P; } );
 					} // section 5
 					#pragma omp section
                {
-               float lb_old = lon - Rlon, ub_old = lon + Rlon;
+               float lb_old = lon - sp.Rlon, ub_old = lon + sp.Rlon;
                float lb_lon = SearchBound( eka, minfo, minfo.lon, lb_old, Pthreshold, Emin, 10 );
                float ub_lon = SearchBound( eka, minfo, minfo.lon, ub_old, Pthreshold, Emin, 10 );
-               Plon = (ub_lon-lb_lon) * sfactor;
+               const float P = (ub_lon-lb_lon) * sfactor;
+               space.Update( [P]( Space& s ) { s.Plon = P; } );
                } // section 6
 					#pragma omp section
 					{
-					float lb_old = lat - Rlat, ub_old = lat + Rlat;
+					float lb_old = lat - sp.Rlat, ub_old = lat + sp.Rlat;
 					float lb_lat = SearchBound( eka, minfo, minfo.lat, lb_old, Pthreshold, Emin, 10 );
 					float ub_lat = SearchBound( eka, minfo, minfo.lat, ub_old, Pthreshold, Emin, 10 );
-					Plat = (ub_lat-lb_lat) * sfactor;
+					const float P = (ub_lat-lb_lat) * sfactor;
+					space.Update( [P]( Space& s ) { s.Plat = P; } );
 					} // section 7
 					#pragma omp section
 					{
-					float lb_old = t0 - Rtim, ub_old = t0 + Rtim;
+					float lb_old = t0 - sp.Rtim, ub_old = t0 + sp.Rtim;
 					float lb_tim = SearchBound( eka, minfo, minfo.t0, lb_old, Pthreshold, Emin, 10 );
 					float ub_tim = SearchBound( eka, minfo, minfo.t0, ub_old, Pthreshold, Emin, 10 );
-					Ptim = (ub_tim-lb_tim) * sfactor;
+					const float P = (ub_tim-lb_tim) * sfactor;
+					space.Update( [P]( Space& s ) { s.Ptim = P; } );
 					} // section 8
 				} // omp sections ends
 			} // parallel ends
@@ -269,93 +298,96 @@ class ModelSpace : public ModelInfo, public Searcher::IModelSpace<ModelInfo> {
 			if( ! isValid() ) throw std::runtime_error("invalid/incomplete model info");
 
 			if( ! pertall ) minew = *this;
+			const Space sp = space.Read();
 
 			bool perturbed = false;
 			while( ! perturbed ) {
 				int dice = pertall ? 0 : randO[omp_get_thread_num()].UniformI();
 				//std::cerr<<" rolled "<<dice<<std::endl;
 
-				if( Pstk>0 && (pertall||dice==1) ) {
+				if( sp.Pstk>0 && (pertall||dice==1) ) {
 					// stk
-					float stk_cur = ShiftInto(this->stk, Cstk-Rstk, Cstk+Rstk, 360.);
-					if( Rstk >= 180. ) {
-						minew.stk = Neighbour_Cycle(stk_cur, Pstk, 0., 360.);
+					float stk_cur = ShiftInto(this->stk, sp.Cstk-sp.Rstk, sp.Cstk+sp.Rstk, 360.);
+					if( sp.Rstk >= 180. ) {
+						minew.stk = Neighbour_Cycle(stk_cur, sp.Pstk, 0., 360.);
 					} else {
-						minew.stk = Neighbour_Reflect(stk_cur, Pstk, Cstk-Rstk, Cstk+Rstk);
+						minew.stk = Neighbour_Reflect(stk_cur, sp.Pstk, sp.Cstk-sp.Rstk, sp.Cstk+sp.Rstk);
 						minew.stk = ShiftInto(minew.stk, 0., 360., 360.);
 					}
 					perturbed = true;
 				} 
-				if( Pdip>0 && (pertall||dice==2) ) {
+				if( sp.Pdip>0 && (pertall||dice==2) ) {
 					// dip
-					float lb = Cdip-Rdip, ub = Cdip+Rdip;
+					float lb = sp.Cdip-sp.Rdip, ub = sp.Cdip+sp.Rdip;
 					if( lb < 0. ) lb = 0.;
 					if( ub > 90. ) ub = 90.;
-					minew.dip = Neighbour_Reflect(this->dip, Pdip, lb, ub);
+					minew.dip = Neighbour_Reflect(this->dip, sp.Pdip, lb, ub);
 					perturbed = true;
 				}
-				if( Prak>0 && (pertall||dice==3) ) {
+				if( sp.Prak>0 && (pertall||dice==3) ) {
 					// rak
-					float rak_cur = ShiftInto(this->rak, Crak-Rrak, Crak+Rrak, 360.);
-					if( Rrak >= 180. ) {
-						minew.rak = Neighbour_Cycle(rak_cur, Prak, -180., 180.);
+					float rak_cur = ShiftInto(this->rak, sp.Crak-sp.Rrak, sp.Crak+sp.Rrak, 360.);
+					if( sp.Rrak >= 180. ) {
+						minew.rak = Neighbour_Cycle(rak_cur, sp.Prak, -180., 180.);
 					} else {
-						minew.rak = Neighbour_Reflect(rak_cur, Prak, Crak-Rrak, Crak+Rrak);
+						minew.rak = Neighbour_Reflect(rak_cur, sp.Prak, sp.Crak-sp.Rrak, sp.Crak+sp.Rrak);
 						minew.rak = ShiftInto(minew.rak, -180., 180., 360.);
 					}
 					perturbed = true;
 				}
-				if( Pdep>0 && (pertall||dice==4) ) {
+				if( sp.Pdep>0 && (pertall||dice==4) ) {
 					// dep
-					float lb = Cdep-Rdep, ub = Cdep+Rdep;
+					float lb = sp.Cdep-sp.Rdep, ub = sp.Cdep+sp.Rdep;
 					if( lb < 0. ) lb = 0.;
 					if( ub > DEPMAX ) ub = DEPMAX;
-					minew.dep = Neighbour_Reflect(this->dep, Pdep, lb, ub);
+					minew.dep = Neighbour_Reflect(this->dep, sp.Pdep, lb, ub);
 					perturbed = true;
 				}
-				if( PM0>1 && (pertall||dice==5) ) {
+				if( sp.PM0>1 && (pertall||dice==5) ) {
 					// M0
 					//minew.M0 = M0;
-					float lb = CM0 / RM0, ub = CM0 * RM0;
+					float lb = sp.CM0 / sp.RM0, ub = sp.CM0 * sp.RM0;
 					if( lb < 1.0e19 ) lb = 1.0e19;
 					if( ub > 1.0e31 ) lb = 1.0e31;
-					minew.M0 = Neighbour_ReflectM(this->M0, PM0, lb, ub);
+					minew.M0 = Neighbour_ReflectM(this->M0, sp.PM0, lb, ub);
 					perturbed = true;
 				}
-				if( Plon>0 && (pertall||dice==6) ) {
+				if( sp.Plon>0 && (pertall||dice==6) ) {
 					// longitude
-					minew.lon = Neighbour_Reflect(this->lon, Plon, Clon-Rlon, Clon+Rlon);
+					minew.lon = Neighbour_Reflect(this->lon, sp.Plon, sp.Clon-sp.Rlon, sp.Clon+sp.Rlon);
 					perturbed = true;
 				}
-				if( Plat>0 && (pertall||dice==7) ) {
+				if( sp.Plat>0 && (pertall||dice==7) ) {
 					// latitude
-					minew.lat = Neighbour_Reflect(this->lat, Plat, Clat-Rlat, Clat+Rlat);
+					minew.lat = Neighbour_Reflect(this->lat, sp.Plat, sp.Clat-sp.Rlat, sp.Clat+sp.Rlat);
 					perturbed = true;
 				}
-				if( Ptim>0 && (pertall||dice==8) ) {
+				if( sp.Ptim>0 && (pertall||dice==8) ) {
 					// origin time
-					minew.t0 = Neighbour_Reflect(this->t0, Ptim, Ctim-Rtim, Ctim+Rtim);
+					minew.t0 = Neighbour_Reflect(this->t0, sp.Ptim, sp.Ctim-sp.Rtim, sp.Ctim+sp.Rtim);
 					perturbed = true;
 				}
+				if( perturbed ) Metrics::Propose( dice );	// for the acceptance rate per parameter
 			}
 		}
 
 		/* streaming perturbation ranges */
 		friend std::ostream& operator<< ( std::ostream& o, ModelSpace& ms ) {
       //o<<std::fixed<<std::setprecision(2) <<std::setw(6)<<f.stk<<" "<<std::setw(6)<<f.dip<<" "<<std::setw(7)<<f.rak<<" "<<std::setprecision(3)<<std::setw(7)<<f.dep; 
-			float deplb = ms.Cdep-ms.Rdep, depub = ms.Cdep+ms.Rdep;
+			const Space sp = ms.space.Read();
+			float deplb = sp.Cdep-sp.Rdep, depub = sp.Cdep+sp.Rdep;
 			if( deplb < 0. ) deplb = 0.;
 			if( depub > DEPMAX ) depub = DEPMAX;
 			o<<std::setprecision(4)
-			<<"  lon ("<<ms.Clon-ms.Rlon<<"~"<<ms.Clon+ms.Rlon<<", "<<ms.Plon<<")"
-			<<"  lat ("<<ms.Clat-ms.Rlat<<"~"<<ms.Clat+ms.Rlat<<", "<<ms.Plat<<")"
-			<<"  tim ("<<ms.Ctim-ms.Rtim<<"~"<<ms.Ctim+ms.Rtim<<", "<<ms.Ptim<<")\n"
+			<<"  lon ("<<sp.Clon-sp.Rlon<<"~"<<sp.Clon+sp.Rlon<<", "<<sp.Plon<<")"
+			<<"  lat ("<<sp.Clat-sp.Rlat<<"~"<<sp.Clat+sp.Rlat<<", "<<sp.Plat<<")"
+			<<"  tim ("<<sp.Ctim-sp.Rtim<<"~"<<sp.Ctim+sp.Rtim<<", "<<sp.Ptim<<")\n"
 			<<std::setprecision(3)
-			<<"  stk ("<<ms.Cstk-ms.Rstk<<"~"<<ms.Cstk+ms.Rstk<<", "<<ms.Pstk<<")"
-			<<"  dip ("<<ms.Cdip-ms.Rdip<<"~"<<ms.Cdip+ms.Rdip<<", "<<ms.Pdip<<")"
-			<<"  rak ("<<ms.Crak-ms.Rrak<<"~"<<ms.Crak+ms.Rrak<<", "<<ms.Prak<<")\n"
-			<<"  dep ("<<deplb<<"~"<<depub<<", "<<ms.Pdep<<")"
-			<<"  M0  ("<<std::scientific<<ms.CM0/ms.RM0<<"~"<<ms.CM0*ms.RM0<<", "<<ms.PM0<<")";
+			<<"  stk ("<<sp.Cstk-sp.Rstk<<"~"<<sp.Cstk+sp.Rstk<<", "<<sp.Pstk<<")"
+			<<"  dip ("<<sp.Cdip-sp.Rdip<<"~"<<sp.Cdip+sp.Rdip<<", "<<sp.Pdip<<")"
+			<<"  rak ("<<sp.Crak-sp.Rrak<<"~"<<sp.Crak+sp.Rrak<<", "<<sp.Prak<<")\n"
+			<<"  dep ("<<deplb<<"~"<<depub<<", "<<sp.Pdep<<")"
+			<<"  M0  ("<<std::scientific<<sp.CM0/sp.RM0<<"~"<<sp.CM0*sp.RM0<<", "<<sp.PM0<<")";
 			return o;
 		}
 
@@ -367,28 +399,39 @@ class ModelSpace : public ModelInfo, public Searcher::IModelSpace<ModelInfo> {
 
 	private: // variables
 		//bool validS{false}, validP{false};
-		float Clon{NaN}, Clat{NaN}, Ctim{NaN}, Cstk{NaN}, Cdip{NaN}, Crak{NaN}, Cdep{NaN}, CM0{NaN}; // model center
-		float Rlon{0.15}, Rlat{0.15}, Rtim{2.}, Rstk{30.}, Rdip{20.}, Rrak{30.}, Rdep{5.}, RM0{10.}; // model param radius
-		float Plon{NaN}, Plat{NaN}, Ptim{NaN}, Pstk{NaN}, Pdip{NaN}, Prak{NaN}, Pdep{NaN}, PM0{NaN}; // perturb length ( gaussian half length )
-		float pertfactor{0.1};
+		// the space parameters are read by the searching threads while the space is re-shaped:
+		// readers take a consistent copy without blocking, and each change publishes a new one
+		struct Space {
+			float Clon{NaN}, Clat{NaN}, Ctim{NaN}, Cstk{NaN}, Cdip{NaN}, Crak{NaN}, Cdep{NaN}, CM0{NaN}; // model center
+			float Rlon{0.15}, Rlat{0.15}, Rtim{2.}, Rstk{30.}, Rdip{20.}, Rrak{30.}, Rdep{5.}, RM0{10.}; // model param radius
+			float Plon{NaN}, Plat{NaN}, Ptim{NaN}, Pstk{NaN}, Pdip{NaN}, Prak{NaN}, Pdep{NaN}, PM0{NaN}; // perturb length ( gaussian half length )
+			float pertfactor{0.1};
+		};
+		SeqLocked<Space> space;
 		mutable std::vector<Rand> randO;
 
 	private:	// methods
-		// initialize perturbation length and random number generators
-		void resetPerturb() {
-			// re-compute perturbation ranges
+		// re-compute perturbation ranges
+		static void resetPerturb( Space& sp ) {
 			//float curRdep = Rdep>0 ? Rdep : 50.;
-			Ptim = pertfactor * Rtim; PM0 = pow(RM0, pertfactor);
-			Plon = pertfactor * Rlon; Plat = pertfactor * Rlat;
-			Pstk = pertfactor * Rstk; Pdip = pertfactor * Rdip;
-			Prak = pertfactor * Rrak; Pdep = pertfactor * Rdep;
+			const float pf = sp.pertfactor;
+			sp.Ptim = pf * sp.Rtim; sp.PM0 = pow(sp.RM0, pf);
+			sp.Plon = pf * sp.Rlon; sp.Plat = pf * sp.Rlat;
+			sp.Pstk = pf * sp.Rstk; sp.Pdip = pf * sp.Rdip;
+			sp.Prak = pf * sp.Rrak; sp.Pdep = pf * sp.Rdep;
 		}
+		void resetPerturb() { space.Update( []( Space& sp ) { resetPerturb( sp ); } ); }
+		// set model center to the current MState
+		void Centralize( Space& sp ) const {
+			sp.Clon = lon; sp.Clat = lat; sp.Ctim = t0; sp.CM0 = M0;
+			sp.Cstk = stk; sp.Cdip = dip; sp.Crak = rak; sp.Cdep = dep;
+		}
+		// initialize model center, perturbation length and random number generators
 		void Initialize() {
-			// set model center to the current MState
-			Clon = lon; Clat = lat; Ctim = t0; CM0 = M0;
-			Cstk = stk; Cdip = dip; Crak = rak; Cdep = dep;
-			// compute perturbation ranges
-			resetPerturb();
+			space.Update( [this]( Space& sp ) {
+				Centralize( sp );
+				resetPerturb( sp );
+			} );
 			// produce Rand object for each thread
 			randO.clear();
 			for(int i=0; i<omp_get_max_threads(); i++) {
@@ -8,6 +8,8 @@ typedef int omp_int_t;
 inline omp_int_t omp_get_num_threads() { return 1; }
 inline omp_int_t omp_get_max_threads() { return 1; }
 inline omp_int_t omp_get_thread_num() { return 0; }
+inline omp_int_t omp_get_level() { return 0; }
+inline omp_int_t omp_get_team_size(int) { return 1; }
 inline void omp_set_nested(bool) {}
 typedef char omp_lock_t;
 inline void omp_init_lock(omp_lock_t*) {}
@@ -17,41 +19,134 @@ inline void omp_unset_lock(omp_lock_t*) {}
 #endif
 
 #include <vector>
-class RWLock {
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/* run func(i) for i in [0, n) as OpenMP tasks on a (nested) team of nthread threads,
+	or in place when nthread<=1. The first exception thrown by func is rethrown */
+template <class Func>
+void ParallelTasks( const int n, const int nthread, const Func& func ) {
+	if( nthread<=1 || n<=1 ) {
+		for( int i=0; i<n; i++ ) func(i);
+		return;
+	}
+	std::exception_ptr perr;
+	#pragma omp parallel num_threads(nthread)
+	#pragma omp single
+	for( int i=0; i<n; i++ ) {
+		#pragma omp task firstprivate(i) shared(perr)
+		try {
+			func(i);
+		} catch( ... ) {
+			#pragma omp critical(ParallelTasks)
+			if( ! perr ) perr = std::current_exception();
+		}
+	}
+	if( perr ) std::rethrow_exception( perr );
+}
+
+/* # of threads for an inner (nested) loop: the cores left idle by the enclosing parallel
+	regions, and no more than keeps each thread busy for MinChunk sec by the measured cost
+	per item. The first loop runs in place to take the measurement */
+class InnerThreads {
 public:
-	// FCFS: any lock func (lockRead or lockWrite) that's called first locks first
-	// when FCFS==false, lockWrite may appear to have a lower priorty (because it
-	//	sets more locks and is hence slower) and be constantly blocked by lockRead
-	RWLock(bool FCFS = true) 
-	: nt(omp_get_max_threads()), lockV(nt), FCFS(FCFS) {
-		if( FCFS ) omp_init_lock(&plock);
-		for(auto &lock : lockV) omp_init_lock(&lock);
-	}
-	~RWLock() {
-		if( FCFS ) omp_destroy_lock(&plock);
-		for(auto &lock : lockV) omp_destroy_lock(&lock);
-	}
-	void lock4Read() {
-		if( FCFS ) omp_set_lock(&plock);
-		omp_set_lock(&( lockV[omp_get_thread_num()]) ); 
-		if( FCFS ) omp_unset_lock(&plock);
-	}
-	void unlock4Read() { 
-		omp_unset_lock(&( lockV[omp_get_thread_num()]) ); 
-	}
-	void lock4Write() { 
-		if( FCFS ) omp_set_lock(&plock);
-		for(auto &lock : lockV) omp_set_lock(&lock);
-		if( FCFS ) omp_unset_lock(&plock);
-	}
-	void unlock4Write() { 
-		for(auto &lock : lockV) omp_unset_lock(&lock);
+	// nmax: cap on the inner threads (<=0: no cap). Construct outside parallel regions
+	InnerThreads( const int nmax = 0 ) : ncore(omp_get_max_threads()), nmax(nmax) {}
+
+	int Get( const int nitem ) const {
+		const float cost = costitem.load( std::memory_order_relaxed );
+		if( nitem<2 || nmax==1 || cost<=0. ) return 1;
+		int nouter = 1;
+		for( int l=1; l<=omp_get_level(); l++ ) nouter *= omp_get_team_size(l);
+		int nthd = std::min( ncore/nouter, nitem );
+		if( nmax > 0 ) nthd = std::min( nthd, nmax );
+		nthd = std::min( nthd, (int)(cost*nitem/MinChunk) );
+		return std::max( nthd, 1 );
+	}
+
+	// record the wall time (sec) of a loop over nitem items run on nthd threads
+	void Record( const float sec, const int nitem, const int nthd ) {
+		if( nitem <= 0 ) return;
+		const float c = sec * nthd / nitem, cold = costitem.load( std::memory_order_relaxed );
+		costitem.store( cold<=0. ? c : cold+0.2*(c-cold), std::memory_order_relaxed );
 	}
+
 private:
-	int nt;
-	bool FCFS;
-	omp_lock_t plock;
-	std::vector<omp_lock_t> lockV;
+	static constexpr float MinChunk = 2.e-3;
+	int ncore, nmax;
+	std::atomic<float> costitem{-1.};	// running average of the single-thread time per item
+};
+
+/* a trivially copyable T behind a sequence lock. Read() never blocks: it copies the value
+	and retries when a write overlapped the copy. Writers are serialized among themselves,
+	make the version odd while changing the value and even again once it is published */
+template <class T>
+class SeqLocked {
+	static_assert( std::is_trivially_copyable<T>::value, "SeqLocked: T has to be trivially copyable" );
+public:
+	SeqLocked( const T& val = T() ) { Store( val ); }
+	SeqLocked( const SeqLocked& other ) { Store( other.Read() ); }
+	SeqLocked& operator=( const SeqLocked& other ) {
+		if( this != &other ) Write( other.Read() );
+		return *this;
+	}
+
+	T Read() const {
+		T val;
+		for( ;; ) {
+			const unsigned v = seq.load( std::memory_order_acquire );
+			if( v & 1u ) continue;	// a write in progress
+			Load( val );
+			std::atomic_thread_fence( std::memory_order_acquire );
+			if( seq.load( std::memory_order_relaxed ) == v ) return val;
+		}
+	}
+
+	void Write( const T& val ) { Update( [&val]( T& v ) { v = val; } ); }
+
+	// func(T&) modifies a copy of the value, which is then published. Nothing is published
+	// when func throws
+	template <class Func>
+	void Update( const Func& func ) {
+		while( wlock.test_and_set( std::memory_order_acquire ) );
+		T val; Load( val );
+		try {
+			func( val );
+		} catch( ... ) {
+			wlock.clear( std::memory_order_release );
+			throw;
+		}
+		const unsigned v = seq.load( std::memory_order_relaxed );
+		seq.store( v+1, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_release );
+		Store( val );
+		seq.store( v+2, std::memory_order_release );
+		wlock.clear( std::memory_order_release );
+	}
+
+	// # of writes so far
+	unsigned Version() const { return seq.load( std::memory_order_acquire ) >> 1; }
+
+private:
+	static constexpr int NW = (sizeof(T)+sizeof(uint64_t)-1) / sizeof(uint64_t);
+	std::atomic<uint64_t> words[NW];
+	std::atomic<unsigned> seq{0};
+	std::atomic_flag wlock = ATOMIC_FLAG_INIT;
+
+	void Load( T& val ) const {
+		uint64_t buff[NW];
+		for( int i=0; i<NW; i++ ) buff[i] = words[i].load( std::memory_order_relaxed );
+		memcpy( &val, buff, sizeof(T) );
+	}
+	void Store( const T& val ) {
+		uint64_t buff[NW] = {};
+		memcpy( buff, &val, sizeof(T) );
+		for( int i=0; i<NW; i++ ) words[i].store( buff[i], std::memory_order_relaxed );
+	}
 };
 
 #endif
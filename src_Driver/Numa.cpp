@@ -0,0 +1,84 @@
+#include "Numa.h"
+#include "MyOMP.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sched.h>
+
+namespace {
+	struct Topology {
+		std::vector<std::vector<int>> cpusV;	// cpus of each node
+		std::vector<int> nodeOfCpu;
+
+		Topology() {
+			for( int node=0; ; node++ ) {
+				std::ifstream fin( "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist" );
+				if( ! fin ) break;
+				std::string line; std::getline( fin, line );
+				cpusV.push_back( ParseList(line) );
+			}
+			// no sysfs: one node with the cpus we may run on
+			if( cpusV.empty() ) {
+				cpu_set_t set; CPU_ZERO( &set );
+				std::vector<int> cpus;
+				if( sched_getaffinity( 0, sizeof(set), &set ) == 0 )
+					for( int cpu=0; cpu<CPU_SETSIZE; cpu++ ) if( CPU_ISSET(cpu, &set) ) cpus.push_back( cpu );
+				cpusV.push_back( cpus );
+			}
+			for( int node=0; node<cpusV.size(); node++ )
+				for( const int cpu : cpusV[node] ) {
+					if( cpu >= nodeOfCpu.size() ) nodeOfCpu.resize( cpu+1, 0 );
+					nodeOfCpu[cpu] = node;
+				}
+		}
+
+		// "0-15,32-47"
+		static std::vector<int> ParseList( const std::string& list ) {
+			std::vector<int> cpus;
+			std::stringstream ss( list );
+			for( std::string range; std::getline(ss, range, ','); ) {
+				int cb, ce;
+				const int nread = sscanf( range.c_str(), "%d-%d", &cb, &ce );
+				if( nread < 1 ) continue;
+				if( nread == 1 ) ce = cb;
+				for( int cpu=cb; cpu<=ce && cpu<CPU_SETSIZE; cpu++ ) cpus.push_back( cpu );
+			}
+			return cpus;
+		}
+	};
+
+	const Topology& Topo() { static const Topology topo; return topo; }
+}
+
+namespace Numa {
+	int NNode() { return Topo().cpusV.size(); }
+
+	const std::vector<int>& Cpus( const int node ) { return Topo().cpusV.at(node); }
+
+	int ThisNode() {
+		const auto& topo = Topo();
+		if( topo.cpusV.size() < 2 ) return 0;
+		const int cpu = sched_getcpu();
+		return cpu>=0 && cpu<topo.nodeOfCpu.size() ? topo.nodeOfCpu[cpu] : 0;
+	}
+
+	bool BindToNode( const int node ) {
+		const auto& cpus = Cpus( node );
+		if( cpus.empty() ) return false;
+		cpu_set_t set; CPU_ZERO( &set );
+		for( const int cpu : cpus ) CPU_SET( cpu, &set );
+		return sched_setaffinity( 0, sizeof(set), &set ) == 0;
+	}
+
+	int PinThreads() {
+#ifdef _OPENMP
+		if( omp_get_proc_bind() != omp_proc_bind_false ) return 0;
+#endif
+		const int nnode = NNode(), nthread = omp_get_max_threads();
+		int nbound = 0;
+		#pragma omp parallel num_threads(nthread) reduction(+:nbound)
+		nbound += BindToNode( omp_get_thread_num() * nnode / nthread );
+		return nbound;
+	}
+}
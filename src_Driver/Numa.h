@@ -0,0 +1,43 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <exception>
+#include <thread>
+#include <vector>
+
+/* NUMA topology from /sys/devices/system/node (a single node when it is missing), thread
+	placement on the cpus of a node, and running code on a node so that the memory it
+	allocates and first touches lands there */
+namespace Numa {
+	int NNode();
+	const std::vector<int>& Cpus( const int node );
+	// node of the cpu the calling thread is running on (0 on a single node)
+	int ThisNode();
+
+	// restrict the calling thread to the cpus of node. returns false if the kernel refused
+	bool BindToNode( const int node );
+
+	/* bind the threads of the OpenMP team (of omp_get_max_threads) to the nodes in contiguous
+		blocks: thread i to node i*NNode()/nthread. Threads of nested teams inherit the node of
+		the thread that creates them. Nothing is done when OMP_PROC_BIND/OMP_PLACES already bind
+		the threads. returns the # of threads bound */
+	int PinThreads();
+
+	// run func() on a thread bound to node, and wait for it. Exceptions are rethrown
+	template <class Func>
+	void OnNode( const int node, const Func& func ) {
+		std::exception_ptr perr;
+		std::thread thd( [&]() {
+			try {
+				BindToNode( node );
+				func();
+			} catch( ... ) {
+				perr = std::current_exception();
+			}
+		} );
+		thd.join();
+		if( perr ) std::rethrow_exception( perr );
+	}
+}
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/* per-stage profiling (built with -DEQK_PROFILE, i.e. make PROFILE=1): PROFILE_SCOPE(name)
+	times the enclosing scope and reads the hardware counters of the calling thread (cycles,
+	instructions, cache misses, branch misses) from perf_event_open, or only times it when perf
+	events are unavailable. Stages nest into paths per thread, and an indented breakdown
+	(inclusive/self thread-sec, calls, IPC, miss rates) is printed at exit.
+	Without EQK_PROFILE, PROFILE_SCOPE expands to nothing */
+#ifdef EQK_PROFILE
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define PROFILE_CAT_(a, b) a##b
+#define PROFILE_CAT(a, b) PROFILE_CAT_(a, b)
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILE_CAT(profScope_, __LINE__)( name )
+
+namespace Profiler {
+	enum HwCounter { Cycles, Instructions, CacheMisses, BranchMisses, NHw };
+	const char Sep = '\x01';	// between the stages of a path (sorts the paths depth-first)
+
+	struct Stat {
+		long n = 0;
+		double sec = 0.;
+		std::array<uint64_t, NHw> hw{};
+		Stat& operator+=( const Stat& st ) {
+			n += st.n; sec += st.sec;
+			for( int i=0; i<NHw; i++ ) hw[i] += st.hw[i];
+			return *this;
+		}
+	};
+
+	/* ---------- counters and stage stats of a single thread ---------- */
+	class ThreadData {
+	public:
+		std::mutex mtx;	// guards statM against the report
+		std::map<std::string, Stat> statM;
+		std::string path;	// the stages currently entered, separated by Sep
+		int fd = -1;		// perf event group leader (-1: timing only)
+
+		ThreadData() {
+#ifdef __linux__
+			// one group, counted in user space for this thread on any cpu
+			const uint64_t configA[NHw] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+													  PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+			for( int i=0; i<NHw; i++ ) {
+				perf_event_attr attr; memset( &attr, 0, sizeof(attr) );
+				attr.size = sizeof(attr); attr.type = PERF_TYPE_HARDWARE; attr.config = configA[i];
+				attr.read_format = PERF_FORMAT_GROUP;
+				attr.exclude_kernel = 1; attr.exclude_hv = 1; attr.disabled = (i==0);
+				const int fdi = syscall( __NR_perf_event_open, &attr, 0, -1, fd, 0 );
+				if( fdi < 0 ) { Close(); return; }
+				if( i == 0 ) fd = fdi; else fdV.push_back( fdi );
+			}
+			ioctl( fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP );
+#endif
+		}
+		~ThreadData() { Close(); }
+
+		void ReadHw( std::array<uint64_t, NHw>& hw ) const {
+#ifdef __linux__
+			uint64_t buff[NHw+1];	// PERF_FORMAT_GROUP: nr, then the values
+			if( fd>=0 && read(fd, buff, sizeof(buff))==sizeof(buff) ) {
+				std::copy( buff+1, buff+1+NHw, hw.begin() );
+				return;
+			}
+#endif
+			hw.fill( 0 );
+		}
+
+	private:
+		std::vector<int> fdV;
+		void Close() {
+#ifdef __linux__
+			for( const int fdi : fdV ) close( fdi );
+			if( fd >= 0 ) close( fd );
+#endif
+			fdV.clear(); fd = -1;
+		}
+	};
+
+	/* ---------- all threads; reports on destruction (at exit) ---------- */
+	class Registry {
+	public:
+		std::shared_ptr<ThreadData> NewThread() {
+			auto ptd = std::make_shared<ThreadData>();
+			std::lock_guard<std::mutex> lck( mtx );
+			tdV.push_back( ptd );
+			return ptd;
+		}
+		~Registry() { Report( std::cout ); }
+
+		void Report( std::ostream& o ) {
+			std::lock_guard<std::mutex> lck( mtx );
+			if( tdV.empty() ) return;
+			// merge over threads, and count the threads each stage ran on
+			std::map<std::string, Stat> statM;
+			std::map<std::string, int> nthdM;
+			bool hwok = false;
+			for( const auto& ptd : tdV ) {
+				std::lock_guard<std::mutex> lckt( ptd->mtx );
+				hwok |= ptd->fd >= 0;
+				for( const auto& sp : ptd->statM ) { statM[sp.first] += sp.second; nthdM[sp.first]++; }
+			}
+			// self = inclusive - direct children
+			std::map<std::string, Stat> selfM = statM;
+			for( const auto& sp : statM ) {
+				const auto isep = sp.first.rfind(Sep);
+				if( isep == std::string::npos ) continue;
+				auto& self = selfM[sp.first.substr(0, isep)];
+				self.sec -= sp.second.sec;
+				for( int i=0; i<NHw; i++ ) self.hw[i] -= std::min( self.hw[i], sp.second.hw[i] );
+			}
+			double secroot = 0.;
+			for( const auto& sp : statM ) if( sp.first.find(Sep) == std::string::npos ) secroot += sp.second.sec;
+
+			o<<"### Profile: "<<tdV.size()<<" thread(s), "<<(hwok ? "perf event counters" : "timing only (perf events unavailable)")
+			 <<"; thread-sec summed over threads, stages nested as entered on each thread. ###\n";
+			o<<std::left<<std::setw(48)<<"stage"<<std::right<<std::setw(10)<<"calls"<<std::setw(5)<<"thd"
+			 <<std::setw(12)<<"incl(s)"<<std::setw(8)<<"%"<<std::setw(12)<<"self(s)";
+			if( hwok ) o<<std::setw(8)<<"IPC"<<std::setw(12)<<"cmiss/kI"<<std::setw(12)<<"bmiss/kI";
+			o<<"\n";
+			// std::map order of the paths is depth-first
+			for( const auto& sp : statM ) {
+				const auto& path = sp.first; const auto& st = sp.second; const auto& self = selfM[path];
+				const int depth = std::count( path.begin(), path.end(), Sep );
+				const auto isep = path.rfind(Sep);
+				const std::string label = std::string(2*depth, ' ') + (isep==std::string::npos ? path : path.substr(isep+1));
+				o<<std::left<<std::setw(48)<<label<<std::right<<std::setw(10)<<st.n<<std::setw(5)<<nthdM[path]
+				 <<std::fixed<<std::setprecision(3)<<std::setw(12)<<st.sec<<std::setprecision(1)<<std::setw(8)<<(secroot>0. ? 100.*st.sec/secroot : 0.)
+				 <<std::setprecision(3)<<std::setw(12)<<self.sec;
+				if( hwok ) {
+					const double ki = st.hw[Instructions] * 1.e-3;
+					o<<std::setprecision(2)<<std::setw(8)<<(st.hw[Cycles]>0 ? (double)st.hw[Instructions]/st.hw[Cycles] : 0.)
+					 <<std::setw(12)<<(ki>0. ? st.hw[CacheMisses]/ki : 0.)<<std::setw(12)<<(ki>0. ? st.hw[BranchMisses]/ki : 0.);
+				}
+				o<<std::defaultfloat<<"\n";
+			}
+			o.flush();
+		}
+
+	private:
+		std::mutex mtx;
+		std::vector<std::shared_ptr<ThreadData>> tdV;	// kept beyond the threads' lifetime
+	};
+
+	inline Registry& Reg() { static Registry reg; return reg; }
+	inline ThreadData& Local() {
+		thread_local std::shared_ptr<ThreadData> ptd = Reg().NewThread();
+		return *ptd;
+	}
+
+	/* ---------- a profiled stage ---------- */
+	class Scope {
+	public:
+		Scope( const char* name ) : td(Local()), plen(td.path.size()) {
+			if( plen > 0 ) td.path += Sep;
+			td.path += name;
+			td.ReadHw( hw0 );
+			tb = Clock::now();
+		}
+		~Scope() {
+			const auto te = Clock::now();
+			std::array<uint64_t, NHw> hw1; td.ReadHw( hw1 );
+			{
+				std::lock_guard<std::mutex> lck( td.mtx );
+				auto& st = td.statM[td.path];
+				st.n++; st.sec += std::chrono::duration<double>(te-tb).count();
+				for( int i=0; i<NHw; i++ ) st.hw[i] += hw1[i] - hw0[i];
+			}
+			td.path.resize( plen );
+		}
+	private:
+		typedef std::chrono::steady_clock Clock;
+		ThreadData& td;
+		const size_t plen;
+		std::array<uint64_t, NHw> hw0;
+		Clock::time_point tb;
+	};
+}
+
+#else
+#define PROFILE_SCOPE(name)
+#endif
+
+#endif
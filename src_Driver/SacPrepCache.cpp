@@ -0,0 +1,84 @@
+#include "SacPrepCache.h"
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+
+namespace {
+	const char PrepBinMagic[8] = "EQKPREP";
+	const uint32_t PrepBinVersion = 2;
+
+	// FNV-1a (64 bits)
+	const uint64_t FNVOffset = 14695981039346656037ULL, FNVPrime = 1099511628211ULL;
+	inline void FNVUpdate( uint64_t& h, const char* buff, const size_t n ) {
+		for( size_t i=0; i<n; i++ ) { h ^= (unsigned char)buff[i]; h *= FNVPrime; }
+	}
+}
+
+uint64_t SacPrepCache::Key( const std::string& fsac ) const {
+	std::ifstream fin( fsac, std::ios::binary );
+	if( ! fin ) return 0;
+	uint64_t h = FNVOffset;
+	char buff[65536];
+	while( fin ) {
+		fin.read( buff, sizeof(buff) );
+		FNVUpdate( h, buff, fin.gcount() );
+	}
+	FNVUpdate( h, reinterpret_cast<const char*>(params.data()), params.size()*sizeof(float) );
+	return h==0 ? 1 : h;
+}
+
+/* sidecar: [magic][version][key][accepted] and, if accepted, 3 x [fname size, fname][SAC_HD][sig] */
+void SacPrepCache::Save( const std::string& fsac, const uint64_t key, const bool accepted, const SacRec3& sac3 ) const {
+	// write to a temporary file and rename: concurrent jobs never see a partial sidecar
+	const std::string fbin = SidecarName(fsac), ftmp = fbin + ".tmp" + std::to_string(getpid());
+	std::ofstream fout( ftmp, std::ios::binary );
+	if( ! fout ) {
+		std::cerr<<"Warning(SacPrepCache::Save): cannot write to "<<ftmp<<std::endl;
+		return;
+	}
+	const uint8_t acc = accepted;
+	fout.write( PrepBinMagic, 8 );
+	fout.write( reinterpret_cast<const char*>(&PrepBinVersion), sizeof(PrepBinVersion) );
+	fout.write( reinterpret_cast<const char*>(&key), sizeof(key) );
+	fout.write( reinterpret_cast<const char*>(&acc), sizeof(acc) );
+	if( accepted )
+		for( const auto& sac : sac3 ) {
+			const uint64_t nname = sac.fname.size();
+			fout.write( reinterpret_cast<const char*>(&nname), sizeof(nname) );
+			fout.write( sac.fname.data(), nname );
+			fout.write( reinterpret_cast<const char*>(&(sac.shd)), sizeof(SAC_HD) );
+			fout.write( reinterpret_cast<const char*>(sac.sig.get()), sac.shd.npts*sizeof(float) );
+		}
+	fout.close();
+	if( ! fout || rename(ftmp.c_str(), fbin.c_str()) != 0 ) {
+		std::cerr<<"Warning(SacPrepCache::Save): failed to write "<<fbin<<std::endl;
+		unlink( ftmp.c_str() );
+	}
+}
+
+bool SacPrepCache::Load( const std::string& fsac, const uint64_t key, bool& accepted, SacRec3& sac3 ) const {
+	if( key == 0 ) return false;
+	std::ifstream fin( SidecarName(fsac), std::ios::binary );
+	if( ! fin ) return false;
+	char magic[8];
+	uint32_t version; uint64_t keyin; uint8_t acc;
+	if( !fin.read(magic, 8) || memcmp(magic, PrepBinMagic, 8)!=0 ) return false;
+	if( !fin.read(reinterpret_cast<char*>(&version), sizeof(version)) || version!=PrepBinVersion ) return false;
+	// the sidecar is only used when written from the same file with the same settings
+	if( !fin.read(reinterpret_cast<char*>(&keyin), sizeof(keyin)) || keyin!=key ) return false;
+	if( !fin.read(reinterpret_cast<char*>(&acc), sizeof(acc)) ) return false;
+	accepted = acc;
+	if( ! accepted ) return true;
+	for( auto& sac : sac3 ) {
+		uint64_t nname;
+		if( !fin.read(reinterpret_cast<char*>(&nname), sizeof(nname)) || nname>4096 ) return false;
+		sac.fname.resize( nname );
+		if( !fin.read(&(sac.fname[0]), nname) ) return false;
+		if( !fin.read(reinterpret_cast<char*>(&(sac.shd)), sizeof(SAC_HD)) || sac.shd.npts<=0 ) return false;
+		sac.sig.reset( SigMem::Alloc(sac.shd.npts) );
+		if( !fin.read(reinterpret_cast<char*>(sac.sig.get()), sac.shd.npts*sizeof(float)) ) return false;
+	}
+	return true;
+}
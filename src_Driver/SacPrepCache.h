@@ -0,0 +1,36 @@
+#ifndef SACPREPCACHE_H
+#define SACPREPCACHE_H
+
+#include "SacRec.h"
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/* Binary sidecar (sacname + ".prepbin") of a preprocessed waveform record: the windowed sac and
+	its amplitude/phase spectra as produced by EQKAnalyzer::LoadData, or the record being rejected
+	(by distance or SNR). A sidecar is keyed by the FNV-1a hash of the sac file bytes and of every
+	parameter the preprocessing depends on, so it is used only for the same file and settings. */
+class SacPrepCache {
+public:
+	typedef std::array<SacRec, 3> SacRec3;
+
+	// params: everything the preprocessing depends on besides the sac file itself
+	SacPrepCache( const std::vector<float>& params ) : params(params) {}
+
+	// key of a sac file (0 if the file cannot be read)
+	uint64_t Key( const std::string& fsac ) const;
+
+	/* load the sidecar of fsac written with the given key.
+		Returns false if missing/outdated; accepted=false for a rejected record */
+	bool Load( const std::string& fsac, const uint64_t key, bool& accepted, SacRec3& sac3 ) const;
+
+	// write the sidecar of fsac (sac3 is ignored when !accepted)
+	void Save( const std::string& fsac, const uint64_t key, const bool accepted, const SacRec3& sac3 ) const;
+
+private:
+	std::vector<float> params;
+	static std::string SidecarName( const std::string& fsac ) { return fsac + ".prepbin"; }
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define SEARCHER_H
 
 #include "MyOMP.h"
+#include "Metrics.h"
 #include "Rand.h"
 #include "VectorOperations.h"
 #include <iostream>
@@ -12,10 +13,11 @@
 #include <random>
 #include <algorithm>
 #include <functional>
+#include <atomic>
 
 namespace Searcher {
 //class Searcher {
-	static float _poc = -1.;	// percentage-of-completion of the current search
+	// percentage-of-completion of the current search, temperature, and energies are kept as Metrics gauges
 
 	// Interfaces. Required by the searcher!!
 	template < class MI >
@@ -82,6 +84,21 @@ namespace Searcher {
 	};
 
 
+	// lowers a to v when v is smaller, by compare-and-swap
+	static inline void AtomicMin( std::atomic<float>& a, const float v ) {
+		float cur = a.load( std::memory_order_relaxed );
+		while( v<cur && ! a.compare_exchange_weak( cur, v, std::memory_order_relaxed ) );
+	}
+
+	// state of one spawn (thread) in the SA loop, on cache lines of its own
+	template < class MI >
+	struct alignas(64) Spawn {
+		Rand rand;
+		float pacc = 0.;
+		SearchInfo<MI> si;
+	};
+
+
    // accept (likelihood function)
    static float Paccept(const float E, const float Enew, const double T) {
 		return Enew<=E ? 1. : (T==0?0:exp((E-Enew)/T));
@@ -133,13 +150,13 @@ namespace Searcher {
 																	  std::ostream& sout = std::cout, short outSI = 0, bool saveV = false,
 																	  const int istart = 0 ) {
 		// initialize random number generator
-		_poc = 0.; float pocinc = 1./(nsearch+2);
+		float poc = 0., pocinc = 1./(nsearch+2);
+		Metrics::Set( Metrics::Progress, poc );
 		//std::default_random_engine generator1( std::chrono::system_clock::now().time_since_epoch().count() + std::random_device{}() );
 		//std::uniform_real_distribution<float> d_uniform(0., 1.);
 		//std::normal_distribution<float> d_normal(0., 1.);
 		//auto rnd = std::bind( d_uniform, generator1 );
 		const int nthread = omp_get_max_threads();
-		Rand randA[nthread];
 
 		// force MS, and DH to be derived from the provided interfaces at compile time
 		const IModelSpace<MI>& ims = ms;
@@ -174,19 +191,24 @@ namespace Searcher {
 		SearchInfo<MI> sibest( istart, T, ms, Ndata0, E, true );
 		if( saveV ) VSinfo.push_back( sibest );
 		sout<<sibest<<"\n";
-		_poc += pocinc;
+		poc += pocinc;
+		Metrics::Set( Metrics::Progress, poc ); Metrics::Set( Metrics::Temperature, T );
+		Metrics::Set( Metrics::Ebest, Ebest ); Metrics::Set( Metrics::Ecurrent, E );
 
 		// main loop
+		// the spawns write only to their own slots and lower Emin by CAS; the best is
+		// taken from the slots once all spawns of a step are in
 		const int nspawn = nthread; 
-		float paccA[nspawn]; SearchInfo<MI> SIA[nspawn];
-//float EaccA[nspawn];
+		Spawn<MI> spawnA[nspawn];
 		for( int i=istart; i<istart+nsearch; i+=nspawn ) {
-			float Emin = E; int imin = -1;
+			std::atomic<float> Emin{E};
+			// clear the slots: the team may come up with fewer threads than nspawn
+			for( auto& sp : spawnA ) { sp.si.isearch = -1; sp.si.accepted = -1; sp.pacc = 0.; }
 		  #pragma omp parallel
 		  { // spawn (simultaneously perturb) num_threads new locations from the current
 			// perturb and compute Enew
-			MI minew; float Enew; 
-			int Ndata, isaccepted = 0;	// 0 for rejected
+			MI minew; float Enew = -1.; 
+			int Ndata = 0, isaccepted = 0;	// 0 for rejected
 			try {	
 				ms.Perturb( minew, false );
 				dh.Energy( minew, Enew, Ndata );
@@ -197,50 +219,53 @@ namespace Searcher {
 			}
 			// update Emin
 			int ispawn = omp_get_thread_num();
-			if( Enew < Emin ) { 
-				#pragma omp critical
-				if( Enew < Emin ) { Emin = Enew; imin = ispawn; }
-			}
+			auto& sp = spawnA[ispawn];
+			if( isaccepted != -1 ) AtomicMin( Emin, Enew );
 			// compute acceptance probability based on Emin
 			#pragma omp barrier
-//EaccA[ispawn] = Enew;
-			paccA[ispawn] = isaccepted==-1 ? 0. : Paccept(Emin, Enew, T);
+			sp.pacc = isaccepted==-1 ? 0. : Paccept(Emin.load(std::memory_order_relaxed), Enew, T);
 			// records whether the current model should be 'accepted' according to Paccept
 			// note, however, that this does not decide which of the spawned models will be accepted as the new location
-			if( randA[ispawn].Uniform()<paccA[ispawn] ) isaccepted = 1;
+			if( sp.rand.Uniform()<sp.pacc ) isaccepted = 1;
+			// acceptance of the parameter perturbed by this thread (none for a skipped spawn)
+			if( isaccepted == -1 ) Metrics::Skip();
+			else Metrics::Decide( isaccepted == 1 );
 			// save searching info of current location
-			SIA[ispawn] = { i+1+ispawn, T, minew, Ndata, Enew, isaccepted };
+			sp.si = { i+1+ispawn, T, minew, Ndata, Enew, isaccepted };
 		  } // spawn ends
 			// update the best
-			if( Emin<Ebest ) { Ebest = Emin; sibest = SIA[imin]; }
+			for( const auto& sp : spawnA )
+				if( sp.si.accepted!=-1 && sp.si.E<Ebest ) { Ebest = sp.si.E; sibest = sp.si; }
 			// include the old model as one of the candidates
-			float psum = Paccept(Emin, E, T);
-			// select the new location base on paccA
-			// normalize paccA
-			for(int ip=0; ip<nspawn; ip++) psum += paccA[ip];
-			for(int ip=0; ip<nspawn; ip++) paccA[ip] /= psum;
+			float psum = Paccept(Emin.load(std::memory_order_relaxed), E, T);
+			// select the new location base on the pacc of the spawns
+			// normalize pacc
+			for(const auto &sp : spawnA) psum += sp.pacc;
+			for(auto &sp : spawnA) sp.pacc /= psum;
 			// select model with a random probability and accumulated pacc
-			float p = randA[0].Uniform(), Paccu = 0.;
+			float p = spawnA[0].rand.Uniform(), Paccu = 0.;
 			int ip; for(ip=0; ip<nspawn; ip++) {
-				Paccu += paccA[ip]; if(Paccu>p) break;
+				Paccu += spawnA[ip].pacc; if(Paccu>p) break;
 			}
 			// update Energy and model state if one of the new spawns is accepted
-//float Eold = E;
-			if( ip != nspawn ) { const auto &si = SIA[ip]; ms.SetMState( si.info ); E = si.E; }
+			if( ip != nspawn ) { const auto &si = spawnA[ip].si; ms.SetMState( si.info ); E = si.E; }
 			// output
 			if( outacc ) {
-				for(const auto &si : SIA)
+				for(const auto &sp : spawnA) {
+					const auto &si = sp.si;
+					if( si.isearch < 0 ) continue;	// no spawn this step
 					if(outrej || si.accepted==1) {
 						if(saveV) VSinfo.push_back( si );
 						sout<<si<<"\n";
 					}
-//sout<<"debug info: Eold="<<Eold<<" Emin="<<Emin<<" Enew="<<E<<"(ispawn="<<ip<<") psum="<<psum<<" prand="<<p<<" (E,paccA)s: ";
-//for(int i=0; i<nspawn; i++) sout<<EaccA[i]<<","<<paccA[i]<<"  "; sout<<"\n";
+				}
 				if( i % 100 == 0 ) sout.flush();
 			}
 			// temperature decrease
 			for(int it=0; it<nspawn; it++) Cool(T);
-			_poc += pocinc*nspawn;	// update perc-of-completion
+			poc += pocinc*nspawn;	// update perc-of-completion
+			Metrics::Set( Metrics::Progress, poc ); Metrics::Set( Metrics::Temperature, T );
+			Metrics::Set( Metrics::Ebest, Ebest ); Metrics::Set( Metrics::Ecurrent, E );
 		}
 		/*
 		RWLock rwlock;
@@ -282,7 +307,7 @@ namespace Searcher {
 			}
 			// temperature decrease
 			Cool(T);
-			_poc += pocinc;	// update perc-of-completion
+			poc += pocinc;	// update perc-of-completion
 			if( i % 100 == 0 ) sout.flush();
 			} // critical ends
 		}
@@ -296,7 +321,7 @@ namespace Searcher {
 		if(saveV) VSinfo.push_back( sibest );
 		// set model state to the best fitting model
 		ms.SetMState( sibest.info );
-		_poc = -1.;
+		Metrics::Set( Metrics::Progress, -1. );
 		return VSinfo;
 	}
 
@@ -321,8 +346,8 @@ namespace Searcher {
 			#pragma omp section
 			{	// section S
 			std::this_thread::sleep_for( std::chrono::seconds(1) );
-			while( _poc >= 0. ) {
-				std::cout<<"*** In process... "<<std::setprecision(1)<<std::setw(4)<<std::fixed<<_poc*100<<"\% completed... ***"<<std::endl<<"\x1b[A";
+			for( float poc; (poc=Metrics::Get(Metrics::Progress)) >= 0.; ) {
+				std::cout<<"*** In process... "<<std::setprecision(1)<<std::setw(4)<<std::fixed<<poc*100<<"\% completed... ***"<<std::endl<<"\x1b[A";
 				std::this_thread::sleep_for( std::chrono::seconds(20) );
 			}
 			std::cout<<"### 100.0\% completed ###\t\t\t\n";
@@ -11,6 +11,9 @@
 #include <fstream>
 #include <algorithm>
 #include <stdexcept>
+#include <unordered_map>
+#include <cmath>
+#include <cstdint>
 
 
 struct StaInfo : public Point<float> {
@@ -70,6 +73,40 @@ public:
 
 };
 
+/* spatial hash of station locations on cells of StaInfo::maxmisloc: a location within maxmisloc
+	of (lon, lat) (Point::IsSameLocation) is in one of the 3x3 cells around it */
+class LocHash {
+public:
+	void clear() { cellM.clear(); }
+	void reserve( const size_t n ) { cellM.reserve(n); }
+
+	void Insert( const float lon, const float lat, const int idx ) {
+		cellM[Key(Cell(lon), Cell(lat))].push_back( Entry{Point<float>(lon, lat), idx} );
+	}
+
+	// smallest index of the stored locations at (lon, lat), -1 if none
+	int Find( const float lon, const float lat ) const {
+		const Point<float> loc( lon, lat );
+		const long ilon = Cell(lon), ilat = Cell(lat);
+		int idx = -1;
+		for( long i=ilon-1; i<=ilon+1; i++ )
+			for( long j=ilat-1; j<=ilat+1; j++ ) {
+				const auto I = cellM.find( Key(i, j) );
+				if( I == cellM.end() ) continue;
+				for( const auto& e : I->second )
+					if( (idx<0 || e.idx<idx) && loc.IsSameLocation(e.loc) ) idx = e.idx;
+			}
+		return idx;
+	}
+
+private:
+	struct Entry { Point<float> loc; int idx; };
+	std::unordered_map<uint64_t, std::vector<Entry>> cellM;
+
+	static long Cell( const float x ) { return (long)std::floor( x / StaInfo::maxmisloc ); }
+	static uint64_t Key( const long i, const long j ) { return ((uint64_t)(uint32_t)i << 32) | (uint32_t)j; }
+};
+
 class StaList {
 public:
 	StaList() {}
@@ -77,28 +114,15 @@ public:
 
 	void SortByLon() {
 		std::sort( _dataV.begin(), _dataV.end() );
-		sorted = true;
+		Index();
 	}
 
-	bool SearchLoc( const float lon, const float lat, StaInfo& data_find ) {
-		if( ! sorted ) SortByLon();
-      // iterator to the first data in _dataV with a lon>=loc.lon-StaInfo::maxmisloc
-		StaInfo loc( "", lon, lat );
-      auto loclb = loc; loclb.lon -= StaInfo::maxmisloc;
-      auto idatal = std::lower_bound( _dataV.begin(), _dataV.end(), loclb );
-      // iterator to the first data in dataV with a lon>loc.lon+StaInfo::maxmisloc
-      auto locub = loc; locub.lon += StaInfo::maxmisloc;
-      auto idatau = std::upper_bound( idatal, _dataV.end(), locub );
-      auto idata = idatal;
-		//std::cerr<<lon<<" "<<lat<<" "<<idatal-_dataV.begin()<<" "<<idatau-_dataV.begin()<<"\n";
-      for( ; idata<idatau; idata++ )
-         if( loc.IsSameLocation(*idata) ) break;
-      if( idata < idatau ) { // found
-			data_find = *idata;
-			return true;
-      } else { // not found
-			return false;
-      }
+	// station at (lon, lat) (within StaInfo::maxmisloc), through the location hash
+	bool SearchLoc( const float lon, const float lat, StaInfo& data_find ) const {
+		const int ista = _locH.Find( lon, lat );
+		if( ista < 0 ) return false;
+		data_find = _dataV[ista];
+		return true;
 	}
 
 	const std::vector<StaInfo>& DataRef() { return _dataV; }
@@ -107,7 +131,12 @@ public:
 
 private:
 	std::vector<StaInfo> _dataV;
-	bool sorted = false;
+	LocHash _locH;
+
+	void Index() {
+		_locH.clear(); _locH.reserve( _dataV.size() );
+		for( int i=0; i<_dataV.size(); i++ ) _locH.Insert( _dataV[i].lon, _dataV[i].lat, i );
+	}
 
 	void Load( const std::string& fname, const bool storeline = false ) {
 		_dataV.clear();
@@ -122,6 +151,7 @@ private:
 				std::cerr<<e.what()<<"\n";
 			}
 		}
+		Index();
 		//std::cout<<"   "<<dataV.size()<<" data lines read in."<<std::endl;
 	}
 
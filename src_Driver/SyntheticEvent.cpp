@@ -0,0 +1,267 @@
+#include "SyntheticEvent.h"
+#include "SDContainer.h"
+#include "RadPattern.h"
+#include "SynGenerator.h"
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace {
+	// a number of the eigen file
+	std::string E( const double v ) {
+		char buff[32]; snprintf( buff, sizeof(buff), "%14.7E", v );
+		return buff;
+	}
+
+	std::ofstream Open( const std::string& fname ) {
+		std::ofstream fout( fname );
+		if( ! fout ) throw std::runtime_error( "Error(SyntheticEvent): cannot write to " + fname );
+		return fout;
+	}
+
+	// period index k = per - 5 of the eigen/model files: phase and group velocities of the 1D
+	// model (the eig/phv files), about which the 3D model varies
+	float Vel1D( const char type, const char kind, const float k ) {
+		if( type == 'R' ) return (kind=='P' ? 3.5 : 3.1) + 0.01*k;
+		return (kind=='P' ? 3.9 : 3.6) + 0.01*k;
+	}
+}
+
+/* -------------------- settings -------------------- */
+std::vector<float> SyntheticEvent::MeasurementPeriods() const {
+	std::vector<float> perV;
+	for( int i=0; i<nper; i++ ) perV.push_back( 8 + 2*i );
+	return perV;
+}
+
+float SyntheticEvent::Vel( const char type, const char kind, const float per, const float lon, const float lat ) {
+	const float dlon = lon-lonmin, dlat = lat-latmin, k = per - 5.;
+	if( kind == 'P' ) return Vel1D(type, kind, k) + 0.1*sin(0.4*dlat)*cos(0.3*dlon);
+	return Vel1D(type, kind, k) + 0.1*cos(0.2*dlat);
+}
+
+SyntheticEvent SyntheticEvent::Read( const std::string& dir ) {
+	const std::string fname = dir + "/dataset.txt";
+	std::ifstream fin( fname );
+	if( ! fin ) throw std::runtime_error( "Error(SyntheticEvent::Read): cannot access " + fname );
+	SyntheticEvent se;
+	for( std::string line; std::getline(fin, line); ) {
+		std::stringstream ss(line); std::string key; ss >> key;
+		if( key == "nsta" ) ss >> se.nsta;
+		else if( key == "nper" ) ss >> se.nper;
+		else if( key == "grid" ) ss >> se.dgrid;
+		else if( key == "noise" ) ss >> se.noise;
+		else if( key == "seed" ) ss >> se.seed;
+		else if( key == "truth" ) { std::string rest; std::getline(ss, rest); se.minfo = ModelInfo(rest); }
+	}
+	return se;
+}
+
+/* -------------------- output -------------------- */
+void SyntheticEvent::Write( const std::string& dir ) const {
+	if( nsta<=0 || nper<=0 || dgrid<=0. )
+		throw std::runtime_error( "Error(SyntheticEvent::Write): invalid nsta/nper/grid = " + std::to_string(nsta) + "/" +
+										  std::to_string(nper) + "/" + std::to_string(dgrid) );
+	for( const auto& d : { dir, dir+"/data", dir+"/out" } )
+		if( mkdir( d.c_str(), 0755 ) != 0 && errno != EEXIST )
+			throw std::runtime_error( "Error(SyntheticEvent::Write): cannot create " + d );
+
+	const auto staV = WriteStations( dir + "/stations.lst" );
+	for( const char type : { 'R', 'L' } ) {
+		const std::string stype(1, type);
+		WriteEigen( dir + "/" + stype + ".eig", type );
+		WritePhv( dir + "/" + stype + ".phv", type );
+		WriteModel( dir + "/model." + stype + ".bin", type );
+		for( const float per : MeasurementPeriods() ) {
+			const std::string fbase = dir + "/data/" + stype + "_" + std::to_string((int)per);
+			WriteMap( fbase + ".G.map", type, 'G', per );
+			WriteMap( fbase + ".P.map", type, 'P', per );
+			WriteMeasurements( dir, type, per, staV );
+		}
+		WriteSACs( dir, type, staV );
+	}
+	WriteParams( dir );
+
+	auto fout = Open( dir + "/dataset.txt" );
+	fout<<"nsta "<<nsta<<"\nnper "<<nper<<"\ngrid "<<dgrid<<"\nnoise "<<noise<<"\nseed "<<seed<<"\n"
+		 <<"truth "<<minfo.lon<<" "<<minfo.lat<<" "<<minfo.t0<<" "<<minfo.stk<<" "<<minfo.dip<<" "
+		 <<minfo.rak<<" "<<minfo.dep<<" "<<minfo.M0<<"\n";
+}
+
+void SyntheticEvent::WriteEigen( const std::string& fname, const char type ) const {
+	auto fout = Open( fname );
+	std::string header( 40, ' ' );
+	header.replace( 1, 4, type=='R' ? "Rayl" : "Love" ); header[type=='R' ? 16 : 12] = '1';
+	fout<<" some header line\n"<<header<<"\n";
+	const int ndep = 300;
+	for( int k=0; k<=PerMax()-5; k++ ) {
+		const float t = 5 + k, c = Vel1D(type, 'P', k), u = Vel1D(type, 'G', k);
+		fout<<" @@@@@@@@@@@@@@@@@@@@\n";
+		if( type == 'R' ) {
+			for( const double v : { (double)t, (double)c, (double)u, 2.*M_PI/t/c, 1.e-3/(k+1), 0.8, 200. } ) fout<<E(v)<<"  ";
+		} else {
+			for( const double v : { (double)t, (double)c, (double)u, 2.*M_PI/t/c, 2.e-3/(k+1), 250. } ) fout<<E(v)<<"  ";
+		}
+		fout<<"\n"<<E(1.5+0.1*k)<<"  "<<E(0.)<<"  "<<E(0.)<<"  "<<E(0.)<<"\n";
+		for( int i=0; i<ndep; i++ ) {
+			const double d = 0.37*(i+1);
+			fout<<E(d)<<"  "<<E(exp(-d/(10+k))*cos(d/7.))<<"  "<<E(-sin(d/5.)/(k+3))<<"\n";
+		}
+		if( type != 'R' ) continue;
+		fout<<" $$$$$$$$$$$$$$$$$$$$\n";
+		for( int i=0; i<ndep; i++ ) {
+			const double d = 0.37*(i+1);
+			fout<<E(d)<<"  "<<E(exp(-d/(8+k))*sin(d/9.+0.3))<<"  "<<E(cos(d/6.)/(k+2))<<"\n";
+		}
+	}
+}
+
+void SyntheticEvent::WritePhv( const std::string& fname, const char type ) const {
+	auto fout = Open( fname );
+	for( int k=0; k<=PerMax()-5; k++ ) fout<<5+k<<" "<<Vel1D(type, 'P', k)<<"\n";
+}
+
+// Fortran unformatted sequential: a header record, then one record of u, c, (geometrical
+// spreading) g and (attenuation) a per period, each (nlat, nlon) in column-major order
+void SyntheticEvent::WriteModel( const std::string& fname, const char type ) const {
+	std::ofstream fout( fname, std::ios::binary );
+	if( ! fout ) throw std::runtime_error( "Error(SyntheticEvent::WriteModel): cannot write to " + fname );
+	const double step = std::max( dgrid, 0.11f );	// the tracer takes at most 200 lats x 300 lons
+	const int nlat = (latmax-latmin)/step + 1, nlon = (lonmax-lonmin)/step + 1, nmod = PerMax()-4;
+	auto put = [&]( const void* p, const size_t n ) { fout.write( (const char*)p, n ); };
+	auto record = [&]( const int nbyte ) { put( &nbyte, 4 ); };
+
+	const int n0 = 0; const double flat = latmin, flon = lonmin, per = 5., sper = 1.;
+	record( 64 );
+	put(&n0, 4); put(&flat, 8); put(&nlat, 4); put(&step, 8); put(&flon, 8); put(&nlon, 4); put(&step, 8);
+	put(&per, 8); put(&nmod, 4); put(&sper, 8);
+	record( 64 );
+
+	std::vector<double> buff( nlat*nlon );
+	for( int k=0; k<nmod; k++ ) {
+		const int nbyte = 4 * nlat * nlon * 8;
+		record( nbyte );
+		for( const char kind : { 'G', 'P', 'g', 'a' } ) {
+			for( int j=0; j<nlon; j++ )
+				for( int i=0; i<nlat; i++ )
+					buff[j*nlat+i] = kind=='g' ? 1.e-4 : ( kind=='a' ? 1. : Vel(type, kind, 5+k, flon+j*step, flat+i*step) );
+			put( buff.data(), buff.size()*8 );
+		}
+		record( nbyte );
+	}
+	if( ! fout ) throw std::runtime_error( "Error(SyntheticEvent::WriteModel): failed writing " + fname );
+}
+
+void SyntheticEvent::WriteMap( const std::string& fname, const char type, const char kind, const float per ) const {
+	auto fout = Open( fname );
+	const int nlat = (latmax-latmin)/dgrid + 1, nlon = (lonmax-lonmin)/dgrid + 1;
+	for( int j=0; j<nlon; j++ )
+		for( int i=0; i<nlat; i++ ) {
+			const float lon = lonmin + j*dgrid, lat = latmin + i*dgrid;
+			fout<<lon<<" "<<lat<<" "<<Vel(type, kind, per, lon, lat)<<"\n";
+		}
+}
+
+// stations at random (seeded) locations over lon 236.5-253.5, lat 33.5-46.5, and > 1 deg from the event
+std::vector<SyntheticEvent::Sta> SyntheticEvent::WriteStations( const std::string& fname ) const {
+	std::mt19937 gen( seed );
+	std::uniform_real_distribution<float> Ulon(lonmin+6.5, lonmax-6.5), Ulat(latmin+3.5, latmax-3.5);
+	std::vector<Sta> staV;
+	auto fout = Open( fname );
+	char name[16];
+	for( int i=0; i<nsta; i++ ) {
+		float lon, lat;
+		do { lon = Ulon(gen); lat = Ulat(gen); } while( fabs(lon-minfo.lon)<1. && fabs(lat-minfo.lat)<1. );
+		snprintf( name, sizeof(name), "S%04d", i );
+		staV.push_back( {name, lon, lat} );
+		fout<<lon<<" "<<lat<<" "<<name<<" XX\n";
+	}
+	return staV;
+}
+
+// predict path and source terms at the true model for the stations (from a placeholder
+// measurement file), then replace the measurements by the predictions plus noise
+void SyntheticEvent::WriteMeasurements( const std::string& dir, const char type, const float per, const std::vector<Sta>& staV ) const {
+	const std::string stype(1, type), fbase = dir + "/data/" + stype + "_" + std::to_string((int)per);
+	const std::string fmeas = fbase + ".meas";
+	{
+		auto fout = Open( fmeas );
+		for( const auto& sta : staV ) fout<<sta.lon<<" "<<sta.lat<<" 0 0 1\n";
+	}
+	SDContainer sdc( per, type=='R' ? R : L, true, fmeas, fbase+".G.map", fbase+".P.map", dir+"/stations.lst", minfo.lon, minfo.lat );
+	sdc.UpdatePathPred( minfo.lon, minfo.lat, minfo.t0 );
+	RadPattern rp( type, dir + "/" + stype + ".eig" );
+	rp.Predict( minfo.stk, minfo.dip, minfo.rak, minfo.dep, minfo.M0, {per} );
+	sdc.UpdateSourcePred( rp );
+
+	// noise: group/phase times by noise*5*per sec, log amplitudes by noise*10
+	std::mt19937 gen( seed + 1000*(type=='L') + (int)per ); std::normal_distribution<float> N(0., 1.);
+	const float NaN = AziData::NaN;
+	auto fout = Open( fmeas );
+	int nout = 0;
+	for( const auto& sd : sdc ) {
+		if( sd.Gpath==NaN || sd.Gsource==NaN || sd.Ppath==NaN || sd.Psource==NaN || sd.Asource==NaN ) continue;
+		fout<<sd.lon<<" "<<sd.lat<<" "<<sd.Gpath+sd.Gsource+noise*5*per*N(gen)<<" "
+			 <<sd.Ppath+sd.Psource+noise*5*per*N(gen)<<" "<<exp(sd.Asource+noise*10*N(gen))<<"\n";
+		nout++;
+	}
+	std::cout<<"### SyntheticEvent: "<<nout<<" "<<type<<" measurements at "<<per<<" sec. ###"<<std::endl;
+}
+
+// synthetics (vertical for R, transverse for L) at 1 sps, with gaussian noise of noise*max|sig|
+void SyntheticEvent::WriteSACs( const std::string& dir, const char type, const std::vector<Sta>& staV ) const {
+	const std::string stype(1, type);
+	SynGenerator synG( dir+"/model."+stype+".bin", dir+"/"+stype+".phv", dir+"/"+stype+".eig", type, 0 );
+	for( const auto& sta : staV ) {
+		SacRec sac;
+		snprintf( sac.shd.kstnm, sizeof(sac.shd.kstnm), "%s", sta.name.c_str() ); snprintf( sac.shd.knetwk, sizeof(sac.shd.knetwk), "XX" );
+		sac.shd.stlo = sta.lon; sac.shd.stla = sta.lat;
+		synG.PushbackSta( sac );
+	}
+	synG.SetEvent( minfo );
+
+	std::mt19937 gen( seed + 2000*(type=='L') ); std::normal_distribution<float> N(0., 1.);
+	const int npts = 3000;
+	auto flst = Open( dir + "/data/saclist" + stype + ".txt" );
+	for( const auto& sta : staV ) {
+		SacRec z, r, t;
+		if( ! synG.ComputeSyn( sta.name, sta.lon, sta.lat, npts, 1., z, r, t, false ) ) continue;
+		SacRec& sac = type=='R' ? z : t;
+		float amax = 0.; for( int i=0; i<npts; i++ ) amax = std::max( amax, std::fabs(sac.sig[i]) );
+		for( int i=0; i<npts; i++ ) sac.sig[i] += noise * amax * N(gen);
+		sac.shd.b = 0.;	// origin time = b + t0
+		const std::string fsac = "data/" + sta.name + "." + stype + ".SAC";
+		sac.Write( dir + "/" + fsac );
+		flst<<fsac<<"\n";
+	}
+}
+
+// the searches start from a perturbed model
+void SyntheticEvent::WriteParams( const std::string& dir ) const {
+	std::stringstream ss;
+	ss<<"lon "<<minfo.lon+0.15<<"\nlat "<<minfo.lat-0.1<<"\nt0 1.\npertfactor 0.1\nM0 "<<minfo.M0
+	  <<"\nstk "<<minfo.stk+15.<<"\ndip "<<minfo.dip-5.<<"\nrak "<<minfo.rak+10.<<"\ndep "<<minfo.dep+3.<<"\n"
+	  <<"fRse R.eig\nfRsp R.phv\nfLse L.eig\nfLsp L.phv\ndflag B\nindep 0.5\n"
+	  <<"fmisAll out/misAll\nfmisF out/misF\nfmisL out/misL\nfpos out/pos\ndirsac out/sac\nfsigmas out/sigmas\n";
+	const std::string common = ss.str();
+
+	auto fdisp = Open( dir + "/param_disp.txt" );
+	fdisp<<common;
+	for( const char type : { 'R', 'L' } )
+		for( const float per : MeasurementPeriods() ) {
+			const std::string fbase = std::string("data/") + type + "_" + std::to_string((int)per);
+			fdisp<<"f"<<type<<"m "<<fbase<<".meas "<<fbase<<".G.map "<<fbase<<".P.map "<<per<<" stations.lst\n";
+		}
+
+	auto fwave = Open( dir + "/param_wave.txt" );
+	fwave<<common<<"SNRMIN -1\nfsaclistR data/saclistR.txt 0\nfsaclistL data/saclistL.txt 0\n"
+		  <<"fmodelR model.R.bin\nfmodelL model.L.bin\npermin 6\npermax 20\n"
+		  <<"sigmaR -1 1. 1. 0.3\nsigmaL -1 1. 1. 0.3\n";
+}
@@ -0,0 +1,56 @@
+#ifndef SYNTHETICEVENT_H
+#define SYNTHETICEVENT_H
+
+#include "ModelInfo.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/* a self-contained synthetic event for offline benchmarks. Write(dir) produces, in dir:
+	R/L.eig and R/L.phv (eigen functions and phase velocities at 5 - pmax sec), model.R/L.bin
+	(3D model in the binary format read by the tracer), data/{R,L}_{per}.{G,P}.map (group/phase
+	velocity maps), data/{R,L}_{per}.meas (measurements predicted at the true model, plus noise),
+	stations.lst, data/{sta}.{R,L}.SAC (synthetics of the true model, plus noise) with their saclists,
+	and param_disp.txt/param_wave.txt for the measurement/waveform methods. Paths in the param
+	files are relative to dir. The velocities are smooth analytic fields over lon 230-260, lat
+	30-50, with the stations placed randomly (by seed) around the event */
+class SyntheticEvent {
+public:
+	ModelInfo minfo{ 245.1, 39.2, 0., 248., 33.5, -54., 6., 1.1e23 };	// the true model
+	int nsta = 30;			// # of stations
+	int nper = 4;			// # of measurement periods (8, 10, 12, ... sec)
+	float dgrid = 0.5;	// grid step (deg) of the maps; the 3D model takes max(dgrid, 0.11)
+	float noise = 0.01;	// relative noise level
+	unsigned seed = 11;
+
+	SyntheticEvent() {}
+	SyntheticEvent( const int nsta, const int nper, const float dgrid, const unsigned seed )
+		: nsta(nsta), nper(nper), dgrid(dgrid), seed(seed) {}
+
+	std::vector<float> MeasurementPeriods() const;
+	// the period range of the eigen/model files
+	int PerMax() const { return std::max( 24, 8 + 2*nper ); }
+
+	void Write( const std::string& dir ) const;
+
+	// read back the settings (dataset.txt) of an event written to dir
+	static SyntheticEvent Read( const std::string& dir );
+
+private:
+	static constexpr float lonmin = 230., lonmax = 260., latmin = 30., latmax = 50.;
+	struct Sta { std::string name; float lon, lat; };
+
+	// group (kind='G') or phase (kind='P') velocity at period per
+	static float Vel( const char type, const char kind, const float per, const float lon, const float lat );
+
+	void WriteEigen( const std::string& fname, const char type ) const;
+	void WritePhv( const std::string& fname, const char type ) const;
+	void WriteModel( const std::string& fname, const char type ) const;
+	void WriteMap( const std::string& fname, const char type, const char kind, const float per ) const;
+	std::vector<Sta> WriteStations( const std::string& fname ) const;
+	void WriteMeasurements( const std::string& dir, const char type, const float per, const std::vector<Sta>& staV ) const;
+	void WriteSACs( const std::string& dir, const char type, const std::vector<Sta>& staV ) const;
+	void WriteParams( const std::string& dir ) const;
+};
+
+#endif
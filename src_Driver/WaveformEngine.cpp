@@ -0,0 +1,281 @@
+#include "WaveformEngine.h"
+#include "Parabola.h"
+#include "Profiler.h"
+#include <fftw3.h>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+
+WaveformEngine::~WaveformEngine() {
+	#pragma omp critical(fftw)
+	{
+	for( auto& p : planM )
+		for( auto plan : p.second ) if( plan ) fftw_destroy_plan( plan );
+	}
+}
+
+
+/* -------------------- spectra of all stations -------------------- */
+void WaveformEngine::Spectra( SynGenerator& synG, const std::vector<SacRec3>& sac3V, std::vector<Spec>& specV,
+										InnerThreads* pinner, std::vector<SacRec>* psynV ) {
+	PROFILE_SCOPE("WaveformEngine::Spectra");
+	const auto& mi = synG.minfo;
+	const int nsta = sac3V.size();
+	int nvisit = 0;
+	std::shared_ptr<const std::vector<Spec>> pbasisV;
+	if( nloc > 0 ) pbasisV = Find( synG.type, mi, nvisit );
+	if( pbasisV && pbasisV->size()!=nsta*6 ) pbasisV.reset();
+
+	// second visit: synthesize and transform the six unit-tensor components of all stations in one batch
+	if( !pbasisV && nvisit>1 ) {
+		std::vector<SacRec> sacV( nsta*6 );
+		std::vector<const SacRec*> psacV( nsta*6 );
+		Synthesize( synG, nsta*6, pinner, [&]( const int i ) {
+			Windowed( synG, sac3V[i/6][0], i/6, i%6, sacV[i] );
+			psacV[i] = &(sacV[i]);
+		} );
+		auto pbasisVnew = std::make_shared<std::vector<Spec>>();
+		Transform( psacV, *pbasisVnew );
+		Insert( synG.type, mi, pbasisVnew );
+		pbasisV = std::move(pbasisVnew);
+	}
+
+	specV.resize( nsta );
+	if( psynV ) psynV->clear();
+	if( pbasisV ) {
+		// weighted sum of the unit-tensor spectra
+		float M0, MT[6]; synG.MomentTensor( M0, MT );
+		for( int ista=0; ista<nsta; ista++ ) {
+			const Spec *basisA = &((*pbasisV)[ista*6]);
+			auto& spec = specV[ista];
+			spec.b = basisA[0].b; spec.delta = basisA[0].delta;
+			spec.azi = basisA[0].azi; spec.ns = basisA[0].ns;
+			const int nk = basisA[0].spec.size(), npts = basisA[0].asig.size();
+			spec.spec.assign( nk, 0. ); spec.asig.assign( npts, 0. );
+			Cplx *specA = spec.spec.data(), *asigA = spec.asig.data();
+			for( int m=0; m<6; m++ ) {
+				const float w = M0 * MT[m];
+				const Cplx *specAm = basisA[m].spec.data(), *asigAm = basisA[m].asig.data();
+				for( int i=0; i<nk; i++ ) specA[i] += w * specAm[i];
+				for( int i=0; i<npts; i++ ) asigA[i] += w * asigAm[i];
+			}
+		}
+		return;
+	}
+
+	// synthesize and transform all stations in one batch
+	std::vector<SacRec> sacV( nsta );
+	std::vector<const SacRec*> psacV( nsta );
+	if( psynV ) psynV->resize( nsta );
+	Synthesize( synG, nsta, pinner, [&]( const int ista ) {
+		Windowed( synG, sac3V[ista][0], ista, -1, sacV[ista], psynV ? &((*psynV)[ista]) : nullptr );
+		psacV[ista] = &(sacV[ista]);
+	} );
+	Transform( psacV, specV );
+}
+
+void WaveformEngine::Spectra( const std::vector<SacRec3>& sac3V, std::vector<SacRec>& sacSV, std::vector<Spec>& specV ) {
+	PROFILE_SCOPE("WaveformEngine::Spectra");
+	const int nsta = sac3V.size();
+	if( sacSV.size() != nsta )
+		throw ErrorWE::BadParam(FuncName, "# of synthetics != # of stations");
+	std::vector<const SacRec*> psacV( nsta );
+	for( int ista=0; ista<nsta; ista++ ) {
+		Window( sac3V[ista][0], sacSV[ista] );
+		psacV[ista] = &(sacSV[ista]);
+	}
+	Transform( psacV, specV );
+}
+
+template <class Func>
+void WaveformEngine::Synthesize( SynGenerator& synG, const int n, InnerThreads* pinner, const Func& func ) const {
+	const int nthd = pinner ? pinner->Get(n) : 1;
+	if( nthd > 1 ) synG.Trace();	// the only lazily-updated state of synG
+	const auto tb = std::chrono::steady_clock::now();
+	ParallelTasks( n, nthd, func );
+	if( pinner ) pinner->Record( std::chrono::duration<float>(std::chrono::steady_clock::now()-tb).count(), n, nthd );
+}
+
+void WaveformEngine::Windowed( SynGenerator& synG, const SacRec& sacM, const int ista, const int m, SacRec& sacS, SacRec* psacF ) const {
+	const auto &shd = sacM.shd;
+	SacRec sacSZ, sacSR, sacST;
+	int nptsS = ceil( (shd.user3-synG.minfo.t0)/shd.delta ) + 1;
+	if( m >= 0 ) psacF = nullptr;
+	// the full FFT size when asked for (and nptsS alone if that fails)
+	const int nptsF = psacF ? SynGenerator::FullSize(nptsS) : nptsS;
+	auto synthesize = [&]( const int npts ) {
+		return m < 0 ?
+			synG.ComputeSyn( ista, npts, shd.delta, sacSZ, sacSR, sacST, rotate, f1, f2, f3, f4 ) :
+			synG.ComputeSynUnit( m, ista, npts, shd.delta, sacSZ, sacSR, sacST, rotate, f1, f2, f3, f4 );
+	};
+	bool synsuc = synthesize( nptsF );
+	if( !synsuc && nptsF!=nptsS ) { psacF = nullptr; synsuc = synthesize( nptsS ); }
+	if( ! synsuc )
+		throw ErrorWE::BadSyn(FuncName, "station "+sacM.stname()+(m<0 ? "" : " tensor component "+std::to_string(m)));
+	SacRec& sacSC = synG.type=='R' ? sacSZ : sacST;
+	if( psacF && nptsF!=nptsS ) {
+		*psacF = std::move(sacSC);
+		if( ! SynGenerator::CutSyn( *psacF, synG.minfo.t0, nptsS, sacS ) )
+			throw ErrorWE::BadSyn(FuncName, "station "+sacM.stname()+" (cut from the full size)");
+	} else {
+		if( psacF ) *psacF = sacSC;
+		sacS = std::move( sacSC );
+	}
+	Window( sacM, sacS );
+}
+
+
+/* -------------------- batched transforms -------------------- */
+void WaveformEngine::Transform( const std::vector<const SacRec*>& sacV, std::vector<Spec>& specV ) {
+	specV.resize( sacV.size() );
+	// group traces by FFT size
+	std::map<int, std::vector<int>> groupM;
+	for( int i=0; i<sacV.size(); i++ ) groupM[FFTSize(sacV[i]->shd.npts)].push_back(i);
+
+	for( const auto& group : groupM ) {
+		const int ns = group.first, nk = ns/2 + 1, howmany = group.second.size();
+		auto plans = Plans( ns, howmany );
+		double *rin = fftw_alloc_real( (size_t)howmany*ns );
+		fftw_complex *sf = fftw_alloc_complex( (size_t)howmany*nk );
+		fftw_complex *ain = fftw_alloc_complex( (size_t)howmany*ns ), *aout = fftw_alloc_complex( (size_t)howmany*ns );
+		if( !rin || !sf || !ain || !aout )
+			throw std::runtime_error("Error(WaveformEngine::Transform): fftw_malloc failed!");
+
+		// zero-padded traces
+		std::fill( rin, rin+(size_t)howmany*ns, 0. );
+		for( int j=0; j<howmany; j++ ) {
+			const auto& sac = *(sacV[group.second[j]]);
+			std::copy( sac.sig.get(), sac.sig.get()+sac.shd.npts, rin+(size_t)j*ns );
+		}
+		{ PROFILE_SCOPE("FFTW"); fftw_execute_dft_r2c( plans[0], rin, sf ); }
+
+		// FFTW_BACKWARD spectrum of a real trace == conjugate of its r2c output, with the DC
+		// term halved (as SacRec FFTW_B). The one-sided spectrum, transformed FFTW_FORWARD,
+		// gives the analytic signal (as SacRec::FromAmPh)
+		std::fill( &(ain[0][0]), &(ain[0][0])+(size_t)howmany*ns*2, 0. );
+		for( int j=0; j<howmany; j++ ) {
+			fftw_complex *sfj = sf + (size_t)j*nk, *ainj = ain + (size_t)j*ns;
+			for( int i=0; i<nk; i++ ) { ainj[i][0] = sfj[i][0]; ainj[i][1] = -sfj[i][1]; }
+			ainj[0][0] *= 0.5; ainj[0][1] *= 0.5; ainj[nk-1][1] = 0.;
+		}
+		{ PROFILE_SCOPE("FFTW"); fftw_execute_dft( plans[1], ain, aout ); }
+
+		for( int j=0; j<howmany; j++ ) {
+			const auto& sac = *(sacV[group.second[j]]);
+			auto& spec = specV[group.second[j]];
+			const float delta = sac.shd.delta, fa = 2./ns;
+			spec.b = sac.shd.b; spec.delta = delta;
+			spec.azi = sac.Azi(); spec.ns = ns;
+			spec.spec.resize( nk );
+			const fftw_complex *ainj = ain + (size_t)j*ns, *aoutj = aout + (size_t)j*ns;
+			for( int i=0; i<nk; i++ ) spec.spec[i] = Cplx( ainj[i][0]*delta, ainj[i][1]*delta );
+			const int npts = sac.shd.npts;
+			spec.asig.resize( npts );
+			for( int i=0; i<npts; i++ ) spec.asig[i] = Cplx( aoutj[i][0]*fa, aoutj[i][1]*fa );
+		}
+
+		fftw_free(rin); fftw_free(sf);
+		fftw_free(ain); fftw_free(aout);
+	}
+}
+
+std::array<fftw_plan_s*,2> WaveformEngine::Plans( const int ns, const int howmany ) {
+	std::array<fftw_plan_s*,2> plans;
+	// the FFTW planner is not thread-safe (the same critical section as in SacRec)
+	#pragma omp critical(fftw)
+	{
+	auto& p = planM[std::make_pair(ns, howmany)];
+	if( ! p[0] ) {
+		const int nk = ns/2 + 1;
+		double *rin = fftw_alloc_real( (size_t)howmany*ns );
+		fftw_complex *cin = fftw_alloc_complex( (size_t)howmany*ns ), *cout = fftw_alloc_complex( (size_t)howmany*ns );
+		p[0] = fftw_plan_many_dft_r2c( 1, &ns, howmany, rin, nullptr, 1, ns, cin, nullptr, 1, nk, FFTW_ESTIMATE );
+		p[1] = fftw_plan_many_dft( 1, &ns, howmany, cin, nullptr, 1, ns, cout, nullptr, 1, ns, FFTW_FORWARD, FFTW_ESTIMATE );
+		fftw_free(rin); fftw_free(cin); fftw_free(cout);
+	}
+	plans = p;
+	}
+	return plans;
+}
+
+
+/* -------------------- misfits -------------------- */
+WaveformEngine::Misfit WaveformEngine::StaMisfit( const SacRec3& sac3, const Spec& spec ) const {
+	const auto& shdM = sac3[0].shd;
+	const SacRec &sac_am1 = sac3[1], &sac_ph1 = sac3[2];
+	const int nk = spec.spec.size(), npts = spec.asig.size();
+	if( sac_am1.shd.npts!=nk || sac_ph1.shd.npts!=nk )
+		throw ErrorWE::BadParam(FuncName, "spectrum size mismatch: "+std::to_string(nk)+" - "+std::to_string(sac_am1.shd.npts));
+
+	// frequency band (indexed as by SacRec::Mean/RMSAvg on the ToAmPh output)
+	const float deltaf = 1./(spec.delta*spec.ns);
+	const int ib = nint(f2/deltaf), ie = nint(f3/deltaf) + 1;
+	if( ib<0 || ie>nk || ib>=ie )
+		throw ErrorWE::BadParam(FuncName, "frequency band out of range");
+
+	// mean synthetic amplitude, and signed rms of the amplitude and (2pi corrected) phase differences
+	const float maxfloat = std::numeric_limits<float>::max(), TWO_PI = M_PI * 2.;
+	const float *am1 = sac_am1.sig.get(), *ph1 = sac_ph1.sig.get();
+	float amsum = 0., damsum = 0., dphsum = 0.;
+	int namean = 0, nam = 0, nph = 0;
+	for( int i=ib; i<ie; i++ ) {
+		const float am = std::abs(spec.spec[i]);
+		if( am < maxfloat ) { amsum += am; namean++; }
+		const float dam = am - am1[i];
+		if( dam < maxfloat ) { damsum += dam*dam; nam++; }
+		float dph = std::arg(spec.spec[i]) - ph1[i];
+		if( dph >= M_PI ) dph -= TWO_PI;
+		else if( dph < -M_PI ) dph += TWO_PI;
+		if( dph < maxfloat ) { dphsum += dph*dph; nph++; }
+	}
+	Misfit mis;
+	mis.azi = spec.azi;
+	mis.AmpTheory = amsum / namean;
+	mis.rms_am = -std::sqrt(damsum/(nam-1));
+	mis.rms_ph = -std::sqrt(dphsum/(nph-1));
+
+	// peak of the envelope (refined by a parabola, as SacRec::Peak)
+	int imax = 0;
+	float amax = std::abs(spec.asig[0]);
+	for( int i=1; i<npts; i++ ) {
+		const float a = std::abs(spec.asig[i]);
+		if( amax < a ) { amax = a; imax = i; }
+	}
+	auto X = [&]( const int i ) { return (double)spec.b + i*spec.delta; };
+	if( imax==0 || imax==npts-1 ) {
+		mis.tpeak = X(imax);
+	} else {
+		PointC p1(X(imax-1), std::abs(spec.asig[imax-1]));
+		PointC p2(X(imax),   amax);
+		PointC p3(X(imax+1), std::abs(spec.asig[imax+1]));
+		mis.tpeak = Parabola( p1, p2, p3 ).Vertex().x;
+	}
+	mis.grT = shdM.user4 - mis.tpeak;
+	return mis;
+}
+
+/* -------------------- unit-tensor spectra cache -------------------- */
+std::shared_ptr<const std::vector<WaveformEngine::Spec>> WaveformEngine::Find( const char type, const ModelInfo& mi, int& nvisit ) {
+	std::lock_guard<std::mutex> lock(mtx);
+	auto I = entryL.begin();
+	for( ; I!=entryL.end(); I++ )
+		if( I->Matches(type, mi) ) break;
+	if( I == entryL.end() ) {
+		if( entryL.size() >= nloc ) entryL.pop_back();
+		entryL.push_front( Entry{type, mi.lon, mi.lat, mi.dep, mi.t0, 0} );
+	} else if( I != entryL.begin() ) {
+		entryL.splice( entryL.begin(), entryL, I );
+	}
+	auto& entry = entryL.front();
+	nvisit = ++(entry.nvisit);
+	return entry.pbasisV;
+}
+
+void WaveformEngine::Insert( const char type, const ModelInfo& mi, std::shared_ptr<const std::vector<Spec>> pbasisV ) {
+	std::lock_guard<std::mutex> lock(mtx);
+	for( auto& entry : entryL )
+		if( entry.Matches(type, mi) ) { entry.pbasisV = std::move(pbasisV); return; }
+	if( entryL.size() >= nloc ) entryL.pop_back();
+	entryL.push_front( Entry{type, mi.lon, mi.lat, mi.dep, mi.t0, 1, std::move(pbasisV)} );
+}
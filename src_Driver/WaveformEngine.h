@@ -0,0 +1,131 @@
+#ifndef WAVEFORMENGINE_H
+#define WAVEFORMENGINE_H
+
+#include "SynGenerator.h"
+#include "ModelInfo.h"
+#include "SacRec.h"
+#include "MyOMP.h"
+#include <array>
+#include <complex>
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+struct fftw_plan_s;
+
+/* ---------- exceptions ---------- */
+namespace ErrorWE {
+   class BadSyn : public std::runtime_error {
+   public:
+      BadSyn(const std::string funcname, const std::string info = "")
+	 : runtime_error("Error("+funcname+"): Invalid synthetic ("+info+").") {}
+   };
+
+   class BadParam : public std::runtime_error {
+   public:
+      BadParam(const std::string funcname, const std::string info = "")
+        : runtime_error("Error("+funcname+"): Bad parameters ("+info+").") {}
+   };
+};
+
+
+/* Spectral-domain waveform misfits.
+	The windowed synthetic of a station (resampled and cut to the data window, as in
+	EQKAnalyzer::WaveformMisfit) is kept as its one-sided spectrum and its analytic signal:
+	amplitude/phase misfits come from the former, the envelope peak from the latter, with no
+	further transforms. Stations are transformed in batches (one r2c and one c2c
+	fftw_plan_many_dft per FFT size).
+	Since synthetics are linear in aM*tm, the spectra of the six unit moment tensor components
+	are also kept for the last few (location, depth, t0)s, so that focal-only steps reduce to a
+	weighted sum of them: no synthesis and no transforms. */
+class WaveformEngine {
+public:
+	typedef std::array<SacRec, 3> SacRec3;
+	typedef std::complex<float> Cplx;
+
+	// a windowed synthetic in the spectral domain
+	struct Spec {
+		float b, delta, azi;		// window begin time, sampling interval, and station azimuth
+		int ns = 0;					// FFT size (as chosen by SacRec::ToAmPh)
+		std::vector<Cplx> spec;	// [ns/2+1] spectrum * delta (FFTW_BACKWARD, as SacRec::ToAmPh)
+		std::vector<Cplx> asig;	// [window npts] analytic signal: |asig| = envelope from SacRec::FromAmPh
+	};
+	// misfits of a station (as in EQKAnalyzer::WaveformMisfit)
+	struct Misfit { float azi, grT, rms_ph, rms_am, AmpTheory, tpeak; };
+
+	/* nloc = # of (location, depth, t0)s to keep unit-tensor spectra for (0: batched transforms only).
+		f1-f4 and rotate are passed to SynGenerator::ComputeSyn */
+	WaveformEngine( const int nloc, const float f1, const float f2, const float f3, const float f4, const bool rotate )
+		: nloc(nloc), f1(f1), f2(f2), f3(f3), f4(f4), rotate(rotate) {}
+	WaveformEngine( const WaveformEngine& ) = delete;
+	WaveformEngine& operator=( const WaveformEngine& ) = delete;
+	~WaveformEngine();
+
+	/* spectra of the windowed synthetics of all stations for the event set in synG: a weighted sum
+		of the unit-tensor spectra if kept for the current (location, depth, t0), synthesis and batched
+		FFTs otherwise. Unit-tensor spectra are built when a (location, depth, t0) is visited the second time.
+		Stations are synthesized on the # of threads pinner decides (in place if nullptr).
+		The full-size synthetics (SynGenerator::FullSize) go to psynV if given, unless summed from unit-tensor spectra (left empty) */
+	void Spectra( SynGenerator& synG, const std::vector<SacRec3>& sac3V, std::vector<Spec>& specV,
+					  InnerThreads* pinner = nullptr, std::vector<SacRec>* psynV = nullptr );
+	// spectra of the given synthetics (as from SynGenerator::ComputeSyn) of all stations, windowed in place
+	void Spectra( const std::vector<SacRec3>& sac3V, std::vector<SacRec>& sacSV, std::vector<Spec>& specV );
+
+	// amplitude, phase, and envelope-peak misfits of a station
+	Misfit StaMisfit( const SacRec3& sac3, const Spec& spec ) const;
+
+	// spectra of windowed real traces, transformed in batches of the same FFT size
+	void Transform( const std::vector<const SacRec*>& sacV, std::vector<Spec>& specV );
+
+	void clear() { std::lock_guard<std::mutex> lock(mtx); entryL.clear(); }
+
+private:
+	int nloc;
+	float f1, f2, f3, f4;
+	bool rotate;
+
+	// unit-tensor spectra ([nsta][6]) by wave type and event (lon, lat, dep, t0), most recently used first
+	struct Entry {
+		char type;
+		float elon, elat, dep, t0;
+		int nvisit;
+		std::shared_ptr<const std::vector<Spec>> pbasisV;
+		bool Matches( const char type2, const ModelInfo& mi ) const {
+			return type==type2 && elon==mi.lon && elat==mi.lat && dep==mi.dep && t0==mi.t0;
+		}
+	};
+	std::list<Entry> entryL;
+	std::mutex mtx;
+
+	// FFTW plans (r2c forward, c2c analytic signal) by (ns, howmany)
+	std::map<std::pair<int,int>, std::array<fftw_plan_s*,2>> planM;
+
+	std::shared_ptr<const std::vector<Spec>> Find( const char type, const ModelInfo& mi, int& nvisit );
+	void Insert( const char type, const ModelInfo& mi, std::shared_ptr<const std::vector<Spec>> pbasisV );
+	std::array<fftw_plan_s*,2> Plans( const int ns, const int howmany );
+
+	// run func(i) for the n syntheses, timed and on the # of threads pinner decides
+	template <class Func>
+	void Synthesize( SynGenerator& synG, const int n, InnerThreads* pinner, const Func& func ) const;
+
+	/* synthetic of station ista (record sacM) (m<0) or of its m-th unit tensor component, resampled and cut to the data window.
+		The full-size synthetic goes to psacF if given (m<0 only) */
+	void Windowed( SynGenerator& synG, const SacRec& sacM, const int ista, const int m, SacRec& sacS, SacRec* psacF = nullptr ) const;
+	// resample and cut a synthetic to the window of record sacM
+	static void Window( const SacRec& sacM, SacRec& sacS ) {
+		sacS.Resample();	// shift to regular sampling grids
+		sacS.cut( sacM.shd.user2, sacM.shd.user3 );
+	}
+
+	// FFT size SacRec::ToAmPh uses for n points
+	static int FFTSize( const int n ) {
+		int ns = (int)(log((double)n)/log(2.))+1;
+		return (int)pow(2,ns);
+	}
+	inline static int nint( float in ) { return static_cast<int>(floor(in+0.5)); }
+};
+
+#endif
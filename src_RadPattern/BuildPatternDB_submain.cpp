@@ -0,0 +1,67 @@
+#include "PatternDB.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+int main( int argc, char* argv[] ) {
+   if( argc<10 || argc>13 ) {
+      std::cerr<<"Usage: "<<argv[0]<<" [R/L/B] [eigen_file_R (.R)] [eigen_file_L (.L)] [per-sigmas_R] [per-sigmas_L]"
+					<<" [dep_min] [dep_max] [ddep] [out_db] [grid (reg/fib, optional)] [dang (optional, default=10)] [ndim (optional, default=24)]"<<std::endl;
+      exit(-1);
+   }
+
+   // read in type 
+   char type = argv[1][0];
+	if( type!='R' && type!='L' && type!='B' ) {
+      std::cerr<<"Unknown type: "<<type<<std::endl;
+      exit(0);
+   }
+
+   // read in the per-sigmas lists
+	// per sigmaG(sec) sigmaP(sec) sigmaA(fraction 0-1)
+	auto loadfSigmas = []( const std::string &fsigmas, MA3 &sigmasM ) {
+	   std::ifstream fin(fsigmas);
+		if( ! fin ) {
+	      std::cerr<<"Error(main): Cannot read from file "<<fsigmas<<std::endl;
+		   exit(0);
+	   }
+	   for(std::string line; std::getline(fin, line); ) {
+		   float per, sG, sP, sA;
+			if( sscanf(line.c_str(), "%f %f %f %f", &per, &sG, &sP, &sA) != 4 ) continue;
+	      sigmasM[per] = {sG, sP, sA};
+		}
+	   fin.close();
+		std::cout<<"### "<<sigmasM.size()<<" periods read in from "<<fsigmas<<" ###"<<std::endl;
+	};
+	MA3 sigmasMR, sigmasML;
+	if( type != 'L' ) loadfSigmas( argv[4], sigmasMR );
+	if( type != 'R' ) loadfSigmas( argv[5], sigmasML );
+
+	PatternDB::BuildParam bp;
+	bp.dep0 = atof(argv[6]); bp.dep1 = atof(argv[7]); bp.ddep = atof(argv[8]);
+	if( argc > 10 ) {
+		std::string grid(argv[10]);
+		if( grid!="reg" && grid!="fib" ) {
+			std::cerr<<"Unknown grid: "<<grid<<std::endl;
+			exit(0);
+		}
+		bp.fibonacci = grid=="fib";
+	}
+	if( argc > 11 ) bp.dang = atof(argv[11]);
+	if( argc > 12 ) bp.ndim = atoi(argv[12]);
+
+	auto tbeg = std::chrono::steady_clock::now();
+	PatternDB pdb;
+	pdb.Build( type, argv[2], argv[3], sigmasMR, sigmasML, bp );
+	pdb.Save( argv[9] );
+	std::cout<<"### database built in "<<std::chrono::duration<float>(std::chrono::steady_clock::now()-tbeg).count()<<" sec. ###"<<std::endl;
+
+   return 0;
+}
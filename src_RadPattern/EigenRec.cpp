@@ -0,0 +1,356 @@
+#include "EigenRec.h"
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef FuncName
+#define FuncName __FUNCTION__
+#endif
+
+/* ---------- cache settings and the (process-wide) table registry ---------- */
+namespace {
+	float cfg_ddep = 0.1, cfg_depmax = 100.;
+	bool cfg_sidecar = false;
+	// guards the registry only: loaded tables are read without locking
+	std::mutex mtx_cache;
+	std::map< std::string, std::shared_ptr<const EigenTable> > cache;
+
+	const char EigBinMagic[8] = "EQKEIGB";
+	const uint32_t EigBinVersion = 1;
+
+	/* line reader on an in-memory file */
+	class LineReader {
+	public:
+		LineReader( const std::string& buff ) : buff(buff) {}
+		bool next( std::string& line ) {
+			if( pos >= buff.size() ) return false;
+			size_t pe = buff.find('\n', pos);
+			if( pe == std::string::npos ) pe = buff.size();
+			line.assign( buff, pos, pe-pos );
+			pos = pe + 1; iline++;
+			return true;
+		}
+		int lineNum() const { return iline; }
+	private:
+		const std::string& buff;
+		size_t pos = 0;
+		int iline = 0;
+	};
+
+	inline bool isAtLine( const std::string& line ) { return line.find("@@@") != std::string::npos; }
+	inline bool isDollarLine( const std::string& line ) { return line.find("$$$") != std::string::npos; }
+
+	// search for the "Rayl"/"Love" keyword within the first 40 characters (as in surfread.f)
+	// and read the mode# at +15/+11 characters
+	bool isStartLine( const std::string& line, char& type, int& imod ) {
+		size_t jmax = std::min( line.size(), (size_t)40 );
+		for( size_t j=0; j<jmax; j++ ) {
+			size_t off;
+			if( line.compare(j, 4, "Rayl") == 0 ) { type = 'R'; off = j+15; }
+			else if( line.compare(j, 4, "Love") == 0 ) { type = 'L'; off = j+11; }
+			else continue;
+			if( off >= line.size() ) return false;
+			imod = atoi( line.c_str()+off );
+			return true;
+		}
+		return false;
+	}
+
+	// read up to nmax floats from a line, returns #floats read
+	int readFloats( const std::string& line, float* vals, const int nmax ) {
+		const char* p = line.c_str();
+		int n = 0;
+		for( ; n<nmax; n++ ) {
+			char* pe;
+			vals[n] = strtof( p, &pe );
+			if( pe == p ) break;
+			p = pe;
+		}
+		return n;
+	}
+
+	bool isNewer( const std::string& f1, const std::string& f2 ) {
+		struct stat st1, st2;
+		if( stat(f1.c_str(), &st1) != 0 || stat(f2.c_str(), &st2) != 0 ) return false;
+		return st1.st_mtime >= st2.st_mtime;
+	}
+}
+
+
+/* ---------- EigenTable ---------- */
+void EigenTable::LoadText( const std::string& fnamein, const int imodin ) {
+	fname = fnamein; imod = imodin;
+	// read the whole file into memory
+	std::ifstream fin( fname );
+	if( ! fin )
+		throw ErrorER::BadFile(FuncName, fname);
+	std::stringstream ss; ss << fin.rdbuf();
+	const std::string buff = ss.str();
+	LineReader lr( buff );
+
+	// find the "Rayleigh/Love ... mode#" line to start with
+	std::string line;
+	bool found = false;
+	while( lr.next(line) ) {
+		int imodcur;
+		if( isStartLine(line, type, imodcur) && imodcur==imod ) {
+			found = true; break;
+		}
+	}
+	if( ! found )
+		throw ErrorER::Format(FuncName, "starting line for mod#="+std::to_string(imod)+" not found in "+fname);
+
+	// period loop
+	const int nexpect = type=='R' ? 7 : 6;
+	for( int icomp=0; icomp<2; icomp++ ) {
+		ioff[icomp].assign(1, 0);
+		dep[icomp].clear(); eig[icomp].clear(); deig[icomp].clear();
+	}
+	bool sepRead = false;
+	auto formatError = [&]( const std::string& info ) {
+		return ErrorER::Format(FuncName, info+" at line "+std::to_string(lr.lineNum())+" of "+fname);
+	};
+	while( true ) {
+		// @@@ line (already consumed by the last Love block)
+		if( ! sepRead ) {
+			if( ! lr.next(line) || ! isAtLine(line) ) break;
+		}
+		sepRead = false;
+		// per, c, u, wvn, amp, (ratio), Q
+		float vals[7];
+		if( ! lr.next(line) || readFloats(line, vals, nexpect) < nexpect ) break;	// end of the section
+		per.push_back(vals[0]); phv.push_back(vals[1]); grv.push_back(vals[2]);
+		wvn.push_back(vals[3]); amp.push_back(vals[4]);
+		ratio.push_back( type=='R' ? vals[5] : 0. );
+		Q.push_back( vals[nexpect-1] );
+		// I0
+		if( ! lr.next(line) || readFloats(line, vals, 1) < 1 )
+			throw formatError("missing I0");
+		I0.push_back(vals[0]);
+		// horizontal (Rayleigh) or Love component
+		int nd = 0; bool dollar = false;
+		while( lr.next(line) ) {
+			if( isDollarLine(line) ) { dollar = true; break; }
+			if( isAtLine(line) ) { sepRead = true; break; }
+			if( readFloats(line, vals, 3) < 3 ) break;
+			dep[0].push_back(vals[0]); eig[0].push_back(vals[1]); deig[0].push_back(vals[2]);
+			nd++;
+		}
+		ioff[0].push_back( dep[0].size() );
+		if( nd == 0 )
+			throw formatError("empty eigen function");
+		if( type == 'L' ) continue;
+		// vertical component (Rayleigh): same number of depths
+		if( ! dollar )
+			throw formatError("missing $$$ line");
+		for( int id=0; id<nd; id++ ) {
+			if( ! lr.next(line) || readFloats(line, vals, 3) < 3 )
+				throw formatError("incomplete vertical eigen function");
+			dep[1].push_back(vals[0]); eig[1].push_back(vals[1]); deig[1].push_back(vals[2]);
+		}
+		ioff[1].push_back( dep[1].size() );
+	}
+
+	// check periods
+	if( per.empty() )
+		throw ErrorER::Format(FuncName, "no period found for mod#="+std::to_string(imod)+" in "+fname);
+	for( int iper=1; iper<nper(); iper++ )
+		if( per[iper] <= per[iper-1] )
+			throw ErrorER::Format(FuncName, "periods not increasing in "+fname);
+}
+
+// exact (linear) interpolation of the raw profile: depths are preceded by a virtual (0, 0, 0)
+// sample, and depths outside of the profile get 0. (left unset in surfread.f)
+void EigenTable::AtDepRaw( const int icomp, const int iper, const float d, float& e, float& de ) const {
+	e = de = 0.;
+	const float *pdep = dep[icomp].data();
+	int ib = ioff[icomp][iper], ie = ioff[icomp][iper+1];
+	if( d < 0. ) return;
+	int j = std::upper_bound( pdep+ib, pdep+ie, d ) - pdep;
+	if( j == ie ) return;
+	float depold = 0., eold = 0., deold = 0.;
+	if( j > ib ) { depold = pdep[j-1]; eold = eig[icomp][j-1]; deold = deig[icomp][j-1]; }
+	float dfactor = (d-depold) / (pdep[j]-depold);
+	e = eold + (eig[icomp][j]-eold)*dfactor;
+	de = deold + (deig[icomp][j]-deold)*dfactor;
+}
+
+void EigenTable::BuildGrid( const float ddepin, const float depmax ) {
+	ddep = ddepin; depmaxReq = depmax;
+	ndep = 0; gridV.clear();
+	if( ddep <= 0. ) return;
+	// keep the grid within the shallowest profile bottom
+	float dmax = depmax;
+	for( int icomp=0; icomp<ncomp(); icomp++ )
+		for( int iper=0; iper<nper(); iper++ )
+			dmax = std::min( dmax, dep[icomp][ioff[icomp][iper+1]-1] );
+	ndep = (int)ceil(dmax/ddep - 1.e-4);	// the last node stays above the profile bottom
+	if( ndep < 2 ) { ndep = 0; return; }
+	const int np = nper();
+	gridV.assign( (size_t)ndep*np*4, 0. );
+	for( int idep=0; idep<ndep; idep++ ) {
+		float d = idep * ddep;
+		float *row = &(gridV[(size_t)idep*np*4]);
+		for( int iper=0; iper<np; iper++ ) {
+			float *v = row + iper*4;
+			AtDepRaw( 0, iper, d, v[0], v[1] );
+			if( type == 'R' ) AtDepRaw( 1, iper, d, v[2], v[3] );
+		}
+	}
+}
+
+void EigenTable::AtDep( const float d, float* eigH, float* deigH, float* eigV, float* deigV ) const {
+	const int np = nper();
+	const bool isR = type=='R' && eigV!=nullptr && deigV!=nullptr;
+	float t = ndep>=2 ? d/ddep : -1.;
+	if( t<0. || t>ndep-1 ) {
+		// outside of the grid: interpolate from the raw profiles
+		for( int iper=0; iper<np; iper++ ) {
+			AtDepRaw( 0, iper, d, eigH[iper], deigH[iper] );
+			if( isR ) AtDepRaw( 1, iper, d, eigV[iper], deigV[iper] );
+		}
+		return;
+	}
+	int idep = std::min( (int)t, ndep-2 );
+	float w = t - idep;
+	const float *r0 = &(gridV[(size_t)idep*np*4]), *r1 = r0 + np*4;
+	for( int iper=0; iper<np; iper++ ) {
+		const float *v0 = r0 + iper*4, *v1 = r1 + iper*4;
+		eigH[iper] = v0[0] + (v1[0]-v0[0])*w;
+		deigH[iper] = v0[1] + (v1[1]-v0[1])*w;
+		if( ! isR ) continue;
+		eigV[iper] = v0[2] + (v1[2]-v0[2])*w;
+		deigV[iper] = v0[3] + (v1[3]-v0[3])*w;
+	}
+}
+
+/* binary sidecar: [magic][version, type, imod, ndep][ddep, depmax][vectors as (uint64 size, data)] */
+void EigenTable::SaveBinary( const std::string& fbin ) const {
+	// write to a temporary file and rename: concurrent jobs never see a partial sidecar
+	std::string ftmp = fbin + ".tmp" + std::to_string(getpid());
+	std::ofstream fout( ftmp, std::ios::binary );
+	if( ! fout ) {
+		std::cerr<<"Warning(EigenTable::SaveBinary): cannot write to "<<ftmp<<std::endl;
+		return;
+	}
+	auto writeV = [&]( const auto& V ) {
+		uint64_t n = V.size();
+		fout.write( reinterpret_cast<const char*>(&n), sizeof(n) );
+		fout.write( reinterpret_cast<const char*>(V.data()), n*sizeof(V[0]) );
+	};
+	int32_t hd[4] = { (int32_t)EigBinVersion, type, imod, ndep };
+	float hdf[2] = { ddep, depmaxReq };
+	fout.write( EigBinMagic, 8 );
+	fout.write( reinterpret_cast<const char*>(hd), sizeof(hd) );
+	fout.write( reinterpret_cast<const char*>(hdf), sizeof(hdf) );
+	for( const auto* pV : { &per, &phv, &grv, &wvn, &amp, &ratio, &Q, &I0 } ) writeV(*pV);
+	for( int icomp=0; icomp<2; icomp++ ) {
+		writeV(ioff[icomp]); writeV(dep[icomp]); writeV(eig[icomp]); writeV(deig[icomp]);
+	}
+	writeV(gridV);
+	fout.close();
+	if( ! fout || rename(ftmp.c_str(), fbin.c_str()) != 0 ) {
+		std::cerr<<"Warning(EigenTable::SaveBinary): failed to write "<<fbin<<std::endl;
+		unlink( ftmp.c_str() );
+	}
+}
+
+bool EigenTable::LoadBinary( const std::string& fbin, const int imodin, const float ddepin, const float depmax ) {
+	std::ifstream fin( fbin, std::ios::binary );
+	if( ! fin ) return false;
+	char magic[8];
+	int32_t hd[4]; float hdf[2];
+	if( !fin.read(magic, 8) || memcmp(magic, EigBinMagic, 8)!=0 ) return false;
+	if( !fin.read(reinterpret_cast<char*>(hd), sizeof(hd)) || !fin.read(reinterpret_cast<char*>(hdf), sizeof(hdf)) ) return false;
+	// the sidecar is only used when written by the same version with the same grid settings
+	if( hd[0]!=(int32_t)EigBinVersion || hd[2]!=imodin || hdf[0]!=ddepin || hdf[1]!=depmax ) return false;
+	type = hd[1]; imod = hd[2]; ndep = hd[3];
+	ddep = hdf[0]; depmaxReq = hdf[1];
+	bool succ = true;
+	auto readV = [&]( auto& V ) {
+		uint64_t n;
+		if( !succ || !fin.read(reinterpret_cast<char*>(&n), sizeof(n)) ) { succ = false; return; }
+		V.resize(n);
+		succ = (bool)fin.read( reinterpret_cast<char*>(V.data()), n*sizeof(V[0]) );
+	};
+	for( auto* pV : { &per, &phv, &grv, &wvn, &amp, &ratio, &Q, &I0 } ) readV(*pV);
+	for( int icomp=0; icomp<2; icomp++ ) {
+		readV(ioff[icomp]); readV(dep[icomp]); readV(eig[icomp]); readV(deig[icomp]);
+	}
+	readV(gridV);
+	// consistency
+	const size_t np = per.size();
+	succ = succ && np>0 && (type=='R'||type=='L') && gridV.size()==(size_t)ndep*np*4;
+	for( int icomp=0; succ && icomp<ncomp(); icomp++ )
+		succ = ioff[icomp].size()==np+1 && (size_t)ioff[icomp].back()==dep[icomp].size() &&
+				 eig[icomp].size()==dep[icomp].size() && deig[icomp].size()==dep[icomp].size();
+	return succ;
+}
+
+
+/* ---------- EigenRec ---------- */
+void EigenRec::SetDepthGrid( const float ddep, const float depmax ) {
+	if( depmax <= 0. )
+		throw ErrorER::BadParam(FuncName, "depmax = "+std::to_string(depmax));
+	cfg_ddep = ddep; cfg_depmax = depmax;
+}
+
+void EigenRec::UseSidecar( const bool use ) { cfg_sidecar = use; }
+
+std::shared_ptr<const EigenTable> EigenRec::Load( const std::string& fname, const int imod, const bool useCache ) {
+	std::ostringstream ss; ss<<fname<<"#"<<imod<<"#"<<cfg_ddep<<"#"<<cfg_depmax;
+	const std::string key = ss.str();
+	std::unique_lock<std::mutex> lock( mtx_cache, std::defer_lock );
+	if( useCache ) {
+		lock.lock();
+		auto it = cache.find(key);
+		if( it != cache.end() ) return it->second;
+	}
+
+	auto pet = std::make_shared<EigenTable>();
+	const std::string fbin = fname + "." + std::to_string(imod) + ".eigbin";
+	bool frombin = cfg_sidecar && isNewer(fbin, fname) && pet->LoadBinary(fbin, imod, cfg_ddep, cfg_depmax);
+	if( frombin ) {
+		pet->fname = fname;
+	} else {
+		pet->LoadText( fname, imod );
+		pet->BuildGrid( cfg_ddep, cfg_depmax );
+		if( cfg_sidecar ) pet->SaveBinary( fbin );
+	}
+	std::cout<<"### EigenRec::Load: "<<pet->nper()<<" periods of "<<(pet->type=='R'?"Rayleigh":"Love")<<" mode "<<imod
+				<<" loaded from "<<(frombin?fbin:fname)<<" ("<<pet->ndep<<" grid depths). ###"<<std::endl;
+
+	if( useCache ) cache[key] = pet;
+	return pet;
+}
+
+void EigenRec::reLoad( const std::string& fname, const int imod, const bool useCache ) {
+	pet = Load( fname, imod, useCache );
+	sd = SourceData();
+	depSD = NaN;
+}
+
+void EigenRec::FillSD() {
+	const auto& et = Table();
+	sd.nper = et.nper();
+	sd.dper = sd.nper>1 ? et.per[1]-et.per[0] : 0.;
+	sd.per = et.per; sd.ac = et.amp; sd.wvn = et.wvn;
+	sd.eigH.assign(sd.nper, 0.); sd.deigH.assign(sd.nper, 0.);
+	sd.eigV.assign(sd.nper, 0.); sd.deigV.assign(sd.nper, 0.);
+	depSD = NaN;
+}
+
+void EigenRec::FillSDAtDep( const float dep ) {
+	const auto& et = Table();
+	if( sd.nper != et.nper() ) FillSD();
+	if( dep == depSD ) return;
+	et.AtDep( dep, sd.eigH.data(), sd.deigH.data(), sd.eigV.data(), sd.deigV.data() );
+	depSD = dep;
+}
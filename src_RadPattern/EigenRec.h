@@ -1 +0,0 @@
-/projects/yeti4009/code/MyLibs/include/EigenRec.h
\ No newline at end of file
@@ -0,0 +1,124 @@
+#ifndef EIGENREC_H
+#define EIGENREC_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+
+/* ---------- exceptions ---------- */
+namespace ErrorER {
+   class BadFile : public std::runtime_error {
+   public:
+      BadFile(const std::string funcname, const std::string info = "")
+	 : runtime_error("Error("+funcname+"): Cannot access file ("+info+").") {}
+   };
+
+   class BadParam : public std::runtime_error {
+   public:
+      BadParam(const std::string funcname, const std::string info = "")
+        : runtime_error("Error("+funcname+"): Bad parameters ("+info+").") {}
+   };
+
+   class Format : public std::runtime_error {
+   public:
+      Format(const std::string funcname, const std::string info = "")
+        : runtime_error("Error("+funcname+"): Format error ("+info+").") {}
+   };
+};
+
+
+/* Eigen file (SURFLEV output) format, for each period:
+	line0: @@@...
+	line1: per, c, u, wvn, amp(source amp norm term), (ratio, for Rayleigh), Q
+	line2: I0, ?, ?, ?
+	line3 - : dep va(eigen) vd(derivative of eigen)   (Rayleigh horizontal / Love)
+	$$$...  followed by the same number of depth lines (Rayleigh vertical only)
+	the period blocks of each wave type/mode are preceded by a "Rayleigh/Love ... mode#" line
+
+	An EigenTable is parsed once from the file, then never modified: it is shared
+	(through shared_ptr) by all EigenRec objects and threads and can be read without locking.
+*/
+struct EigenTable {
+	char type = 'N';	// 'R'(ayleigh) or 'L'(ove)
+	int imod = 1;
+	std::string fname;
+
+	// per-period quantities (periods increasing)
+	std::vector<float> per, phv, grv, wvn, amp, ratio, Q, I0;
+
+	// raw depth profiles: component icomp (0=horizontal/Love, 1=vertical) of period iper
+	// occupies [ioff[icomp][iper], ioff[icomp][iper+1]) of dep/eig/deig[icomp]
+	std::vector<int> ioff[2];
+	std::vector<float> dep[2], eig[2], deig[2];
+
+	// source-depth quantities precomputed on the fine depth grid (0, ddep, ... (ndep-1)*ddep):
+	// gridV[(idep*nper + iper)*4 + (0=eigH, 1=deigH, 2=eigV, 3=deigV)]
+	float ddep = 0., depmaxReq = 0.;	// grid spacing and the requested max depth
+	int ndep = 0;
+	std::vector<float> gridV;
+
+	int nper() const { return per.size(); }
+	int ncomp() const { return type=='R' ? 2 : 1; }
+
+	// eigH/deigH/eigV/deigV (nper each) at depth dep. eigV/deigV are ignored (and may be nullptr) for Love waves
+	void AtDep( const float dep, float* eigH, float* deigH, float* eigV, float* deigV ) const;
+
+	// parse the text file / precompute the depth grid / binary (sidecar) IO
+	void LoadText( const std::string& fname, const int imod );
+	void BuildGrid( const float ddep, const float depmax );
+	bool LoadBinary( const std::string& fbin, const int imod, const float ddep, const float depmax );
+	void SaveBinary( const std::string& fbin ) const;
+
+private:
+	// exact (linear) interpolation of the raw profile, as in surfread.f
+	void AtDepRaw( const int icomp, const int iper, const float dep, float& eig, float& deig ) const;
+};
+
+
+class EigenRec {
+public:
+	// source-depth data as required by rad_pattern_r/l
+	struct SourceData {
+		int nper = 0;
+		float dper = 0.;
+		std::vector<float> per, eigH, deigH, eigV, deigV, ac, wvn;
+	} sd;
+
+	// useCache: share the parsed table with all other EigenRecs on the same file/mode
+	EigenRec( const std::string& fname = "", const int imod = 1, const bool useCache = true ) {
+		if( ! fname.empty() ) reLoad( fname, imod, useCache );
+	}
+
+	void reLoad( const std::string& fname, const int imod = 1, const bool useCache = true );
+
+	// fill the depth-independent part of sd
+	void FillSD();
+	// fill eigen functions at depth dep
+	void FillSDAtDep( const float dep );
+
+	// give this EigenRec a table of its own (allocated by the calling thread), out of the cache
+	void Detach() { if( pet ) pet = std::make_shared<const EigenTable>( *pet ); }
+
+	const EigenTable& Table() const {
+		if( ! pet ) throw ErrorER::BadParam(__FUNCTION__, "no eigen file loaded");
+		return *pet;
+	}
+
+	/* cache settings (to be set before loading) */
+	// spacing (km) and extent of the precomputed depth grid. ddep<=0 disables the grid
+	static void SetDepthGrid( const float ddep, const float depmax = 100. );
+	// read/write the binary sidecar file (fname + ".eigbin")
+	static void UseSidecar( const bool use );
+
+	static constexpr float NaN = -12345.;
+
+private:
+	std::shared_ptr<const EigenTable> pet;
+	float depSD = NaN;
+
+	static std::shared_ptr<const EigenTable> Load( const std::string& fname, const int imod, const bool useCache );
+};
+
+#endif
@@ -0,0 +1,434 @@
+#include "PatternDB.h"
+#include "MyOMP.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <algorithm>
+#include <unistd.h>
+
+static constexpr char PDBMagic[8] = {'E','Q','K','P','D','B','\0','\0'};
+static constexpr int32_t PDBVersion = 1;
+static constexpr int LeafSize = 16;
+
+
+/* ---------- patterns and features ---------- */
+void PatternDB::InitPatterns() {
+	if( useR() ) rpR0.SetModel( 'R', feigR );
+	if( useL() ) rpL0.SetModel( 'L', feigL );
+	perlstR.clear(); if( useR() ) for( const auto& paPair : sigmasMR ) perlstR.push_back(paPair.first);
+	perlstL.clear(); if( useL() ) for( const auto& paPair : sigmasML ) perlstL.push_back(paPair.first);
+	if( perlstR.empty() && perlstL.empty() )
+		throw ErrorPD::BadParam(FuncName, "no period to be used");
+	const int naziF = (int)std::round(360./daziF);
+	nfeat = (perlstR.size()+perlstL.size()) * naziF * 4;
+}
+
+void PatternDB::Predict( const Mech& mc, RadPattern& rpR, RadPattern& rpL ) const {
+	if( useR() ) rpR.Predict( mc.stk, mc.dip, mc.rak, mc.dep, 1., perlstR );
+	if( useL() ) rpL.Predict( mc.stk, mc.dip, mc.rak, mc.dep, 1., perlstL );
+}
+
+// [type][period][azimuth]{ grt/sG, (cos, sin)*per/(2pi*sP), (lnA-mean)/sA }. invalidated azimuths are left 0
+void PatternDB::Features( const RadPattern& rpR, const RadPattern& rpL, float* featA ) const {
+	const int naziF = (int)std::round(360./daziF);
+	std::fill( featA, featA+nfeat, 0. );
+	// weighted mean of log amplitudes (as removed by NormAmps)
+	double lsum = 0., wsum = 0.;
+	auto sumAmps = [&]( const RadPattern& rp, const std::vector<float>& perlst, const MA3& sigmasM ) {
+		for( const auto per : perlst ) {
+			float sA = -log(1.-sigmasM.at(per)[2]), w = 1./(sA*sA);
+			for( int iazi=0; iazi<naziF; iazi++ ) {
+				float grt, pht, amp;
+				if( ! rp.GetPred(per, iazi*daziF, grt, pht, amp) ) continue;
+				lsum += w * log(amp); wsum += w;
+			}
+		}
+	};
+	if( useR() ) sumAmps( rpR, perlstR, sigmasMR );
+	if( useL() ) sumAmps( rpL, perlstL, sigmasML );
+	const float lmean = wsum>0. ? lsum/wsum : 0.;
+	// fill features
+	float *fA = featA;
+	auto fillFeats = [&]( const RadPattern& rp, const std::vector<float>& perlst, const MA3& sigmasM ) {
+		for( const auto per : perlst ) {
+			const auto& sigmas = sigmasM.at(per);
+			float sA = -log(1.-sigmas[2]), pmul = per / (2.*M_PI*sigmas[1]);
+			for( int iazi=0; iazi<naziF; iazi++, fA+=4 ) {
+				float grt, pht, amp;
+				if( ! rp.GetPred(per, iazi*daziF, grt, pht, amp) ) continue;
+				float theta = 2.*M_PI*pht/per;
+				fA[0] = grt / sigmas[0];
+				fA[1] = cos(theta) * pmul; fA[2] = sin(theta) * pmul;
+				fA[3] = (log(amp)-lmean) / sA;
+			}
+		}
+	};
+	if( useR() ) fillFeats( rpR, perlstR, sigmasMR );
+	if( useL() ) fillFeats( rpL, perlstL, sigmasML );
+}
+
+PatternDB::Match PatternDB::Misfit( RadPattern& rp1R, RadPattern& rp1L, const RadPattern& rp2R, const RadPattern& rp2L, const Mech& mc ) const {
+	auto chiSA = !useL() ? rp1R.chiSquare(rp2R, sigmasMR) :
+					 !useR() ? rp1L.chiSquare(rp2L, sigmasML) :
+					 chiSquare( rp1R, rp1L, rp2R, rp2L, sigmasMR, sigmasML );
+	return Match{ mc, chiSA[0]+chiSA[1]+chiSA[2], (int)chiSA[3]*3 };
+}
+
+PatternDB::Match PatternDB::Misfit( const Mech& ref, const Mech& mc ) const {
+	RadPattern rp1R = rpR0, rp1L = rpL0, rp2R = rpR0, rp2L = rpL0;
+	Predict( ref, rp2R, rp2L ); Predict( mc, rp1R, rp1L );
+	return Misfit( rp1R, rp1L, rp2R, rp2L, mc );
+}
+
+
+/* ---------- build ---------- */
+std::vector<PatternDB::Mech> PatternDB::SampleMechs( const BuildParam& bp ) const {
+	if( bp.dang<=0. || bp.ddep<=0. || bp.dep1<bp.dep0 )
+		throw ErrorPD::BadParam(FuncName, "dang/ddep/dep range");
+	// (stk, dip) pairs
+	std::vector<std::array<float,2>> sdV;
+	if( bp.fibonacci ) {
+		// Fibonacci lattice of (downward) fault normals over the hemisphere: equal-area cells of about dang^2
+		const float dangr = bp.dang*M_PI/180.;
+		const int nnorm = std::max(1, (int)std::round(2.*M_PI/(dangr*dangr)));
+		const float golden = 180.*(3.-sqrt(5.));
+		for( int i=0; i<nnorm; i++ ) {
+			float z = 1. - (i+0.5)/nnorm;
+			sdV.push_back( { (float)fmod(i*golden, 360.), (float)(acos(z)*180./M_PI) } );
+		}
+	} else {
+		for( float stk=0.; stk<360.-1.e-3; stk+=bp.dang )
+			for( float dip=0.5*bp.dang; dip<90.+1.e-3; dip+=bp.dang )
+				sdV.push_back( {stk, dip} );
+	}
+	std::vector<Mech> mechs;
+	for( float dep=bp.dep0; dep<bp.dep1+1.e-3; dep+=bp.ddep )
+		for( const auto& sd : sdV )
+			for( float rak=-180.; rak<180.-1.e-3; rak+=bp.dang )
+				mechs.push_back( Mech{sd[0], sd[1], rak, dep} );
+	return mechs;
+}
+
+// mean and leading principal axes of nsamp feature vectors (subspace iteration on the covariance)
+void PatternDB::ComputePCA( const std::vector<float>& featV, const int nsamp ) {
+	const int nf = nfeat, k = _ndim;
+	meanV.assign(nf, 0.);
+	for( int is=0; is<nsamp; is++ )
+		for( int i=0; i<nf; i++ ) meanV[i] += featV[(size_t)is*nf+i];
+	for( auto& val : meanV ) val /= nsamp;
+	// centered and transposed: XT[nf][nsamp]
+	std::vector<float> XT( (size_t)nf*nsamp );
+	for( int is=0; is<nsamp; is++ )
+		for( int i=0; i<nf; i++ ) XT[(size_t)i*nsamp+is] = featV[(size_t)is*nf+i] - meanV[i];
+	// covariance
+	std::vector<double> C( (size_t)nf*nf );
+	#pragma omp parallel for schedule(dynamic, 4)
+	for( int i=0; i<nf; i++ ) {
+		const float *xi = &(XT[(size_t)i*nsamp]);
+		for( int j=i; j<nf; j++ ) {
+			const float *xj = &(XT[(size_t)j*nsamp]);
+			double sum = 0.;
+			#pragma omp simd reduction(+:sum)
+			for( int is=0; is<nsamp; is++ ) sum += xi[is]*xj[is];
+			C[(size_t)i*nf+j] = C[(size_t)j*nf+i] = sum / nsamp;
+		}
+	}
+	// subspace iteration from a fixed random start
+	std::mt19937 gen(12345); std::normal_distribution<double> dist;
+	std::vector<double> Q( (size_t)k*nf ), Z( (size_t)k*nf );
+	for( auto& val : Q ) val = dist(gen);
+	auto orthonormalize = [&]( std::vector<double>& V ) {
+		for( int j=0; j<k; j++ ) {
+			double *vj = &(V[(size_t)j*nf]);
+			for( int l=0; l<j; l++ ) {
+				const double *vl = &(V[(size_t)l*nf]);
+				double dot = 0.; for( int i=0; i<nf; i++ ) dot += vj[i]*vl[i];
+				for( int i=0; i<nf; i++ ) vj[i] -= dot*vl[i];
+			}
+			double norm = 0.; for( int i=0; i<nf; i++ ) norm += vj[i]*vj[i];
+			norm = norm>0. ? 1./sqrt(norm) : 0.;
+			for( int i=0; i<nf; i++ ) vj[i] *= norm;
+		}
+	};
+	orthonormalize(Q);
+	for( int iter=0; iter<60; iter++ ) {
+		#pragma omp parallel for schedule(static)
+		for( int i=0; i<nf; i++ ) {
+			const double *Ci = &(C[(size_t)i*nf]);
+			for( int j=0; j<k; j++ ) {
+				const double *qj = &(Q[(size_t)j*nf]);
+				double sum = 0.;
+				#pragma omp simd reduction(+:sum)
+				for( int l=0; l<nf; l++ ) sum += Ci[l]*qj[l];
+				Z[(size_t)j*nf+i] = sum;
+			}
+		}
+		orthonormalize(Z); Q.swap(Z);
+	}
+	// explained variance
+	double trace = 0., varexp = 0.;
+	for( int i=0; i<nf; i++ ) trace += C[(size_t)i*nf+i];
+	for( int j=0; j<k; j++ ) {
+		const double *qj = &(Q[(size_t)j*nf]);
+		for( int i=0; i<nf; i++ ) {
+			double sum = 0.; const double *Ci = &(C[(size_t)i*nf]);
+			for( int l=0; l<nf; l++ ) sum += Ci[l]*qj[l];
+			varexp += qj[i]*sum;
+		}
+	}
+	basisV.assign( Q.begin(), Q.end() );
+	std::cout<<"### PatternDB::ComputePCA: "<<nf<<" features compressed to "<<k<<" ("
+				<<(trace>0.?varexp/trace*100.:100.)<<"% of the variance of "<<nsamp<<" samples). ###"<<std::endl;
+}
+
+void PatternDB::Build( const char typein, const std::string& feigRin, const std::string& feigLin,
+							  const MA3& sigmasMRin, const MA3& sigmasMLin, const BuildParam& bp ) {
+	if( typein!='R' && typein!='L' && typein!='B' )
+		throw ErrorPD::BadParam(FuncName, std::string("unknown type = ")+typein);
+	if( bp.daziF<=0. || bp.ndim<=0 || bp.nsampPCA<=0 )
+		throw ErrorPD::BadParam(FuncName, "daziF/ndim/nsampPCA");
+	type = typein; feigR = feigRin; feigL = feigLin;
+	sigmasMR = sigmasMRin; sigmasML = sigmasMLin;
+	daziF = bp.daziF; bpBuild = bp;
+	InitPatterns();
+	_ndim = std::min( bp.ndim, nfeat );
+
+	mechV = SampleMechs( bp );
+	const int nmech = mechV.size(), nsamp = std::min( nmech, bp.nsampPCA );
+	std::cout<<"### PatternDB::Build: "<<nmech<<" mechanisms sampled on a "<<(bp.fibonacci?"Fibonacci":"regular")
+				<<" grid ("<<bp.dang<<" deg, dep = "<<bp.dep0<<" - "<<bp.dep1<<" km). ###"<<std::endl;
+
+	// features of an evenly strided subsample -> compression basis
+	std::vector<float> featV( (size_t)nsamp*nfeat );
+	#pragma omp parallel
+	{
+	RadPattern rpR = rpR0, rpL = rpL0;
+	#pragma omp for schedule(dynamic, 64)
+	for( int is=0; is<nsamp; is++ ) {
+		Predict( mechV[(size_t)is*nmech/nsamp], rpR, rpL );
+		Features( rpR, rpL, &(featV[(size_t)is*nfeat]) );
+	}
+	}
+	ComputePCA( featV, nsamp );
+	featV.clear(); featV.shrink_to_fit();
+
+	// compressed features of all mechanisms
+	coordV.resize( (size_t)nmech*_ndim );
+	#pragma omp parallel
+	{
+	RadPattern rpR = rpR0, rpL = rpL0;
+	std::vector<float> fV(nfeat);
+	#pragma omp for schedule(dynamic, 64)
+	for( int im=0; im<nmech; im++ ) {
+		Predict( mechV[im], rpR, rpL );
+		Features( rpR, rpL, fV.data() );
+		for( int i=0; i<nfeat; i++ ) fV[i] -= meanV[i];
+		float *cA = &(coordV[(size_t)im*_ndim]);
+		for( int j=0; j<_ndim; j++ ) {
+			const float *bA = &(basisV[(size_t)j*nfeat]);
+			float sum = 0.;
+			#pragma omp simd reduction(+:sum)
+			for( int i=0; i<nfeat; i++ ) sum += bA[i]*fV[i];
+			cA[j] = sum;
+		}
+	}
+	}
+	BuildTree();
+}
+
+
+/* ---------- IO ---------- */
+void PatternDB::Save( const std::string& fname ) const {
+	std::string ftmp = fname + ".tmp" + std::to_string(getpid());
+	std::ofstream fout( ftmp, std::ios::binary );
+	if( ! fout ) throw ErrorPD::BadFile(FuncName, ftmp);
+	auto writeV = [&]( const auto& V ) {
+		uint64_t n = V.size();
+		fout.write( reinterpret_cast<const char*>(&n), sizeof(n) );
+		fout.write( reinterpret_cast<const char*>(V.data()), n*sizeof(V[0]) );
+	};
+	auto sigmasV = []( const MA3& sigmasM ) {
+		std::vector<float> V;
+		for( const auto& paPair : sigmasM ) V.insert( V.end(), {paPair.first, paPair.second[0], paPair.second[1], paPair.second[2]} );
+		return V;
+	};
+	int32_t hd[4] = { PDBVersion, type, _ndim, nfeat };
+	std::vector<float> bpV{ (float)bpBuild.fibonacci, bpBuild.dang, bpBuild.dep0, bpBuild.dep1, bpBuild.ddep,
+									bpBuild.daziF, (float)bpBuild.ndim, (float)bpBuild.nsampPCA };
+	fout.write( PDBMagic, 8 );
+	fout.write( reinterpret_cast<const char*>(hd), sizeof(hd) );
+	writeV(feigR); writeV(feigL);
+	writeV(sigmasV(sigmasMR)); writeV(sigmasV(sigmasML));
+	writeV(bpV); writeV(meanV); writeV(basisV);
+	writeV(mechV); writeV(coordV);
+	fout.close();
+	if( ! fout || rename(ftmp.c_str(), fname.c_str()) != 0 ) {
+		unlink( ftmp.c_str() );
+		throw ErrorPD::BadFile(FuncName, fname);
+	}
+	std::cout<<"### PatternDB::Save: "<<mechV.size()<<" mechanisms ("<<_ndim<<" dims) saved to "<<fname<<". ###"<<std::endl;
+}
+
+void PatternDB::Load( const std::string& fname, const std::string& feigRin, const std::string& feigLin ) {
+	std::ifstream fin( fname, std::ios::binary );
+	if( ! fin ) throw ErrorPD::BadFile(FuncName, fname);
+	char magic[8]; int32_t hd[4];
+	if( !fin.read(magic, 8) || memcmp(magic, PDBMagic, 8)!=0 )
+		throw ErrorPD::Format(FuncName, "not a pattern database: "+fname);
+	if( !fin.read(reinterpret_cast<char*>(hd), sizeof(hd)) || hd[0]!=PDBVersion )
+		throw ErrorPD::Format(FuncName, "unsupported version in "+fname);
+	bool succ = true;
+	auto readV = [&]( auto& V ) {
+		uint64_t n;
+		if( !succ || !fin.read(reinterpret_cast<char*>(&n), sizeof(n)) ) { succ = false; return; }
+		V.resize(n);
+		succ = (bool)fin.read( reinterpret_cast<char*>(&(V[0])), n*sizeof(V[0]) );
+	};
+	auto sigmasM = []( const std::vector<float>& V, MA3& sigmasM ) {
+		sigmasM.clear();
+		for( size_t i=0; i+3<V.size(); i+=4 ) sigmasM[V[i]] = {V[i+1], V[i+2], V[i+3]};
+	};
+	std::vector<float> sRV, sLV, bpV;
+	readV(feigR); readV(feigL); readV(sRV); readV(sLV);
+	readV(bpV); readV(meanV); readV(basisV);
+	readV(mechV); readV(coordV);
+	type = hd[1]; _ndim = hd[2]; nfeat = hd[3];
+	succ = succ && bpV.size()==8 && (type=='R'||type=='L'||type=='B') && meanV.size()==(size_t)nfeat &&
+			 basisV.size()==(size_t)_ndim*nfeat && coordV.size()==mechV.size()*_ndim;
+	if( ! succ ) throw ErrorPD::Format(FuncName, "corrupted "+fname);
+	bpBuild.fibonacci = bpV[0]!=0.; bpBuild.dang = bpV[1]; bpBuild.dep0 = bpV[2]; bpBuild.dep1 = bpV[3];
+	bpBuild.ddep = bpV[4]; bpBuild.daziF = bpV[5]; bpBuild.ndim = bpV[6]; bpBuild.nsampPCA = bpV[7];
+	daziF = bpBuild.daziF;
+	sigmasM(sRV, sigmasMR); sigmasM(sLV, sigmasML);
+	if( ! feigRin.empty() ) feigR = feigRin;
+	if( ! feigLin.empty() ) feigL = feigLin;
+	int nfeatStored = nfeat;
+	InitPatterns();
+	if( nfeat != nfeatStored ) throw ErrorPD::Format(FuncName, "inconsistent feature size in "+fname);
+	BuildTree();
+	std::cout<<"### PatternDB::Load: "<<mechV.size()<<" mechanisms ("<<_ndim<<" dims) loaded from "<<fname<<". ###"<<std::endl;
+}
+
+
+/* ---------- KD-tree ---------- */
+void PatternDB::BuildTree() {
+	idxV.resize( mechV.size() );
+	for( int i=0; i<idxV.size(); i++ ) idxV[i] = i;
+	nodeV.clear(); nodeV.reserve( 2*idxV.size()/LeafSize + 1 );
+	if( ! idxV.empty() ) BuildNode( 0, idxV.size() );
+}
+
+int PatternDB::BuildNode( const int ibeg, const int iend ) {
+	int inode = nodeV.size();
+	nodeV.push_back( KDNode{ibeg, iend, -1, -1, -1, 0.} );
+	if( iend-ibeg <= LeafSize ) return inode;
+	// split along the dimension of the largest spread, at the median
+	int dim = 0; float spreadmax = -1.;
+	for( int j=0; j<_ndim; j++ ) {
+		float vmin = coordV[(size_t)idxV[ibeg]*_ndim+j], vmax = vmin;
+		for( int i=ibeg+1; i<iend; i++ ) {
+			float val = coordV[(size_t)idxV[i]*_ndim+j];
+			if( val < vmin ) vmin = val; else if( val > vmax ) vmax = val;
+		}
+		if( vmax-vmin > spreadmax ) { spreadmax = vmax-vmin; dim = j; }
+	}
+	int imid = (ibeg+iend) / 2;
+	std::nth_element( idxV.begin()+ibeg, idxV.begin()+imid, idxV.begin()+iend,
+							[&](int i1, int i2){ return coordV[(size_t)i1*_ndim+dim] < coordV[(size_t)i2*_ndim+dim]; } );
+	float split = coordV[(size_t)idxV[imid]*_ndim+dim];
+	int ileft = BuildNode( ibeg, imid ), iright = BuildNode( imid, iend );
+	auto& node = nodeV[inode];
+	node.dim = dim; node.split = split; node.left = ileft; node.right = iright;
+	return inode;
+}
+
+// heap: max-heap of (squared distance, index) holding the best k so far
+void PatternDB::SearchNode( const int inode, const float* q, const int k, std::vector<std::pair<float,int>>& heap ) const {
+	const auto& node = nodeV[inode];
+	if( node.dim < 0 ) {
+		for( int i=node.ibeg; i<node.iend; i++ ) {
+			const float *cA = &(coordV[(size_t)idxV[i]*_ndim]);
+			float d2 = 0.;
+			for( int j=0; j<_ndim; j++ ) { float d = cA[j]-q[j]; d2 += d*d; }
+			if( heap.size() < k ) {
+				heap.push_back( {d2, idxV[i]} ); std::push_heap( heap.begin(), heap.end() );
+			} else if( d2 < heap.front().first ) {
+				std::pop_heap( heap.begin(), heap.end() ); heap.back() = {d2, idxV[i]};
+				std::push_heap( heap.begin(), heap.end() );
+			}
+		}
+		return;
+	}
+	float diff = q[node.dim] - node.split;
+	SearchNode( diff<0. ? node.left : node.right, q, k, heap );
+	if( heap.size()<k || diff*diff<heap.front().first )
+		SearchNode( diff<0. ? node.right : node.left, q, k, heap );
+}
+
+void PatternDB::SearchTree( const float* q, const int k, std::vector<std::pair<float,int>>& heap ) const {
+	heap.clear(); heap.reserve(k);
+	if( ! nodeV.empty() && k>0 ) SearchNode( 0, q, k, heap );
+	std::sort_heap( heap.begin(), heap.end() );
+}
+
+
+/* ---------- queries ---------- */
+std::vector<PatternDB::Match> PatternDB::Query( const Mech& ref, const int nout, const int kcand ) const {
+	if( mechV.empty() ) throw ErrorPD::BadParam(FuncName, "empty database");
+	// compressed features of the reference
+	RadPattern rprR = rpR0, rprL = rpL0;
+	Predict( ref, rprR, rprL );
+	std::vector<float> fV(nfeat), qV(_ndim);
+	Features( rprR, rprL, fV.data() );
+	for( int j=0; j<_ndim; j++ ) {
+		const float *bA = &(basisV[(size_t)j*nfeat]);
+		float sum = 0.;
+		for( int i=0; i<nfeat; i++ ) sum += bA[i]*(fV[i]-meanV[i]);
+		qV[j] = sum;
+	}
+	// nearest neighbours
+	std::vector<std::pair<float,int>> heap;
+	SearchTree( qV.data(), std::max(nout, kcand), heap );
+	// re-rank by the exact misfit
+	std::vector<Match> matchV( heap.size() );
+	#pragma omp parallel
+	{
+	RadPattern rpR = rpR0, rpL = rpL0;
+	#pragma omp for schedule(dynamic, 4)
+	for( int i=0; i<heap.size(); i++ ) {
+		const auto& mc = mechV[heap[i].second];
+		Predict( mc, rpR, rpL );
+		matchV[i] = Misfit( rpR, rpL, rprR, rprL, mc );
+	}
+	}
+	std::sort( matchV.begin(), matchV.end(), [](const Match& m1, const Match& m2){ return m1.E < m2.E; } );
+	if( matchV.size() > nout ) matchV.resize(nout);
+	return matchV;
+}
+
+PatternDB::Match PatternDB::Refine( const Mech& ref, const Match& m, const float step0, const float stepmin ) const {
+	RadPattern rprR = rpR0, rprL = rpL0, rpR = rpR0, rpL = rpL0;
+	Predict( ref, rprR, rprL );
+	auto misfit = [&]( const Mech& mc ) { Predict( mc, rpR, rpL ); return Misfit( rpR, rpL, rprR, rprL, mc ); };
+	Match mbest = misfit( m.mech );
+	const float depmin = bpBuild.dep0, depmax = bpBuild.dep1;
+	float step = step0;
+	for( int iter=0; iter<1000 && step>=stepmin; iter++ ) {
+		bool improved = false;
+		for( int ip=0; ip<4; ip++ )
+			for( const float sign : {-1.f, 1.f} ) {
+				Mech mc = mbest.mech;
+				float* pA[4] = { &mc.stk, &mc.dip, &mc.rak, &mc.dep };
+				*(pA[ip]) += sign*step;
+				// keep the mechanism in range
+				if( mc.stk < 0. ) mc.stk += 360.; else if( mc.stk >= 360. ) mc.stk -= 360.;
+				if( mc.rak < -180. ) mc.rak += 360.; else if( mc.rak >= 180. ) mc.rak -= 360.;
+				if( mc.dip<0. || mc.dip>90. || mc.dep<depmin || mc.dep>depmax ) continue;
+				auto mt = misfit( mc );
+				if( mt.E < mbest.E ) { mbest = mt; improved = true; }
+			}
+		if( ! improved ) step *= 0.5;
+	}
+	return mbest;
+}
@@ -0,0 +1,122 @@
+#ifndef PATTERNDB_H
+#define PATTERNDB_H
+
+#include "RadPattern.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <array>
+
+
+/* ---------- exceptions ---------- */
+namespace ErrorPD {
+   class BadFile : public std::runtime_error {
+   public:
+      BadFile(const std::string funcname, const std::string info = "")
+	 : runtime_error("Error("+funcname+"): Cannot access file ("+info+").") {}
+   };
+
+   class BadParam : public std::runtime_error {
+   public:
+      BadParam(const std::string funcname, const std::string info = "")
+        : runtime_error("Error("+funcname+"): Bad parameters ("+info+").") {}
+   };
+
+   class Format : public std::runtime_error {
+   public:
+      Format(const std::string funcname, const std::string info = "")
+        : runtime_error("Error("+funcname+"): Bad pattern database format ("+info+").") {}
+   };
+};
+
+
+/* Precomputed focal-mechanism pattern database.
+	(stk, dip, rak) are sampled on a regular or Fibonacci grid at each depth, and every
+	mechanism is described by a feature vector of its Rayleigh/Love radiation patterns
+	(group time, phase time as a 2D point on the period circle, and log amplitude with the
+	mean removed, each scaled by its sigma, at every daziF degree) so that the squared
+	Euclidean distance approximates the chi-square misfit of RadPattern::chiSquare.
+	The features are compressed by PCA to ndim and searched by a KD-tree; candidates are
+	then re-ranked by the exact misfit and optionally refined locally. */
+class PatternDB {
+public:
+	struct Mech { float stk, dip, rak, dep; };
+	struct Match { Mech mech; float E; int N; };	// E = chiSG+chiSP+chiSA, N = # of data
+
+	struct BuildParam {
+		bool fibonacci = false;		// Fibonacci lattice of fault normals instead of regular (stk, dip)
+		float dang = 10.;				// angular spacing (deg) of stk, dip, and rak
+		float dep0 = 2., dep1 = 30., ddep = 2.;
+		float daziF = 10.;			// azimuth step (deg) of the features
+		int ndim = 24;					// dimension of the compressed features
+		int nsampPCA = 5000;			// # of mechanisms used to determine the PCA basis
+	};
+
+	PatternDB() {}
+	PatternDB( const std::string& fname, const std::string& feigR = "", const std::string& feigL = "" ) {
+		Load( fname, feigR, feigL );
+	}
+
+	// type = R, L, or B(oth)
+	void Build( const char type, const std::string& feigR, const std::string& feigL,
+					const MA3& sigmasMR, const MA3& sigmasML, const BuildParam& bp );
+	void Save( const std::string& fname ) const;
+	// feigR/L replace the eigen file names stored in the database when given
+	void Load( const std::string& fname, const std::string& feigR = "", const std::string& feigL = "" );
+
+	size_t size() const { return mechV.size(); }
+	int ndim() const { return _ndim; }
+	const BuildParam& Params() const { return bpBuild; }
+
+	/* kcand nearest neighbours of ref in the compressed feature space,
+		re-ranked by the exact chi-square misfit. The best nout are returned */
+	std::vector<Match> Query( const Mech& ref, const int nout = 20, const int kcand = 1000 ) const;
+
+	/* compass search on (stk, dip, rak, dep) from m, with the step shrinking from step0 to stepmin (deg/km) */
+	Match Refine( const Mech& ref, const Match& m, const float step0, const float stepmin = 0.5 ) const;
+
+	// misfit of mechanism mc to the patterns of ref
+	Match Misfit( const Mech& ref, const Mech& mc ) const;
+
+private:
+	char type = 'N';
+	std::string feigR, feigL;
+	MA3 sigmasMR, sigmasML;
+	std::vector<float> perlstR, perlstL;
+	float daziF = 10.;
+	BuildParam bpBuild;
+
+	// compression: mean[nfeat], basis[ndim][nfeat]
+	int _ndim = 0, nfeat = 0;
+	std::vector<float> meanV, basisV;
+	// the database: mechanisms and their compressed features [size][ndim]
+	std::vector<Mech> mechV;
+	std::vector<float> coordV;
+
+	// KD-tree over coordV (implicit: built by median splits of idxV)
+	struct KDNode { int ibeg, iend, dim, left, right; float split; };
+	std::vector<KDNode> nodeV;
+	std::vector<int> idxV;
+
+	// prototype patterns (share the eigen tables with their copies)
+	RadPattern rpR0, rpL0;
+
+	bool useR() const { return type=='R' || type=='B'; }
+	bool useL() const { return type=='L' || type=='B'; }
+	void InitPatterns();
+	// predict the patterns of a mechanism into rpR/rpL
+	void Predict( const Mech& mc, RadPattern& rpR, RadPattern& rpL ) const;
+	// features of predicted patterns
+	void Features( const RadPattern& rpR, const RadPattern& rpL, float* featA ) const;
+	// misfit between predicted patterns (rp1 are modified by the amplitude normalization)
+	Match Misfit( RadPattern& rp1R, RadPattern& rp1L, const RadPattern& rp2R, const RadPattern& rp2L, const Mech& mc ) const;
+
+	std::vector<Mech> SampleMechs( const BuildParam& bp ) const;
+	void ComputePCA( const std::vector<float>& featV, const int nsamp );
+	void BuildTree();
+	int BuildNode( const int ibeg, const int iend );
+	void SearchTree( const float* q, const int k, std::vector<std::pair<float,int>>& heap ) const;
+	void SearchNode( const int inode, const float* q, const int k, std::vector<std::pair<float,int>>& heap ) const;
+};
+
+#endif
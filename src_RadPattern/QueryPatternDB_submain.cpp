@@ -0,0 +1,63 @@
+#include "PatternDB.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+
+int main( int argc, char* argv[] ) {
+   if( argc<7 || argc>11 ) {
+      std::cerr<<"Usage: "<<argv[0]<<" [pattern_db] [strike] [dip] [rake] [depth] [out_name]"
+					<<" [nout (optional, default=20)] [refine (0/1, optional, default=1)]"
+					<<" [eigen_file_R (optional)] [eigen_file_L (optional)]"<<std::endl;
+      exit(-1);
+   }
+
+	PatternDB pdb( argv[1], argc>9 ? argv[9] : "", argc>10 ? argv[10] : "" );
+
+   // read in focal info 
+	PatternDB::Mech ref{ (float)atof(argv[2]), (float)atof(argv[3]), (float)atof(argv[4]), (float)atof(argv[5]) };
+   std::cout<<"### Input Focal info = ("<<ref.stk<<" "<<ref.dip<<" "<<ref.rak<<" "<<ref.dep<<"). ###"<<std::endl;
+	const int nout = argc>7 ? atoi(argv[7]) : 20;
+	const bool refine = argc>8 ? atoi(argv[8])!=0 : true;
+
+	// nearest patterns, re-ranked by the exact misfit
+	auto tbeg = std::chrono::steady_clock::now();
+	auto matchV = pdb.Query( ref, nout );
+	float tquery = std::chrono::duration<float>(std::chrono::steady_clock::now()-tbeg).count();
+	std::cout<<"### "<<matchV.size()<<" matches found in "<<tquery<<" sec. ###"<<std::endl;
+
+	// local refinement from each match
+	if( refine ) {
+		tbeg = std::chrono::steady_clock::now();
+		const float step0 = 0.5 * pdb.Params().dang;
+		#pragma omp parallel for schedule(dynamic, 1)
+		for( int i=0; i<matchV.size(); i++ ) matchV[i] = pdb.Refine( ref, matchV[i], step0 );
+		std::sort( matchV.begin(), matchV.end(), [](const PatternDB::Match& m1, const PatternDB::Match& m2){ return m1.E < m2.E; } );
+		// matches that converged to the same mechanism
+		auto same = []( const PatternDB::Match& m1, const PatternDB::Match& m2 ) {
+			return fabs(m1.mech.stk-m2.mech.stk)<1.e-3 && fabs(m1.mech.dip-m2.mech.dip)<1.e-3 &&
+					 fabs(m1.mech.rak-m2.mech.rak)<1.e-3 && fabs(m1.mech.dep-m2.mech.dep)<1.e-3;
+		};
+		matchV.erase( std::unique(matchV.begin(), matchV.end(), same), matchV.end() );
+		float trefine = std::chrono::duration<float>(std::chrono::steady_clock::now()-tbeg).count();
+		std::cout<<"### matches refined in "<<trefine<<" sec. ###"<<std::endl;
+	}
+
+	// output: stk dip rak dep E N
+	std::ofstream fout( argv[6] );
+	if( ! fout ) {
+		std::cerr<<"Error(main): Cannot write to file "<<argv[6]<<std::endl;
+		exit(0);
+	}
+	for( const auto& m : matchV )
+		fout<<m.mech.stk<<" "<<m.mech.dip<<" "<<m.mech.rak<<" "<<m.mech.dep<<"   "<<m.E<<" "<<m.N<<"\n";
+
+   return 0;
+}
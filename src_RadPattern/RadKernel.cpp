@@ -0,0 +1,120 @@
+#include "RadKernel.h"
+#include <cmath>
+#include <string>
+#include <stdexcept>
+
+/* constants as defined in the FORTRAN kernels */
+static constexpr float pi = 3.1415927, drad = 180./pi;
+static constexpr float pi2 = 6.2831854, rUnwrap = 2.;	// unwrap.f
+static constexpr float oo2pi = 0.1591549431, eps = 0.0001;
+
+/* phaRad.f: asin(y/a) with the x<0 half mapped into (pi/2, 3pi/2) == atan2 shifted from (-pi,-pi/2) by 2pi */
+#pragma omp declare simd
+static inline float phaRad( const float y, const float x ) {
+	float ph = std::atan2(y, x);
+	return ph < -0.5f*pi ? ph + 2.f*pi : ph;
+}
+
+
+RadKernel::RadKernel( const float dazi )
+	: _dazi(dazi) {
+	float nseg = 360. / dazi;
+	if( dazi<=0. || std::fabs(nseg-std::round(nseg)) > 1.e-4 )
+		throw std::runtime_error("Error(RadKernel::RadKernel): 360 is not a multiple of dazi = "+std::to_string(dazi));
+	_nazi = (int)std::round(nseg) + 1;	// 0 - 360 inclusive, as in rad_pattern4_?.f
+	_stride = (_nazi + 15) / 16 * 16;
+	// azimuth tables, shifted by 180 degree so that results come out in the RadPattern order
+	cV.resize(_nazi); sV.resize(_nazi); csqV.resize(_nazi);
+	ssqV.resize(_nazi); s2V.resize(_nazi); c2V.resize(_nazi);
+	for( int iazi=0; iazi<_nazi; iazi++ ) {
+		float azi = std::fmod( iazi*dazi + 180.f, 360.f );
+		float c = std::cos(azi/drad), s = std::sin(azi/drad);
+		cV[iazi] = c; sV[iazi] = s;
+		csqV[iazi] = c*c; ssqV[iazi] = s*s;
+		s2V[iazi] = 2.*s*c; c2V[iazi] = c*c - s*s;
+	}
+}
+
+int RadKernel::Compute( const char type, const std::array<float,6>& MT, const float M0, const EigenRec::SourceData& sd,
+								const std::vector<float>& perlst, float* const* grt, float* const* pht, float* const* amp ) const {
+	if( type!='R' && type!='L' )
+		throw std::runtime_error(std::string("Error(RadKernel::Compute): unknown type = ")+type);
+	const int nper = sd.nper, nazi = _nazi, stride = _stride;
+	if( nper < 2 )
+		throw std::runtime_error("Error(RadKernel::Compute): too few periods in the source data ("+std::to_string(nper)+")");
+
+	// locate requested periods
+	jperV.resize( perlst.size() );
+	for( int iper=0; iper<perlst.size(); iper++ ) {
+		int j = 0;
+		for( ; j<nper; j++ ) if( std::fabs(perlst[iper]-sd.per[j]) < eps ) break;
+		if( j == nper ) return iper;
+		jperV[iper] = j;
+	}
+
+	/* source terms for all periods, vectorized over azimuth */
+	phM.resize( nper*stride ); ampM.resize( nper*stride );
+	const float *cA = cV.data(), *sA = sV.data(), *csqA = csqV.data();
+	const float *ssqA = ssqV.data(), *s2A = s2V.data(), *c2A = c2V.data();
+	const float tm1 = MT[0], tm2 = MT[1], tm3 = MT[2], tm4 = MT[3], tm5 = MT[4], tm6 = MT[5];
+	for( int j=0; j<nper; j++ ) {
+		const float stepr = 1. / (pi*2.0f*(1.f/sd.per[j]));
+		float *phA = &(phM[j*stride]), *ampA = &(ampM[j*stride]);
+		if( type == 'R' ) {
+			// Re: xx, yy, zz, xy terms; Im: xz, yz terms
+			const float aa = -sd.wvn[j]*sd.eigH[j], ab = sd.wvn[j]*sd.eigV[j] + sd.deigH[j];
+			const float cxx = tm1*aa*stepr, cyy = tm2*aa*stepr, czz = tm3*sd.deigV[j]*stepr, cxy = tm4*aa*stepr;
+			const float cxz = tm5*ab*stepr, cyz = tm6*ab*stepr;
+			#pragma omp simd
+			for( int i=0; i<nazi; i++ ) {
+				float re = cxx*csqA[i] + cyy*ssqA[i] + czz + cxy*s2A[i];
+				float im = cxz*cA[i] + cyz*sA[i];
+				ampA[i] = std::sqrt(re*re + im*im);
+				phA[i] = phaRad(im, re);
+			}
+		} else {
+			// Re: xx, yy, xy terms; Im: xz, yz terms
+			const float aa = 0.5*sd.wvn[j]*sd.eigH[j], ad = 2.*sd.deigH[j];
+			const float cs2 = (tm2-tm1)*aa*stepr, cc2 = tm4*2.f*aa*stepr;
+			const float cxz = tm5*ad*stepr, cyz = -tm6*ad*stepr;
+			#pragma omp simd
+			for( int i=0; i<nazi; i++ ) {
+				float re = cs2*s2A[i] + cc2*c2A[i];
+				float im = cxz*sA[i] + cyz*cA[i];
+				ampA[i] = std::sqrt(re*re + im*im);
+				phA[i] = phaRad(im, re);
+			}
+		}
+	}
+
+	/* unwrap along period (unwrap.f), row by row so that azimuths stay vectorized */
+	for( int j=1; j<nper; j++ ) {
+		const float *ph0A = &(phM[(j-1)*stride]);
+		float *ph1A = &(phM[j*stride]);
+		#pragma omp simd
+		for( int i=0; i<nazi; i++ ) {
+			float dp = ph1A[i] - ph0A[i];
+			if( std::fabs(dp) > pi2/rUnwrap ) ph1A[i] -= std::copysign(pi2, dp);
+		}
+	}
+
+	/* group time, phase time, and amplitude at the requested periods */
+	for( int iper=0; iper<perlst.size(); iper++ ) {
+		const int j = jperV[iper];
+		// one-sided difference at the two ends, central (but still divided by dper) elsewhere
+		const int jl = j==0 ? 0 : j-1, jh = j==nper-1 ? j : j+1;
+		const float *phlA = &(phM[jl*stride]), *phhA = &(phM[jh*stride]);
+		const float *phA = &(phM[j*stride]), *ampA = &(ampM[j*stride]);
+		const float per = sd.per[j], dper = sd.dper, q = -per*per/pi2;
+		float *grtA = grt[iper], *phtA = pht[iper], *ampoA = amp[iper];
+		#pragma omp simd
+		for( int i=0; i<nazi; i++ ) {
+			float dp = phhA[i] - phlA[i];
+			grtA[i] = std::fabs(dp) > 3.f ? NaNgrt : dp/dper*q;
+			phtA[i] = phA[i]*oo2pi*per;
+			ampoA[i] = ampA[i] * M0;
+		}
+	}
+
+	return -1;
+}
@@ -0,0 +1,42 @@
+#ifndef RADKERNEL_H
+#define RADKERNEL_H
+
+#include "EigenRec.h"
+#include <array>
+#include <vector>
+
+
+/* Native replacement of rad_pattern_r_/rad_pattern_l_ (rad_pattern4_*.f + sourceRad.f + phaRad.f + unwrap.f).
+	All periods of the source data are evaluated at all azimuths in one pass over
+	structure-of-arrays buffers laid out as [period][azimuth] (azimuth contiguous),
+	so that the inner azimuth loops vectorize.
+	Predictions are written, already rotated by 180 degree, into caller-provided arrays:
+	output index iazi corresponds to the azimuth (iazi*dazi + 180) % 360 of the source term. */
+class RadKernel {
+public:
+	// dazi = azimuth step in degree (360 must be a multiple of it)
+	RadKernel( const float dazi = 2. );
+
+	float dazi() const { return _dazi; }
+	int nazi() const { return _nazi; }
+
+	/* compute group time, phase time, and amplitude*M0 for every period in perlst.
+		grt[iper], pht[iper], amp[iper] should each point to nazi() floats.
+		group times that cannot be determined are set to NaNgrt.
+		returns the index (into perlst) of the first period not found in sd, or -1 on success */
+	int Compute( const char type, const std::array<float,6>& MT, const float M0, const EigenRec::SourceData& sd,
+					 const std::vector<float>& perlst, float* const* grt, float* const* pht, float* const* amp ) const;
+
+	static constexpr float NaNgrt = -123456.;	// same flag as unwrap.f
+
+private:
+	float _dazi;
+	int _nazi, _stride;	// stride = nazi padded to 16 floats
+	// azimuth tables (already shifted by 180 degree)
+	std::vector<float> cV, sV, csqV, ssqV, s2V, c2V;
+	// work space: phase and amplitude [nper][stride], and the index into sd.per of each requested period
+	mutable std::vector<float> phM, ampM;
+	mutable std::vector<int> jperV;
+};
+
+#endif
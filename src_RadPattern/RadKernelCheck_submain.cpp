@@ -0,0 +1,147 @@
+#include "RadKernel.h"
+#include "EigenRec.h"
+#include "Rand.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/* cross-check RadKernel against the FORTRAN rad_pattern_r_/rad_pattern_l_ at random
+	mechanisms and depths, and report the throughput of both */
+
+/* FORTRAN entrance */
+const int nazi = 181;
+extern"C" {
+   void rad_pattern_r_(const float mt[6], int *nper, const float *dper,
+							  const float *per, const float *eigH, const float *deigH, const float *eigV, const float *deigV, const float *camp, const float *wvn,
+							  const float *perlst, int *nperlst, float *azi, float grT[][nazi], float phT[][nazi], float amp[][nazi]);
+   void rad_pattern_l_(const float mt[6], int *nper, const float *dper,
+							  const float *per, const float *eigH, const float *deigH, const float *camp, const float *wvn,
+							  const float *perlst, int *nperlst, float *azi, float grT[][nazi], float phT[][nazi], float amp[][nazi]);
+}
+
+static std::array<float, 6> MomentTensor( float stk, float dip, float rak ) {
+	float deg2rad = M_PI/180.;
+	stk *= deg2rad; dip *= deg2rad; rak *= deg2rad;
+	float sins = sin(stk), coss = cos(stk), sin2s = sin(2.*stk), cos2s = cos(2.*stk);
+	float sind = sin(dip), cosd = cos(dip), sin2d = sin(2.*dip), cos2d = cos(2.*dip);
+	float sinr = sin(rak), cosr = cos(rak);
+	return std::array<float, 6>{ -(sind*cosr*sin2s + sin2d*sinr*sins*sins), (sind*cosr*sin2s - sin2d*sinr*coss*coss), (sin2d*sinr),
+										  (sind*cosr*cos2s + sin2d*sinr*sins*coss), -(cosd*cosr*coss + cos2d*sinr*sins), -(cosd*cosr*sins - cos2d*sinr*coss) };
+}
+
+int main( int argc, char* argv[] ) {
+   if( argc!=4 && argc!=5 && argc!=6 ) {
+      std::cerr<<"Usage: "<<argv[0]<<" [R/L] [eigen_file (.R/L)] [per_lst] [nmodels (optional, default=1000)] [dazi for the benchmark (optional, default=2)]"<<std::endl;
+      exit(-1);
+   }
+
+   char type = argv[1][0];
+   if( type != 'R' && type != 'L' ) {
+      std::cerr<<"Unknown type: "<<type<<std::endl;
+      exit(0);
+   }
+   std::vector<float> perlst;
+   std::ifstream fin(argv[3]);
+   if( ! fin ) {
+      std::cerr<<"Error(main): Cannot read from file "<<argv[3]<<std::endl;
+      exit(0);
+   }
+   for(std::string line; std::getline(fin, line); ) {
+      float pertmp;
+      if( sscanf(line.c_str(), "%f", &pertmp) == 1 ) perlst.push_back(pertmp);
+   }
+   fin.close();
+	int nperlst = perlst.size();
+	if( nperlst == 0 || nperlst > 20 ) {	// rad_pattern4_?.f are limited to 20 periods
+      std::cerr<<"Error(main): 1-20 periods expected in "<<argv[3]<<std::endl;
+      exit(0);
+	}
+	const int nmodel = argc>4 ? atoi(argv[4]) : 1000;
+	const float dazib = argc>5 ? atof(argv[5]) : 2.;
+
+	/* random models */
+	EigenRec er( argv[2], 1, true );
+	Rand randO;
+	std::vector<float> depV(nmodel);
+	std::vector<std::array<float,6>> MTV(nmodel);
+	for( int imodel=0; imodel<nmodel; imodel++ ) {
+		MTV[imodel] = MomentTensor( randO.Uniform()*360., randO.Uniform()*90., randO.Uniform()*360.-180. );
+		depV[imodel] = 1. + randO.Uniform()*50.;
+	}
+
+	/* cross-check at dazi = 2 */
+	RadKernel rk(2.);
+	float azi[nazi], grT[nperlst][nazi], phT[nperlst][nazi], amp[nperlst][nazi];
+	std::vector<std::vector<float>> grtV(nperlst, std::vector<float>(nazi)), phtV = grtV, ampV = grtV;
+	std::vector<float*> grtP(nperlst), phtP(nperlst), ampP(nperlst);
+	for( int iper=0; iper<nperlst; iper++ ) {
+		grtP[iper] = grtV[iper].data(); phtP[iper] = phtV[iper].data(); ampP[iper] = ampV[iper].data();
+	}
+	auto runF = [&]( const std::array<float,6>& MT ) {
+		auto& sd = er.sd;
+		if( type == 'R' )
+			rad_pattern_r_( MT.data(), &(sd.nper), &(sd.dper), sd.per.data(), sd.eigH.data(), sd.deigH.data(), sd.eigV.data(), sd.deigV.data(),
+								 sd.ac.data(), sd.wvn.data(), perlst.data(), &nperlst, azi, grT, phT, amp );
+		else
+			rad_pattern_l_( MT.data(), &(sd.nper), &(sd.dper), sd.per.data(), sd.eigH.data(), sd.deigH.data(),
+								 sd.ac.data(), sd.wvn.data(), perlst.data(), &nperlst, azi, grT, phT, amp );
+	};
+	// max differences over azimuths with amp >= 5% of the average (those kept by RadPattern)
+	// phase times are compared modulo the period (2pi branches may differ where Re ~ 0)
+	float dgmax = 0., dpmax = 0., damax = 0.; long ncmp = 0, nbad = 0, nflag = 0, nbranch = 0;
+	for( int imodel=0; imodel<nmodel; imodel++ ) {
+		er.FillSDAtDep( depV[imodel] );
+		runF( MTV[imodel] );
+		if( rk.Compute( type, MTV[imodel], 1., er.sd, perlst, grtP.data(), phtP.data(), ampP.data() ) >= 0 ) {
+			std::cerr<<"Error(main): period(s) not found in "<<argv[2]<<std::endl;
+			exit(0);
+		}
+		for( int iper=0; iper<nperlst; iper++ ) {
+			float aavg = 0.;
+			for( int i=0; i<nazi; i++ ) aavg += amp[iper][i];
+			aavg /= nazi;
+			for( int i=0; i<nazi; i++ ) {
+				int iF = (i + nazi/2) % (nazi-1);	// the 180 degree shift of RadPattern
+				if( amp[iper][iF] < 0.05*aavg ) continue;
+				if( (grT[iper][iF]==RadKernel::NaNgrt) != (grtV[iper][i]==RadKernel::NaNgrt) ) { nflag++; continue; }
+				ncmp++;
+				float dp = phT[iper][iF] - phtV[iper][i];
+				if( fabs(dp) > 0.5*perlst[iper] ) { nbranch++; dp = fabs(remainder(dp, perlst[iper])); }
+				else dp = fabs(dp);
+				float dg = fabs(grT[iper][iF] - grtV[iper][i]);
+				float da = fabs(amp[iper][iF] - ampV[iper][i]) / amp[iper][iF];
+				if( dp > 1.e-3*perlst[iper] || dg > 5.e-2 || da > 1.e-4 ) nbad++;
+				if( dp > dpmax ) dpmax = dp;
+				if( grT[iper][iF]!=RadKernel::NaNgrt && dg > dgmax ) dgmax = dg;
+				if( da > damax ) damax = da;
+			}
+		}
+	}
+	std::cout<<"### "<<ncmp<<" predictions compared: max |dgrt| = "<<dgmax<<" sec, max |dpht| = "<<dpmax
+				<<" sec, max |damp|/amp = "<<damax<<". "<<nbad<<" beyond tolerance, "<<nflag<<" with mismatched flags, "
+				<<nbranch<<" on a different 2pi branch. ###"<<std::endl;
+
+	/* throughput */
+	auto tbeg = std::chrono::steady_clock::now();
+	for( int imodel=0; imodel<nmodel; imodel++ ) runF( MTV[imodel] );
+	float tF = std::chrono::duration<float>(std::chrono::steady_clock::now()-tbeg).count();
+	RadKernel rkb(dazib);
+	std::vector<std::vector<float>> bufV(nperlst*3, std::vector<float>(rkb.nazi()));
+	for( int iper=0; iper<nperlst; iper++ ) {
+		grtP[iper] = bufV[iper*3].data(); phtP[iper] = bufV[iper*3+1].data(); ampP[iper] = bufV[iper*3+2].data();
+	}
+	tbeg = std::chrono::steady_clock::now();
+	for( int imodel=0; imodel<nmodel; imodel++ )
+		rkb.Compute( type, MTV[imodel], 1., er.sd, perlst, grtP.data(), phtP.data(), ampP.data() );
+	float tC = std::chrono::duration<float>(std::chrono::steady_clock::now()-tbeg).count();
+	std::cout<<"### FORTRAN kernel: "<<nmodel/tF<<" patterns/sec (dazi=2). RadKernel: "<<nmodel/tC
+				<<" patterns/sec (dazi="<<dazib<<", "<<nmodel*(float)rkb.nazi()*er.sd.nper/tC*1.e-6<<" M period-azimuths/sec). ###"<<std::endl;
+
+	return 0;
+}
@@ -1,23 +1,10 @@
 #include "RadPattern.h"
+#include "Profiler.h"
 #include <fstream>
 #include <sstream>
 #include <cstring>
 #include <algorithm>
 
-/* FORTRAN entrance */
-const int nazi = RadPattern::nazi;
-extern"C" {
-   //void rad_pattern_r_(const float *strike, const float *dip, const float *rake, int *nper, const float *dper, 
-   void rad_pattern_r_(const float mt[6], int *nper, const float *dper, 
-							  const float *per, const float *eigH, const float *deigH, const float *eigV, const float *deigV, const float *camp, const float *wvn,
-							  const float *perlst, int *nperlst, float *azi, float grT[][nazi], float phT[][nazi], float amp[][nazi]);
-   //void rad_pattern_l_(const float *strike, const float *dip, const float *rake, int *nper, const float *dper,
-   void rad_pattern_l_(const float mt[6], int *nper, const float *dper,
-							  const float *per, const float *eigH, const float *deigH, const float *camp, const float *wvn,
-							  const float *perlst, int *nperlst, float *azi, float grT[][nazi], float phT[][nazi], float amp[][nazi]);
-}
-
-
 /* con/destructors and operators */
 RadPattern::RadPattern( const char type, const std::string& feigname )
    : type(type), er(feigname, 1, true) {
@@ -31,18 +18,6 @@ void RadPattern::SetModel( const char typein, const std::string& feigname ) {
    type = typein;	er.reLoad(feigname, 1, true); er.FillSD();
 }
 
-/* copy arrayin[nazi] into Vout with positions shifted by int(nazi/2) */
-void RadPattern::ShiftCopy( std::vector<float>& Vout, const float* arrayin, const int nazi ) const {
-   // check nazi
-   if( nazi % 2 == 0 )
-      throw ErrorRP::BadParam( FuncName, "unexpected nazi = " + std::to_string(nazi) );
-   int nazio2 = nazi / 2;
-   Vout.clear(); Vout.reserve(nazi);
-   // shift by 180 degree
-   Vout = std::vector<float>( arrayin+nazio2, arrayin+nazi-1 );
-   Vout.insert( Vout.end(), arrayin, arrayin+nazio2+1 );
-}
-
 // computes moment tensor from strike, dip, and rake
 std::array<float, 6> RadPattern::MomentTensor( float stk, float dip, float rak, const float M0 ) const {
 	float deg2rad = M_PI/180.;
@@ -62,6 +37,7 @@ std::array<float, 6> RadPattern::MomentTensor( float stk, float dip, float rak,
 
 /* predict radpattern for rayleigh and love waves */
 bool RadPattern::Predict( const std::array<ftype, 6>& MTi, const ftype depin, const ftype M0in, const std::vector<float>& perlst, bool crctPha ) {
+	PROFILE_SCOPE("RadPattern::Predict");
 
 	// return if the requested new state is exactly the same as the one stored
 	//if( stk==stkin && dip==dipin && rak==rakin &&
@@ -97,49 +73,18 @@ bool RadPattern::Predict( const std::array<ftype, 6>& MTi, const ftype depin, co
 		campM[per] = std::array<float, 2>{ er.sd.ac[index], er.sd.wvn[index] };
    }
 
-   // run rad_pattern
-   int nperlst = perlst.size();
-	float azi[nazi], grT[nperlst][nazi], phT[nperlst][nazi], amp[nperlst][nazi];
-
-   if( type == 'R' ) {
-      rad_pattern_r_( MT.data(), &(er.sd.nper), &(er.sd.dper), 
-							 er.sd.per.data(), er.sd.eigH.data(), er.sd.deigH.data(), er.sd.eigV.data(), er.sd.deigV.data(),
-							 er.sd.ac.data(), er.sd.wvn.data(), perlst.data(), &nperlst, azi, grT, phT, amp );
-		//for(int i=0; i<nazi; i++) std::cout<<"R: "<<azi[i]<<" "<<grT[0][i]<<" "<<phT[0][i]<<" "<<amp[0][i]<<std::endl;
-   } else if( type == 'L' ) {
-      rad_pattern_l_( MT.data(), &(er.sd.nper), &(er.sd.dper), 
-							 er.sd.per.data(), er.sd.eigH.data(), er.sd.deigH.data(), 
-							 er.sd.ac.data(), er.sd.wvn.data(), perlst.data(), &nperlst, azi, grT, phT, amp );
-		//for(int i=0; i<nazi; i++) std::cout<<"L: "<<azi[i]<<" "<<grT[0][i]<<" "<<phT[0][i]<<" "<<amp[0][i]<<std::endl;
-   }
-	// copy predictions into maps
+	// run the radiation kernel directly into the prediction arrays
 	grtM.clear(); phtM.clear(); ampM.clear(); //campM.clear(); aziV.clear();
-   //float azi[nazi], grT[nperlst][nazi], phT[nperlst][nazi], amp[nperlst][nazi];
+	std::vector<float*> grtP(perlst.size()), phtP(perlst.size()), ampP(perlst.size());
 	for( int iper=0; iper<perlst.size(); iper++ ) {
 		float per = perlst[iper];
-/*
-		// copy as is
 		auto &grV = grtM[per], &phV = phtM[per], &amV = ampM[per];
-      grV = std::vector<float>( grT[iper], grT[iper]+nazi );
-      phV = std::vector<float>( phT[iper], phT[iper]+nazi );
-      amV = std::vector<float>( amp[iper], amp[iper]+nazi );
-		// shift the phase by pi
-		float T_pi = per * 0.5;
-		auto pi_shifter = [&](float& val) {
-			val += T_pi;
-			if( val > T_pi ) val -= per;
-		};
-		std::for_each( phV.begin(), phV.end(), pi_shifter );
-		// flip
-		std::transform( grV.begin(), grV.end(), grV.begin(), std::negate<float>() );
-		std::transform( phV.begin(), phV.end(), phV.begin(), std::negate<float>() );
-*/
-		// shift by 180 degree
-		ShiftCopy( grtM[per], grT[iper], nazi );
-		ShiftCopy( phtM[per], phT[iper], nazi );
-		ShiftCopy( ampM[per], amp[iper], nazi ); for( auto &val : ampM[per] ) val *= M0;
-		//campM[per] = std::array<float, 2>{ coef_amp[iper], wvn[iper] };
-   }
+		grV.resize(nazi); phV.resize(nazi); amV.resize(nazi);
+		grtP[iper] = grV.data(); phtP[iper] = phV.data(); ampP[iper] = amV.data();
+	}
+	int iperBad = rk.Compute( type, MT, M0, er.sd, perlst, grtP.data(), phtP.data(), ampP.data() );
+	if( iperBad >= 0 )
+		throw ErrorRP::BadParam( FuncName, "period not in eigen file = " + std::to_string(perlst[iperBad]) );
 	if( crctPha ) CorrectPhase();
 //std::cerr<<"RadPattern::Predict 1: "<<type<<" "<<MT[0]<<" "<<MT[1]<<" "<<MT[2]<<" "<<MT[3]<<" "<<MT[4]<<" "<<MT[5]<<std::endl;
 
@@ -3,12 +3,15 @@
 
 #include "MyOMP.h"
 #include "EigenRec.h"
+#include "RadKernel.h"
 #include "Rand.h"
 #include <cmath>
 #include <memory>
 #include <iostream>
 #include <iomanip>
 #include <vector>
+#include <array>
+#include <functional>
 #include <string>
 #include <map>
 
@@ -63,6 +66,8 @@ public:
 	RadPattern( const char type = 'N', const std::string& feigname = "" );
 
    void SetModel( const char type, const std::string& feigname );
+	// give this object eigen tables of its own (allocated by the calling thread)
+	void Detach() { er.Detach(); }
 
 	friend std::ostream& operator <<(std::ostream &o, const RadPattern &rp) {
 		o<<rp.type<<" "<<rp.grtM.size()<<"   "
@@ -135,6 +140,8 @@ public:
 private:
    //struct Rimpl; std::unique_ptr<Rimpl> pimplR;
 	EigenRec er;
+	// native radiation kernel (sampled at dazi)
+	RadKernel rk{dazi};
 
 	// sample azimuths
 	std::vector<float> aziV;
@@ -151,8 +158,6 @@ private:
 	
 	std::array<float, 6> MomentTensor( float stk, float dip, float rak, const float M0=1. ) const;
 
-	void ShiftCopy( std::vector<float>& Vout, const float* arrayin, const int nazi ) const;
-
 	void NormCoefs( const RadPattern &rp2, const std::map<float,float> &sigmaM, float &a, float &b );
 
 	template <class OP>
@@ -1,43 +1,121 @@
 #include "Map.h"
 #include "DisAzi.h"
+#include "Profiler.h"
 #include <cstdio>
 #include <cmath>
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* ------------ binary map format ------------ */
+// [header (128 bytes)][points: DataPoint<float>*npts][idx1: int32*nlon1*nlat1][idx2: int32*nlon2*nlat2]
+// each section starts on a 64-byte boundary. Points are stored as DataPoint records in hash
+// (dataM1 block) order, so that the map uses them in place (a view into the shared mapping)
+// and the optional index sections (ppair::pos of dataM1/dataM2) can be applied directly.
+struct MapBinHeader {
+	char magic[8];				// "EQKMAPB"
+	uint32_t version;
+	uint32_t endian;			// = 0x01020304 in the byte order of the writer
+	uint32_t isReg;			// grid type: 1 = regular (dataM2 stored), 0 = irregular
+	uint32_t hasIndex;		// 1 = idx1 (and idx2 if isReg) sections present
+	float lonmin, lonmax, latmin, latmax;
+	float grd1_lon, grd1_lat, grd2_lon, grd2_lat;
+	float dataavg;
+	uint32_t nlon1, nlat1, nlon2, nlat2;
+	uint32_t recsize;			// = sizeof(DataPoint<float>) of the writer
+	uint64_t npts;
+	uint64_t off_pts, off_idx1, off_idx2, reserved[2];
+};
+static_assert( sizeof(MapBinHeader) == 128, "unexpected MapBinHeader size" );
+static_assert( sizeof(DataPoint<float>) == 4*sizeof(float), "unexpected DataPoint layout" );
+static const char MapBinMagic[8] = "EQKMAPB";
+static const uint32_t MapBinVersion = 2, MapBinEndian = 0x01020304;
+static const uint64_t MapBinAlign = 64;
 
+// (the points are read-only once hashed, and may live in a read-only mapping)
 template <typename T>
 class ppair {
 public:
 	int pos = -1;	// complementary position info
 	//ppair() {}
-	ppair( const typename std::vector<T>::iterator p1, const typename std::vector<T>::iterator p2, int pos = -1 )
-		: p1(p1), p2(p2), pos(pos) {}
-	ppair( const typename std::vector<T>::iterator p1, const size_t size, int pos = -1 )
-		: p1(p1), p2(p1+size), pos(pos) {}
+	ppair( const T* p1, const T* p2, int pos = -1 )
+		: pos(pos), p1(p1), p2(p2) {}
+	ppair( const T* p1, const size_t size, int pos = -1 )
+		: pos(pos), p1(p1), p2(p1+size) {}
 
-	void assign( const typename std::vector<T>::iterator p1in, const typename std::vector<T>::iterator p2in ) {
+	void assign( const T* p1in, const T* p2in ) {
 		p1 = p1in; p2 = p2in;
 	}
 
 	size_t size() const { return p2-p1; }
-	inline const typename std::vector<T>::iterator& begin() const { return p1; }
-	inline		 typename std::vector<T>::iterator& begin() { return p1; }
-	inline const typename std::vector<T>::iterator& end() const { return p2; }
-	inline		 typename std::vector<T>::iterator& end() { return p2; }
+	inline const T* begin() const { return p1; }
+	inline const T* end() const { return p2; }
+private:
+	const T *p1, *p2;
+};
+
+/* the points of a map: held in a vector, or viewed in place in the read-only MAP_SHARED
+ * mapping of a binary map file. The mapping lives as long as any view of it, so concurrent
+ * processes (and all copies in one process) read the same page-cache pages */
+class PointStore {
+public:
+	typedef DataPoint<float> value_type;
+	typedef const DataPoint<float>* const_iterator;
+
+	size_t size() const { return pmap ? nmap : dataV.size(); }
+	bool empty() const { return size() == 0; }
+	const DataPoint<float>* data() const { return pmap ? pmapbeg : dataV.data(); }
+	const_iterator begin() const { return data(); }
+	const_iterator end() const { return data() + size(); }
+	const_iterator cbegin() const { return begin(); }
+	const DataPoint<float>& operator[]( const size_t i ) const { return data()[i]; }
+
+	bool isMapped() const { return (bool)pmap; }
+	// view n points at pbeg, kept valid by pmap
+	void View( std::shared_ptr<const void> pmapin, const DataPoint<float>* pbeg, const size_t n ) {
+		dataV.clear(); pmap = std::move(pmapin); pmapbeg = pbeg; nmap = n;
+	}
+	// the vector to modify (a view is copied into it first)
+	std::vector< DataPoint<float> >& Vec() {
+		if( pmap ) {
+			dataV.assign( begin(), end() );
+			pmap.reset(); pmapbeg = nullptr; nmap = 0;
+		}
+		return dataV;
+	}
+	// an empty vector to fill (the view, if any, is released)
+	std::vector< DataPoint<float> >& Reset() {
+		pmap.reset(); pmapbeg = nullptr; nmap = 0;
+		dataV.clear();
+		return dataV;
+	}
+
 private:
-	typename std::vector<T>::iterator p1, p2;
+	std::vector< DataPoint<float> > dataV;
+	std::shared_ptr<const void> pmap;
+	const DataPoint<float>* pmapbeg = nullptr;
+	size_t nmap = 0;
 };
 
+/* the grid data, hash and index of a map. Once loaded/clipped, a Mimpl is never
+ * modified: it is shared (read-only) by all copies of the Map and by all threads.
+ * The source-dependent distances are kept in Map::disV instead */
 struct Map::Mimpl {
 
-	Mimpl() {}
+	Mimpl( const float grdlon = 1., const float grdlat = 1. )
+		: grd1_lon(grdlon), grd1_lat(grdlat) {}
 
 	Mimpl( const Mimpl& m2 )
 		: lonmin(m2.lonmin), lonmax(m2.lonmax), latmin(m2.latmin), latmax(m2.latmax)
 		, dis_lat1D(m2.dis_lat1D), dis_lon1D(m2.dis_lon1D), dataV(m2.dataV), dataavg(m2.dataavg)
 		, grd1_lon(m2.grd1_lon), grd1_lat(m2.grd1_lat), dataM1(m2.dataM1)
-		, grd2_lon(m2.grd2_lon), grd2_lat(m2.grd2_lat), dataM2(m2.dataM2), isReg(m2.isReg) {
+		, isReg(m2.isReg), grd2_lon(m2.grd2_lon), grd2_lat(m2.grd2_lat), dataM2(m2.dataM2) {
 		ApplyHash();
 	}
 
@@ -45,7 +123,7 @@ struct Map::Mimpl {
 		: lonmin(m2.lonmin), lonmax(m2.lonmax), latmin(m2.latmin), latmax(m2.latmax)
 		, dis_lat1D(m2.dis_lat1D), dis_lon1D(std::move(m2.dis_lon1D)), dataV(std::move(m2.dataV)), dataavg(std::move(m2.dataavg))
 		, grd1_lon(m2.grd1_lon), grd1_lat(m2.grd1_lat), dataM1(std::move(m2.dataM1))
-		, grd2_lon(m2.grd2_lon), grd2_lat(m2.grd2_lat), dataM2(std::move(m2.dataM2)), isReg(m2.isReg) {
+		, isReg(m2.isReg), grd2_lon(m2.grd2_lon), grd2_lat(m2.grd2_lat), dataM2(std::move(m2.dataM2)) {
 		// this is likely not necessary when moving unless the compiler writer went nuts
 		ApplyHash();	// but just to be safe...
 	}
@@ -76,8 +154,8 @@ struct Map::Mimpl {
 	float dis_lat1D;
 	std::vector<float> dis_lon1D;
 
-	// data vector
-	std::vector< DataPoint<float> > dataV;
+	// data points (owned, or viewed in a mapped binary file)
+	PointStore dataV;
 	std::vector< DataPoint<float> > dataavg;
 
 	// matrix (of iterators) 1
@@ -106,7 +184,7 @@ struct Map::Mimpl {
 		//sscanf(line.c_str(), "%f %f %f", &lon, &lat, &data);
 		//fin.seekg(0); // rewind
 		/* load in all data */
-		dataV.clear(); dataavg.assign(1, 0.);
+		auto& V = dataV.Reset(); dataavg.assign(1, 0.);
 		for(std::string line; std::getline(fin, line); ) {
 			float lon, lat, data;
 			std::stringstream ss(line);
@@ -117,7 +195,7 @@ struct Map::Mimpl {
 			if( data != data ) continue;
 			if( lon < 0. ) lon += 360.;
 			//float dis = Path<float>(srcin, Point<float>(lon,lat)).Dist();
-			dataV.push_back( DataPoint<float>(lon, lat, data) );
+			V.push_back( DataPoint<float>(lon, lat, data) );
 			dataavg[0].data += data;
 		}
 		fin.close();
@@ -130,6 +208,148 @@ struct Map::Mimpl {
 		CompMapBoundaries();
 	}
 
+	/* check for the binary magic */
+	static bool isBinary( const std::string& fname ) {
+		std::ifstream fin(fname.c_str(), std::ios::binary);
+		char magic[8];
+		if( !fin || !fin.read(magic, 8) ) return false;
+		return memcmp(magic, MapBinMagic, 8) == 0;
+	}
+
+	/* load the binary map through mmap. The points are used in place: the mapping is kept
+	 * (read-only, MAP_SHARED) for as long as this grid object or a copy of it views it.
+	 * The prebuilt index is applied only when it was built with the same block size (grd1)
+	 * as requested here */
+	void ReadBinary( const std::string& fname ) {
+		int fd = open(fname.c_str(), O_RDONLY);
+		if( fd < 0 )
+			throw ErrorM::BadFile(FuncName, "read from "+fname);
+		struct stat st;
+		if( fstat(fd, &st)<0 || st.st_size<(off_t)sizeof(MapBinHeader) ) {
+			close(fd);
+			throw ErrorM::BadFile(FuncName, "truncated file "+fname);
+		}
+		size_t fsize = st.st_size;
+		void *pmap = mmap(nullptr, fsize, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if( pmap == MAP_FAILED )
+			throw ErrorM::BadFile(FuncName, "mmap "+fname);
+		std::shared_ptr<const void> mapping( pmap, [fsize]( const void* p ) { munmap(const_cast<void*>(p), fsize); } );
+		ReadBinary( mapping, fsize, fname );
+	}
+
+	void ReadBinary( const std::shared_ptr<const void>& mapping, const size_t fsize, const std::string& fname ) {
+		const char* buf = static_cast<const char*>(mapping.get());
+		MapBinHeader hd;
+		memcpy(&hd, buf, sizeof(hd));
+		if( memcmp(hd.magic, MapBinMagic, 8) != 0 || hd.version != MapBinVersion )
+			throw ErrorM::BadFile(FuncName, "unknown binary format (re-convert with MapConverter) in "+fname);
+		if( hd.endian != MapBinEndian || hd.recsize != sizeof(DataPoint<float>) )
+			throw ErrorM::BadFile(FuncName, "byte order/record layout mismatch in "+fname);
+		size_t npts = hd.npts;
+		auto within = [&]( uint64_t off, size_t nbytes ) { return off>=sizeof(hd) && off<=fsize && nbytes<=fsize-off; };
+		if( npts==0 || npts>(size_t)INT32_MAX || hd.off_pts%alignof(DataPoint<float>)!=0 ||
+			 !within(hd.off_pts, npts*sizeof(DataPoint<float>)) )
+			throw ErrorM::BadFile(FuncName, "corrupted/empty file "+fname);
+		dataV.View( mapping, reinterpret_cast<const DataPoint<float>*>(buf+hd.off_pts), npts );
+		dataavg.assign(1, hd.dataavg);
+		lonmin = hd.lonmin; lonmax = hd.lonmax;
+		latmin = hd.latmin; latmax = hd.latmax;
+
+		/* use the index if present and compatible, re-hash otherwise */
+		size_t nidx1 = (size_t)hd.nlon1 * hd.nlat1, nidx2 = (size_t)hd.nlon2 * hd.nlat2;
+		bool useIndex = hd.hasIndex && roundoff(hd.grd1_lon-grd1_lon)==0 && roundoff(hd.grd1_lat-grd1_lat)==0 &&
+							 nidx1>0 && within(hd.off_idx1, nidx1*sizeof(int32_t)) &&
+							 (!hd.isReg || (nidx2>0 && within(hd.off_idx2, nidx2*sizeof(int32_t))));
+		if( ! useIndex ) {
+			Hash();
+			return;
+		}
+		/* block starts of dataM1 are non-decreasing positions in [0, npts]; cells of dataM2
+		 * are a position in [0, npts) or -1 (empty). Check before anything points into dataV */
+		const int32_t *pidx1 = reinterpret_cast<const int32_t*>(buf+hd.off_idx1);
+		const int32_t *pidx2 = hd.isReg ? reinterpret_cast<const int32_t*>(buf+hd.off_idx2) : nullptr;
+		const int32_t n = npts;
+		for( size_t i=0; i<nidx1; i++ )
+			if( pidx1[i]<0 || pidx1[i]>n || (i>0 && pidx1[i]<pidx1[i-1]) )
+				throw ErrorM::BadFile(FuncName, "corrupted index in "+fname);
+		for( size_t i=0; i<nidx2; i++ )
+			if( pidx2[i]<-1 || pidx2[i]>=n )
+				throw ErrorM::BadFile(FuncName, "corrupted index in "+fname);
+		dataM1.assign(hd.nlon1, hd.nlat1, ppair< DataPoint<float> >( dataavg.data(), (size_t)0 ));
+		for( size_t i=0; i<nidx1; i++ ) dataM1[i].pos = pidx1[i];
+		isReg = hd.isReg;
+		if( isReg ) {
+			grd2_lon = hd.grd2_lon; grd2_lat = hd.grd2_lat;
+			dataM2.assign(hd.nlon2, hd.nlat2, ppair< DataPoint<float> >( dataavg.data(), (size_t)1 ));
+			for( size_t i=0; i<nidx2; i++ ) dataM2[i].pos = pidx2[i];
+		} else {
+			dataM2.clear();
+		}
+		CompDist1D();
+		ApplyHash();
+	}
+
+	/* write the (hashed) map into the binary format */
+	void WriteBinary( const std::string& fname, const bool withIndex ) const {
+		if( dataV.empty() )
+			throw ErrorM::BadParam(FuncName, "empty map");
+		std::ofstream fout(fname.c_str(), std::ios::binary);
+		if( ! fout )
+			throw ErrorM::BadFile(FuncName, "write to "+fname);
+		MapBinHeader hd;
+		memset(&hd, 0, sizeof(hd));
+		memcpy(hd.magic, MapBinMagic, 8);
+		hd.version = MapBinVersion; hd.endian = MapBinEndian;
+		hd.isReg = isReg; hd.hasIndex = withIndex;
+		hd.lonmin = lonmin; hd.lonmax = lonmax; hd.latmin = latmin; hd.latmax = latmax;
+		hd.grd1_lon = grd1_lon; hd.grd1_lat = grd1_lat;
+		hd.grd2_lon = isReg ? grd2_lon : 0.; hd.grd2_lat = isReg ? grd2_lat : 0.;
+		hd.dataavg = dataavg[0].data;
+		hd.recsize = sizeof(DataPoint<float>);
+		hd.npts = dataV.size();
+		auto align = []( uint64_t off ) { return (off + MapBinAlign - 1) / MapBinAlign * MapBinAlign; };
+		hd.off_pts = align(sizeof(hd));
+		uint64_t offend = hd.off_pts + hd.npts * sizeof(DataPoint<float>);
+		if( withIndex ) {
+			hd.nlon1 = dataM1.NumRows(); hd.nlat1 = dataM1.NumCols();
+			hd.off_idx1 = align(offend);
+			offend = hd.off_idx1 + (uint64_t)dataM1.Size()*sizeof(int32_t);
+			if( isReg ) {
+				hd.nlon2 = dataM2.NumRows(); hd.nlat2 = dataM2.NumCols();
+				hd.off_idx2 = align(offend);
+			}
+		}
+		// write sections, zero-padded up to each offset
+		auto padTo = [&]( uint64_t off ) {
+			static const char zeros[MapBinAlign] = {};
+			uint64_t cur = fout.tellp();
+			if( off > cur ) fout.write(zeros, off-cur);
+		};
+		auto writeI = [&]( uint64_t off, const Array2D< ppair< DataPoint<float> > >& dataM ) {
+			padTo(off);
+			std::vector<int32_t> idx; idx.reserve(dataM.Size());
+			for( const auto& pp : dataM ) idx.push_back(pp.pos);
+			fout.write(reinterpret_cast<const char*>(idx.data()), idx.size()*sizeof(int32_t));
+		};
+		fout.write(reinterpret_cast<const char*>(&hd), sizeof(hd));
+		padTo(hd.off_pts);
+		fout.write(reinterpret_cast<const char*>(dataV.data()), dataV.size()*sizeof(DataPoint<float>));
+		if( withIndex ) {
+			writeI(hd.off_idx1, dataM1);
+			if( isReg ) writeI(hd.off_idx2, dataM2);
+		}
+		if( ! fout )
+			throw ErrorM::BadFile(FuncName, "write to "+fname);
+	}
+
+	// copy viewed (mapped) points into dataV
+	void Own() {
+		if( ! dataV.isMapped() ) return;
+		dataV.Vec();
+		ApplyHash();
+	}
+
 	void Hash() {
 		if( dataV.size() == 0 ) return;
 		HashM1();
@@ -159,8 +379,8 @@ struct Map::Mimpl {
 		}
 		dataavg[0].data /= size;
 		/* now rearrange all DataPoints into dataV and store iterators in dataM */
-		dataV.clear(); dataV.reserve(size*2+1000);
-		dataM1.assign(nlon, nlat, ppair< DataPoint<float> >( dataavg.begin(), 0 ));
+		auto& V = dataV.Reset(); V.reserve(size);
+		dataM1.assign(nlon, nlat, ppair< DataPoint<float> >( dataavg.data(), (size_t)0 ));
 		for( size_t i=0; i<dataM_hash.NumRows(); i++ ) {
 			for( size_t j=0; j<dataM_hash.NumCols(); j++ ) {
 				auto& dpV = dataM_hash(i, j);
@@ -171,13 +391,17 @@ struct Map::Mimpl {
 				auto p2 = dataV.end();
 				*/
 				//size_t old_size = dataV.size(), inser_size = dpV.size();
-				dataM1(i, j).pos = dataV.size();
+				dataM1(i, j).pos = V.size();
 				std::copy( std::make_move_iterator(dpV.begin()), 
-							  std::make_move_iterator(dpV.end()), std::back_inserter(dataV) );
+							  std::make_move_iterator(dpV.end()), std::back_inserter(V) );
 				//dataM1(i, j) = ppair< DataPoint<float> >(dataV.begin() + old_size, inser_size);
 			}
 		}
-		/* compute distance of 1 degree in lon/lat */
+		CompDist1D();
+	}
+
+	/* compute distance of 1 degree in lon/lat */
+	void CompDist1D() {
 		//dis_lat1D = 111.;
 		float clon = 0.5 * (lonmin + lonmax);
 		dis_lat1D = Path<float>(clon, 0., clon, 1.).Dist();
@@ -195,7 +419,7 @@ struct Map::Mimpl {
 		if( ! CompMapGrids() ) return false;
 		int nlon = (int)ceil( (lonmax-lonmin) / grd2_lon ) + 1;
 		int nlat = (int)ceil( (latmax-latmin) / grd2_lat ) + 1;
-		dataM2.assign(nlon, nlat, ppair< DataPoint<float> >( dataavg.begin(), 1 ) );
+		dataM2.assign(nlon, nlat, ppair< DataPoint<float> >( dataavg.data(), (size_t)1 ) );
 		//for( auto iter=dataV.begin(); iter<dataV.end(); iter++ ) {
 		for(int i=0; i<dataV.size(); i++) {
 			const auto& dp = dataV[i];
@@ -266,7 +490,7 @@ struct Map::Mimpl {
    bool CompMapGrids() {
       // compute x grid
 		// sort by lon
-      auto dataVtmp = dataV;
+      std::vector< DataPoint<float> > dataVtmp( dataV.begin(), dataV.end() );
       std::sort( dataVtmp.begin(), dataVtmp.end(), [](const DataPoint<float>& n1, const DataPoint<float>& n2) {
             return n1.lon < n2.lon;
       } );
@@ -292,7 +516,7 @@ struct Map::Mimpl {
       }
       // compute y grid
 		// sort by lon
-      dataVtmp = dataV;
+      dataVtmp.assign( dataV.begin(), dataV.end() );
       std::sort( dataVtmp.begin(), dataVtmp.end(), [](const DataPoint<float>& n1, const DataPoint<float>& n2) {
             return n1.lat < n2.lat;
       } );
@@ -320,7 +544,7 @@ struct Map::Mimpl {
 		return true;
    }
 
-	inline float estimate_dist(const Point<float>& p1, const Point<float>& p2) {
+	inline float estimate_dist(const Point<float>& p1, const Point<float>& p2) const {
 		float lon1 = p1.Lon(), lat1 = p1.Lat();
 		if( lon1 < 0. ) lon1 += 360.;
 		float lon2 = p2.Lon(), lat2 = p2.Lat();
@@ -344,7 +568,7 @@ std::cerr<<p1<<" "<<p2<<"   "<<dis_lon<<" "<<dis_lat<<"\n";
 	}
 
 	float Interp4( const DataPoint<float>& dp1, const DataPoint<float>& dp2,
-						const DataPoint<float>& dp3, const DataPoint<float>& dp4, const Point<float>& P ) {
+						const DataPoint<float>& dp3, const DataPoint<float>& dp4, const Point<float>& P ) const {
 		float w1 = 1. / (0.01+estimate_dist( dp1, P )), dat1 = dp1.data;
 		float w2 = 1. / (0.01+estimate_dist( dp2, P )), dat2 = dp2.data;
 		float w3 = 1. / (0.01+estimate_dist( dp3, P )), dat3 = dp3.data;
@@ -352,7 +576,7 @@ std::cerr<<p1<<" "<<p2<<"   "<<dis_lon<<" "<<dis_lat<<"\n";
 		return (w1*dat1 + w2*dat2 + w3*dat3 + w4*dat4 ) / (w1+w2+w3+w4);
 	}
 
-	float Interpolate( const Point<float>& P ) {
+	float Interpolate( const Point<float>& P ) const {
 		const auto& dataM = isReg ? dataM2 : dataM1;
 		int ilon_l = ilon_floor( P.lon ), ilon_u = ilon_ceil( P.lon );
 		int ilat_l = ilat_floor( P.lat ), ilat_u = ilat_ceil( P.lat );
@@ -397,53 +621,43 @@ std::cerr<<p1<<" "<<p2<<"   "<<dis_lon<<" "<<dis_lat<<"\n";
 
 
 /* -------------- con/destructors and assignment operators ----------------- */
+// copies share the (immutable) grid data and copy only the source-dependent distances
 Map::Map( const float grdlon, const float grdlat ) 
-	: pimplM( new Mimpl() ) {
-	pimplM->grd1_lon = grdlon;
-	pimplM->grd1_lat = grdlat;
-}
+	: pimplM( std::make_shared<const Mimpl>(grdlon, grdlat) ) {}
 
 Map::Map( const std::string& inname, const float grdlon, const float grdlat )
-	: pimplM( new Mimpl() ), fname(inname) {
-   pimplM->grd1_lon = grdlon;
-   pimplM->grd1_lat = grdlat;
+	: pimplM( std::make_shared<const Mimpl>(grdlon, grdlat) ), fname(inname) {
 	Load( fname );
 }
 //	: Map( inname, Point<float>(), grdlon, grdlat) {}
 
 Map::Map( const std::string& inname, const Point<float>& srcin, const float grdlon, const float grdlat ) 
-	: pimplM( new Mimpl() ), fname(inname), src(srcin) {
-	pimplM->grd1_lon = grdlon;
-	pimplM->grd1_lat = grdlat;
+	: pimplM( std::make_shared<const Mimpl>(grdlon, grdlat) ), fname(inname), src(srcin) {
 	Load( fname );
 	SetSource( src );
 }
 
 Map::Map( const Map& mp_other ) 
-	: pimplM( new Mimpl(*(mp_other.pimplM)) )
-	, fname(mp_other.fname), src(mp_other.src) {
-	//pimplM->Hash(); // ApplyHash called inside Mimpl constructors
-}
+	: pimplM( mp_other.pimplM ), disV( mp_other.disV )
+	, fname(mp_other.fname), src(mp_other.src) {}
 
 Map::Map( Map&& mp_other ) 
-	: pimplM( std::move(mp_other.pimplM) ) 
-	, fname(mp_other.fname), src(mp_other.src) { 
-	//pimplM->Hash(); // ApplyHash called inside Mimpl constructors
-}
+	: pimplM( std::move(mp_other.pimplM) ), disV( std::move(mp_other.disV) )
+	, fname(std::move(mp_other.fname)), src(mp_other.src) {}
 
 Map& Map::operator= ( const Map& mp_other ) {
-	pimplM.reset( new Mimpl(*(mp_other.pimplM)) );
+	pimplM = mp_other.pimplM;
+	disV = mp_other.disV;
 	fname = mp_other.fname;
 	src = mp_other.src;
-	//pimplM->Hash(); // ApplyHash called inside Mimpl constructors
 	return *this;
 }
 
 Map& Map::operator= ( Map&& mp_other ) {
 	pimplM = std::move(mp_other.pimplM);
+	disV = std::move(mp_other.disV);
 	fname = std::move(mp_other.fname);
 	src = std::move(mp_other.src);
-	//pimplM->Hash(); // ApplyHash called inside Mimpl constructors
 	return *this;
 }
 
@@ -476,31 +690,60 @@ void Map::Load( const std::string& fnamein ) {
 		lat = lat>0 ? lat-90. : lat+90.;
 		src = Point<float>(lon, lat);
 	} */
-	// open/check the file
-	pimplM->ReadData( fname );
-	pimplM->Hash();
+	// open/check the file (into a new grid object; copies of *this keep the old one)
+	auto pnew = std::make_shared<Mimpl>( pimplM->grd1_lon, pimplM->grd1_lat );
+	if( Mimpl::isBinary( fname ) ) {
+		pnew->ReadBinary( fname );	// hashed inside
+	} else {
+		pnew->ReadData( fname );
+		pnew->Hash();
+	}
+	pimplM = std::move(pnew);
+	ResetSource();
+}
+
+void Map::SaveBinary( const std::string& fnameout, const bool withIndex ) const {
+	pimplM->WriteBinary( fnameout, withIndex );
 }
 
 /* ------------ set source location ------------ */
 void Map::SetSource( const Point<float>& srcin ) {
 	src = srcin;
-	for( auto& dp : pimplM->dataV ) {
-		dp.dis = Path<float>( src, Point<float>(dp.lon, dp.lat) ).Dist();
+	const auto& dataV = pimplM->dataV;
+	disV.resize( dataV.size() );
+	for( size_t i=0; i<dataV.size(); i++ ) {
+		const auto& dp = dataV[i];
+		disV[i] = Path<float>( src, Point<float>(dp.lon, dp.lat) ).Dist();
 		//std::cerr<<"      debug SetSource: "<<dp<<std::endl;
 	}
 }
 
+// recompute distances for the current grid object (if a source has been set)
+void Map::ResetSource() {
+	if( src == Point<float>() ) disV.clear();
+	else SetSource( src );
+}
+
 /* --- clip the map around the source location (to speed up the average methods) --- */
 void Map::Clip( const float lonmin, const float lonmax, const float latmin, const float latmax ) {
 //std::cerr<<"Map::Clip 1:  "<<*(pimplM->dataM1(0,0).begin())<<" "<<*(pimplM->dataM2(0,0).begin())<<" "<<pimplM->dataM1.NumRows()<<" "<<pimplM->dataM1.NumCols()<<" "<<*this<<" "<<pimplM->dataV.size()<<" "<<pimplM->dataV.data()<<std::endl;
-	// reset bounds to within the given region
-	pimplM->CompMapBoundaries( lonmin, lonmax, latmin, latmax );
+	// reset bounds to within the given region (on a copy of the shared grid object)
+	auto pnew = std::make_shared<Mimpl>( *pimplM );
+	pnew->CompMapBoundaries( lonmin, lonmax, latmin, latmax );
 	// and re-hash
-	pimplM->Hash();
+	pnew->Hash();
+	pimplM = std::move(pnew);
+	ResetSource();
 }
 
 size_t Map::size() const { return pimplM->dataV.size(); }
 
+void Map::Detach() {
+	auto pnew = std::make_shared<Mimpl>( *pimplM );
+	pnew->Own();	// points viewed in a mapped file are copied as well
+	pimplM = std::move(pnew);
+}
+
 /* ------------ compute number of points near the given location ------------ */
 float Map::NumberOfPoints(Point<float> rec, const float xhdis, const float yhdis, float& loneff, float& lateff) const {
 	/* references */
@@ -648,7 +891,7 @@ void Map::TraceGCP( Point<float> Psrc, const Point<float>& Prec, float dis_step,
 /* ------------ compute average value along the path src-rec ------------ */
 DataPoint<float> Map::PathAverage(Point<float> rec, float& perc, const float lambda, const bool acc) {
 	// check source
-	if( src == Point<float>() )
+	if( src == Point<float>() || disV.size() != pimplM->dataV.size() )
 		throw ErrorM::BadParam(FuncName, "invalid src location");
 
 	float dis = Path<float>(src, rec).Dist();
@@ -665,6 +908,7 @@ DataPoint<float> Map::PathAverage(Point<float> rec, float& perc, const float lam
 
 	// references
 	const auto& dataM = pimplM->dataM1;
+	const auto Ibeg = pimplM->dataV.cbegin();
 	float lonmin = pimplM->lonmin, latmin = pimplM->latmin;
 	float grd_lon = pimplM->grd1_lon, grd_lat = pimplM->grd1_lat;
 
@@ -704,7 +948,7 @@ DataPoint<float> Map::PathAverage(Point<float> rec, float& perc, const float lam
 			for( const auto& dpcur : dataM(irow, icol) ) {
 				if( dpcur.Data() == NaN ) continue;
 				//distance from dpcur to src/rec;
-				float dis_src = dpcur.Dis(); //pimplM->estimate_dist(src, dpcur);
+				float dis_src = disV[&dpcur-&(*Ibeg)]; //pimplM->estimate_dist(src, dpcur);
 				float dis_rec = pimplM->estimate_dist(rec, dpcur);
 				if( dis_src+dis_rec > max_esti ) continue; // 2.*dab == hdis * 3.
 				dis_rec = (Path<float>(rec, dpcur).*fDist_ptr)();
@@ -712,7 +956,7 @@ DataPoint<float> Map::PathAverage(Point<float> rec, float& perc, const float lam
 				//calc_dist(rec.Lat(), rec.Lon(), dpcur.Lat(), dpcur.Lon(), &dis_rec);
 				float dis_ellip = dis_src + dis_rec - dis; // dis == 2.*f
 				if( dis_ellip > dab2 ) continue; // 2.*dab == hdis * 3.
-				if( dismax < dpcur.Dis() ) dismax = dpcur.Dis();
+				if( dismax < dis_src ) dismax = dis_src;
 				float weight = exp( alpha * dis_ellip * dis_ellip );
 				//std::cerr<<(Point<float>)dpcur<<" "<<weight<<"   "<<src<<"  "<<rec<<std::endl;
 				weit += weight;
@@ -732,10 +976,135 @@ DataPoint<float> Map::PathAverage(Point<float> rec, float& perc, const float lam
 }
 
 
+/* ------------ path averages of several maps on the same grid in a single pass ------------ */
+bool Map::SameGrid( const Map& m2 ) const {
+	const auto &p1 = *pimplM, &p2 = *(m2.pimplM);
+	if( &p1 == &p2 ) return true;
+	if( p1.dataV.size()!=p2.dataV.size() || p1.isReg!=p2.isReg ||
+		 p1.lonmin!=p2.lonmin || p1.lonmax!=p2.lonmax || p1.latmin!=p2.latmin || p1.latmax!=p2.latmax ||
+		 p1.grd1_lon!=p2.grd1_lon || p1.grd1_lat!=p2.grd1_lat ||
+		 p1.dataM1.NumRows()!=p2.dataM1.NumRows() || p1.dataM1.NumCols()!=p2.dataM1.NumCols() ) return false;
+	for( size_t i=0; i<p1.dataV.size(); i++ )
+		if( p1.dataV[i].lon!=p2.dataV[i].lon || p1.dataV[i].lat!=p2.dataV[i].lat ) return false;
+	for( size_t i=0; i<p1.dataM1.Size(); i++ )
+		if( p1.dataM1[i].pos != p2.dataM1[i].pos ) return false;
+	return true;
+}
+
+void Map::PathAverage_Fused( Map* const maps[], const AvgType types[], const int nmap, Point<float> rec,
+									  float avgs[], float percs[], const float lambda, const bool acc ) {
+	PROFILE_SCOPE("Map::PathAverage_Fused");
+	if( nmap <= 0 ) return;
+	if( nmap > NFusedMax ) throw ErrorM::BadParam(FuncName, "too many maps");
+	const Map& map0 = *(maps[0]);
+	const auto& src = map0.src;
+	// check source and grids
+	if( src == Point<float>() || map0.disV.size() != map0.pimplM->dataV.size() )
+		throw ErrorM::BadParam(FuncName, "invalid src location");
+	for( int k=1; k<nmap; k++ )
+		if( maps[k]->pimplM->dataV.size() != map0.pimplM->dataV.size() || ! (maps[k]->src == src) )
+			throw ErrorM::BadParam(FuncName, "maps on different grids/sources");
+
+	float dis = Path<float>(src, rec).Dist();
+	if( lambda < 0. ) {
+		throw ErrorM::BadParam(FuncName, "negative lambda");
+	} else if ( lambda == 0. ) { // direct ray tracing (no weights to share)
+		for( int k=0; k<nmap; k++ ) {
+			int N = 0; float avg = 0.;
+			if( types[k] == Reci ) {
+				maps[k]->TraceGCP(src, rec, trace_step, [&](float val) { avg += 1./val; N++;} );
+				avg = N / avg;
+			} else {
+				maps[k]->TraceGCP(src, rec, trace_step, [&](float val) { avg += val; N++;} );
+				avg /= N;
+			}
+			avgs[k] = avg; percs[k] = 1.;
+		}
+		return;
+	}
+
+	// references (geometry from map0, values from each map at the same position)
+	const auto& pimpl = *(map0.pimplM);
+	const auto& dataM = pimpl.dataM1;
+	const auto Ibeg = pimpl.dataV.cbegin();
+	float lonmin = pimpl.lonmin, latmin = pimpl.latmin;
+	float grd_lon = pimpl.grd1_lon, grd_lat = pimpl.grd1_lat;
+	const DataPoint<float>* pdataV[NFusedMax];
+	for( int k=0; k<nmap; k++ ) pdataV[k] = maps[k]->pimplM->dataV.data();
+
+	/* rec parameters */
+	size_t idlmax = pimpl.dis_lon1D.size() - 1;
+	int ilatmid = (int)floor( ( (rec.Lat()+src.Lat()) * 0.5 - latmin ) / grd_lat + 0.5 );
+	if( ilatmid > idlmax ) ilatmid = idlmax;
+	else if( ilatmid < 0 ) ilatmid = 0;
+	float dis_lon1D = pimpl.dis_lon1D[ilatmid], dis_lat1D = pimpl.dis_lat1D;
+	float grd_dis_lon = grd_lon * dis_lon1D,  grd_dis_lat = grd_lat * dis_lat1D;
+	float grd_semidiag = sqrt( (grd_dis_lon * grd_dis_lon) + (grd_dis_lat * grd_dis_lat) );
+
+	/* ellipse parameters (as in PathAverage_Reci) */
+	float Nmin = 3.;
+	float f = dis*0.5;
+	float dab = lambda/(2.*Nmin), dab2 = dab*2.;
+	float amax = f+dab;
+	float max_2a = 2. * (amax + grd_semidiag) + 10.;
+	float max_esti = 2. * amax + 40.;
+
+	// accumulators of each map
+	float weitV[NFusedMax], datasumV[NFusedMax], dismaxV[NFusedMax], disminV[NFusedMax];
+	bool validV[NFusedMax];
+	for( int k=0; k<nmap; k++ ) { weitV[k] = datasumV[k] = dismaxV[k] = 0.; disminV[k] = 99999.; }
+	float alpha = -1.125 / (dab*dab);
+	auto fDist_ptr = acc ? &Path<float>::Dist : &Path<float>::DistF;
+	for(int irow=0; irow<dataM.NumRows(); irow++) {
+		for(int icol=0; icol<dataM.NumCols(); icol++) {
+			// distances from (irow, icol) to src/rec
+			float loncur = lonmin+irow*grd_lon, latcur = latmin+icol*grd_lat;
+			float disEsrc = pimpl.estimate_dist( src, Point<float>(loncur,latcur) );
+			float disErec = pimpl.estimate_dist( rec, Point<float>(loncur,latcur) );
+			if( disEsrc + disErec > max_2a ) continue;
+			for( const auto& dpcur : dataM(irow, icol) ) {
+				const size_t ip = &dpcur-&(*Ibeg);
+				bool anyvalid = false;
+				for( int k=0; k<nmap; k++ ) anyvalid |= ( validV[k] = pdataV[k][ip].Data() != NaN );
+				if( ! anyvalid ) continue;
+				// geometry and weight (once for all maps)
+				float dis_src = map0.disV[ip];
+				float dis_rec = pimpl.estimate_dist(rec, dpcur);
+				if( dis_src+dis_rec > max_esti ) continue;
+				dis_rec = (Path<float>(rec, dpcur).*fDist_ptr)();
+				float dis_ellip = dis_src + dis_rec - dis;
+				if( dis_ellip > dab2 ) continue;
+				for( int k=0; k<nmap; k++ ) {
+					if( ! validV[k] ) continue;
+					if( dismaxV[k] < dis_src ) dismaxV[k] = dis_src;
+					if( disminV[k] > dis_src ) disminV[k] = dis_src;
+				}
+				float weight = exp( alpha * dis_ellip * dis_ellip );
+				if( weight < 0.01 ) continue;
+				// accumulate
+				for( int k=0; k<nmap; k++ ) {
+					if( ! validV[k] ) continue;
+					const float data = pdataV[k][ip].Data();
+					weitV[k] += weight;
+					datasumV[k] += types[k]==Reci ? ( weight / data ) : ( weight * data );
+				}
+			}
+		}
+	}
+	for( int k=0; k<nmap; k++ ) {
+		const float weit = weitV[k], datasum = datasumV[k];
+		if( weit == 0. ) avgs[k] = NaN;
+		else avgs[k] = types[k]==Reci ? weit/datasum : datasum/weit;
+		float perc = dismaxV[k] - disminV[k];
+		percs[k] = perc>=dis ? 1 : perc/dis;
+	}
+}
+
 /* ------------ compute average along the path src-rec weighted by the reciprocal of the map value ------------ */
 DataPoint<float> Map::PathAverage_Reci(Point<float> rec, float& perc, const float lambda, const bool acc) {
+	PROFILE_SCOPE("Map::PathAverage_Reci");
 	// check source
-	if( src == Point<float>() )
+	if( src == Point<float>() || disV.size() != pimplM->dataV.size() )
 		throw ErrorM::BadParam(FuncName, "invalid src location");
 
 	float dis = Path<float>(src, rec).Dist();
@@ -752,6 +1121,7 @@ DataPoint<float> Map::PathAverage_Reci(Point<float> rec, float& perc, const floa
 
 	// references
 	const auto& dataM = pimplM->dataM1;
+	const auto Ibeg = pimplM->dataV.cbegin();
 	float lonmin = pimplM->lonmin, latmin = pimplM->latmin;
 	float grd_lon = pimplM->grd1_lon, grd_lat = pimplM->grd1_lat;
 
@@ -798,7 +1168,7 @@ DataPoint<float> Map::PathAverage_Reci(Point<float> rec, float& perc, const floa
 			for( const auto& dpcur : dataM(irow, icol) ) {
 				if( dpcur.Data() == NaN ) continue;
 				//distance from dpcur to src/rec;
-				float dis_src = dpcur.Dis(); //pimplM->estimate_dist(src, dpcur);
+				float dis_src = disV[&dpcur-&(*Ibeg)]; //pimplM->estimate_dist(src, dpcur);
 				//float dis_rec1 = Path<float>(rec, dpcur).Dist();
 				//std::cerr<<(Point<float>)src<<" "<<(Point<float>)dpcur<<"   "<<dis_src<<" "<<dis_rec<<" "<<dis_rec1<<"   "<<max_esti<<"   "<<grd_lon<<"\n";
 				float dis_rec = pimplM->estimate_dist(rec, dpcur);
@@ -809,8 +1179,8 @@ DataPoint<float> Map::PathAverage_Reci(Point<float> rec, float& perc, const floa
 				//calc_dist(rec.Lat(), rec.Lon(), dpcur.Lat(), dpcur.Lon(), &dis_rec);
 				float dis_ellip = dis_src + dis_rec - dis; // dis == 2.*f
 				if( dis_ellip > dab2 ) continue; // 2.*dab == hdis * 3.
-				if( dismax < dpcur.Dis() ) dismax = dpcur.Dis();
-				if( dismin > dpcur.Dis() ) dismin = dpcur.Dis();
+				if( dismax < dis_src ) dismax = dis_src;
+				if( dismin > dis_src ) dismin = dis_src;
 				float weight = exp( alpha * dis_ellip * dis_ellip );
 				if( weight < 0.01 ) continue;
 				//std::cerr<<(Point<float>)dpcur<<" "<<weight<<"   "<<src<<"  "<<rec<<std::endl;
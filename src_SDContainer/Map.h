@@ -75,13 +75,19 @@ public:
 	bool isReg() const;
 
 	/* ------------ IO and resets ------------ */
+	// both the text (lon lat data) and the binary (see Map.cpp) formats are accepted
 	void Load( const std::string& fnamein );
+	// write the current (hashed/clipped) map in the binary format
+	void SaveBinary( const std::string& fnameout, const bool withIndex = true ) const;
 	/* ------------ set source location ------------ */
 	void SetSource( const float lon, const float lat ) { SetSource( Point<float>(lon, lat) ); }
 	void SetSource( const Point<float>& srcin );
 
 	size_t size() const;
 
+	// give this copy a grid of its own, allocated (and first touched) by the calling thread
+	void Detach();
+
 	/* --- clip the map around the source location (to speed up the average methods) --- */
 	void Clip( const float lonmin, const float lonmax, const float latmin, const float latmax );
 
@@ -119,6 +125,19 @@ public:
 	*/
    DataPoint<float> PathAverage_Reci(Point<float> Prec, float& perc, const float lambda = 0., const bool acc = false);
 
+	/* ------------ path averages of several maps on the same grid in a single pass ------------ */
+	// true if m2 has the same points in the same hash as this map (values may differ)
+	bool SameGrid( const Map& m2 ) const;
+	// how each map is averaged: Reci = as PathAverage_Reci (velocities), Arith = weighted mean (e.g. amplitude or Q)
+	enum AvgType { Reci, Arith };
+	/* average nmap maps (SameGrid, with the same source) along src-rec: the distances, the ellipse
+		membership and the weights are computed once and all maps are accumulated in the same loop.
+		Writes the average and perc of map i into avgs[i] and percs[i]. With the ellipse and the
+		weights of PathAverage_Reci, a Reci map gets exactly the PathAverage_Reci result */
+	static const int NFusedMax = 8;
+	static void PathAverage_Fused( Map* const maps[], const AvgType types[], const int nmap, Point<float> Prec,
+											 float avgs[], float percs[], const float lambda = 0., const bool acc = false );
+
 	// trace along the great circle path. return a vector of map values along the path
 	template<class Functor>
 	void TraceGCP( Point<float> Psrc, const Point<float>& Prec, float dis_step, const Functor& func );
@@ -134,10 +153,15 @@ protected:
 	static const int npts_min = 5;				// or at least 5 sample points
 
 private:
+	// grid data, hash and index: immutable and shared among copies/threads
+   struct Mimpl;
+   std::shared_ptr<const Mimpl> pimplM;
+	// source-dependent state (owned by each copy)
+	std::vector<float> disV;	// distance from src to each point in Mimpl::dataV
 	std::string fname;
 	Point<float> src;
-   struct Mimpl;
-   std::unique_ptr<Mimpl> pimplM;
+
+	void ResetSource();
 
 };
 
@@ -27,7 +27,7 @@ public:
 
 	void correctLon() { if(lon<0.) lon+=360.; }
 
-   virtual bool LoadLine( const std::string& line ) {
+   bool LoadLine( const std::string& line ) {
       //return ( sscanf(line.c_str(), "%f %f", &lon, &lat) == 2 );
 		std::stringstream ss(line);
 		return (bool)(ss >> lon >> lat);
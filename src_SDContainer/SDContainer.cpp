@@ -2,38 +2,39 @@
 #include "DisAzi.h"
 #include "StaList.h"
 #include "VectorOperations.h"
+#include "Profiler.h"
 #include <algorithm>
 #include <limits>
 
 /* IO */
 void SDContainer::LoadMeasurements( const std::string& fname, const float clon, const float clat, 
-												const float dismin, const float dismax, const std::string fsta ) {
+												const float dismin, const float dismax, const std::string fsta,
+												std::ostream& sout, std::ostream& serr ) {
 	// check input file
 	std::ifstream fin( fname );
 	if( ! fin ) 
 		throw ErrorSC::BadFile(FuncName, fname);
 	// clear data vector
-	dataV.clear();
+	clear();
 	// correct the input phase traveltime measurements for phase shift!
 	//float ph_shift = pio4_R==0 ? 0 : (-pio4_R*0.125*per);
 	float ph_shift = (type==R?-pio4_R:-pio4_L) * 0.125*per;
 	// load station list (if given)
 	bool checksta = !fsta.empty(); StaList stalst;
 	if( checksta ) stalst = StaList( fsta );
-	// read from file
+	// read from file (redundant stations are looked up in the location hash of those accepted)
+	LocHash locH;
 	int nskipC = 0, nskipR = 0;
 	for(std::string line; std::getline(fin, line); ) {
 		if( line.empty() ) continue;
 		StaData sdcur(line.c_str(), ph_shift, clon, clat);
 		if( sdcur.dis!=NaN && (sdcur.dis<dismin||sdcur.dis>dismax) ) continue;
 		if( ! sdcur.isComplete() ) {
-			std::cerr<<"Warning(SDContainer::LoadMeasurements): Incomplete station data = "<<sdcur<<std::endl;
+			serr<<"Warning(SDContainer::LoadMeasurements): Incomplete station data = "<<sdcur<<std::endl;
 			nskipC++; continue;
 		}
-		if( std::find_if(dataV.begin(), dataV.end(), [&]( const StaData& sd ) {
-					return sdcur.IsSameLocation(sd);
-					} ) != dataV.end() ) {
-			std::cerr<<"Warning(SDContainer::LoadMeasurements): redundant station at "<<static_cast<Point<float> &>(sdcur)<<std::endl;
+		if( locH.Find( sdcur.lon, sdcur.lat ) >= 0 ) {
+			serr<<"Warning(SDContainer::LoadMeasurements): redundant station at "<<static_cast<Point<float> &>(sdcur)<<std::endl;
 			nskipR++; continue;
 		}
 		if( checksta ) {
@@ -41,21 +42,30 @@ void SDContainer::LoadMeasurements( const std::string& fname, const float clon,
 			if( ! stalst.SearchLoc( sdcur.lon, sdcur.lat, data_find ) ) continue;
 		}
 		//std::cerr<<"SDContainer::LoadMeasurements: fname="<<fname<<" per="<<per<<" type="<<type<<" size="<<dataV.size()<<" "<<sdcur.Gdata<<" "<<sdcur.Pdata<<" "<<sdcur.Adata<<"\n";
-		sdcur.Adata = log(sdcur.Adata); dataV.push_back( sdcur );
+		sdcur.Adata = log(sdcur.Adata); push_back( sdcur );
+		locH.Insert( sdcur.lon, sdcur.lat, dataV.size()-1 );
 	}
-	std::cout<<"### SDContainer::LoadMeasurements: "<<dataV.size()<<" stations loaded from file "<<fname<<".";
-	if( nskipC>0 ) std::cout<<"\n    Warning: "<<nskipC<<" lines skipped due to data incompleteness.";
-	if( nskipR>0 ) std::cout<<"\n    Warning: "<<nskipR<<" lines skipped due to station redundancy.";
-	std::cout<<" ###"<<std::endl;
+	sout<<"### SDContainer::LoadMeasurements: "<<dataV.size()<<" stations loaded from file "<<fname<<".";
+	if( nskipC>0 ) sout<<"\n    Warning: "<<nskipC<<" lines skipped due to data incompleteness.";
+	if( nskipR>0 ) sout<<"\n    Warning: "<<nskipR<<" lines skipped due to station redundancy.";
+	sout<<" ###"<<std::endl;
 	
 }
 
 void SDContainer::LoadMaps( const std::string& fmapG, const std::string& fmapP ) {
    // read in vel maps
-	mapG.Load( fmapG );
-	mapP.Load( fmapP );
-	if( mapG.size()==0 || mapP.size()==0 )
+	Map mapGin, mapPin;
+	mapGin.Load( fmapG );
+	mapPin.Load( fmapP );
+	if( mapGin.size()==0 || mapPin.size()==0 )
 		throw ErrorSC::EmptyMap(FuncName, fmapG + " " + fmapP);
+	LoadMaps( mapGin, mapPin );
+}
+
+void SDContainer::LoadMaps( const Map& mapGin, const Map& mapPin, std::ostream& sout ) {
+	mapG = mapGin; mapP = mapPin;
+	if( mapG.size()==0 || mapP.size()==0 )
+		throw ErrorSC::EmptyMap(FuncName, "group/phase map");
 
 	// get data region
 	if( dataV.empty() ) return;
@@ -68,12 +78,13 @@ void SDContainer::LoadMaps( const std::string& fmapG, const std::string& fmapP )
 		if( sd.lat < latmin ) latmin = sd.lat;
 		else if( sd.lat > latmax ) latmax = sd.lat;
 	}
-	std::cout<<"### SDContainer::LoadMaps: Data Region = "<<lonmin<<" - "<<lonmax<<"   "<<latmin<<" - "<<latmax<<" ###\n";
+	sout<<"### SDContainer::LoadMaps: Data Region = "<<lonmin<<" - "<<lonmax<<"   "<<latmin<<" - "<<latmax<<" ###\n";
 	// clip maps ( for faster predictions )
 	mapG.Clip( lonmin-1., lonmax+1., latmin-1., latmax+1. );
 	mapP.Clip( lonmin-1., lonmax+1., latmin-1., latmax+1. );
-	std::cout<<"### SDContainer::LoadMaps: Group Map Region (clipped) = "<<mapG<<" ###\n";
-	std::cout<<"### SDContainer::LoadMaps: Phase Map Region (clipped) = "<<mapP<<" ###\n";
+	_sameGridGP = mapG.SameGrid( mapP );
+	sout<<"### SDContainer::LoadMaps: Group Map Region (clipped) = "<<mapG<<" ###\n";
+	sout<<"### SDContainer::LoadMaps: Phase Map Region (clipped) = "<<mapP<<" ###\n";
 }
 
 
@@ -92,7 +103,30 @@ void SDContainer::UpdateAziDis( const float srclon, const float srclat ) {
 		//sdtmp.valid = true;
 		//if( azi<210 && azi>160 ) sdtmp.valid = false;
 	}
-	std::sort( dataV.begin(), dataV.end() );
+	Sort();
+}
+
+/* A small epicenter move (SA/MC steps) changes the azimuths only slightly and leaves only
+	a few stations out of order, which the insertion sort fixes in O(n + #inversions) and
+	without moving any StaData record. Stations crossing azimuth 0/360 cost O(n) each; a
+	large move (e.g. a fresh container) would cost O(n^2), so the sort gives up once the
+	shifts exceed n*log2(n) and falls back to std::sort */
+void SDContainer::Sort() {
+	const int nsta = aziI.size();
+	auto aziless = [&]( const int i1, const int i2 ) { return dataV[i1] < dataV[i2]; };
+	long nshift = 0, maxshift = nsta;
+	for( int n=nsta; n>1; n>>=1 ) maxshift += nsta;
+	for( int k=1; k<nsta; k++ ) {
+		const int icur = aziI[k];
+		int j = k;
+		for( ; j>0 && aziless(icur, aziI[j-1]); j-- ) aziI[j] = aziI[j-1];
+		aziI[j] = icur;
+		nshift += k - j;
+		if( nshift > maxshift ) {
+			std::sort( aziI.begin(), aziI.end(), aziless );
+			return;
+		}
+	}
 }
 
 // predict traveltimes from VelMaps and store into Gpath&Ppath
@@ -106,6 +140,24 @@ bool SDContainer::UpdatePathPred( const float srclon, const float srclat, const
 	// period and wavelength
 	float pero2 = per*0.5, lambda = per * Lfactor;
 
+	if( _velG==NaN && _velP==NaN && _sameGridGP ) {
+		// reset both maps and update the Tpath predictions from one pass of the ellipse weights
+		mapG.SetSource( srclon, srclat );
+		mapP.SetSource( srclon, srclat );
+		Map* const maps[2] = { &mapG, &mapP };
+		const Map::AvgType types[2] = { Map::Reci, Map::Reci };
+		for( auto& sd : dataV ) {
+			float vels[2], percs[2], dis = sd.dis;
+			// loosen the acceptance criterion at small distances
+			float lam = dis<300. ? (lambda * (2.5-dis*0.005)) : lambda;
+			float minP = dis>15. ? (Min_Perc - 9./dis) : (Min_Perc - 0.6);
+			Map::PathAverage_Fused( maps, types, 2, Point<float>(sd.lon,sd.lat), vels, percs, lam );
+			if( percs[0] > minP ) sd.Gpath = dis / vels[0] + srct0;
+			if( percs[1] > minP ) sd.Ppath = dis / vels[1] + srct0;
+		}
+		return true;
+	}
+
 	if( _velG == NaN ) {
 		// reset Group map and update Tpath predictions
 		mapG.SetSource( srclon, srclat );
@@ -170,7 +222,8 @@ void SDContainer::UpdateSourcePred( const RadPattern& rad ) {
 void SDContainer::ToMisfitV( std::vector<AziData>& adV, const float Tmin ) const {
 	adV.clear();
 	//const float Tmin = nwavelength * per;	// three wavelength criterion
-	for( const auto& sdcur : dataV ) {
+	for( const int i : aziI ) {
+		const auto& sdcur = dataV[i];
 		if( sdcur.azi!=NaN ) {
 			//std::cerr<<"ToMisfitV 1: "<<sdcur.Pdata<<" "<<sdcur.Psource<<" "<<sdcur.Ppath<<" "<<Tmin<<std::endl;
 			if( sdcur.Pdata < Tmin ) continue;
@@ -217,10 +270,11 @@ void SDContainer::BinAverage_ExcludeBad( std::vector<StaData>& sdVgood, bool c2p
 	HandleBadBins(adVmean, adVstd, ad_stdest);
 
 	// pick out good stations that falls within the range defined by adVmean and adVstd
-	VO::SelectData( dataV, sdVgood, adVmean, adVstd, exfactor );
+	VO::SelectData( dataV, aziI, sdVgood, adVmean, adVstd, exfactor );
 }
 
 void SDContainer::BinAverage( std::vector<AziData>& adVmean, std::vector<AziData>& adVvar, bool c2pi, bool isFTAN, bool compVars ) {
+	PROFILE_SCOPE("SDContainer::BinAverage");
 	if( c2pi ) Correct2PI();
 	// dump into AziData vector
 	float Tmin;
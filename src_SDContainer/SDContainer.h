@@ -92,7 +92,7 @@ public:
 	SDContainer( const float perin, const Dtype typein, const bool isFTAN, const std::string fmeasure, 
 					 const std::string fmapG, const std::string fmapP, const std::string fsta="", 
 					 const float clon = NaN, const float clat = NaN, const float dismin = 0., const float dismax = 99999. ) 
-		: per(perin), oop(1./perin), type(typein), _isFTAN(isFTAN) {
+		: per(perin), type(typein), _isFTAN(isFTAN), oop(1./perin) {
 		if( type!=R && type!=L ) {
 			std::string str( "unknown data type: " + std::to_string(type) ); //str.push_back(type);
 			throw ErrorSC::BadParam( FuncName, str );
@@ -101,17 +101,33 @@ public:
 		LoadMaps( fmapG, fmapP );
 	}
 
+	// 3D model from maps loaded already (shared with other containers until clipped).
+	// Reports go to sout and warnings to serr
+	SDContainer( const float perin, const Dtype typein, const bool isFTAN, const std::string fmeasure, 
+					 const Map& mapGin, const Map& mapPin, const std::string fsta="", 
+					 const float clon = NaN, const float clat = NaN, const float dismin = 0., const float dismax = 99999.,
+					 std::ostream& sout = std::cout, std::ostream& serr = std::cerr ) 
+		: per(perin), type(typein), _isFTAN(isFTAN), oop(1./perin) {
+		if( type!=R && type!=L ) {
+			std::string str( "unknown data type: " + std::to_string(type) ); //str.push_back(type);
+			throw ErrorSC::BadParam( FuncName, str );
+		}
+		LoadMeasurements( fmeasure, clon, clat, dismin, dismax, fsta, sout, serr );
+		LoadMaps( mapGin, mapPin, sout );
+	}
+
 	// 1D model: Path velocities are fixed at the input velocities
 	SDContainer( const float perin, const Dtype typein, const bool isFTAN, const std::string fmeasure, 
 					 const float velG, const float velP, const std::string fsta="",
-					 const float clon = NaN, const float clat = NaN, const float dismin = 0., const float dismax = 99999. ) 
-		: per(perin), oop(1./perin), type(typein), _isFTAN(isFTAN),
+					 const float clon = NaN, const float clat = NaN, const float dismin = 0., const float dismax = 99999.,
+					 std::ostream& sout = std::cout, std::ostream& serr = std::cerr ) 
+		: per(perin), type(typein), _isFTAN(isFTAN), oop(1./perin),
 		  _velG(velG), _velP(velP) {
 		if( type!=R && type!=L ) {
 			std::string str( "unknown data type: " + std::to_string(type) ); //str.push_back(type);
 			throw ErrorSC::BadParam( FuncName, str );
 		}
-		LoadMeasurements( fmeasure, clon, clat, dismin, dismax, fsta );
+		LoadMeasurements( fmeasure, clon, clat, dismin, dismax, fsta, sout, serr );
 	}
 	/*
 	SDContainer( float perin, const std::vector<StaData>& datain )
@@ -121,9 +137,11 @@ public:
 		: per(perin), dataV( std::move(datain) ) {}
 	*/
 
-	void Sort() { std::sort(dataV.begin(), dataV.end()); }
+	/* order the stations by azimuth. The records stay where they are: only the permutation
+		index aziI is sorted, by an insertion sort that starts from the previous order */
+	void Sort();
 
-	void push_back( const StaData& sd ) { dataV.push_back(sd); }
+	void push_back( const StaData& sd ) { aziI.push_back( dataV.size() ); dataV.push_back(sd); }
 
 	std::vector<StaData>::const_iterator begin() const { return dataV.begin(); }
 	std::vector<StaData>::iterator begin() { return dataV.begin(); }
@@ -134,7 +152,7 @@ public:
 
 	std::size_t size() const { return dataV.size(); }
 
-	void clear() { dataV.clear(); }
+	void clear() { dataV.clear(); aziI.clear(); }
 
 	AziData ComputeVar();	// cannot be const, Correct2PI is called inside
 	// get Variances of G, P, and A stored in an AziData
@@ -178,18 +196,24 @@ public:
 
 	/* IO */
 	void LoadMeasurements( const std::string& fmeasure, const float clon, const float clat, 
-								  const float dismin, const float dismax, const std::string fsta="" );
+								  const float dismin, const float dismax, const std::string fsta="",
+								  std::ostream& sout = std::cout, std::ostream& serr = std::cerr );
 	void LoadMaps( const std::string& fmapG, const std::string& fmapP );
+	// take (copies of) loaded maps and clip them to the data region
+	void LoadMaps( const Map& mapGin, const Map& mapPin, std::ostream& sout = std::cout );
+	// give this copy maps of its own (allocated by the calling thread)
+	void Detach() { mapG.Detach(); mapP.Detach(); }
 	void PrintAll( std::ostream& sout = std::cout, const bool normAmp = false ) {
 		if( normAmp ) {
-			for( const auto& sd : dataV )	{
+			for( const int i : aziI )	{
+				const auto& sd = dataV[i];
 				auto sdout = sd;
 				sdout.Adata = sd.NormAmp(sd.Adata, per);
 				sdout.Asource = sd.NormAmp(sd.Asource, per);
 				sout<<sdout<<"\n";
 			}
 		} else {
-			for( const auto& sd : dataV )	sout<<sd<<"\n";
+			for( const int i : aziI )	sout<<dataV[i]<<"\n";
 		}
 	}
 
@@ -235,8 +259,12 @@ private:
 	//float stk = NaN, rak = NaN, dip = NaN, dep = NaN;
 
 	Map mapG, mapP;
+	bool _sameGridGP = false;	// mapG and mapP on one grid: path averages fused (Map::PathAverage_Fused)
 	float _velG = NaN, _velP = NaN;
 	std::vector<StaData> dataV;
+	// dataV[aziI[0]], dataV[aziI[1]], ... are in azimuthal order (after Sort/UpdateAziDis).
+	// The binning code reads the stations through it
+	std::vector<int> aziI;
 
 	void HandleBadBins(std::vector<AziData>& adVmean, std::vector<AziData>& adVstd, const AziData adest ) const;
 	// compute variance by propagating the given variance into the data
@@ -292,6 +292,51 @@ namespace VO {
 					dataout.push_back( (*iter) );
 			}
       }
+		return true;
+   }
+
+	// ... with datain read through the permutation indexV (datain[indexV[0]], datain[indexV[1]], ... sorted)
+	template < class T, class T2 >
+   bool SelectData( const std::vector<T>& datain, const std::vector<int>& indexV, std::vector<T>& dataout,
+						  const std::vector<T2>& binmeanV, const std::vector<T2>& binstdV,
+						  const float exfactor ) {
+      // check if datain is sorted by indexV
+		for( int k=1; k<indexV.size(); k++ )
+			if( datain[indexV[k]] < datain[indexV[k-1]] )
+				throw BadData(FuncName, "not sorted");
+		if( ! isSorted(binmeanV) )
+			throw BadData(FuncName, "not sorted");
+		// check sizes
+		size_t binsize = binmeanV.size();
+		if( binsize != binstdV.size() )
+			throw SizeMismatch(FuncName, "binmeanV - binstdV");
+		// check address
+		if( &datain == &dataout )
+			throw BadParam(FuncName, "datain and dataout cannot be identical");
+		// search (on the index)
+		auto lessVal = [&]( const int i, const T2& val ) { return datain[i] < val; };
+		auto valLess = [&]( const T2& val, const int i ) { return val < datain[i]; };
+      auto IT_lbound = indexV.begin(), IT_ubound = indexV.begin();
+      // bin ranges provided by binmeanV and binstdV
+		dataout.clear();
+		for( int i=0; i<binsize; i++ ) {
+			auto& binmean = binmeanV[i];
+			auto& binstd = binstdV[i];
+         // data window (in datain) for the current azi range (from binavgV)
+			T2 T2lbound = binstd * exfactor;
+			T2 T2ubound = binmean + T2lbound;
+			T2lbound = binmean - T2lbound;
+         IT_lbound = std::lower_bound( IT_lbound, indexV.end(), T2lbound, lessVal );
+         IT_ubound = std::upper_bound( IT_ubound, indexV.end(), T2ubound, valLess );
+			// check all Ts in the range
+			for( auto iter=IT_lbound; iter<IT_ubound; iter++ ) {
+				// store into dataout if within defined boundaries
+				const auto& data = datain[*iter];
+				if( data.isWithin( T2lbound, T2ubound) )
+					dataout.push_back( data );
+			}
+      }
+		return true;
    }
 
 };
@@ -1,27 +1,133 @@
 #include "SacRec.h"
 #include "DisAzi.h"
 #include "Array2D.h"
+#include "Profiler.h"
 //#include "MyLogger.h"
 //#include "SysTools.h"
 #include <fftw3.h>
 #include <cstdio>
 #include <cstdlib>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <cmath>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <cstring>
+#include <cerrno>
 #include <limits>
 #include <chrono>
 #include <random>
 #include <algorithm>
+#include <array>
+#include <map>
+#include <atomic>
+#include <vector>
 //#include <pthread.h>
 
 //#include "SysTools.h"
 //extern MEMO memo;
 
 
+/* ---------------------------------------- signal buffers ---------------------------------------- */
+namespace {
+	// each buffer is preceded by a header padded to the alignment
+	const size_t SigAlign = 64;
+	struct SigHeader { int sclass; };	// size class (buffer of 2^sclass floats), <0 if not pooled
+	const int NSigClass = 48, MinSigClass = 4;
+	std::atomic<bool> sig_usepool( false );
+	std::atomic<size_t> sig_capbytes( (size_t)64 << 20 );
+
+	inline SigHeader* HeaderOf( float* p ) {
+		return reinterpret_cast<SigHeader*>( reinterpret_cast<char*>(p) - SigAlign );
+	}
+	float* NewBlock( const size_t nfloat, const int sclass ) {
+		void* base = nullptr;
+		if( posix_memalign( &base, SigAlign, SigAlign + nfloat*sizeof(float) ) != 0 )
+			throw ErrorSR::MemError( "SigMem::Alloc", "posix_memalign failed for "+std::to_string(nfloat)+" floats!" );
+		reinterpret_cast<SigHeader*>(base)->sclass = sclass;
+		return reinterpret_cast<float*>( static_cast<char*>(base) + SigAlign );
+	}
+	inline void FreeBlock( float* p ) { free( HeaderOf(p) ); }
+	inline size_t ClassBytes( const int sclass ) { return ((size_t)1 << sclass) * sizeof(float); }
+
+	/* per-thread free lists by size class. The state flag is trivially destructible, so buffers
+		freed after the pool of their thread is gone (at thread/program exit) go back to the heap */
+	thread_local int sigpool_state = 0;	// 0: not constructed, 1: alive, 2: destroyed
+	class SigPool {
+	public:
+		SigPool() { sigpool_state = 1; }
+		~SigPool() {
+			sigpool_state = 2;
+			for( auto& L : freeL ) for( auto p : L ) FreeBlock(p);
+		}
+		float* Pop( const int sclass ) {
+			auto& L = freeL[sclass];
+			if( L.empty() ) return nullptr;
+			float* p = L.back(); L.pop_back();
+			bytes -= ClassBytes(sclass);
+			return p;
+		}
+		void Push( float* p, const int sclass ) {
+			freeL[sclass].push_back(p);
+			bytes += ClassBytes(sclass);
+		}
+		// release the largest buffers first until no more than cap bytes are kept
+		void Trim( const size_t cap ) {
+			for( int ic=NSigClass-1; ic>=0 && bytes>cap; ic-- ) {
+				auto& L = freeL[ic];
+				for( ; !L.empty() && bytes>cap; L.pop_back() ) {
+					FreeBlock( L.back() );
+					bytes -= ClassBytes(ic);
+				}
+			}
+		}
+	private:
+		std::vector<float*> freeL[NSigClass];
+		size_t bytes = 0;
+	};
+	thread_local SigPool sigpool;
+}
+
+float* SigMem::Alloc( const size_t n, const bool zero ) {
+	const size_t nf = std::max( n, (size_t)1 );
+	float* p = nullptr;
+	if( sig_usepool && sigpool_state!=2 ) {
+		int sclass = MinSigClass;
+		while( ((size_t)1<<sclass) < nf ) sclass++;
+		if( sclass >= NSigClass )
+			throw ErrorSR::MemError( "SigMem::Alloc", "buffer too large: "+std::to_string(n)+" floats!" );
+		p = sigpool.Pop( sclass );
+		if( ! p ) p = NewBlock( (size_t)1<<sclass, sclass );
+	} else {
+		p = NewBlock( nf, -1 );
+	}
+	if( zero ) std::fill( p, p+nf, 0. );
+	return p;
+}
+
+void SigMem::Free( float* p ) {
+	if( ! p ) return;
+	const int sclass = HeaderOf(p)->sclass;
+	if( sclass>=0 && sig_usepool && sigpool_state==1 ) sigpool.Push( p, sclass );
+	else FreeBlock( p );
+}
+
+void SigMem::UsePool( const bool use, const size_t capMB ) {
+	sig_capbytes = capMB << 20;
+	sig_usepool = use;
+	if( ! use ) Trim();
+}
+
+void SigMem::Trim() {
+	if( sigpool_state != 1 ) return;
+	sigpool.Trim( sig_usepool ? (size_t)sig_capbytes : 0 );
+}
+
+
 /* ---------------------------------------- Pimpl handle struct ---------------------------------------- */
 struct SacRec::SRimpl {
 
@@ -46,7 +152,7 @@ struct SacRec::SRimpl {
    // forward FFT: out ==> seis
    void FFTW_F(fftw_plan plan, fftw_complex *out, float *seis, int n, const short outtype = 0) {
 		/* outtype: real(0)/imaginary(1)/amp(2)/phase(3) of the IFFT result */
-      fftw_execute(plan);
+      { PROFILE_SCOPE("FFTW"); fftw_execute(plan); }
       //pthread_mutex_lock(&fftlock);
 		#pragma omp critical(fftw)
 		{
@@ -97,7 +203,7 @@ struct SacRec::SRimpl {
       memset(*in, 0, ns*sizeof(fftw_complex));
       int k;
       for(k=0; k<n; k++) (*in)[k][0] = seis[k];
-      fftw_execute(plan);
+      { PROFILE_SCOPE("FFTW"); fftw_execute(plan); }
 		if( !planF ) fftw_free(*in);
       //cleanup
       //pthread_mutex_lock(&fftlock);
@@ -433,7 +539,6 @@ struct SacRec::SRimpl {
 		if( rec_flag ) {
 			if((frec = fopen(fname,"r")) == NULL) return 0;
 			//pthread_mutex_lock(&fiolock);
-			#pragma omp critical(sacIO)
 			for(irec=0;;irec++)
 				if(fscanf(frec,"%d %d", &rec_b[irec], &rec_e[irec])!=2) break;
 			*nrec=irec;
@@ -864,16 +969,16 @@ namespace System {
 /* ---------------------------------------- constructors and operators ---------------------------------------- */
 /* default constructor */
 SacRec::SacRec( std::ostream& reportin )
- : sig(nullptr), shd(sac_null),
-	report(&reportin),
-	pimpl(new SRimpl() ) {
+ : shd(sac_null), sig(nullptr),
+	pimpl(new SRimpl() ),
+	report(&reportin) {
 }
 
 /* constructor with sac file name */
 SacRec::SacRec( const std::string& fnamein, std::ostream& reportin )
- : sig(nullptr), shd(sac_null),
-	report(&reportin), fname(fnamein),
-	pimpl(new SRimpl() ) {
+ : fname(fnamein), shd(sac_null), sig(nullptr),
+	pimpl(new SRimpl() ),
+	report(&reportin) {
 }
 
 /* constructor with initial signal npts */
@@ -884,10 +989,10 @@ SacRec::SacRec( const size_t npts, std::ostream& reportin )
 
 /* copy constructor */
 SacRec::SacRec( const SacRec& recin )
-	: fname(recin.fname), report(recin.report),
-	shd(recin.shd), pimpl( new SRimpl(*(recin.pimpl)) ) {
+	: fname(recin.fname), shd(recin.shd),
+	pimpl( new SRimpl(*(recin.pimpl)) ), report(recin.report) {
 	if( recin.sig && shd.npts>0 ) {
-		sig.reset(new float[shd.npts]);
+		sig.reset(SigMem::Alloc(shd.npts));
 		if( ! sig )
 			throw ErrorSR::MemError( FuncName, "new failed!");
 		std::copy(recin.sig.get(), recin.sig.get()+recin.shd.npts, sig.get()); 
@@ -896,8 +1001,8 @@ SacRec::SacRec( const SacRec& recin )
 
 /* move constructor */
 SacRec::SacRec( SacRec&& recin )
- : fname(std::move(recin.fname)), report(recin.report),
-	shd(recin.shd), pimpl( std::move(recin.pimpl) ) {
+ : fname(std::move(recin.fname)), shd(recin.shd),
+	pimpl( std::move(recin.pimpl) ), report(recin.report) {
    if ( recin.sig ) {
       sig = std::move(recin.sig);
 		//recin.sig.reset(nullptr);
@@ -913,7 +1018,7 @@ SacRec& SacRec::operator= ( const SacRec& recin ) {
 	shd = recin.shd;
    int npts=recin.shd.npts; 
 	if( recin.sig && npts>0 ) {
-		sig.reset(new float[npts]);
+		sig.reset(SigMem::Alloc(npts));
 		if( ! sig )
 			throw ErrorSR::MemError( FuncName, "new failed!");
 		std::copy(recin.sig.get(), recin.sig.get()+npts, sig.get());
@@ -949,7 +1054,7 @@ void SacRec::MutateAs ( const SacRec& recin ) {
 	report = recin.report;
 	shd = recin.shd;
 	fname = recin.fname;
-   sig.reset(new float[recin.shd.npts]() );
+   sig.reset(SigMem::Alloc(recin.shd.npts, true) );
 	if( ! sig )
 		throw ErrorSR::MemError( FuncName, "new failed!");
 }
@@ -961,62 +1066,186 @@ float SacRec::MemConsumed() const {
 	return ( sizeof(SRimpl)+sizeof(SacRec)+fname.size()+npts*sizeof(float) ) / 1048576.;
 }
 
+/* ---------------------------------------- mapped sac files ---------------------------------------- */
+namespace {
+	const size_t NSacNum = 110;	// # of 4-byte numeric words at the head of SAC_HD
+	inline void Swap4( void* p ) {
+		char* c = static_cast<char*>(p);
+		std::swap(c[0], c[3]); std::swap(c[1], c[2]);
+	}
+	// put a header read from file into native byte order (its version, internal4, is 6 either way)
+	bool FixByteOrder( SAC_HD& shd ) {
+		int version = shd.internal4; Swap4( &version );
+		const bool swapped = shd.internal4!=6 && version==6;
+		if( swapped )
+			for( size_t i=0; i<NSacNum; i++ ) Swap4( reinterpret_cast<char*>(&shd) + 4*i );
+		if( shd.npts > 0 ) shd.e = shd.b + shd.delta * (shd.npts-1);
+		return swapped;
+	}
+	// origin time from the header's ko string
+	void SetOrigin( SAC_HD& shd ) {
+		char koo[9];
+		for ( int i=0; i<8; i++ ) koo[i] = shd.ko[i];
+		koo[8] = 0;
+		float fes;
+		int eh, em;
+		sscanf(koo,"%d%*[^0123456789]%d%*[^.0123456789]%g",&eh,&em,&fes);
+		shd.o = shd.b + (shd.nzhour-eh)*3600. + (shd.nzmin-em)*60. + shd.nzsec-fes + shd.nzmsec*.001;
+	}
+	/* the samples in [tb, te] of the record (shdin, sig) into sac_result (zero-padded beyond the record).
+		sig may be sac_result's own signal */
+	void CutSig( const SAC_HD& shdin, const float* sig, const std::string& fname, const float tb, const float te,
+					 SacRec& sac_result, const std::string& funcname ) {
+		const SAC_HD shd = shdin;
+		int nb = (int)floor( (tb-shd.b) / shd.delta + 0.5 );
+		int ne = (int)floor( (te-shd.b) / shd.delta + 0.5 );
+		if( nb>=ne || ne<0 || nb>shd.npts )
+			throw ErrorSR::BadParam( funcname, "Invalid nb/ne/npts = " + std::to_string(nb) +
+											 "/" + std::to_string(ne) + "/" + std::to_string(shd.npts) );
+		int nptsnew = ne - nb + 1;
+		float* signew = SigMem::Alloc( nptsnew, true );
+		// define start positions
+		int inew, iold;
+		if( nb < 0 ) { inew = -nb; iold = 0; }
+		else { inew = 0; iold = nb; }
+		// define copy size
+		float nptscpy = std::min( nptsnew - inew, shd.npts - iold - 1 );
+		// copy data
+		memcpy( &(signew[inew]), &(sig[iold]), nptscpy * sizeof(float) );
+		// reset sacT.sig
+		sac_result.sig.reset(signew);
+		// update shd
+		if( &(sac_result.shd) != &shdin ) {
+			sac_result.shd = shd;
+			sac_result.fname = fname;
+		}
+		sac_result.shd.b += nb * shd.delta;
+		sac_result.shd.e = sac_result.shd.b + (nptsnew-1) * shd.delta;
+		sac_result.shd.npts = nptsnew;
+	}
+	// read n bytes from offset off. pread leaves the file offset alone: nothing to lock
+	bool PreadAll( const int fd, void* buff, size_t n, off_t off ) {
+		char* pc = static_cast<char*>(buff);
+		while( n > 0 ) {
+			const ssize_t nr = pread( fd, pc, n, off );
+			if( nr < 0 && errno == EINTR ) continue;
+			if( nr <= 0 ) return false;
+			pc += nr; off += nr; n -= nr;
+		}
+		return true;
+	}
+}
+
+SacView::SacView( const std::string& fnamein, const bool loadsig )
+	: fname(fnamein) {
+	const int fd = open( fname.c_str(), O_RDONLY );
+	if( fd < 0 )
+		throw ErrorSR::BadFile( FuncName, "reading from " + fname );
+	struct stat st;
+	if( fstat(fd, &st)!=0 || st.st_size<(off_t)sizeof(SAC_HD) ) {
+		close(fd);
+		throw ErrorSR::BadFile( FuncName, "failed to retrieve sac header from " + fname );
+	}
+	len = loadsig ? st.st_size : sizeof(SAC_HD);
+	base = mmap( nullptr, len, PROT_READ, MAP_PRIVATE | (loadsig ? MAP_POPULATE : 0), fd, 0 );
+	close(fd);
+	if( base == MAP_FAILED ) {
+		base = nullptr;
+		throw ErrorSR::BadFile( FuncName, "cannot map " + fname );
+	}
+	// throwing from here on: the destructor does not run
+	const std::string funcname = FuncName;	// __FUNCTION__ in the lambda would be operator()
+	auto Fail = [&]( const std::string& info, const bool badfile ) {
+		munmap( base, len ); base = nullptr;
+		if( badfile ) throw ErrorSR::BadFile( funcname, info );
+		throw ErrorSR::BadParam( funcname, info );
+	};
+
+	memcpy( &shd, base, sizeof(SAC_HD) );
+	swapped = FixByteOrder( shd );
+	if( ! loadsig ) return;
+
+	// signal
+	if( shd.npts <= 0 )
+		Fail( "negative npts("+std::to_string(shd.npts)+") in header", false );
+	if( len < sizeof(SAC_HD) + sizeof(float)*shd.npts )
+		Fail( "failed to extract sac sig from " + fname, true );
+	const float* sigmap = reinterpret_cast<const float*>( static_cast<const char*>(base) + sizeof(SAC_HD) );
+	if( swapped ) {
+		sigswap.assign( sigmap, sigmap+shd.npts );
+		for( auto& val : sigswap ) Swap4( &val );
+		sig = sigswap.data();
+	} else {
+		madvise( base, len, MADV_SEQUENTIAL );
+		sig = sigmap;
+	}
+}
+
+SacView::~SacView() {
+	if( base ) munmap( base, len );
+}
+
+void SacView::cut( float tb, float te, SacRec& sac_result ) const {
+	if( !sig || shd.npts<=0 )	// check signal
+		throw ErrorSR::EmptySig(FuncName);
+	SAC_HD shdo = shd; SetOrigin( shdo );
+	CutSig( shdo, sig, fname, tb, te, sac_result, FuncName );
+}
+
+
 /* ---------------------------------------- sac IO ---------------------------------------- */
 /* load sac header from file 'fname' */
 void SacRec::LoadHD () {
-   std::ifstream fsac(fname);
-   if( ! fsac )
+	const int fd = open( fname.c_str(), O_RDONLY );
+	if( fd < 0 )
 		throw ErrorSR::BadFile( FuncName, "reading from " + fname );
-   //if( SHDMap.empty() ) pimpl->CreateSHDMap();
-   //pthread_mutex_lock(&fiolock);
-	size_t rdsize = sizeof(SAC_HD);
-	#pragma omp critical(sacIO)
-   fsac.read( reinterpret_cast<char *>(&shd), rdsize );
-	if( fsac.gcount() != rdsize )
-		throw ErrorSR::BadFile( FuncName, "failed to retrieve sac header from "+fname+
-													 "("+std::to_string(fsac.gcount())+std::to_string(rdsize)+")" );
-   fsac.close();
-   //pthread_mutex_unlock(&fiolock);
-	// make sure shd.e is filled
-	if( shd.npts > 0 ) shd.e = shd.b + shd.delta * (shd.npts-1);
+	const bool succeed = PreadAll( fd, &shd, sizeof(SAC_HD), 0 );
+	close(fd);
+	if( ! succeed )
+		throw ErrorSR::BadFile( FuncName, "failed to retrieve sac header from " + fname );
+	FixByteOrder( shd );
 }
 
-/* load sac header+signal from file 'fname', memory is allocated on heap */
+/* load sac header+signal from file 'fname', memory is allocated on heap.
+	Positional reads straight into the signal buffer: files are loaded concurrently without
+	locking. (A mapped SacView costs more than it saves when the signal is copied anyway.) */
 void SacRec::Load () {
-   std::ifstream fsac(fname);
-   if( ! fsac )
+	const int fd = open( fname.c_str(), O_RDONLY );
+	if( fd < 0 )
 		throw ErrorSR::BadFile( FuncName, "reading from " + fname );
-   //if( SHDMap.empty() ) pimpl->CreateSHDMap();
-   //pthread_mutex_lock(&fiolock);
-	size_t rdsize = sizeof(SAC_HD);
-	#pragma omp critical(sacIO)
-   fsac.read( reinterpret_cast<char *>(&shd), rdsize );
-	if( fsac.gcount() != rdsize )
-		throw ErrorSR::BadFile( FuncName, "failed to retrieve sac header from " + fname );
-   //pthread_mutex_unlock(&fiolock);
-	// make sure shd.e is filled
-	if( shd.npts > 0 ) shd.e = shd.b + shd.delta * (shd.npts-1);
+	const std::string funcname = FuncName;	// __FUNCTION__ in the lambda would be operator()
+	auto Fail = [&]( const std::string& info, const bool badfile ) {
+		close(fd);
+		if( badfile ) throw ErrorSR::BadFile( funcname, info );
+		throw ErrorSR::BadParam( funcname, info );
+	};
+	if( ! PreadAll( fd, &shd, sizeof(SAC_HD), 0 ) )
+		Fail( "failed to retrieve sac header from " + fname, true );
+	const bool swapped = FixByteOrder( shd );
 	// allocate memory for sac signal
 	if( shd.npts <= 0 )
-		throw ErrorSR::BadParam( FuncName, "negative npts("+std::to_string(shd.npts)+") in header");
-   sig.reset(new float[shd.npts]);
-	if( ! sig )
-		throw ErrorSR::MemError( FuncName, "new failed!");
-   float* sigsac = sig.get();
-	rdsize = sizeof(float) * shd.npts;
-	#pragma omp critical(sacIO)
-   fsac.read( reinterpret_cast<char *>(sigsac), rdsize );
-	if( fsac.gcount() != rdsize )
-		throw ErrorSR::BadFile( FuncName, "failed to extract sac sig from " + fname );
-   fsac.close();
+		Fail( "negative npts("+std::to_string(shd.npts)+") in header", false );
+   sig.reset(SigMem::Alloc(shd.npts));
+	if( ! PreadAll( fd, sig.get(), sizeof(float)*shd.npts, sizeof(SAC_HD) ) )
+		Fail( "failed to extract sac sig from " + fname, true );
+	close(fd);
+	if( swapped ) {
+		float* sigsac = sig.get();
+		for( int i=0; i<shd.npts; i++ ) Swap4( &sigsac[i] );
+	}
 
    /* calculate t0 */
-   char koo[9];
-   for ( int i=0; i<8; i++ ) koo[i] = shd.ko[i]; koo[8] = 0;
-   float fes;
-   int eh, em;
-   sscanf(koo,"%d%*[^0123456789]%d%*[^.0123456789]%g",&eh,&em,&fes);
-   shd.o = shd.b + (shd.nzhour-eh)*3600. + (shd.nzmin-em)*60. + shd.nzsec-fes + shd.nzmsec*.001;
+   SetOrigin( shd );
+}
+
+/* copy header+signal from a mapped sac file */
+void SacRec::Load( const SacView& view ) {
+	if( ! view.Sig() )
+		throw ErrorSR::EmptySig( FuncName, "no signal mapped for " + view.Name() );
+	fname = view.Name(); shd = view.Header();
+	sig.reset(SigMem::Alloc(shd.npts));
+	std::copy( view.Sig(), view.Sig()+shd.npts, sig.get() );
+	SetOrigin( shd );
 }
 
 /* write to file '*outfname' */
@@ -1058,8 +1287,8 @@ void SacRec::Write (const std::string& outfname) {
    if( ! sig )
 		throw ErrorSR::EmptySig( FuncName, "writing to " + outfname );
    /* open file */
-   std::ofstream fsac(outfname);
-   if( ! fsac )
+	const int fd = open( outfname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+   if( fd < 0 )
 		throw ErrorSR::BadFile( FuncName, "writing to " + outfname );
    /* update header */
    shd.iftype = (int)ITIME;
@@ -1072,13 +1301,28 @@ void SacRec::Write (const std::string& outfname) {
    /* check and re-format header time if necessary */
    UpdateTime();
 
-   //pthread_mutex_lock(&fiolock);
-	#pragma omp critical(sacIO)
-	{
-   fsac.write( reinterpret_cast<char *>(&shd), sizeof(SAC_HD) );
-   fsac.write( reinterpret_cast<char *>(sig.get()), sizeof(float)*shd.npts );
-   fsac.close();
+	// header and signal go out from memory in one gathered write: concurrent writers need no lock
+	struct iovec iov[2] = { { &shd, sizeof(SAC_HD) }, { sig.get(), sizeof(float)*shd.npts } };
+	size_t nleft = iov[0].iov_len + iov[1].iov_len;
+	struct iovec* piov = iov; int niov = 2;
+	while( nleft > 0 ) {
+		const ssize_t nw = writev( fd, piov, niov );
+		if( nw < 0 && errno == EINTR ) continue;
+		if( nw <= 0 ) {
+			close(fd);
+			throw ErrorSR::BadFile( FuncName, "failed to write to " + outfname );
+		}
+		nleft -= nw;
+		// skip what has been written
+		for( size_t n = nw; n > 0; ) {
+			const size_t nskip = std::min( n, piov->iov_len );
+			piov->iov_base = static_cast<char*>(piov->iov_base) + nskip;
+			piov->iov_len -= nskip; n -= nskip;
+			if( piov->iov_len == 0 ) { piov++; niov--; }
+		}
 	}
+	if( close(fd) != 0 )
+		throw ErrorSR::BadFile( FuncName, "failed to write to " + outfname );
 }
 
 void SacRec::LoadTXT( const std::string& fname ) {
@@ -1089,8 +1333,6 @@ void SacRec::LoadTXT( const std::string& fname ) {
 	// read from fin
 	std::vector< std::array<float, 2> > dataV;
 	float delta = -123.;
-	#pragma omp critical(sacIO)
-	{
 	float xold = -123.;
 	for(std::string line; std::getline(fin, line); ) {
 		std::stringstream ss(line);
@@ -1104,13 +1346,12 @@ void SacRec::LoadTXT( const std::string& fname ) {
 		} else if( xold!=-123. ) { delta = x - xold; }
 		xold = x;
 	}
-	}
 	// write header
 	shd.delta = delta;
 	shd.b = dataV.front()[0]; shd.e = dataV.back()[0];
 	shd.npts = (shd.e - shd.b) / delta + 1;
 	// allocate memory for sac signal
-   sig.reset(new float[shd.npts]());
+   sig.reset(SigMem::Alloc(shd.npts, true));
 	if( ! sig )
 		throw ErrorSR::MemError( FuncName, "new failed!");
    float* sigsac = sig.get();
@@ -1529,7 +1770,7 @@ void SacRec::Smooth( float timehlen, SacRec& sacout, bool abs, float tb, float t
 		sacout = *this;
 	} else {	// resize sacout.sig otherwise
 		sacout.shd = shd;
-		sacout.sig.reset( new float[shd.npts] );
+		sacout.sig.reset( SigMem::Alloc(shd.npts) );
 		if( ! sacout.sig )
 			throw ErrorSR::MemError( FuncName, "new failed!");
 	}
@@ -1567,6 +1808,7 @@ bool SacRec::Mean ( float tbegin, float tend, int step, float& mean ) const {
    }
 	if( neff == 0 ) return false;
 	mean /= neff;
+	return true;
 }
 
 bool SacRec::MeanStd ( float tbegin, float tend, int step, float& mean, float& std ) const {
@@ -1662,7 +1904,7 @@ void SacRec::Integrate( SacRec& sac_out ) const {
 	sac_am.Transform( [&](float& val) {
 		val /= omega;
 		omega += domega;
-	}, fl );
+	}, ifl );
 	// IFFT
 	sac_out.shd = shd;
 	sac_out.FromAmPh( sac_am, sac_ph );
@@ -1721,7 +1963,7 @@ void SacRec::ToAmPh_p( SacRec& sac_am, SacRec& sac_ph, const float fl, const flo
 
    //forming amplitude spectrum
    int nk = std::max(nfout, ns/2 + 1);
-   float *amp = new float[nk], *pha = new float[nk];
+   float *amp = SigMem::Alloc(nk), *pha = SigMem::Alloc(nk);
 	float delta = shd.delta;
 	float deltaf = 1./(delta*ns);
 	if( amp==nullptr || pha==nullptr )
@@ -1781,7 +2023,7 @@ void SacRec::FFT_p( SacRec& sac_re, SacRec& sac_im, const int nfout ) const {
 
    //forming spectrums
    int nk = std::max(nfout, ns/2 + 1);
-   float *re = new float[nk], *im = new float[nk];
+   float *re = SigMem::Alloc(nk), *im = SigMem::Alloc(nk);
 	float delta = shd.delta;
 	if( re==nullptr || im==nullptr )
 		throw ErrorSR::MemError( FuncName, "new failed!");
@@ -1855,7 +2097,7 @@ void SacRec::FromAmPh_p( SacRec& sac_am, SacRec& sac_ph, const short outtype ) {
 	if( shd.npts==NaN || shd.npts>ns ) shd.npts = ns;	//shd.npts = ns;
 	if( shd.delta == NaN ) shd.delta = 1.;
 	// run FFTW_F
-	sig.reset( new float[shd.npts] );
+	sig.reset( SigMem::Alloc(shd.npts) );
 	if( ! sig )
 		throw ErrorSR::MemError( FuncName, "new failed!");
 	pimpl->FFTW_F(plan, out, sig.get(), shd.npts, outtype);
@@ -2382,34 +2624,7 @@ void SacRec::Envelope( SacRec& sacout ) {
 void SacRec::cut( float tb, float te, SacRec& sac_result ) const {
 	if( !sig || shd.npts<=0 )	// check signal
 		throw ErrorSR::EmptySig(FuncName);
-
-   int nb = nint( (tb-shd.b) / shd.delta );
-   int ne = nint( (te-shd.b) / shd.delta );
-   if( nb>=ne || ne<0 || nb>shd.npts )
-		throw ErrorSR::BadParam( FuncName, "Invalid nb/ne/npts = " + std::to_string(nb) +
-										 "/" + std::to_string(ne) + "/" + std::to_string(shd.npts) );
-   int nptsnew = ne - nb + 1;
-   float* signew = (float *) calloc ( nptsnew, sizeof(float) );
-	if( signew == nullptr )
-		throw ErrorSR::MemError( FuncName, "calloc failed!");
-   // define start positions
-   int inew, iold;
-   if( nb < 0 ) { inew = -nb; iold = 0; }
-   else { inew = 0; iold = nb; }
-   // define copy size
-   float nptscpy = std::min( nptsnew - inew, shd.npts - iold - 1 );
-   // copy data
-   memcpy( &(signew[inew]), &(sig[iold]), nptscpy * sizeof(float) );
-   // reset sacT.sig
-   sac_result.sig.reset(signew);
-   // update shd
-   if( &(sac_result) != this ) {
-		sac_result.shd = shd;
-		sac_result.fname = fname;
-	}
-   sac_result.shd.b += nb * shd.delta;
-	sac_result.shd.e = sac_result.shd.b + (nptsnew-1) * shd.delta;
-   sac_result.shd.npts = nptsnew;
+	CutSig( shd, sig.get(), fname, tb, te, sac_result, FuncName );
 }
 
 
@@ -2453,7 +2668,7 @@ bool SacRec::merge( SacRec sacrec2 ) {
 		throw ErrorSR::BadParam( FuncName, "sps mismatch");
 
    /* allocate new space */
-   std::unique_ptr<float[]> sig0(new float[N]);
+   SigPtr sig0( SigMem::Alloc(N) );
 	if( ! sig0 )
 		throw ErrorSR::MemError( FuncName, "new failed!");
    std::fill(&(sig0[0]), &(sig0[N]), std::numeric_limits<float>::max()); // initialize the array to max float
@@ -2786,7 +3001,7 @@ void SacRec::Resample( int sps, bool fitParabola ) {
 	int nptst = (int)floor( ( t0 + (shd.npts-1)*shd.delta - t0new ) * sps ) + 1;
 	if( nptst < 1 ) throw ErrorSR::InsufData(FuncName, "npts<=0 after resampling");
    //int nptst = nint((shd.npts-1)*shd.delta*sps)+10;
-   std::unique_ptr<float[]> sig2(new float[nptst]);
+   SigPtr sig2( SigMem::Alloc(nptst) );
 	if( ! sig2 )
 		throw ErrorSR::MemError( FuncName, "new failed!");
 	float *sigsac = sig.get(), *sigsac2 = sig2.get();
@@ -2841,6 +3056,138 @@ void SacRec::Resample( int sps, bool fitParabola ) {
    shd.npts = j;
 }
 
+namespace {
+	/* per-thread FFT workspace: grow-only fftw_malloc'ed (SIMD aligned) buffers, and
+		r2c/c2r plans cached by FFT size (executed on the buffers through the new-array interface) */
+	class FFTArena {
+	public:
+		~FFTArena() {
+			#pragma omp critical(fftw)
+			{
+			for( auto& p : planM ) { fftw_destroy_plan(p.second[0]); fftw_destroy_plan(p.second[1]); }
+			}
+			fftw_free(rbuf); fftw_free(cbuf);
+		}
+		// plans may (re)allocate the buffers: get them before Real/Complex
+		const std::array<fftw_plan, 2>& Plans( const int n ) {
+			auto& p = planM[n];
+			if( ! p[0] ) {
+				double *r = Real(n); fftw_complex *c = Complex(n/2+1);
+				#pragma omp critical(fftw)
+				{
+				p[0] = fftw_plan_dft_r2c_1d( n, r, c, FFTW_ESTIMATE );
+				p[1] = fftw_plan_dft_c2r_1d( n, c, r, FFTW_ESTIMATE );
+				}
+			}
+			return p;
+		}
+		double* Real( const size_t n ) {
+			if( n > nr ) {
+				fftw_free(rbuf); rbuf = fftw_alloc_real(n); nr = n;
+				if( ! rbuf ) throw std::runtime_error("Error(FFTArena::Real): fftw_malloc failed!");
+			}
+			return rbuf;
+		}
+		fftw_complex* Complex( const size_t n ) {
+			if( n > nc ) {
+				fftw_free(cbuf); cbuf = fftw_alloc_complex(n); nc = n;
+				if( ! cbuf ) throw std::runtime_error("Error(FFTArena::Complex): fftw_malloc failed!");
+			}
+			return cbuf;
+		}
+	private:
+		double *rbuf = nullptr;
+		fftw_complex *cbuf = nullptr;
+		size_t nr = 0, nc = 0;
+		std::map<int, std::array<fftw_plan, 2>> planM;
+	};
+	thread_local FFTArena fftArena;
+}
+
+void SacRec::Preprocess( double f1, double f2, double f3, double f4, bool integrate, int sps ) {
+	if( shd.npts > maxnpts4parallel ) {
+		#pragma omp critical(largesig)
+		{
+		Preprocess_p(f1, f2, f3, f4, integrate, sps);
+		}
+	} else {
+		Preprocess_p(f1, f2, f3, f4, integrate, sps);
+	}
+}
+void SacRec::Preprocess_p( double f1, double f2, double f3, double f4, bool integrate, int sps ) {
+   if( ! sig )
+		throw ErrorSR::EmptySig(FuncName);
+	if( sps <= 0 ) sps = floor(1.0/shd.delta+0.5);
+	const float dt = 1./sps;
+	if( dt < shd.delta )
+		throw ErrorSR::BadParam( FuncName, "Upsampling not implemented" );
+	// grid alignment in the time domain (as Resample) unless decimating by an integer factor
+	const int iinc = (int)floor(dt/shd.delta+0.5);
+	const bool decimate = iinc!=1 && fabs(iinc*shd.delta-dt)<1.e-7;
+	if( ! decimate ) Resample( sps );
+	const int ninc = decimate ? iinc : 1, n = shd.npts;
+
+	// output grid
+	const double t0 = shd.nzmsec*0.001+shd.b, t0new = decimate ? ceil(t0*sps)*dt : t0;
+	int nout = n;
+	if( decimate ) {
+		nout = (int)floor( ( t0 + (n-1)*shd.delta - t0new ) * sps ) + 1;
+		if( nout < 1 ) throw ErrorSR::InsufData(FuncName, "npts<=0 after resampling");
+	}
+
+	// FFT sizes: ns (input) is a multiple of nsd (output)
+	const int nd = (n-1)/ninc + 1;
+	const int nsd = (int)pow(2, (int)(log((double)nd)/log(2.))+1), ns = nsd * ninc;
+	const int nkd = nsd/2 + 1;
+	const fftw_plan planF = fftArena.Plans(ns)[0], planB = fftArena.Plans(nsd)[1];
+	double *rbuf = fftArena.Real(ns);
+	fftw_complex *cbuf = fftArena.Complex(ns/2+1);
+
+	// forward FFT of the zero-padded signal
+	const float *sigsac = sig.get();
+	std::copy( sigsac, sigsac+n, rbuf );
+	std::fill( rbuf+n, rbuf+ns, 0. );
+	{ PROFILE_SCOPE("FFTW"); fftw_execute_dft_r2c( planF, rbuf, cbuf ); }
+
+	// spectral operators, up to the output Nyquist
+	const double df = 1./(shd.delta*ns);
+	if( decimate ) pimpl->cosTaperR( sps/2.2, sps/2.01, df, nkd, cbuf, 1 );	// anti-aliasing
+	if( integrate ) {	// divide by i*omega, with everything below 1000 sec removed (as Integrate)
+		const int ifl = std::max( 1, std::min( nint(0.001/df), nkd ) );
+		std::fill( &(cbuf[0][0]), &(cbuf[ifl][0]), 0. );
+		const double domega = 2. * M_PI * df;
+		for( int k=ifl; k<nkd; k++ ) {
+			const double omega = k * domega, re = cbuf[k][0];
+			cbuf[k][0] = cbuf[k][1] / omega;
+			cbuf[k][1] = -re / omega;
+		}
+	}
+   if( f4 > 0.5/dt ) f4 = 0.49999/dt;
+	pimpl->cosTaperB( f1, f2, f3, f4, df, nkd, cbuf, 1 );
+	if( decimate ) {	// shift onto the output grid
+		const double dphi = 2. * M_PI * df * (t0new-t0);
+		for( int k=1; k<nkd; k++ ) {
+			const double c = cos(k*dphi), s = sin(k*dphi), re = cbuf[k][0], im = cbuf[k][1];
+			cbuf[k][0] = re*c - im*s;
+			cbuf[k][1] = re*s + im*c;
+		}
+	}
+
+	// inverse FFT of the (truncated) spectrum
+	{ PROFILE_SCOPE("FFTW"); fftw_execute_dft_c2r( planB, cbuf, rbuf ); }
+	if( nout != n ) sig.reset( SigMem::Alloc(nout) );
+	float *sigout = sig.get();
+	const double fnorm = 1./ns;
+	for( int i=0; i<nout; i++ ) sigout[i] = rbuf[i] * fnorm;
+	if( decimate ) {
+		shd.nzmsec = 0.;
+		shd.b = t0new;
+		shd.delta = dt;
+		shd.npts = nout;
+	}
+	shd.e = shd.b + (shd.npts-1)*shd.delta;
+}
+
 void SacRec::Interpolate( int npts_ratio, SacRec& sac2 ) const {
 	if( npts_ratio <= 1 ) return;
 	if( ! sig )
@@ -2851,7 +3198,7 @@ void SacRec::Interpolate( int npts_ratio, SacRec& sac2 ) const {
 	sac2.shd = shd;
 	sac2.shd.npts = npts2; sac2.shd.delta /= npts_ratio;
 	sac2.sig.reset();
-	sac2.sig.reset( new float[npts2] );
+	sac2.sig.reset( SigMem::Alloc(npts2) );
 
 	// interpolate starts
 	auto sigsac = sig.get(), sig2sac = sac2.sig.get();
@@ -3177,7 +3524,7 @@ void SacRec::CCFromAmPh(SacRec& sac_am, SacRec& sac_ph, const SAC_HD& shd1, cons
 	shd.evlo = shd1.stlo; shd.stlo = shd2.stlo;
 	shd.evla = shd1.stla; shd.stla = shd2.stla;
 	pimpl->ComputeDisAzi( shd );
-	sig.reset( new float[lag*2+1]() );
+	sig.reset( SigMem::Alloc(lag*2+1, true) );
 	float *cor = sig.get(), *CCout = sac_CC.sig.get();
    for( int i = 1; i< (lag+1); i++) {
       cor[lag+i] =  CCout[i];
@@ -9,6 +9,7 @@
 #include <sstream>
 #include <string>
 #include <memory>
+#include <vector>
 #include <limits>
 #include <stdexcept>
 #include <cmath>
@@ -96,13 +97,60 @@ namespace ErrorSR {
 };
 
 
+/* ---------- signal buffers ---------- */
+/* 64-byte aligned (SIMD/FFTW) signal buffers behind SacRec::sig.
+	With the pool on, freed buffers are kept in per-thread power-of-two size classes and
+	handed out again, so the temporary SacRecs of a misfit evaluation stop hitting malloc.
+	Trim() gives back what is above the per-thread cap (call it after each energy evaluation). */
+namespace SigMem {
+	float* Alloc( const size_t n, const bool zero = false );	// throws ErrorSR::MemError
+	void Free( float* p );
+	void UsePool( const bool use, const size_t capMB = 64 );
+	void Trim();
+};
+struct SigDeleter { void operator()( float* p ) const { SigMem::Free(p); } };
+typedef std::unique_ptr<float[], SigDeleter> SigPtr;
+
+
+/* ---------- mapped sac files ---------- */
+/* Read-only view of a sac file through mmap. No state is shared between views, so files can be
+	read concurrently without locking. The header is checked and put into native byte order;
+	Sig() points into the mapping itself unless the file was written in the other byte order,
+	in which case the signal is swapped into a private copy. */
+class SacRec;
+class SacView {
+public:
+	SacView( const std::string& fnamein, const bool loadsig = true );	// throws ErrorSR::BadFile/BadParam
+	~SacView();
+	SacView( const SacView& ) = delete;
+	SacView& operator=( const SacView& ) = delete;
+
+	const std::string& Name() const { return fname; }
+	const SAC_HD& Header() const { return shd; }
+	const float* Sig() const { return sig; }	// valid for the lifetime of the view (nullptr if !loadsig)
+	bool Swapped() const { return swapped; }
+
+	/* copy the samples in [tb, te] into sac_result, as SacRec::Load followed by SacRec::cut
+		but with only the window copied out of the mapping */
+	void cut( float tb, float te, SacRec& sac_result ) const;
+
+private:
+	std::string fname;
+	void* base = nullptr; size_t len = 0;
+	SAC_HD shd;
+	const float* sig = nullptr;
+	bool swapped = false;
+	std::vector<float> sigswap;
+};
+
+
 //enum SACTYPE { TIME, AMP, PHA, DISP };
 
 class SacRec {
 public:
    std::string fname;			// input file name
    SAC_HD shd;				// sac header
-   std::unique_ptr<float[]> sig;	// pointer to the signal
+   SigPtr sig;				// pointer to the signal (from SigMem)
    //std::auto_ptr<float> sig;
 public:
    /* ------------------------------ con/destructors and operators ------------------------------ */
@@ -139,9 +187,7 @@ public:
 		if( npts <= 0 )
 			throw ErrorSR::BadParam( FuncName, "negative npts!");
 		shd.npts = npts; shd.e = shd.b + shd.delta*npts;
-		sig.reset(new float[npts]);
-		if( ! sig )
-			throw ErrorSR::MemError( FuncName, "new failed!");
+		sig.reset( SigMem::Alloc(npts) );
 	}
 
    /* ------------------------------ sac file read/write ------------------------------ */
@@ -151,6 +197,8 @@ public:
    /* read sac header+signal from file 'fname', memory is allocated on heap */
    void Load();
    void Load( const std::string& fnamein ) { fname = fnamein; Load(); }
+   /* copy header+signal from a mapped sac file */
+   void Load( const SacView& view );
 	/* clear sac and release memory */
 	void clear() { sig.reset(); shd = sac_null; fname.clear(); }
    /* write to file '*fname' */
@@ -397,6 +445,12 @@ public:
    /* resample (with anti-aliasing filter) the signal to given sps */
    //void Resample( bool fitParabola = true ) { Resample( floor(1.0/shd.delta+0.5), fitParabola ); }
    void Resample( int sps = -1, bool fitParabola = true );
+	/* fused Resample(sps) + Integrate (if integrate) + BandpassCOSFilt(f1,f2,f3,f4) with a single forward
+		and a single inverse real FFT on per-thread workspace. Grid alignment without decimation is done
+		as in Resample. Otherwise the anti-aliasing filter and the grid shift are applied in the same
+		spectral multiply, and the decimation is a truncation of the spectrum */
+	void Preprocess( double f1, double f2, double f3, double f4, bool integrate = false, int sps = -1 );	// in series when sig is large
+	void Preprocess_p( double f1, double f2, double f3, double f4, bool integrate = false, int sps = -1 );	// always parallel
    void Interpolate( int npts_ratio ) {
 		SacRec sac2;
 		Interpolate(npts_ratio, sac2);
@@ -1,10 +1,16 @@
 #include "SynGenerator.h"
 #include "SacRec.h"
+#include "Profiler.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
 
 /* FORTRAN entrance */
 
@@ -17,8 +23,10 @@ extern"C" {
 
 	void angles2tensor_(float* stk, float* dip, float* rak, float tm[6]);
 
-	void atracer_( char name_fmodel[256], float* elat, float* elon, int* ncor, bool* applyQ, int* nper, int* nsta,
-						float latc[2000], float lon[2000], float* cor );
+	void atracer_open_( char name_fmodel[256], int* nper, void** handle, int* ierr );
+	void atracer_trace_( void** handle, int* iper, float* elat, float* elon, bool* applyQ,
+								float* slatc, float* slon, float* cor1, float* cor2 );
+	void atracer_close_( void** handle );
 
 //	void surfread_( char name_feigen[255], char* sigR, char* sigL, char modestr[2], int* nper, int* nd, float* depth, float freq[2000],
 	void surfread_( char *feig_buff, int *eig_len, char* sigR, char* sigL, char modestr[2], int* nper, float* depth, float freq[2000],
@@ -39,6 +47,8 @@ extern"C" {
 
 void SynGenerator::Initialize( const fstring& name_fmodel_in, const fstring& name_fphvel, const fstring& name_feigen_in, const char wavetype, int mode ) {
 	name_fmodel = name_fmodel_in;
+	pmodel.reset();
+	ptrace = std::make_shared<InnerThreads>();
 	name_feigen = name_feigen_in;
 	type = wavetype;
 	// input params
@@ -73,14 +83,21 @@ void SynGenerator::Initialize( const fstring& name_fmodel_in, const fstring& nam
 	// update permin, permax, and nt by fphvel
 	ReadPerRange( name_fphvel, mode );
 
-	// read feigen into memory
+	// load feigen (parsed once into the shared eigen cache)
+	er.reLoad( name_feigen, mode );
+	const auto& et = er.Table();
+	if( et.type != type )
+		throw std::runtime_error("Error(Initialize): wave type mismatch in "+name_feigen);
+	if( et.nper() < nper )
+		throw std::runtime_error("Error(Initialize): too few periods in "+name_feigen);
+	/*
 	std::ifstream fin( name_feigen );
 	if( ! fin ) throw std::runtime_error("Error(Initialize): IO failed on "+name_feigen);
 	fin.seekg(0, std::ios::end); feig_len = fin.tellg();
 	peig.reset( new char[feig_len] );
 	fin.seekg(0, std::ios::beg);
 	fin.read(peig.get(), feig_len);
-	//std::cerr<<feig_len<<" characters read from "<<name_feigen<<std::endl;
+	*/
 }
 
 void SynGenerator::ReadPerRange( const std::string& name_fphvel, const int mode ) {
@@ -132,16 +149,19 @@ void SynGenerator::LoadSta( const std::string name_fsta ) {
 	std::ifstream fin(name_fsta);
 	if( ! fin )
 		throw std::runtime_error("IO failed on " + name_fsta);
-	nsta = 0;
+	nsta = 0; staM.clear();
 	for( std::string line; std::getline(fin,line); ) {
 		if( sscanf(line.c_str(), "%s %s %f %f", net[nsta], sta[nsta], &(lat[nsta]), &(lon[nsta])) != 4 )
 			continue;
 		latc[nsta] = atan(GEO*tan(pio180*lat[nsta]))/pio180;
+		staM.emplace( sta[nsta], nsta );
 		nsta++;
 	}
 
 	// needs re-trace
 	traced = false;
+	if( pbasis ) pbasis->clear();
+	ptable.reset();
 }
 
 void SynGenerator::PushbackSta( const SacRec& sac ) {
@@ -151,8 +171,21 @@ void SynGenerator::PushbackSta( const SacRec& sac ) {
 	lat[nsta] = sac.shd.stla;
 	latc[nsta] = atan(GEO*tan(pio180*lat[nsta]))/pio180;
 	//std::cerr<<sta[nsta]<<" "<<net[nsta]<<" "<<lon[nsta]<<" "<<lat[nsta]<<" "<<latc[nsta]<<std::endl;
+	staM.emplace( sta[nsta], nsta );
 	nsta++;
 	traced = false;
+	if( pbasis ) pbasis->clear();
+	ptable.reset();
+}
+
+int SynGenerator::FindSta( const std::string& staname, const float slon, const float slat ) const {
+	int ista = -1;
+	const auto range = staM.equal_range( staname );
+	for( auto I=range.first; I!=range.second; I++ ) {
+		const int i = I->second;
+		if( slon==lon[i] && slat==lat[i] && (ista<0 || i<ista) ) ista = i;
+	}
+	return ista;
 }
 
 void SynGenerator::SetEvent( const ModelInfo mi ) {
@@ -166,36 +199,259 @@ void SynGenerator::SetEvent( const ModelInfo mi ) {
 	aM = mi.M0;
 	angles2tensor_(&minfo.stk, &minfo.dip, &minfo.rak, tm);
 
-	// call surfread with the new depth
+	// fill surf_disp data at the new depth
+	FillSurfData( minfo.dep );
 	//#pragma omp critical
-	surfread_( peig.get(), &feig_len, &sigR, &sigL, modestr, &nper, &(minfo.dep), freq, cr, ur, wvr,
-				  cl, ul, wvl, v, dvdz, ampr, ampl, ratio, qR, qL, I0 );
-	//surfread_( name_feigen.f_str(255), &sigR, &sigL, modestr, &nper, &nd, &(minfo.dep), freq, cr, ur, wvr,
+	//surfread_( peig.get(), &feig_len, &sigR, &sigL, modestr, &nper, &(minfo.dep), freq, cr, ur, wvr,
+	//			  cl, ul, wvl, v, dvdz, ampr, ampl, ratio, qR, qL, I0 );
 
 	// needs re-trace
 	traced = false;
 }
 
+/* the output of surfread.f (1-based, with periods at 2 - nper+1) from the eigen cache */
+void SynGenerator::FillSurfData( const float dep ) {
+	const float pi2 = 6.28318, tlim = 10000.;
+	const auto& et = er.Table();
+	float eH[nper], deH[nper], eV[nper], deV[nper];
+	et.AtDep( dep, eH, deH, eV, deV );
+	wvl[0] = qL[0] = ul[0] = 0.;
+	wvr[0] = qR[0] = ur[0] = 0.;
+	for( int i=0; i<nper; i++ ) {
+		int k = i + 1;
+		freq[k] = 1. / et.per[i];
+		I0[k] = et.I0[i];
+		if( type == 'R' ) {
+			cr[k] = et.phv[i]; ur[k] = et.grv[i]; wvr[k] = et.wvn[i];
+			ampr[k] = et.amp[i]; ratio[k] = et.ratio[i]; qR[k] = et.Q[i];
+			v[k][0] = eH[i]; dvdz[k][0] = deH[i];
+			v[k][1] = eV[i]; dvdz[k][1] = deV[i];
+		} else {
+			cl[k] = et.phv[i]; ul[k] = et.grv[i]; wvl[k] = et.wvn[i];
+			ampl[k] = et.amp[i]; qL[k] = et.Q[i];
+			v[k][2] = eH[i]; dvdz[k][2] = deH[i];
+		}
+	}
+	int kend = nper + 1;
+	if( type == 'R' ) {
+		wvr[0] = pi2 / cr[1] / tlim;
+		wvr[kend] = ampr[kend] = qR[kend] = ur[kend] = 0.;
+	} else {
+		wvl[0] = pi2 / cl[1] / tlim;
+		wvl[kend] = ampl[kend] = qL[kend] = ul[kend] = 0.;
+	}
+}
+
+void SynGenerator::LoadModel() {
+	// load once (atracer_close when the last copy is gone)
+	if( pmodel ) return;
+	void* handle = nullptr; int ierr;
+	atracer_open_( name_fmodel.f_str(256), &nper, &handle, &ierr );
+	if( ierr != 0 )
+		throw std::runtime_error("atracer_open failed on " + name_fmodel + " (ierr = " + std::to_string(ierr) + ")");
+	pmodel.reset( handle, [](void* h) { atracer_close_( &h ); } );
+}
+
 void SynGenerator::TraceAll() {
-	// call atracer
-	int ncor;
-	bool applyQ = true;
-   //std::unique_ptr<float[]> pcor( new float[2000*2*500]() ); float *cor = pcor.get();
-	pcor.reset( new float[2000*2*500]() );
+	PROFILE_SCOPE("SynGenerator::TraceAll");
+	LoadModel();
+	// every (station, period) in use is rewritten below: allocate only once
+	if( ! pcor ) pcor.reset( new float[2000*2*500]() );
 	if( ! pcor )
 		throw std::runtime_error("new failed for pcor!");
-	//#pragma omp critical
-	atracer_( name_fmodel.f_str(256), &elat, &elon, &ncor, &applyQ, &nper, &nsta, latc, lon, pcor.get() );
-	//atracer_( fstr_fmodel, &elat, &elon, &ncor, &applyQ, &nsta, latc, lon, pcor.get() );
+	// interpolate the path table, leaving the paths it cannot give
+	std::vector<int> itraceV;
+	if( ! ptable || ! ptable->Interpolate( elon, elat, pcor.get(), itraceV ) ) {
+		itraceV.resize( nsta * nper );
+		for( int i=0; i<itraceV.size(); i++ ) itraceV[i] = i;
+	}
+	// trace each (station, period) as a task. pcor is cor(500,2,2000) in atracer
+	bool applyQ = true;
+	void* handle = pmodel.get();
+	const int ntrace = itraceV.size(), nthd = ntrace_thd>0 ? ntrace_thd : (ptrace ? ptrace->Get(ntrace) : 1);
+	const auto tb = std::chrono::steady_clock::now();
+	ParallelTasks( ntrace, nthd, [&]( const int i ) {
+		const int ista = itraceV[i] / nper;
+		int iper = itraceV[i] % nper + 1;
+		float* cor = pcor.get() + ista*1000 + iper-1;
+		atracer_trace_( &handle, &iper, &elat, &elon, &applyQ, &(latc[ista]), &(lon[ista]), cor, cor+500 );
+	} );
+	if( ntrace_thd<=0 && ntrace>0 && ptrace )
+		ptrace->Record( std::chrono::duration<float>(std::chrono::steady_clock::now()-tb).count(), ntrace, nthd );
 	// all traced
 	traced = true;
 }
 
+/* ---------- PathTable ---------- */
+namespace {
+	const char PathTabMagic[8] = "EQKPTAB";
+	const uint32_t PathTabVersion = 1;
+
+	// FNV-1a (64 bits)
+	const uint64_t FNVOffset = 14695981039346656037ULL, FNVPrime = 1099511628211ULL;
+	inline void FNVUpdate( uint64_t& h, const char* buff, const size_t n ) {
+		for( size_t i=0; i<n; i++ ) { h ^= (unsigned char)buff[i]; h *= FNVPrime; }
+	}
+	template <class T> inline void FNVUpdate( uint64_t& h, const T& val ) {
+		FNVUpdate( h, reinterpret_cast<const char*>(&val), sizeof(T) );
+	}
+}
+
+void SynGenerator::LoadPathTable( const std::string& fname, const float lonmin, const float lonmax,
+											 const float latmin, const float latmax, const float dgrid ) {
+	if( dgrid<=0. || lonmax<lonmin || latmax<latmin )
+		throw std::runtime_error("Error(LoadPathTable): invalid grid");
+	LoadModel();
+	// the grid covers the box with a node to spare on each side
+	const int nlon = ceil((lonmax-lonmin)/dgrid) + 3, nlat = ceil((latmax-latmin)/dgrid) + 3;
+	auto ptab = std::make_shared<PathTable>( lonmin-dgrid, latmin-dgrid, dgrid, nlon, nlat, nsta, nper );
+
+	// key: the model file, periods, stations, and grid
+	uint64_t key = FNVOffset;
+	std::ifstream fin( name_fmodel, std::ios::binary );
+	if( ! fin )
+		throw std::runtime_error("IO failed on " + name_fmodel);
+	char buff[65536];
+	while( fin ) {
+		fin.read( buff, sizeof(buff) );
+		FNVUpdate( key, buff, fin.gcount() );
+	}
+	FNVUpdate( key, nper ); FNVUpdate( key, nsta );
+	FNVUpdate( key, reinterpret_cast<const char*>(latc), nsta*sizeof(float) );
+	FNVUpdate( key, reinterpret_cast<const char*>(lon), nsta*sizeof(float) );
+	float lon0, lat0; ptab->NodeLoc( 0, lon0, lat0 );
+	FNVUpdate( key, lon0 ); FNVUpdate( key, lat0 ); FNVUpdate( key, dgrid );
+	FNVUpdate( key, nlon ); FNVUpdate( key, nlat );
+
+	// load the nodes on file and trace the rest, a node per task
+	std::vector<char> done;
+	ptab->Open( fname, key, done );
+	std::vector<int> inodeV;
+	for( int inode=0; inode<ptab->NNode(); inode++ )
+		if( ! done[inode] ) inodeV.push_back( inode );
+	std::cout<<"### SynGenerator::LoadPathTable: "<<ptab->NNode()-inodeV.size()<<" of "<<nlon<<"x"<<nlat<<" epicenters loaded from "
+				<<fname<<", tracing "<<inodeV.size()<<". ###"<<std::endl;
+	bool applyQ = true;
+	void* handle = pmodel.get();
+	ParallelTasks( inodeV.size(), ntrace_thd>0 ? ntrace_thd : omp_get_max_threads(), [&]( const int i ) {
+		const int inode = inodeV[i];
+		float evlon, evlat; ptab->NodeLoc( inode, evlon, evlat );
+		float* cor = ptab->Node( inode );
+		for( int ista=0; ista<nsta; ista++ )
+			for( int iper=1; iper<=nper; iper++ ) {
+				float* corsta = cor + ista*2*nper + iper-1;
+				atracer_trace_( &handle, &iper, &evlat, &evlon, &applyQ, &(latc[ista]), &(lon[ista]), corsta, corsta+nper );
+			}
+		ptab->WriteNode( inode );
+	} );
+	ptab->Close();
+
+	ptable = ptab;
+	traced = false;
+}
+
+void PathTable::Open( const std::string& fname, const uint64_t key, std::vector<char>& done ) {
+	Close();
+	done.assign( NNode(), false );
+	fd = open( fname.c_str(), O_RDWR | O_CREAT, 0644 );
+	if( fd < 0 )
+		throw std::runtime_error("IO failed on " + fname);
+	char magic[8]; uint32_t version; uint64_t keyin;
+	bool match = pread(fd, magic, 8, 0)==8 && memcmp(magic, PathTabMagic, 8)==0 &&
+					 pread(fd, &version, sizeof(version), 8)==sizeof(version) && version==PathTabVersion &&
+					 pread(fd, &keyin, sizeof(keyin), 12)==sizeof(keyin) && keyin==key;
+	if( match ) {
+		// nodes with a matching hash are complete
+		const size_t nbyte = nodesize * sizeof(float);
+		for( int inode=0; inode<NNode(); inode++ ) {
+			uint64_t hash = 0, hin;
+			char* pnode = reinterpret_cast<char*>(Node(inode));
+			if( pread(fd, pnode, nbyte, NodeOffset(inode)) != (ssize_t)nbyte ||
+				 pread(fd, &hin, sizeof(hin), NodeOffset(inode)+nbyte) != sizeof(hin) ) continue;
+			hash = FNVOffset; FNVUpdate( hash, pnode, nbyte );
+			done[inode] = hash == hin;
+		}
+	} else {
+		// start over
+		if( ftruncate(fd, 0)!=0 || pwrite(fd, PathTabMagic, 8, 0)!=8 ||
+			 pwrite(fd, &PathTabVersion, sizeof(PathTabVersion), 8)!=sizeof(PathTabVersion) ||
+			 pwrite(fd, &key, sizeof(key), 12)!=sizeof(key) )
+			throw std::runtime_error("IO failed on " + fname);
+	}
+}
+
+void PathTable::WriteNode( const int inode ) const {
+	const size_t nbyte = nodesize * sizeof(float);
+	const char* pnode = reinterpret_cast<const char*>(Node(inode));
+	uint64_t hash = FNVOffset; FNVUpdate( hash, pnode, nbyte );
+	// a node is complete once its hash is on file
+	if( pwrite(fd, pnode, nbyte, NodeOffset(inode)) != (ssize_t)nbyte ||
+		 pwrite(fd, &hash, sizeof(hash), NodeOffset(inode)+nbyte) != sizeof(hash) )
+		std::cerr<<"Warning(PathTable::WriteNode): failed to write node "<<inode<<std::endl;
+}
+
+void PathTable::Close() {
+	if( fd >= 0 ) close( fd );
+	fd = -1;
+}
+
+bool PathTable::Interpolate( const float lon, const float lat, float* pcor, std::vector<int>& itraceV ) const {
+	const float fx = (lon-lon0) / dgrid, fy = (lat-lat0) / dgrid;
+	if( fx<0. || fy<0. || fx>nlon-1 || fy>nlat-1 ) return false;
+	const int ix = std::min( (int)fx, nlon-2 ), iy = std::min( (int)fy, nlat-2 );
+	const float wx = fx - ix, wy = fy - iy;
+	const float w00 = (1.-wx)*(1.-wy), w10 = wx*(1.-wy), w01 = (1.-wx)*wy, w11 = wx*wy;
+	const float *c00 = Node(iy*nlon+ix), *c10 = c00 + nodesize, *c01 = c00 + nlon*nodesize, *c11 = c01 + nodesize;
+	itraceV.clear();
+	for( int ista=0; ista<nsta; ista++ )
+		for( int iper=0; iper<nper; iper++ ) {
+			const int iv = ista*2*nper + iper, ia = iv + nper;
+			if( c00[iv]<0. || c10[iv]<0. || c01[iv]<0. || c11[iv]<0. ) {
+				itraceV.push_back( ista*nper + iper );
+				continue;
+			}
+			float* cor = pcor + ista*1000 + iper;
+			cor[0] = w00*c00[iv] + w10*c10[iv] + w01*c01[iv] + w11*c11[iv];
+			cor[500] = w00*c00[ia] + w10*c10[ia] + w01*c01[ia] + w11*c11[ia];
+		}
+	return true;
+}
+
+/* cal_synsac writes the end points of freq, qR, and qL (fr(1), fr(nt+2), ...): each call
+	gets a per-thread copy, so that a SynGenerator can synthesize on several threads at once */
+SynGenerator::FortranWorkspace& SynGenerator::FortranWork() const {
+	thread_local FortranWorkspace fw;
+	const int n = std::min( nper+2, 2000 );
+	std::copy( freq, freq+n, fw.freq );
+	std::copy( qR, qR+n, fw.qR ); std::copy( qL, qL+n, fw.qL );
+	return fw;
+}
+
 bool SynGenerator::ComputeSyn( const std::string& staname, const float slon, const float slat, int npts, float delta,
 										 SacRec& sacz, SacRec& sac1, SacRec& sac2, bool rotate, float f1, float f2, float f3, float f4 ) {
-	// trace all GCPs
-	if( ! traced ) TraceAll();
+	return ComputeSyn( FindSta(staname, slon, slat), npts, delta, sacz, sac1, sac2, rotate, f1, f2, f3, f4 );
+}
 
+bool SynGenerator::ComputeSyn( const int ista, int npts, float delta,
+										 SacRec& sacz, SacRec& sac1, SacRec& sac2, bool rotate, float f1, float f2, float f3, float f4 ) {
+	return Synthesize( aM, tm, ista, npts, delta, sacz, sac1, sac2, rotate, f1, f2, f3, f4 );
+}
+
+bool SynGenerator::ComputeSynUnit( const int m, const std::string& staname, const float slon, const float slat, int npts, float delta,
+											  SacRec& sacz, SacRec& sac1, SacRec& sac2, bool rotate, float f1, float f2, float f3, float f4 ) {
+	return ComputeSynUnit( m, FindSta(staname, slon, slat), npts, delta, sacz, sac1, sac2, rotate, f1, f2, f3, f4 );
+}
+
+bool SynGenerator::ComputeSynUnit( const int m, const int ista, int npts, float delta,
+											  SacRec& sacz, SacRec& sac1, SacRec& sac2, bool rotate, float f1, float f2, float f3, float f4 ) {
+	if( m<0 || m>=6 )
+		throw std::runtime_error("Error(SynGenerator::ComputeSynUnit): invalid tensor component "+std::to_string(m));
+	float tme[6] = {0., 0., 0., 0., 0., 0.}; tme[m] = 1.;
+	return Synthesize( 1., tme, ista, npts, delta, sacz, sac1, sac2, rotate, f1, f2, f3, f4 );
+}
+
+bool SynGenerator::Synthesize( const float aMw, const float* tmw, const int ista, int npts, float delta,
+										 SacRec& sacz, SacRec& sac1, SacRec& sac2, bool rotate, float f1, float f2, float f3, float f4 ) {
 	/*/ calc base size
 	int nbase = 2; n2pow = 1;
 	while( n2pow<13 && nbase<npoints ) { n2pow++; nbase <<= 1; }
@@ -213,16 +469,11 @@ bool SynGenerator::ComputeSyn( const std::string& staname, const float slon, con
 	//if( f1<1./permax || f4>1./permin )
 		//throw std::runtime_error("Error(SynGenerator::ComputeSyn): corner freq out of range!");
 
-	// search for the requested station in the list
-	int ista = 0;
-	for(; ista<nsta; ista++) {
-		if( staname == std::string(sta[ista]) &&
-			 slon == lon[ista] && slat == lat[ista] ) break;
-	}
-	if( ista == nsta ) return false;
+	// the requested station (FindSta)
+	if( ista<0 || ista>=nsta ) return false;
 
-	// station found. Produce synthetics
-	std::string netname = net[ista];// staname = sta[ista];
+	// Produce synthetics
+	const std::string staname = sta[ista], netname = net[ista];
 	//std::cerr<<ista<<" STA = "<<staname<<" NET = "<<netname<<" STLAT = "<<lat[ista]<<" STLON = "<<lon[ista]<<"\n";
 	// prepare sac headers
 	//SacRec sacz, sac1, sac2;
@@ -236,11 +487,43 @@ bool SynGenerator::ComputeSyn( const std::string& staname, const float slon, con
 	if(rotate) { init_sac( 'N', sac1 ); init_sac( 'E', sac2 ); }
 	else { init_sac( 'R', sac1 ); init_sac( 'T', sac2 ); }
 	//sacz.MutateAs(sacz); sac1.MutateAs(sacz); sac2.MutateAs(sacz);
-	int ista_f = ista+1;
-	cal_synsac_( &ista_f, &its, &sigR, &sigL, pcor.get(), &f1, &f2, &f3, &f4, &vmax, &fix_vel, &iq,
-			&npts, freq, &delta, &nper, &key_compr, &elatc, &elonc, qR, qL,
-			&im, &aM, tm, ampl, cl, cr, ul, ur, wvl, wvr, v, dvdz, ratio, I0,
-			&(latc[ista]), &(lon[ista]), sacz.sig.get(), sac1.sig.get(), sac2.sig.get(), &rotate );
+	// look for the synthetic basis of this station at the current location
+	std::shared_ptr<const SynBasisCache::StaBasis> pb;
+	const int nbase = NBase(npts);
+	if( pbasis && nbase>=npts ) {
+		int nvisit;
+		pb = pbasis->Find( elon, elat, minfo.dep, ista, nvisit );
+		if( pb && ! pb->Matches(nbase, delta, f1, f2, f3, f4, rotate) ) pb.reset();
+		if( !pb && nvisit>1 ) {
+			pb = BuildBasis( ista, nbase, delta, f1, f2, f3, f4, rotate );
+			pbasis->Insert( elon, elat, minfo.dep, ista, pb );
+		}
+	}
+	if( pb ) {
+		// weighted sum of the basis
+		float* sigA[3] = { sacz.sig.get(), sac1.sig.get(), sac2.sig.get() };
+		for( int ic=0; ic<3; ic++ ) {
+			float *sig = sigA[ic];
+			std::fill( sig, sig+npts, 0. );
+			for( int m=0; m<6; m++ ) {
+				const float w = aMw * tmw[m];
+				const float *basis = &(pb->sigV[ic][m*nbase]);
+				#pragma omp simd
+				for( int j=0; j<npts; j++ ) sig[j] += w * basis[j];
+			}
+		}
+	} else {
+		// trace all GCPs
+		if( ! traced ) TraceAll();
+		int ista_f = ista+1;
+		float aMe = aMw, tme[6]; std::copy( tmw, tmw+6, tme );
+		auto& fw = FortranWork();
+		PROFILE_SCOPE("cal_synsac_");
+		cal_synsac_( &ista_f, &its, &sigR, &sigL, pcor.get(), &f1, &f2, &f3, &f4, &vmax, &fix_vel, &iq,
+				&npts, fw.freq, &delta, &nper, &key_compr, &elatc, &elonc, fw.qR, fw.qL,
+				&im, &aMe, tme, ampl, cl, cr, ul, ur, wvl, wvr, v, dvdz, ratio, I0,
+				&(latc[ista]), &(lon[ista]), sacz.sig.get(), sac1.sig.get(), sac2.sig.get(), &rotate );
+	}
 	// check results
 	bool valid = sigR=='+' ? sacz.isValid() : sac2.isValid();
 	if( ! valid ) return false;
@@ -252,6 +535,72 @@ bool SynGenerator::ComputeSyn( const std::string& staname, const float slon, con
 	return true;
 }
 
+bool SynGenerator::CutSyn( const SacRec& sacF, const float t0, const int npts, SacRec& sac ) {
+	const int nptsF = sacF.shd.npts;
+	if( !sacF.sig || npts<=0 || npts>nptsF || nptsF>NBase(nptsF) || NBase(npts)!=NBase(nptsF) ) return false;
+	// header as from Synthesize
+	sac.shd = sacF.shd; sac.shd.b = 0.;
+	sac.ResizeSig( npts );
+	sac.shd.b += t0;
+	std::copy( sacF.sig.get(), sacF.sig.get()+npts, sac.sig.get() );
+	return sac.isValid();
+}
+
+std::shared_ptr<const SynBasisCache::StaBasis> SynGenerator::BuildBasis( const int ista, const int nbase, const float delta, float f1, float f2,
+																								 float f3, float f4, bool rotate ) {
+	if( ! traced ) TraceAll();
+	auto pb = std::make_shared<SynBasisCache::StaBasis>();
+	pb->nbase = nbase; pb->delta = delta; pb->rotate = rotate;
+	pb->f1 = f1; pb->f2 = f2; pb->f3 = f3; pb->f4 = f4;
+	for( auto& sigV : pb->sigV ) sigV.resize( 6*nbase );
+	// one unit moment tensor component at a time
+	int ista_f = ista+1, npts = nbase;
+	float deltaf = delta, aMe = 1.;
+	auto& fw = FortranWork();
+	for( int m=0; m<6; m++ ) {
+		float tme[6] = {0., 0., 0., 0., 0., 0.}; tme[m] = 1.;
+		PROFILE_SCOPE("cal_synsac_");
+		cal_synsac_( &ista_f, &its, &sigR, &sigL, pcor.get(), &f1, &f2, &f3, &f4, &vmax, &fix_vel, &iq,
+				&npts, fw.freq, &deltaf, &nper, &key_compr, &elatc, &elonc, fw.qR, fw.qL,
+				&im, &aMe, tme, ampl, cl, cr, ul, ur, wvl, wvr, v, dvdz, ratio, I0,
+				&(latc[ista]), &(lon[ista]), &(pb->sigV[0][m*nbase]), &(pb->sigV[1][m*nbase]), &(pb->sigV[2][m*nbase]), &rotate );
+	}
+	return pb;
+}
+
+
+/* ---------- SynBasisCache ---------- */
+SynBasisCache::Entry& SynBasisCache::Touch( const float elon, const float elat, const float dep, const int ista ) {
+	auto I = entryL.begin();
+	for( ; I!=entryL.end(); I++ )
+		if( I->elon==elon && I->elat==elat && I->dep==dep ) break;
+	if( I == entryL.end() ) {
+		if( entryL.size() >= nloc ) entryL.pop_back();
+		entryL.push_front( Entry{elon, elat, dep} );
+	} else if( I != entryL.begin() ) {
+		entryL.splice( entryL.begin(), entryL, I );
+	}
+	auto& entry = entryL.front();
+	if( entry.basisV.size() <= ista ) {
+		entry.basisV.resize( ista+1 );
+		entry.nvisitV.resize( ista+1, 0 );
+	}
+	return entry;
+}
+
+std::shared_ptr<const SynBasisCache::StaBasis> SynBasisCache::Find( const float elon, const float elat, const float dep,
+																						  const int ista, int& nvisit ) {
+	std::lock_guard<std::mutex> lock(mtx);
+	auto& entry = Touch( elon, elat, dep, ista );
+	nvisit = ++(entry.nvisitV[ista]);
+	return entry.basisV[ista];
+}
+
+void SynBasisCache::Insert( const float elon, const float elat, const float dep, const int ista, std::shared_ptr<const StaBasis> pb ) {
+	std::lock_guard<std::mutex> lock(mtx);
+	Touch( elon, elat, dep, ista ).basisV[ista] = std::move(pb);
+}
+
 
 void SynGenerator::WriteSACHeader( SAC_HD& shd, const int npts, const float delta, const float elat, const float elon,
 														const std::string& sta, const float slat, const float slon, 
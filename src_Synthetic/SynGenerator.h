@@ -3,7 +3,15 @@
 
 #include "SacRec.h"
 #include "ModelInfo.h"
+#include "EigenRec.h"
 #include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <sys/types.h>
 
 class fstring : public std::string {
 public:
@@ -37,6 +45,97 @@ private:
 };
 
 
+/* per-station basis of elementary synthetics: the waveforms of the six moment tensor
+	components (aM = 1), keyed by event (lon, lat, depth) and evicted least-recently-used.
+	Synthetics are linear in aM*tm, so focal-only changes (stk, dip, rak, M0, t0) become a
+	weighted sum of the basis without re-tracing or re-synthesizing.
+	A basis is built only when a (location, station) pair is visited for the second time. */
+class SynBasisCache {
+public:
+	struct StaBasis {
+		int nbase;	// FFT size of cal_synsac (a prefix of it is returned for any npts <= nbase)
+		float delta, f1, f2, f3, f4;
+		bool rotate;
+		std::vector<float> sigV[3];	// Z, R/N, T/E channels, each as [6][nbase]
+		bool Matches( const int nbase2, const float delta2, const float f12, const float f22,
+						  const float f32, const float f42, const bool rotate2 ) const {
+			return nbase==nbase2 && delta==delta2 && f1==f12 && f2==f22 && f3==f32 && f4==f42 && rotate==rotate2;
+		}
+	};
+
+	SynBasisCache( const int nloc ) : nloc(nloc) {}
+	int NLoc() const { return nloc; }
+
+	/* basis of station ista at the given location (nullptr if not built yet).
+		nvisit is set to the # of times this (location, station) pair has been asked for */
+	std::shared_ptr<const StaBasis> Find( const float elon, const float elat, const float dep, const int ista, int& nvisit );
+	void Insert( const float elon, const float elat, const float dep, const int ista, std::shared_ptr<const StaBasis> pb );
+	void clear() { std::lock_guard<std::mutex> lock(mtx); entryL.clear(); }
+
+private:
+	struct Entry {
+		float elon, elat, dep;
+		std::vector<std::shared_ptr<const StaBasis>> basisV;
+		std::vector<int> nvisitV;
+	};
+	int nloc;
+	std::list<Entry> entryL;	// most recently used first
+	std::mutex mtx;
+
+	// move the entry of the location to the front (created, and the last one evicted, when missing)
+	Entry& Touch( const float elon, const float elat, const float dep, const int ista );
+};
+
+
+/* path corrections (pcor of SynGenerator::TraceAll: the path-averaged group velocity and amplitude
+	factor at each station and period) traced from a lon-lat grid of epicenters, and interpolated
+	during a search instead of tracing. The binary file holds a header and then the nodes in order,
+	each followed by its FNV-1a hash. Nodes are written as they are traced, so an interrupted build
+	resumes from the nodes already on file. */
+class PathTable {
+public:
+	// nlon x nlat epicenters from (lon0, lat0) at dgrid (deg) for nsta stations and nper periods
+	PathTable( const float lon0, const float lat0, const float dgrid, const int nlon, const int nlat, const int nsta, const int nper )
+		: lon0(lon0), lat0(lat0), dgrid(dgrid), nlon(nlon), nlat(nlat), nsta(nsta), nper(nper)
+		, nodesize((size_t)nsta*2*nper), data(nodesize*nlon*nlat) {}
+	// copies hold the nodes only (no open file)
+	PathTable( const PathTable& pt2 )
+		: lon0(pt2.lon0), lat0(pt2.lat0), dgrid(pt2.dgrid), nlon(pt2.nlon), nlat(pt2.nlat), nsta(pt2.nsta), nper(pt2.nper)
+		, nodesize(pt2.nodesize), data(pt2.data) {}
+	PathTable& operator=( const PathTable& ) = delete;
+	~PathTable() { Close(); }
+
+	int NNode() const { return nlon*nlat; }
+	void NodeLoc( const int inode, float& lon, float& lat ) const {
+		lon = lon0 + (inode%nlon)*dgrid; lat = lat0 + (inode/nlon)*dgrid;
+	}
+	// corrections of a node as [ista][2][nper]: group velocity (<0: trace failed), amplitude factor
+	float* Node( const int inode ) { return &(data[inode*nodesize]); }
+	const float* Node( const int inode ) const { return &(data[inode*nodesize]); }
+
+	/* open fname for a build, with the key of everything the table depends on. Nodes already on
+		file are loaded and flagged in done; a file of another key is started over */
+	void Open( const std::string& fname, const uint64_t key, std::vector<char>& done );
+	// write node inode to the opened file (from any thread)
+	void WriteNode( const int inode ) const;
+	void Close();
+
+	/* fill pcor (cor(500,2,2000) of atracer) at the epicenter (lon, lat) by bilinear interpolation.
+		Paths that failed to trace from any of the 4 nodes are left to itraceV (as ista*nper+iper).
+		Returns false when (lon, lat) is off the grid */
+	bool Interpolate( const float lon, const float lat, float* pcor, std::vector<int>& itraceV ) const;
+
+private:
+	float lon0, lat0, dgrid;
+	int nlon, nlat, nsta, nper;
+	size_t nodesize;
+	std::vector<float> data;
+	int fd = -1;
+
+	static const size_t HeaderSize = 20;	// magic[8], version, key
+	off_t NodeOffset( const int inode ) const { return HeaderSize + (off_t)inode*(nodesize*sizeof(float)+sizeof(uint64_t)); }
+};
+
 class SynGeneratorData {
 public:
 	char type;
@@ -65,7 +164,8 @@ protected:
 	// tracer data (managed by unique_ptr)
 	//std::unique_ptr<float[]> pcor;
 	bool traced = false;
-	int feig_len = 0;
+	int ntrace_thd = 0;
+	//int feig_len = 0;
 };
 
 class SynGenerator : public SynGeneratorData {
@@ -77,7 +177,7 @@ public:
 		Initialize( name_fmodel, name_fphvel, name_feigen, wavetype, mode );
 	}
 	SynGenerator( const SynGenerator& sg2 ) 
-		: SynGeneratorData(sg2), minfo(sg2.minfo) {
+		: SynGeneratorData(sg2), minfo(sg2.minfo), er(sg2.er), pmodel(sg2.pmodel), ptable(sg2.ptable), pbasis(sg2.pbasis), ptrace(sg2.ptrace), staM(sg2.staM) {
 		// copy cor buff
 		if( traced ) {
 			size_t ncor = 2000*2*500;
@@ -86,29 +186,72 @@ public:
 				throw std::runtime_error("new failed for pcor!");
 			std::copy(sg2.pcor.get(), sg2.pcor.get()+ncor, pcor.get());
 		}
-		// copy feig buff
-		if( feig_len > 0 ) {
-			peig.reset( new char[feig_len] );
-			if( ! peig )
-				throw std::runtime_error("new failed for peig!");
-			std::copy(sg2.peig.get(), sg2.peig.get()+feig_len, peig.get());
-		}
 	}
 
 
 	void Initialize( const fstring& name_fmodel, const fstring& name_fphvel, const fstring& name_feigen, const char wavetype, const int mode );
+	/* load the model for atracer if not yet loaded. Copies made after this share the model;
+		otherwise each copy that traces opens one of its own */
+	void LoadModel();
 
 	// station list
 	void LoadSta( const std::string name_fsta );
-	void ClearSta() { nsta = 0; }
+	void ClearSta() { nsta = 0; staM.clear(); if(pbasis) pbasis->clear(); ptable.reset(); }
 	void PushbackSta( const SacRec& sac );
+	int NSta() const { return nsta; }
+	/* index of the station staname at exactly (slon, slat), -1 if not in the list. Resolve the
+		stations once and synthesize by index in the hot paths */
+	int FindSta( const std::string& staname, const float slon, const float slat ) const;
+
+	// keep the synthetic basis of nloc event locations (shared by copies); nloc<=0 disables the cache
+	void SetBasisCache( const int nloc ) {
+		if( nloc > 0 ) pbasis = std::make_shared<SynBasisCache>(nloc);
+		else pbasis.reset();
+	}
+
+	/* give this copy eigen tables, a path table and an (empty) basis cache of its own, allocated
+		by the calling thread. The atracer model stays shared */
+	void Detach() {
+		er.Detach();
+		if( ptable ) ptable = std::make_shared<const PathTable>( *ptable );
+		if( pbasis ) pbasis = std::make_shared<SynBasisCache>( pbasis->NLoc() );
+	}
 
 	// event info
 	void SetEvent( const ModelInfo mi );
+	/* trace all event-station paths for the current event if not yet done. After this,
+		ComputeSyn(Unit) can be called on one SynGenerator from several threads */
+	void Trace() { if( ! traced ) TraceAll(); }
+	/* # of threads to trace on (<=0: the cores left idle by the enclosing parallel regions).
+		Also recounts the cores from the current omp_get_max_threads(): call outside parallel regions */
+	void SetTraceThreads( const int nthd ) { ntrace_thd = nthd; ptrace = std::make_shared<InnerThreads>(); }
+	/* trace the current stations from a grid (step dgrid in deg) of epicenters covering the lon-lat box,
+		or resume the build in fname, and interpolate the table for events in the box from now on.
+		Adding stations drops the table */
+	void LoadPathTable( const std::string& fname, const float lonmin, const float lonmax,
+							  const float latmin, const float latmax, const float dgrid );
 
 	// produce synthetic as sac file
 	bool ComputeSyn( const std::string& staname, const float slon, const float slat, int npts, float delta, 
 						  SacRec& sacZ, SacRec& sacN, SacRec& sacE, bool rotate = true, float f1=NaN, float f2=NaN, float f3=NaN, float f4=NaN);
+	// ... for the station of index ista (FindSta)
+	bool ComputeSyn( const int ista, int npts, float delta, 
+						  SacRec& sacZ, SacRec& sacN, SacRec& sacE, bool rotate = true, float f1=NaN, float f2=NaN, float f3=NaN, float f4=NaN);
+	// synthetic of the m-th moment tensor component alone (aM = 1). ComputeSyn is the aM*tm[m] weighted sum of these
+	bool ComputeSynUnit( const int m, const std::string& staname, const float slon, const float slat, int npts, float delta, 
+								SacRec& sacZ, SacRec& sacN, SacRec& sacE, bool rotate = true, float f1=NaN, float f2=NaN, float f3=NaN, float f4=NaN);
+	bool ComputeSynUnit( const int m, const int ista, int npts, float delta, 
+								SacRec& sacZ, SacRec& sacN, SacRec& sacE, bool rotate = true, float f1=NaN, float f2=NaN, float f3=NaN, float f4=NaN);
+	// scalar moment and moment tensor of the current event
+	void MomentTensor( float& M0, float MT[6] ) const { M0 = aM; std::copy(tm, tm+6, MT); }
+
+	/* # of points to synthesize for npts so that CutSyn can serve every npts2 of the same FFT size:
+		cal_synsac outputs the first npts points of an FFT of NBase(npts), so a synthetic is a prefix of
+		the synthetic of the full FFT size. Only the b time depends on the origin time */
+	static int FullSize( const int npts ) { return std::max( npts, NBase(npts) ); }
+	/* the synthetic of npts points at origin time t0 from sacF (a synthetic of FullSize points at any t0).
+		Returns false if sacF does not cover npts (by FFT size) */
+	static bool CutSyn( const SacRec& sacF, const float t0, const int npts, SacRec& sac );
 
 	//bool Synthetic( const float lon, const float lat, const std::string& chname,
 	//					 const float f1, const float f2, const float f3, const float f4, SacRec& sac );
@@ -118,13 +261,45 @@ protected:
 	static constexpr float NaN = -123456.;
 
 private:
+	// eigen functions (parsed once and shared through the EigenRec cache)
+	EigenRec er;
 	// tracer data managed by unique_ptr
-	std::unique_ptr<char[]> peig;
 	std::unique_ptr<float[]> pcor;
+	// the model loaded by atracer_open (read-only, shared between copies)
+	std::shared_ptr<void> pmodel;
+	// precomputed path corrections (shared between copies)
+	std::shared_ptr<const PathTable> ptable;
+	// synthetic basis cache (shared between copies)
+	std::shared_ptr<SynBasisCache> pbasis;
+	// threads for TraceAll by the measured cost per trace (shared between copies; set by Initialize/SetTraceThreads)
+	std::shared_ptr<InnerThreads> ptrace;
+	// station name -> index
+	std::unordered_multimap<std::string, int> staM;
+
+	// per-thread copy of the surf_disp arrays cal_synsac modifies
+	struct FortranWorkspace { float freq[2000], qR[2000], qL[2000]; };
+	FortranWorkspace& FortranWork() const;
 
-	// trace all event-station GC paths
+	// fill the surf_disp data at the source depth (replaces the fortran surfread)
+	void FillSurfData( const float dep );
+
+	// trace all event-station GC paths, each (station, period) as a task (or interpolate the path table)
 	void TraceAll();
 
+	// synthetic of the moment tensor tmw scaled by aMw at station ista
+	bool Synthesize( const float aMw, const float* tmw, const int ista, int npts, float delta,
+						  SacRec& sacZ, SacRec& sacN, SacRec& sacE, bool rotate, float f1, float f2, float f3, float f4 );
+
+	// FFT size used by cal_synsac for npts
+	static int NBase( const int npts ) {
+		int nbase = 512;
+		for( int n2pow=9; n2pow<13 && nbase<npts; n2pow++ ) nbase <<= 1;
+		return nbase;
+	}
+	// synthesize the basis of station ista
+	std::shared_ptr<const SynBasisCache::StaBasis> BuildBasis( const int ista, const int nbase, const float delta, float f1, float f2,
+																				  float f3, float f4, bool rotate );
+
 	//void GetParams( const std::string name_fparam );
 	void ReadPerRange( const std::string& name_fphvel, const int mode );
 
@@ -0,0 +1,100 @@
+#include "SynGenerator.h"
+#include "MyOMP.h"
+
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+/* time SynGenerator::TraceAll (all event-station paths at all periods) on 1, 2, 4, ...
+	threads, for nsta stations spread over the model around the event. With a grid step, also
+	build a path table over the event +/- 0.5 deg (into TraceBench.ptab), and compare the
+	synthetics from it against those from tracing at random epicenters in the box */
+
+int main( int argc, char* argv[] ) {
+	if( argc<7 || argc>10 ) {
+		std::cerr<<"Usage: "<<argv[0]<<" [fmodel] [feigen (the phv file should be named ${feigen}.phv)] [wavetype] [evlon] [evlat] [nsta]"
+					<<" [max # of threads (optional, default=all cores)] [nrep (optional, default=5)] [path table grid in deg (optional, default=no table)]"<<std::endl;
+		exit(-1);
+	}
+	const float evlon = atof(argv[4]), evlat = atof(argv[5]), dgrid = argc>9 ? atof(argv[9]) : 0.;
+	const int nsta = atoi(argv[6]), nthdmax = argc>7 ? atoi(argv[7]) : omp_get_max_threads(), nrep = argc>8 ? atoi(argv[8]) : 5;
+	if( nsta<=0 || nsta>2000 || nthdmax<=0 || nrep<=0 ) {
+		std::cerr<<"Invalid nsta/nthread/nrep: "<<nsta<<" "<<nthdmax<<" "<<nrep<<std::endl;
+		exit(-2);
+	}
+
+	SynGenerator synG( argv[1], std::string(argv[2])+".phv", argv[2], argv[3][0], 0 );
+	// stations on a 10x10 deg grid centered at the event
+	const int ngrid = ceil(sqrt(nsta));
+	for( int i=0; i<nsta; i++ ) {
+		SacRec sac;
+		// nsta <= 2000: the names stay unique within the 4 digits kstnm has room for
+		snprintf(sac.shd.kstnm, sizeof(sac.shd.kstnm), "S%04d", i%10000); snprintf(sac.shd.knetwk, sizeof(sac.shd.knetwk), "XX");
+		sac.shd.stlo = evlon - 5. + 10.*(i%ngrid+0.5)/ngrid;
+		sac.shd.stla = evlat - 5. + 10.*(i/ngrid+0.5)/ngrid;
+		synG.PushbackSta( sac );
+	}
+	const ModelInfo mi( evlon, evlat, 0., 0., 45., 90., 10., 1.e23 );
+
+	float t1 = 0.;
+	for( int nthd=1; nthd<=nthdmax; nthd*=2 ) {
+		synG.SetTraceThreads( nthd );
+		synG.SetEvent( mi ); synG.Trace();	// warm up (and load the model)
+		auto tb = std::chrono::steady_clock::now();
+		for( int irep=0; irep<nrep; irep++ ) {
+			synG.SetEvent( mi );	// needs re-trace
+			synG.Trace();
+		}
+		const float t = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now()-tb).count() / nrep;
+		if( nthd == 1 ) t1 = t;
+		std::cout<<"### "<<nthd<<" thread(s): "<<t<<" ms per TraceAll (x"<<t1/t<<"). ###"<<std::endl;
+	}
+	if( dgrid <= 0. ) return 0;
+
+	// path table: build time, and the time of an interpolated TraceAll
+	SynGenerator synGT( synG );
+	synGT.SetTraceThreads( nthdmax );
+	auto tb = std::chrono::steady_clock::now();
+	synGT.LoadPathTable( "TraceBench.ptab", evlon-0.5, evlon+0.5, evlat-0.5, evlat+0.5, dgrid );
+	std::cout<<"### path table (grid "<<dgrid<<" deg): built/loaded in "
+				<<std::chrono::duration<float>(std::chrono::steady_clock::now()-tb).count()<<" sec. ###"<<std::endl;
+	tb = std::chrono::steady_clock::now();
+	for( int irep=0; irep<nrep; irep++ ) {
+		synGT.SetEvent( mi );
+		synGT.Trace();
+	}
+	const float t = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now()-tb).count() / nrep;
+	std::cout<<"### "<<t<<" ms per TraceAll from the table (x"<<t1/t<<"). ###"<<std::endl;
+
+	// synthetics at random epicenters in the box: |diff|/|sig| (L2) of each station
+	std::mt19937 gen(7); std::uniform_real_distribution<float> U(-0.5, 0.5);
+	const int nevent = 20, npts = 1024;
+	float dmean = 0., dmax = 0.; int nsyn = 0;
+	for( int iev=0; iev<nevent; iev++ ) {
+		ModelInfo mir = mi; mir.lon += U(gen); mir.lat += U(gen);
+		synG.SetEvent( mir ); synGT.SetEvent( mir );
+		for( int i=0; i<nsta; i++ ) {
+			const std::string staname = "S" + std::string(4-std::min(4, (int)std::to_string(i).size()), '0') + std::to_string(i);
+			const float stlo = evlon - 5. + 10.*(i%ngrid+0.5)/ngrid, stla = evlat - 5. + 10.*(i/ngrid+0.5)/ngrid;
+			SacRec z1, n1, e1, z2, n2, e2;
+			if( ! synG.ComputeSyn( staname, stlo, stla, npts, 1., z1, n1, e1, false ) ) continue;
+			if( ! synGT.ComputeSyn( staname, stlo, stla, npts, 1., z2, n2, e2, false ) ) continue;
+			for( auto sacp : { std::make_pair(&z1, &z2), std::make_pair(&e1, &e2) } ) {
+				double s2 = 0., d2 = 0.;
+				for( int j=0; j<npts; j++ ) {
+					const float s = sacp.first->sig[j], d = s - sacp.second->sig[j];
+					s2 += s*s; d2 += d*d;
+				}
+				if( s2 <= 0. ) continue;
+				const float d = sqrt(d2/s2);
+				dmean += d; dmax = std::max(dmax, d); nsyn++;
+			}
+		}
+	}
+	std::cout<<"### table vs tracing, "<<nsyn<<" synthetics at "<<nevent<<" epicenters: |diff|/|sig| mean = "
+				<<dmean/std::max(nsyn,1)<<" max = "<<dmax<<". ###"<<std::endl;
+
+	return 0;
+}
@@ -9,132 +9,133 @@ c      parameter (Cnlon=201)
       parameter (npermax=500)
       parameter (nlatmax=200)
       parameter (nlonmax=300)
+c --- ray workspace: model geometry, the current cell (ic,jc), and
+c --- the maps of one period. One per trace, so traces are reentrant
       type tmdl
          integer*4 ic,jc,n,nper,nfi,nla
          real*8 fi,sfi,la,sla,per,sper,bf,ef,bl,el,bp,ep,
      +          hfi(nlatmax),hla(nlonmax),hper(npermax),chfi(nlatmax)
-         real*8 uw(nlatmax,nlonmax),cw(nlatmax,nlonmax)
-         real*8 gw(nlatmax,nlonmax),aw(nlatmax,nlonmax)
+c --- maps of the period being traced (pointers into tmodel)
+         real*8, pointer, dimension(:,:) :: uw=>null(),cw=>null(),
+     +                                      gw=>null(),aw=>null()
       end type
 
+c --- vel/Q tables of all periods as uw(nfi,nla,nper) etc., and the
+c --- geometry every workspace starts from. Read-only once loaded
       type tmodel
          integer*4 n, nper, nfi, nla
          real*8 fi, sfi, la, sla, per, sper
          real*8, allocatable, dimension(:,:,:) :: uw,cw,gw,aw
 C         real*8 uw(225,97,201), cw(225,97,201)
 C         real*8 gw(225,97,201), aw(225,97,201)
+         type (tmdl) geo
       end type
 
       end module mmodel
 
 c  ---------------------------------------------
-c  fmodel = model (vel/Q table) binary file name
-c  fsol = event latitude
-c  lsol = event longitude
-c  nstai = No. of stations
-c  fici = station latitudes
-c  lami = station longitudes
+c  atracer_open: load the model (vel/Q table) binary file
+c  fmodel = model file name
+c  nperi = No. of periods expected
+c  handle = the loaded model (released by atracer_close)
+c  ierr = 0 (success), 1 (IO failed), 2 (model dimensions
+c         exceed limits), 3 (No. periods mismatch)
 c  ---------------------------------------------
-      recursive subroutine atracer(fmodel,fsol,lsol,n,applyQ, nperi,nstai,fici,lami, cor)
+      recursive subroutine atracer_open(fmodel,nperi,handle,ierr)
       use mmodel
-      use omp_lib
+      use iso_c_binding
       implicit none
-
-c ---
-c --- assuming nper<=500 and nsta<=2000!
-      integer*4 nstamax
-      parameter (nstamax=2000)
-C      character*8 codi(2000)
-      integer*4   nperi, nstai
-      real*4      fici(nstamax),lami(nstamax)
-C      common /stn/ nstai,codi,figi,fici,lami
-C      common /mdl/ic,jc,nn,nper,nfi,nla,fi,sfi,la,sla,pper,sper,
-C     +        bf,ef,bl,el,bp,ep,
-C     +        hfi,hla,hper,chfi,uw,cw,gw,aw
-      real*4 cor(npermax,2,nstamax)
-C      common /trk/ cor
-c ---
-      logical*1 applyQ
-      real*4 fsol,lsol
-      real*8 afi,del,per
-      real *8 GEO,rad,pi2,sol(3),dst(3),trres(4),sine,cosi
-      integer*4 ierr,k,ntr,n,m,lnblnk
-c     real*8     cor(500,2,2000)
       character *256 fmodel
-C      data GEO/1.0/
-      data GEO/0.993277d0/
+      integer*4 nperi,ierr
+      type (c_ptr) handle
+      real*8 per
+      type (tmodel), pointer :: model
 
-      type (tmdl) mdl
-      type (tmodel) model
-
-      if( nstai.gt.nstamax ) then
-         write(*,*) "#sta = ",nstai," nstamax = ",nstamax
-         STOP "No. stations exceeds limit"
+      handle = c_null_ptr
+      allocate (model)
+      call read_model_file(fmodel, model, ierr)
+      if( ierr.eq.0 .and. nperi.ne.model%nper ) then
+         write(*,*) "nper-in = ",nperi," nper-mfile = ",model%nper
+         ierr = 3
       endif
-c      allocate (model%uw(Cnper,Cnlat,Cnlon))
-c      allocate (model%cw(Cnper,Cnlat,Cnlon))
-c      allocate (model%gw(Cnper,Cnlat,Cnlon))
-c      allocate (model%aw(Cnper,Cnlat,Cnlon))
+      if( ierr.ne.0 ) then
+         deallocate (model)
+         return
+      endif
+      call read_rect_model(model,0,per,ierr, model%geo)
+      handle = c_loc(model)
+      end
+
+c  ---------------------------------------------
+c  atracer_trace: trace one event-station path at one period.
+c  The ray workspace is local, so any number of threads can
+c  trace from the same handle at once
+c  handle = model from atracer_open
+c  k = period index (1 - nper)
+c  fsol, lsol = event latitude, longitude
+c  fici, lami = station latitude, longitude
+c  cor1 = path averaged group velocity (-1 if failed)
+c  cor2 = amplitude factor (0 if failed)
+c  ---------------------------------------------
+      recursive subroutine atracer_trace(handle,k,fsol,lsol,applyQ,
+     +                                   fici,lami,cor1,cor2)
+      use mmodel
+      use iso_c_binding
+      implicit none
+      type (c_ptr) handle
+      integer*4 k
+      logical*1 applyQ
+      real*4 fsol,lsol,fici,lami,cor1,cor2
 c ---
+      real*8 GEO
+      parameter (GEO=0.993277d0)
+      real*8 afi,del,per,rad,sol(3),dst(3),trres(4)
+      integer*4 ierr,ntr
+      type (tmodel), pointer :: model
+      type (tmdl) mdl
+
+      call c_f_pointer(handle, model)
       rad = datan(1.0d0)/45.0d0
-      pi2 = datan(1.0d0)*8.0d0
-C      write(*,*) fmodel(1:lnblnk(fmodel))
 c --- get event coordinates ----
-C      fsol = datan(GEO*dtan(rad*fsol))/rad
       afi = datan(GEO*dtan(rad*fsol))/rad
       sol(1)=DSIN((90.0d0-afi)*rad)*DCOS(lsol*rad)
       sol(2)=DSIN((90.0d0-afi)*rad)*DSIN(lsol*rad)
       sol(3)=DCOS((90.0d0-afi)*rad)
-c --- MAIN LOOP ------------
+c --- station coordinates (geocentric already) ----
+      afi = fici
+      dst(1)=DSIN((90.0d0-afi)*rad)*DCOS(lami*rad)
+      dst(2)=DSIN((90.0d0-afi)*rad)*DSIN(lami*rad)
+      dst(3)=DCOS((90.0d0-afi)*rad)
+c --- workspace at period k ----
+      mdl = model%geo
+      call read_rect_model(model,k,per,ierr, mdl)
       ntr = 4
-
-!$OMP CRITICAL (IO)
-      call read_model_file(fmodel, model)
-!$OMP END CRITICAL (IO)
-
-      if( nperi.ne.model%nper ) then
-         write(*,*) "nper-in = ",nperi," nper-mfile = ",model%nper
-         STOP "No. periods mismatch"
+      if(ierr.eq.0) call tracer(sol,dst,.01d0,ntr,trres,del,0,ierr, mdl)
+      if(ierr.eq.0) then
+         cor1 = 6371.0*del/trres(2)
+         if( applyQ ) then
+            cor2 = dexp(-trres(3))*trres(4)
+         else
+            cor2 = trres(4)
+         endif
+      else
+         cor1 = -1
+         cor2 = 0
       endif
+      end
+
+c  ---------------------------------------------
+c  atracer_close: release a model from atracer_open
+c  ---------------------------------------------
+      recursive subroutine atracer_close(handle)
+      use mmodel
+      use iso_c_binding
+      implicit none
+      type (c_ptr) handle
+      type (tmodel), pointer :: model
 
-      call read_rect_model(model,0,per,ierr, mdl)
-C      n = 0
-      do k = 1,model%nper
-        call read_rect_model(model,1,per,ierr, mdl)
-        do m = 1,nstai
-c     write(*,*) per,ierr
-c         afi = datan(GEO*dtan(rad*figi(m)))/rad
-          afi = fici(m)
-          dst(1)=DSIN((90.0d0-afi)*rad)*DCOS(lami(m)*rad)
-          dst(2)=DSIN((90.0d0-afi)*rad)*DSIN(lami(m)*rad)
-          dst(3)=DCOS((90.0d0-afi)*rad)
-          call tracer(sol,dst,.01d0,ntr,trres,del,0,ierr, mdl)
-cMB    write(*,*) 'X ',per,trres,del
-          if(ierr.eq.0) then  
-cMB     trres(2) = trres(2)*pi2/per
-cMB     cor(k) = dcmplx(dcos(trres(2)),dsin(trres(2)))*dexp(-trres(3))*trres(4)
-cMB     write(*,*) 'A ', per,6371.0*del,trres(2)
-            cor(k,1,m) = 6371.0*del/trres(2)
-C         write(*,*) k," ",1," ",m,"   ",del,"   ",trres(2)
-            if( applyQ ) then
-               cor(k,2,m) = dexp(-trres(3))*trres(4)
-C               if(per.eq.16.) write(*,*) " applyQ: ",trres(3), trres(4)
-            else
-               cor(k,2,m) = trres(4)
-            endif
-CCC     write(*,*) m,per, 6371.0*del,cor(k,1,m)
-c       write(*,*) per,trres,cor(k)
-          else
-            cor(k,1,m) = -1
-            cor(k,2,m) = 0
-          endif
-        enddo
-      enddo
-C      n = 225
-      call read_rect_model(model,-1,per,ierr, mdl)
-      deallocate (model%uw)
-      deallocate (model%cw)
-      deallocate (model%gw)
-      deallocate (model%aw)
-C      write(*,*) "atracer done: ",cor(1,1,1)," ",cor(2,1,2)," ",cor(3,2,3)," ",cor(300,1,999)
+      if( .not.c_associated(handle) ) return
+      call c_f_pointer(handle, model)
+      deallocate (model)
+      handle = c_null_ptr
       end
@@ -33,11 +33,13 @@
 C         character*80 outseism(50),outtit(50),outspec(50)
 C         character*255 current
 C         character*256 fnam11,fnam12,fnam13
-         data unitC/1.E-7/, step/(1.0,0.0)/, pi/3.14159265/
+C        step is assigned per call: a data-initialized local is static and shared by all threads
+         data unitC/1.E-7/, pi/3.14159265/
 C         common /trk/ cor
 C         common /stn/ nstai,codi,figi,fici,lami,neti
 
          drad = pi/180.
+         step = (1.0,0.0)
 
 C      write(*,*) "check cor in cal_synsac: ",cor(1,1,1)," ",cor(2,1,2)," ",cor(15,1,33)," ",cor(300,1,999)
 C      write(*,*) "check cor in cal_synsac: ",cor(1,2,1)," ",cor(2,2,2)," ",cor(15,2,33)," ",cor(300,2,999)
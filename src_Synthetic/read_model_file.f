@@ -1,33 +1,40 @@
 c ==========================================================
 c read rectangular models into memory
 c ==========================================================
-      recursive subroutine read_model_file(fname,model)
+c ierr = 0 (success), 1 (IO failed), 2 (dimensions exceed limits)
+      recursive subroutine read_model_file(fname,model,ierr)
       use mmodel
       implicit none
-      integer*4 iper
+      integer*4 iper,iu,ierr
       character*255 fname
 
       type (tmodel) model
 
 c --- read unformated file for period per--
 C      write(*,*) fname
-      open(30,file=fname,form='unformatted')
-      read(30) model%n,model%fi,model%nfi,model%sfi,model%la,model%nla,model%sla,model%per,model%nper,model%sper
+c --- (unit from newunit: several models can be read at once)
+      ierr = 1
+      open(newunit=iu,file=fname,form='unformatted',status='old',err=9)
+      read(iu,err=8,end=8) model%n,model%fi,model%nfi,model%sfi,model%la,model%nla,model%sla,model%per,model%nper,model%sper
       if( model%nfi.gt.nlatmax.OR.model%nla.gt.nlonmax.OR.model%nper.gt.npermax ) then
-         STOP 'model dimension exceeds limits'
+         write(*,*) 'model dimension exceeds limits'
+         ierr = 2
+         goto 8
       endif
 c      write(*,*) model%nfi, model%nla, model%nper
 
-      allocate (model%uw(model%nper,model%nfi,model%nla))
-      allocate (model%cw(model%nper,model%nfi,model%nla))
-      allocate (model%gw(model%nper,model%nfi,model%nla))
-      allocate (model%aw(model%nper,model%nfi,model%nla))
+c --- period last: the maps of each period are contiguous
+      allocate (model%uw(model%nfi,model%nla,model%nper))
+      allocate (model%cw(model%nfi,model%nla,model%nper))
+      allocate (model%gw(model%nfi,model%nla,model%nper))
+      allocate (model%aw(model%nfi,model%nla,model%nper))
 
 C      write(*,*) " in read 1: ",model%n,model%fi,model%nfi,model%sfi,model%la,model%nla,model%sla,model%per,model%nper,model%sper
       do iper=1,model%nper
-         read(30) model%uw(iper,:,:),model%cw(iper,:,:),model%gw(iper,:,:),model%aw(iper,:,:)
-C         write(*,*) model%uw(iper,:,:),model%cw(iper,:,:),model%gw(iper,:,:),model%aw(iper,:,:)
+         read(iu,err=8,end=8) model%uw(:,:,iper),model%cw(:,:,iper),model%gw(:,:,iper),model%aw(:,:,iper)
+C         write(*,*) model%uw(:,:,iper),model%cw(:,:,iper),model%gw(:,:,iper),model%aw(:,:,iper)
       enddo
-      close(30)
-      end
+      ierr = 0
+    8 close(iu)
+    9 end
 
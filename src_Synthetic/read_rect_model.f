@@ -2,6 +2,8 @@ c ==========================================================
 c read rectangular models into memory
 c ==========================================================
 
+c nmod = 0: model geometry into mdl
+c nmod = k > 0: mdl to the maps of period k (p = the period)
       recursive subroutine read_rect_model(model,nmod,p,ierr,mdl)
       use mmodel
       use omp_lib
@@ -11,7 +13,7 @@ c ==========================================================
 C      integer*4 TID
 
       type (tmdl) mdl
-      type (tmodel) model
+      type (tmodel), target :: model
 
 c ---
       ierr = 0
@@ -47,16 +49,18 @@ C     +           mdl%n,mdl%fi,mdl%nfi,mdl%sfi,mdl%la,mdl%nla,mdl%sla,mdl%per,md
         mdl%bp = mdl%hper(1)
         mdl%ep = mdl%hper(mdl%nper)
         return
-      else if(nmod.eq.-1) then
+      else if(nmod.lt.0.or.nmod.gt.mdl%nper) then
+        ierr = 1
         return
       endif
-      p = mdl%per+mdl%n*mdl%sper
-      mdl%n = mdl%n+1
+      mdl%n = nmod
+      p = mdl%per+(mdl%n-1)*mdl%sper
 C      read(fid) mdl%uw,mdl%cw,mdl%gw,mdl%aw
-      mdl%uw(1:model%nfi,1:model%nla) = model%uw(mdl%n,:,:)
-      mdl%cw(1:model%nfi,1:model%nla) = model%cw(mdl%n,:,:)
-      mdl%gw(1:model%nfi,1:model%nla) = model%gw(mdl%n,:,:)
-      mdl%aw(1:model%nfi,1:model%nla) = model%aw(mdl%n,:,:)
+c --- no copy: the maps are shared (read-only) by all workspaces
+      mdl%uw => model%uw(:,:,mdl%n)
+      mdl%cw => model%cw(:,:,mdl%n)
+      mdl%gw => model%gw(:,:,mdl%n)
+      mdl%aw => model%aw(:,:,mdl%n)
 C      write(*,*) " in read 2: ",uw,cw,gw,aw
       end
 